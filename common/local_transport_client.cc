@@ -0,0 +1,150 @@
+#include "local_transport_client.h"
+
+#include <chrono>
+
+namespace common {
+
+namespace {
+// The inputs are aligned for any element type and vector loads.
+constexpr size_t kInputAlignment = 64;
+}  // namespace
+
+Error LocalTransportClient::Create(const std::string& name, const std::string& client,
+                                   const size_t input_byte_size, const size_t output_byte_size,
+                                   const uint64_t timeout_ms,
+                                   std::unique_ptr<LocalTransportClient>* local_client) {
+  if (client.empty() || (client.find('.') != std::string::npos)) {
+    return Error(Error::Code::INVALID_ARG,
+                 "invalid local transport client name '" + client + "'");
+  }
+  std::unique_ptr<LocalTransportClient> lclient(
+      new LocalTransportClient(name, client, input_byte_size, output_byte_size));
+  const std::string prefix = LocalResponseChannelName(name, client);
+  if (!lclient->input_segment_.acquire((prefix + ".input").c_str(), input_byte_size) ||
+      !lclient->output_segment_.acquire((prefix + ".output").c_str(), output_byte_size)) {
+    return Error(Error::Code::UNAVAILABLE,
+                 "failed to create the shared memory segments of local transport client '" +
+                 client + "'");
+  }
+  // Listening for the responses before any request is sent.
+  if (!lclient->response_channel_.connect(prefix.c_str(), ipc::receiver) ||
+      !lclient->request_channel_.connect(name.c_str(), ipc::sender) ||
+      !lclient->request_channel_.wait_for_recv(1, timeout_ms)) {
+    return Error(Error::Code::UNAVAILABLE, "no local transport '" + name + "' to connect to");
+  }
+  *local_client = std::move(lclient);
+  return Error::Success;
+}
+
+LocalTransportClient::~LocalTransportClient() {
+  if (request_channel_.valid()) {
+    std::string message;
+    SerializeLocalDisconnect(client_, &message);
+    request_channel_.send(message.data(), message.size());
+  }
+}
+
+Error LocalTransportClient::AddInput(const std::string& name, const SERVER_DataType datatype,
+                                     const std::vector<int64_t>& shape, const size_t byte_size,
+                                     void** buffer) {
+  const size_t offset = (input_used_ + kInputAlignment - 1) / kInputAlignment * kInputAlignment;
+  if ((offset > input_byte_size_) || (input_byte_size_ - offset < byte_size)) {
+    return Error(Error::Code::INVALID_ARG,
+                 "input '" + name + "' of " + std::to_string(byte_size) +
+                 " bytes doesn't fit in the input segment of " +
+                 std::to_string(input_byte_size_) + " bytes");
+  }
+  LocalTensor input;
+  input.name_ = name;
+  input.datatype_ = datatype;
+  input.shape_ = shape;
+  input.region_.segment_ = input_segment_.name();
+  input.region_.segment_byte_size_ = input_byte_size_;
+  input.region_.offset_ = offset;
+  input.region_.byte_size_ = byte_size;
+  request_.inputs_.push_back(input);
+  input_used_ = offset + byte_size;
+  *buffer = static_cast<char*>(input_segment_.get()) + offset;
+  return Error::Success;
+}
+
+void LocalTransportClient::AddRequestedOutput(const std::string& name) {
+  request_.requested_outputs_.push_back(name);
+}
+
+Error LocalTransportClient::Infer(const std::string& model_name, const int64_t model_version,
+                                  const uint64_t timeout_ms, std::vector<Output>* outputs) {
+  if (timed_out_) {
+    return Error(Error::Code::UNAVAILABLE,
+                 "local transport client '" + client_ + "' timed out on an inference");
+  }
+  // The inputs are only for this inference, whatever its outcome.
+  LocalInferRequest request;
+  std::swap(request, request_);
+  input_used_ = 0;
+
+  request.client_ = client_;
+  request.sequence_id_ = ++sequence_id_;
+  request.model_name_ = model_name;
+  request.model_version_ = model_version;
+  request.output_region_.segment_ = output_segment_.name();
+  request.output_region_.segment_byte_size_ = output_byte_size_;
+  request.output_region_.offset_ = 0;
+  request.output_region_.byte_size_ = output_byte_size_;
+  std::string message;
+  SerializeLocalRequest(request, &message);
+  if (!request_channel_.send(message.data(), message.size())) {
+    return Error(Error::Code::UNAVAILABLE, "failed to send to local transport '" + name_ + "'");
+  }
+
+  outputs->clear();
+  Error error;
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (true) {
+    const auto now = std::chrono::steady_clock::now();
+    ipc::buff_t received;
+    if (now < deadline) {
+      received = response_channel_.recv(
+          std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1);
+    }
+    if (received.empty()) {
+      timed_out_ = true;
+      return Error(Error::Code::UNAVAILABLE,
+                   "inference on local transport '" + name_ + "' timed out");
+    }
+    LocalInferResponse response;
+    Error parsed = DeserializeLocalResponse(received.data(), received.size(), &response);
+    if (!parsed.IsOk()) {
+      return parsed;
+    }
+    // A late response to an earlier inference.
+    if (response.sequence_id_ != request.sequence_id_) {
+      continue;
+    }
+    if ((response.error_code_ != static_cast<uint32_t>(Error::Code::SUCCESS)) && error.IsOk()) {
+      error = Error(static_cast<Error::Code>(response.error_code_), response.error_message_);
+    }
+    for (const auto& tensor : response.outputs_) {
+      const ShmRegion& region = tensor.region_;
+      if ((region.segment_ != request.output_region_.segment_) ||
+          (region.offset_ > output_byte_size_) ||
+          (output_byte_size_ - region.offset_ < region.byte_size_)) {
+        return Error(Error::Code::INTERNAL,
+                     "output '" + tensor.name_ + "' is outside of the output segment");
+      }
+      Output output;
+      output.name_ = tensor.name_;
+      output.datatype_ = static_cast<SERVER_DataType>(tensor.datatype_);
+      output.shape_ = tensor.shape_;
+      output.base_ = static_cast<const char*>(output_segment_.get()) + region.offset_;
+      output.byte_size_ = region.byte_size_;
+      outputs->push_back(output);
+    }
+    if ((response.flags_ & SERVER_RESPONSE_COMPLETE_FINAL) != 0) {
+      return error;
+    }
+  }
+}
+
+} // namespace common
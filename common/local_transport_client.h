@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "error.h"
+#include "local_transport_protocol.h"
+#include "interface/IServer.h"
+#include "libipc/ipc.h"
+#include "libipc/shm.h"
+
+namespace common {
+
+// A client of the local transport of a server on the same host. The
+// client writes the inputs in place into its input segment and the
+// server writes the outputs into its output segment, only descriptors of
+// the tensors go over the channels. A client runs one inference at a
+// time, processes and threads needing more run more clients.
+class LocalTransportClient {
+ public:
+  // An output of an inference, in the output segment of the client.
+  struct Output {
+    std::string name_;
+    SERVER_DataType datatype_;
+    std::vector<int64_t> shape_;
+    const void* base_;
+    size_t byte_size_;
+  };
+
+  // Connect as 'client', a name unique among the clients of the server,
+  // to the transport 'name', waiting up to 'timeout_ms' for the server.
+  // The segments hold the inputs and the outputs of an inference.
+  static Error Create(const std::string& name, const std::string& client,
+                      const size_t input_byte_size, const size_t output_byte_size,
+                      const uint64_t timeout_ms, std::unique_ptr<LocalTransportClient>* local_client);
+  ~LocalTransportClient();
+
+  // Add an input to the next inference, returning the buffer of
+  // 'byte_size' bytes in the input segment to write its data into.
+  Error AddInput(const std::string& name, const SERVER_DataType datatype,
+                 const std::vector<int64_t>& shape, const size_t byte_size, void** buffer);
+  // Request an output of the next inference, all the outputs of the
+  // model are produced if none is requested.
+  void AddRequestedOutput(const std::string& name);
+
+  // Run an inference on the inputs added since the last one, waiting up
+  // to 'timeout_ms' for it to complete. The outputs of a decoupled model
+  // are those of all its responses. The outputs are valid until the next
+  // inference. A client whose inference timed out is unusable, the
+  // server may still read its inputs.
+  Error Infer(const std::string& model_name, const int64_t model_version,
+              const uint64_t timeout_ms, std::vector<Output>* outputs);
+
+ private:
+  LocalTransportClient(const std::string& name, const std::string& client,
+                       const size_t input_byte_size, const size_t output_byte_size)
+    : name_(name), client_(client), sequence_id_(0), input_byte_size_(input_byte_size),
+      output_byte_size_(output_byte_size), input_used_(0), timed_out_(false) {}
+
+  const std::string name_;
+  const std::string client_;
+  uint64_t sequence_id_;
+
+  ipc::channel request_channel_;
+  ipc::channel response_channel_;
+  ipc::shm::handle input_segment_;
+  ipc::shm::handle output_segment_;
+  const size_t input_byte_size_;
+  const size_t output_byte_size_;
+
+  // The next inference, its inputs taking the start of the input segment.
+  LocalInferRequest request_;
+  size_t input_used_;
+  bool timed_out_;
+};
+
+} // namespace common
@@ -0,0 +1,232 @@
+#include "local_transport_protocol.h"
+
+#include <string.h>
+
+#define RETURN_IF_READ_ERROR(E)      \
+  do {                               \
+    const Error& error__ = (E);      \
+    if (!error__.IsOk()) {           \
+      return error__;                \
+    }                                \
+  } while (false)
+
+namespace common {
+
+namespace {
+// Tells the messages of the transport from stray ones, and their
+// layout, which changes with the version.
+constexpr uint32_t kMagic = 0x544c434c;  // "LCLT"
+constexpr uint32_t kVersion = 1;
+
+class Writer {
+ public:
+  explicit Writer(std::string* message) : message_(message) {}
+
+  template <typename T>
+  void Append(const T value) {
+    message_->append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+  void Append(const std::string& value) {
+    Append<uint32_t>(value.size());
+    message_->append(value);
+  }
+  void Append(const ShmRegion& region) {
+    Append(region.segment_);
+    Append<uint64_t>(region.segment_byte_size_);
+    Append<uint64_t>(region.offset_);
+    Append<uint64_t>(region.byte_size_);
+  }
+  void Append(const LocalTensor& tensor) {
+    Append(tensor.name_);
+    Append<uint32_t>(tensor.datatype_);
+    Append<uint32_t>(tensor.shape_.size());
+    for (const int64_t dim : tensor.shape_) {
+      Append<int64_t>(dim);
+    }
+    Append(tensor.region_);
+  }
+  void AppendHeader(const LocalMessageType type) {
+    Append<uint32_t>(kMagic);
+    Append<uint32_t>(kVersion);
+    Append<uint32_t>(static_cast<uint32_t>(type));
+  }
+
+ private:
+  std::string* message_;
+};
+
+// Reads a message, failing instead of reading past its end.
+class Reader {
+ public:
+  Reader(const void* base, const size_t byte_size)
+    : base_(reinterpret_cast<const char*>(base)), byte_size_(byte_size), offset_(0) {}
+
+  template <typename T>
+  Error Read(T* value) {
+    if (byte_size_ - offset_ < sizeof(T)) {
+      return Truncated();
+    }
+    memcpy(value, base_ + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return Error::Success;
+  }
+  Error Read(std::string* value) {
+    uint32_t size = 0;
+    RETURN_IF_READ_ERROR(Read(&size));
+    if (byte_size_ - offset_ < size) {
+      return Truncated();
+    }
+    value->assign(base_ + offset_, size);
+    offset_ += size;
+    return Error::Success;
+  }
+  Error Read(ShmRegion* region) {
+    RETURN_IF_READ_ERROR(Read(&region->segment_));
+    RETURN_IF_READ_ERROR(Read(&region->segment_byte_size_));
+    RETURN_IF_READ_ERROR(Read(&region->offset_));
+    return Read(&region->byte_size_);
+  }
+  Error Read(LocalTensor* tensor) {
+    RETURN_IF_READ_ERROR(Read(&tensor->name_));
+    RETURN_IF_READ_ERROR(Read(&tensor->datatype_));
+    uint32_t dim_count = 0;
+    RETURN_IF_READ_ERROR(Read(&dim_count));
+    // Checked before resizing so that a bad count doesn't allocate.
+    if ((byte_size_ - offset_) / sizeof(int64_t) < dim_count) {
+      return Truncated();
+    }
+    tensor->shape_.resize(dim_count);
+    for (auto& dim : tensor->shape_) {
+      RETURN_IF_READ_ERROR(Read(&dim));
+    }
+    return Read(&tensor->region_);
+  }
+  template <typename T>
+  Error Read(std::vector<T>* values) {
+    uint32_t count = 0;
+    RETURN_IF_READ_ERROR(Read(&count));
+    // Each value takes at least 4 bytes.
+    if ((byte_size_ - offset_) / sizeof(uint32_t) < count) {
+      return Truncated();
+    }
+    values->resize(count);
+    for (auto& value : *values) {
+      RETURN_IF_READ_ERROR(Read(&value));
+    }
+    return Error::Success;
+  }
+  Error ReadHeader(const LocalMessageType expected) {
+    LocalMessageType type;
+    RETURN_IF_READ_ERROR(ReadHeader(&type));
+    if (type != expected) {
+      return Error(Error::Code::INVALID_ARG,
+                   "unexpected local transport message of type " +
+                   std::to_string(static_cast<uint32_t>(type)));
+    }
+    return Error::Success;
+  }
+  Error ReadHeader(LocalMessageType* type) {
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    RETURN_IF_READ_ERROR(Read(&magic));
+    RETURN_IF_READ_ERROR(Read(&version));
+    if ((magic != kMagic) || (version != kVersion)) {
+      return Error(Error::Code::INVALID_ARG, "not a local transport message of version " +
+                                             std::to_string(kVersion));
+    }
+    uint32_t value = 0;
+    RETURN_IF_READ_ERROR(Read(&value));
+    *type = static_cast<LocalMessageType>(value);
+    return Error::Success;
+  }
+
+ private:
+  Error Truncated() const {
+    return Error(Error::Code::INVALID_ARG,
+                 "truncated local transport message of " + std::to_string(byte_size_) +
+                 " bytes");
+  }
+
+  const char* base_;
+  const size_t byte_size_;
+  size_t offset_;
+};
+}  // namespace
+
+Error LocalMessageTypeOf(const void* base, const size_t byte_size, LocalMessageType* type) {
+  Reader reader(base, byte_size);
+  return reader.ReadHeader(type);
+}
+
+void SerializeLocalRequest(const LocalInferRequest& request, std::string* message) {
+  Writer writer(message);
+  writer.AppendHeader(LocalMessageType::INFER_REQUEST);
+  writer.Append(request.client_);
+  writer.Append<uint64_t>(request.sequence_id_);
+  writer.Append(request.model_name_);
+  writer.Append<int64_t>(request.model_version_);
+  writer.Append<uint32_t>(request.inputs_.size());
+  for (const auto& input : request.inputs_) {
+    writer.Append(input);
+  }
+  writer.Append<uint32_t>(request.requested_outputs_.size());
+  for (const auto& output : request.requested_outputs_) {
+    writer.Append(output);
+  }
+  writer.Append(request.output_region_);
+}
+
+void SerializeLocalResponse(const LocalInferResponse& response, std::string* message) {
+  Writer writer(message);
+  writer.AppendHeader(LocalMessageType::INFER_RESPONSE);
+  writer.Append<uint64_t>(response.sequence_id_);
+  writer.Append<uint32_t>(response.flags_);
+  writer.Append<uint32_t>(response.error_code_);
+  writer.Append(response.error_message_);
+  writer.Append<uint32_t>(response.outputs_.size());
+  for (const auto& output : response.outputs_) {
+    writer.Append(output);
+  }
+}
+
+void SerializeLocalDisconnect(const std::string& client, std::string* message) {
+  Writer writer(message);
+  writer.AppendHeader(LocalMessageType::DISCONNECT);
+  writer.Append(client);
+}
+
+Error DeserializeLocalRequest(const void* base, const size_t byte_size,
+                              LocalInferRequest* request) {
+  Reader reader(base, byte_size);
+  RETURN_IF_READ_ERROR(reader.ReadHeader(LocalMessageType::INFER_REQUEST));
+  RETURN_IF_READ_ERROR(reader.Read(&request->client_));
+  RETURN_IF_READ_ERROR(reader.Read(&request->sequence_id_));
+  RETURN_IF_READ_ERROR(reader.Read(&request->model_name_));
+  RETURN_IF_READ_ERROR(reader.Read(&request->model_version_));
+  RETURN_IF_READ_ERROR(reader.Read(&request->inputs_));
+  RETURN_IF_READ_ERROR(reader.Read(&request->requested_outputs_));
+  return reader.Read(&request->output_region_);
+}
+
+Error DeserializeLocalResponse(const void* base, const size_t byte_size,
+                               LocalInferResponse* response) {
+  Reader reader(base, byte_size);
+  RETURN_IF_READ_ERROR(reader.ReadHeader(LocalMessageType::INFER_RESPONSE));
+  RETURN_IF_READ_ERROR(reader.Read(&response->sequence_id_));
+  RETURN_IF_READ_ERROR(reader.Read(&response->flags_));
+  RETURN_IF_READ_ERROR(reader.Read(&response->error_code_));
+  RETURN_IF_READ_ERROR(reader.Read(&response->error_message_));
+  return reader.Read(&response->outputs_);
+}
+
+Error DeserializeLocalDisconnect(const void* base, const size_t byte_size, std::string* client) {
+  Reader reader(base, byte_size);
+  RETURN_IF_READ_ERROR(reader.ReadHeader(LocalMessageType::DISCONNECT));
+  return reader.Read(client);
+}
+
+std::string LocalResponseChannelName(const std::string& name, const std::string& client) {
+  return name + "." + client;
+}
+
+} // namespace common
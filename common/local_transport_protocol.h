@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "error.h"
+
+namespace common {
+
+// The messages of the local transport, through which processes on the
+// same host run inferences on a server. The tensors stay in shared
+// memory segments written in place by the producer of the tensor, the
+// messages only describe where they are. The messages are in the byte
+// order of the host, both ends run on it.
+//
+// A client sends its requests on the channel of the transport name and
+// gets the responses on the channel '<name>.<client>'.
+
+// The kinds of messages.
+enum class LocalMessageType : uint32_t {
+  // A request of a client to the server.
+  INFER_REQUEST = 1,
+  // A response of the server to a client.
+  INFER_RESPONSE = 2,
+  // A client going away, the server unmaps its segments.
+  DISCONNECT = 3
+};
+
+// A region of a shared memory segment.
+struct ShmRegion {
+  ShmRegion() : segment_byte_size_(0), offset_(0), byte_size_(0) {}
+
+  // The name and the size of the segment the region is in.
+  std::string segment_;
+  uint64_t segment_byte_size_;
+  uint64_t offset_;
+  uint64_t byte_size_;
+};
+
+// A tensor held in a region of a segment.
+struct LocalTensor {
+  LocalTensor() : datatype_(0) {}
+
+  std::string name_;
+  // A SERVER_DataType.
+  uint32_t datatype_;
+  std::vector<int64_t> shape_;
+  ShmRegion region_;
+};
+
+struct LocalInferRequest {
+  LocalInferRequest() : sequence_id_(0), model_version_(-1) {}
+
+  std::string client_;
+  // Tells apart the requests of a client, the responses carry it.
+  uint64_t sequence_id_;
+  std::string model_name_;
+  int64_t model_version_;
+  std::vector<LocalTensor> inputs_;
+  // All the outputs of the model are produced if none is requested.
+  std::vector<std::string> requested_outputs_;
+  // The region of a segment of the client the outputs are written to.
+  ShmRegion output_region_;
+};
+
+struct LocalInferResponse {
+  LocalInferResponse()
+    : sequence_id_(0), flags_(0), error_code_(static_cast<uint32_t>(Error::Code::SUCCESS)) {}
+
+  uint64_t sequence_id_;
+  // SERVER_ResponseCompleteFlag, the final response may come without
+  // outputs.
+  uint32_t flags_;
+  // An Error::Code and its message, if the request failed.
+  uint32_t error_code_;
+  std::string error_message_;
+  // In the output region of the request.
+  std::vector<LocalTensor> outputs_;
+};
+
+/// Get the kind of a message.
+///
+/// \param base The message.
+/// \param byte_size The size of the message in bytes.
+/// \param type Returns the kind of the message.
+/// \return The error status.
+Error LocalMessageTypeOf(const void* base, const size_t byte_size, LocalMessageType* type);
+
+/// Serialize messages, appending them to 'message'.
+void SerializeLocalRequest(const LocalInferRequest& request, std::string* message);
+void SerializeLocalResponse(const LocalInferResponse& response, std::string* message);
+void SerializeLocalDisconnect(const std::string& client, std::string* message);
+
+/// Deserialize messages, failing if the message is not of the kind or
+/// is truncated.
+Error DeserializeLocalRequest(const void* base, const size_t byte_size,
+                              LocalInferRequest* request);
+Error DeserializeLocalResponse(const void* base, const size_t byte_size,
+                               LocalInferResponse* response);
+Error DeserializeLocalDisconnect(const void* base, const size_t byte_size, std::string* client);
+
+/// The name of the channel the responses to 'client' of the transport
+/// 'name' are sent on.
+std::string LocalResponseChannelName(const std::string& name, const std::string& client);
+
+} // namespace common
@@ -0,0 +1,66 @@
+#include "admission_controller.h"
+
+#include <iostream>
+
+namespace core {
+
+AdmissionController::AdmissionController(const std::string& model_name,
+                                         const uint64_t target_delay_ns,
+                                         const uint64_t interval_ns,
+                                         const uint64_t protected_priority)
+  : model_name_(model_name),
+    target_delay_ns_(target_delay_ns),
+    interval_ns_(interval_ns),
+    protected_priority_(protected_priority),
+    above_target_until_ns_(0),
+    last_sample_ns_(0),
+    shedding_(false),
+    rejected_count_(0) {}
+
+bool AdmissionController::Admit(const uint64_t priority, const uint64_t now_ns) {
+  if (shedding_ && (now_ns >= last_sample_ns_ + interval_ns_)) {
+    // No request left the queue for an interval, which only sheds the
+    // requests that would tell whether it recovered.
+    StopShedding("no request left the queue for an interval");
+  }
+  // Level 0 is a model without priority levels, none of its requests
+  // are protected.
+  if (!shedding_ || ((priority != 0) && (priority <= protected_priority_))) {
+    return true;
+  }
+  ++rejected_count_;
+  return false;
+}
+
+void AdmissionController::RecordQueueDelay(const uint64_t queue_delay_ns,
+                                           const uint64_t now_ns) {
+  last_sample_ns_ = now_ns;
+  if (queue_delay_ns < target_delay_ns_) {
+    StopShedding("a request waited less than the target");
+    return;
+  }
+  if (above_target_until_ns_ == 0) {
+    above_target_until_ns_ = now_ns + interval_ns_;
+  } else if ((now_ns >= above_target_until_ns_) && !shedding_) {
+    shedding_ = true;
+    std::cout << "model '" << model_name_ << "' is overloaded, queue delay above "
+              << target_delay_ns_ / 1000 << "us for " << interval_ns_ / 1000000
+              << "ms, shedding the requests of priority levels above " << protected_priority_
+              << std::endl;
+  }
+}
+
+void AdmissionController::RecordQueueEmpty() {
+  StopShedding("the queue drained");
+}
+
+void AdmissionController::StopShedding(const char* reason) {
+  above_target_until_ns_ = 0;
+  bool shedding = true;
+  if (shedding_.compare_exchange_strong(shedding, false)) {
+    std::cout << "model '" << model_name_ << "' stopped shedding requests, " << reason << ", "
+              << rejected_count_ << " rejected so far" << std::endl;
+  }
+}
+
+}
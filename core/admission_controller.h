@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "constants.h"
+
+namespace core {
+
+// Sheds the requests of the low priority levels of a model while its
+// queue is overloaded, so that the clients learn right away and may retry
+// elsewhere instead of waiting for a timeout. As in CoDel, the queue is
+// overloaded once the queueing delay stayed above a target for a whole
+// interval, which tells a standing queue from a burst that drains by
+// itself, and it recovers as soon as a request waited less than the
+// target. As CoDel does when its queue goes empty, the overload also
+// ends once the queue drained or no request left it for an interval,
+// since shedding every request would otherwise leave no request to
+// measure the recovery with.
+class AdmissionController {
+ public:
+  // Shed the requests of a priority level above 'protected_priority',
+  // all of them if 0, while the queueing delay of 'model_name' stays above
+  // 'target_delay_ns' for 'interval_ns'.
+  AdmissionController(const std::string& model_name, const uint64_t target_delay_ns,
+                      const uint64_t interval_ns, const uint64_t protected_priority);
+
+  // Return true if a request of 'priority' arriving at 'now_ns' is
+  // admitted.
+  bool Admit(const uint64_t priority, const uint64_t now_ns);
+
+  // Record that the request that waited the least of those leaving the
+  // queue at 'now_ns' waited 'queue_delay_ns'. Called by the one thread
+  // dequeuing the requests of the model.
+  void RecordQueueDelay(const uint64_t queue_delay_ns, const uint64_t now_ns);
+
+  // Record that the queue of the model is empty.
+  void RecordQueueEmpty();
+
+  bool Shedding() const { return shedding_; }
+  // The number of requests rejected so far.
+  uint64_t RejectedCount() const { return rejected_count_; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(AdmissionController);
+
+  void StopShedding(const char* reason);
+
+  const std::string model_name_;
+  const uint64_t target_delay_ns_;
+  const uint64_t interval_ns_;
+  const uint64_t protected_priority_;
+
+  // The time the delay has been above the target for an interval, 0
+  // while it is below the target.
+  std::atomic<uint64_t> above_target_until_ns_;
+  // The time of the latest delay recorded.
+  std::atomic<uint64_t> last_sample_ns_;
+  std::atomic<bool> shedding_;
+  std::atomic<uint64_t> rejected_count_;
+};
+
+}
@@ -63,6 +63,11 @@ void Backend::ClearHandles() {
   inst_init_fn_ = nullptr;
   inst_fini_fn_ = nullptr;
   inst_exec_fn_ = nullptr;
+  batcher_init_fn_ = nullptr;
+  batcher_fini_fn_ = nullptr;
+  batch_init_fn_ = nullptr;
+  batch_incl_fn_ = nullptr;
+  batch_fini_fn_ = nullptr;
   model_init_fn_ = nullptr;
   model_fini_fn_ = nullptr;
   backend_init_fn_ = nullptr;
@@ -79,6 +84,11 @@ Status Backend::LoadBackendLibrary() {
   ModelInstanceInitFn_t iifn = nullptr;
   ModelInstanceFiniFn_t iffn = nullptr;
   ModelInstanceExecFn_t iefn = nullptr;
+  ModelBatcherInitFn_t brifn = nullptr;
+  ModelBatcherFiniFn_t brffn = nullptr;
+  ModelBatchInitFn_t bhifn = nullptr;
+  ModelBatchInclFn_t bhinfn = nullptr;
+  ModelBatchFiniFn_t bhffn = nullptr;
   std::unique_ptr<SharedLibrary> slib;
   RETURN_IF_ERROR(SharedLibrary::Acquire(&slib));
   RETURN_IF_ERROR(slib->OpenLibraryHandle(libpath_, &dlhandle_));
@@ -136,9 +146,54 @@ Status Backend::LoadBackendLibrary() {
     false /* optional */,
     reinterpret_cast<void**>(&iefn)
   ));
+  // Custom batching functions, optional
+  RETURN_IF_ERROR(slib->GetEntrypoint(
+    dlhandle_,
+    "BACKEND_ModelBatcherInitialize",
+    true /* optional */,
+    reinterpret_cast<void**>(&brifn)
+  ));
+  RETURN_IF_ERROR(slib->GetEntrypoint(
+    dlhandle_,
+    "BACKEND_ModelBatcherFinalize",
+    true /* optional */,
+    reinterpret_cast<void**>(&brffn)
+  ));
+  RETURN_IF_ERROR(slib->GetEntrypoint(
+    dlhandle_,
+    "BACKEND_ModelBatchInitialize",
+    true /* optional */,
+    reinterpret_cast<void**>(&bhifn)
+  ));
+  RETURN_IF_ERROR(slib->GetEntrypoint(
+    dlhandle_,
+    "BACKEND_ModelBatchIncludeRequest",
+    true /* optional */,
+    reinterpret_cast<void**>(&bhinfn)
+  ));
+  RETURN_IF_ERROR(slib->GetEntrypoint(
+    dlhandle_,
+    "BACKEND_ModelBatchFinalize",
+    true /* optional */,
+    reinterpret_cast<void**>(&bhffn)
+  ));
+  // A batch must be both started and finished by the backend once it
+  // takes part in forming it.
+  if (((bhifn == nullptr) != (bhinfn == nullptr)) ||
+      ((bhifn == nullptr) != (bhffn == nullptr))) {
+    return Status(Status::Code::INVALID_ARG,
+                  "backend '" + name_ + "' must implement all or none of "
+                  "BACKEND_ModelBatchInitialize, BACKEND_ModelBatchIncludeRequest "
+                  "and BACKEND_ModelBatchFinalize");
+  }
   inst_init_fn_ = iifn;
   inst_fini_fn_ = iffn;
   inst_exec_fn_ = iefn;
+  batcher_init_fn_ = brifn;
+  batcher_fini_fn_ = brffn;
+  batch_init_fn_ = bhifn;
+  batch_incl_fn_ = bhinfn;
+  batch_fini_fn_ = bhffn;
   model_init_fn_ = mifn;
   model_fini_fn_ = mffn;
   backend_init_fn_ = bifn;
@@ -23,6 +23,11 @@ class Backend {
   typedef SERVER_Error* (*ModelInstanceInitFn_t)(BACKEND_ModelInstance* instance);
   typedef SERVER_Error* (*ModelInstanceFiniFn_t)(BACKEND_ModelInstance* instance);
   typedef SERVER_Error* (*ModelInstanceExecFn_t)(BACKEND_ModelInstance* instance, BACKEND_Request** requests, const uint32_t request_cnt);
+  typedef SERVER_Error* (*ModelBatcherInitFn_t)(BACKEND_Batcher** batcher, BACKEND_Model* model);
+  typedef SERVER_Error* (*ModelBatcherFiniFn_t)(BACKEND_Batcher* batcher);
+  typedef SERVER_Error* (*ModelBatchInitFn_t)(const BACKEND_Batcher* batcher, void** userp);
+  typedef SERVER_Error* (*ModelBatchInclFn_t)(BACKEND_Request* request, void* userp, bool* should_include);
+  typedef SERVER_Error* (*ModelBatchFiniFn_t)(void* userp);
 
   static Status Create(const std::string& name, 
                        const std::string& dir,
@@ -46,6 +51,13 @@ class Backend {
   ModelInstanceInitFn_t ModelInstanceInitFn() const { return inst_init_fn_; }
   ModelInstanceFiniFn_t ModelInstanceFiniFn() const { return inst_fini_fn_; }
   ModelInstanceExecFn_t ModelInstanceExecFn() const { return inst_exec_fn_; }
+  // The custom batching hooks, either all the batch functions are set
+  // or none is.
+  ModelBatcherInitFn_t ModelBatcherInitFn() const { return batcher_init_fn_; }
+  ModelBatcherFiniFn_t ModelBatcherFiniFn() const { return batcher_fini_fn_; }
+  ModelBatchInitFn_t ModelBatchInitFn() const { return batch_init_fn_; }
+  ModelBatchInclFn_t ModelBatchInclFn() const { return batch_incl_fn_; }
+  ModelBatchFiniFn_t ModelBatchFiniFn() const { return batch_fini_fn_; }
 
  private:
   typedef SERVER_Error* (*BackendInitFn_t)(BACKEND_Backend* backend);
@@ -86,6 +98,11 @@ class Backend {
   ModelInstanceInitFn_t inst_init_fn_;
   ModelInstanceFiniFn_t inst_fini_fn_;
   ModelInstanceExecFn_t inst_exec_fn_;
+  ModelBatcherInitFn_t batcher_init_fn_;
+  ModelBatcherFiniFn_t batcher_fini_fn_;
+  ModelBatchInitFn_t batch_init_fn_;
+  ModelBatchInclFn_t batch_incl_fn_;
+  ModelBatchFiniFn_t batch_fini_fn_;
 };
 
 } // namespace core
\ No newline at end of file
@@ -1,10 +1,109 @@
 #include "backend_model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <tuple>
+
 #include "backend_config.h"
 #include "server.h"
 #include "shared_library.h"
+#include "dynamic_batch_scheduler.h"
+#include "time_utils.h"
+
+#if defined(_MSC_VER)
+#define API_DECLSPEC __declspec(dllexport)
+#elif defined(__GNUC__)
+#define API_DECLSPEC __attribute__((__visibility__("default")))
+#else
+#define API_DECLSPEC
+#endif
 
 namespace core {
 
+namespace {
+// The model parameters controlling when the passive instances of a model
+// are put in and out of rotation.
+constexpr char kStandbyPromoteQueueDepth[] = "standby_promote_queue_depth";
+constexpr char kStandbyDemoteDelay[] = "standby_demote_delay_ms";
+constexpr uint64_t kDefaultStandbyDemoteDelayMs = 1000;
+// The model parameter setting how many batches an instance has formed,
+// the one it executes included. A batch is gathered as it is formed, so
+// the default of 2 gathers the next batch while the current one
+// executes.
+constexpr char kPipelineDepth[] = "pipeline_depth";
+constexpr uint64_t kDefaultPipelineDepth = 2;
+// The model parameter ordering the queue of the dynamic batcher, "fifo"
+// or "deadline" for the earliest deadline first.
+constexpr char kQueueOrder[] = "queue_order";
+// The model parameter enabling the tuning of the batching delay for the
+// most throughput at this p99 latency.
+constexpr char kLatencyTarget[] = "latency_target_us";
+// The model parameters of the instance autoscaler, setting the maximum
+// instance count enables it.
+constexpr char kAutoscaleMinInstances[] = "autoscale_min_instances";
+constexpr char kAutoscaleMaxInstances[] = "autoscale_max_instances";
+constexpr char kAutoscaleInterval[] = "autoscale_interval_ms";
+constexpr char kAutoscaleTargetQueueDelay[] = "autoscale_target_queue_delay_us";
+constexpr uint64_t kDefaultAutoscaleIntervalMs = 5000;
+constexpr uint64_t kMinAutoscaleTargetQueueDelayUs = 1000;
+// An instance is added when the instances are busier than this, and
+// removed when the remaining ones would stay below the lower bound.
+constexpr double kScaleUpUtilization = 0.9;
+constexpr double kScaleDownUtilization = 0.6;
+// The model parameters of the admission control, setting the target
+// queue delay enables it. The requests of the priority levels up to the
+// protected one are never shed.
+constexpr char kAdmissionTargetDelay[] = "admission_target_delay_us";
+constexpr char kAdmissionInterval[] = "admission_interval_ms";
+constexpr char kAdmissionProtectedPriority[] = "admission_protected_priority";
+constexpr uint64_t kDefaultAdmissionIntervalMs = 100;
+
+// The statistics of a response filled by the backend through the C API.
+struct ResponseStatistics {
+  ResponseStatistics()
+    : instance_(nullptr), response_start_ns_(0), compute_output_start_ns_(0),
+      response_end_ns_(0), success_(true) {}
+  BackendModelInstance* instance_;
+  uint64_t response_start_ns_;
+  uint64_t compute_output_start_ns_;
+  uint64_t response_end_ns_;
+  bool success_;
+};
+
+// The queue delay and the utilization the autoscaler observes are those
+// of the whole model, they can't tell which of several groups is
+// saturated. An autoscaled model must have a single non-passive group.
+Status ValidateAutoscaledGroups(const std::string& name,
+                                const inference::ModelConfig& model_config) {
+  size_t active_group_count = 0;
+  for (const auto& group : model_config.instance_group()) {
+    if (!group.passive()) {
+      ++active_group_count;
+    }
+  }
+  if (active_group_count != 1) {
+    return Status(Status::Code::INVALID_ARG,
+                  "autoscaling model '" + name +
+                  "' requires exactly one non-passive instance group");
+  }
+  return Status::Success;
+}
+
+// The error returned through the C API for 'status', nullptr if OK.
+SERVER_Error* ServerErrorFromStatus(const Status& status) {
+  if (status.IsOk()) {
+    return nullptr;
+  }
+  return SERVER_ErrorNew(StatusCodeToServerErrorCode(status.StatusCode()),
+                         status.Message().c_str());
+}
+}  // namespace
+
 Status BackendModel::Create(InferenceServer* server, 
                             const std::string& model_path,
                             const BackendCmdlineConfigMap& backend_cmdline_config_map,
@@ -76,6 +175,15 @@ Status BackendModel::Create(InferenceServer* server,
       host_policy_map));
 
   BackendModel* raw_local_model = local_model.get();
+  // The instances are charged the files of the version until the backend
+  // reports their memory.
+  const std::string version_path =
+      JoinPath({localized_model_dir->Path(), std::to_string(version)});
+  bool version_path_exists = false;
+  RETURN_IF_ERROR(FileExists(version_path, &version_path_exists));
+  if (version_path_exists) {
+    RETURN_IF_ERROR(GetPathByteSize(version_path, &local_model->version_byte_size_));
+  }
   // Model initialization is optional... The TRITONBACKEND_Model object is this
   // TritonModel object.
   if (backend->ModelInitFn() != nullptr) {
@@ -101,6 +209,11 @@ Status BackendModel::Create(InferenceServer* server,
   // Initialize the model for Triton core usage
   RETURN_IF_ERROR(local_model->Init(is_config_provided));
   RETURN_IF_ERROR(local_model->GetExecutionPolicy(model_config));
+  // The batcher is created before the scheduler that uses it.
+  if (backend->ModelBatcherInitFn() != nullptr) {
+    RETURN_IF_SERVER_ERROR(backend->ModelBatcherInitFn()(
+        &local_model->batcher_, reinterpret_cast<BACKEND_Model*>(raw_local_model)));
+  }
   // Create or update the model instances for this model.
   std::vector<std::shared_ptr<BackendModelInstance>> added_instances, 
     removed_instances;
@@ -108,34 +221,519 @@ Status BackendModel::Create(InferenceServer* server,
       model_config, &added_instances, &removed_instances));
   RETURN_IF_ERROR(local_model->SetConfiguredScheduler(added_instances));
   local_model->CommitInstances();
+  local_model->instance_groups_ = model_config.instance_group();
+  RETURN_IF_ERROR(local_model->StartAutoscaler());
   *model = std::move(local_model);
   return Status::Success;
 }
 
+Status BackendModel::UpdateInstanceGroup(const inference::ModelConfig& new_model_config) {
+  std::lock_guard<std::mutex> lock(update_mu_);
+  return UpdateInstanceGroupLocked(new_model_config);
+}
+
+Status BackendModel::UpdateInstanceGroupLocked(const inference::ModelConfig& new_model_config) {
+  // Generate normalized model config with new instance group.
+  inference::ModelConfig model_config = config_;
+  model_config.mutable_instance_group()->CopyFrom(new_model_config.instance_group());
+  RETURN_IF_ERROR(NormalizeInstanceGroup(
+      min_compute_capability_, backend_->BackendAttributes().preferred_groups_,
+      &model_config));
+  RETURN_IF_ERROR(ValidateInstanceGroup(model_config, min_compute_capability_));
+  if (autoscale_policy_.max_instances_ > 0) {
+    RETURN_IF_ERROR(ValidateAutoscaledGroups(Name(), model_config));
+  }
+  // Prepare the new instances on the new config. The current instances
+  // keep serving in the meantime.
+  std::vector<std::shared_ptr<BackendModelInstance>> added_instances,
+    removed_instances;
+  Status status = PrepareInstances(model_config, &added_instances, &removed_instances);
+  if (!status.IsOk()) {
+    ClearBackgroundInstances();
+    return status;
+  }
+  // At this point, the new instances are ready for inference but not yet
+  // known to the scheduler. The scheduler takes the added instances into
+  // use before letting go of the removed ones, a removed instance
+  // finishes the payload it is executing when it is destroyed.
+  status = scheduler_->Update(added_instances, removed_instances);
+  if (!status.IsOk()) {
+    ClearBackgroundInstances();
+    return status;
+  }
+  CommitInstances();
+  instance_groups_ = model_config.instance_group();
+  std::cout << "updated instance group of '" << Name() << "' version "
+            << Version() << ": " << added_instances.size() << " added, "
+            << removed_instances.size() << " removed" << std::endl;
+  return Status::Success;
+}
+
 // Prepare the next set of instances on the background. Returns the instances
 // that will be added and removed if the next set of instances is to be
 // committed.
 Status BackendModel::PrepareInstances(const inference::ModelConfig& model_config,
   std::vector<std::shared_ptr<BackendModelInstance>>* added_instances,
   std::vector<std::shared_ptr<BackendModelInstance>>* removed_instances) {
+  added_instances->clear();
+  removed_instances->clear();
+  // Instances are reused when an instance with the same signature exists.
+  auto existing_instances = IndexInstances();
+  // The instances to create, they are created once all are known.
+  std::vector<std::function<Status()>> creations;
+  std::mutex added_mu;
+  for (const auto& group : model_config.instance_group()) {
+    std::vector<std::string> profile_names;
+    for (const auto& profile_name : group.profile()) {
+      profile_names.push_back(profile_name);
+    }
+    std::vector<BackendModelInstance::SecondaryDevice> secondary_devices;
+    for (const auto& secondary_device : group.secondary_devices()) {
+      secondary_devices.emplace_back(
+          inference::ModelInstanceGroup_SecondaryDevice_SecondaryDeviceKind_Name(
+              secondary_device.kind()),
+          secondary_device.device_id());
+    }
+    // The host policy name, kind and device of each instance of a count.
+    std::vector<std::tuple<std::string, SERVER_InstanceGroupKind, int32_t>> instance_settings;
+    if (group.kind() == inference::ModelInstanceGroup::KIND_CPU) {
+      instance_settings.emplace_back(
+          group.host_policy().empty() ? "cpu" : group.host_policy(),
+          SERVER_INSTANCEGROUPKIND_CPU, 0 /* device_id */);
+    } else if (group.kind() == inference::ModelInstanceGroup::KIND_GPU) {
+      for (const int32_t device_id : group.gpus()) {
+        instance_settings.emplace_back(
+            group.host_policy().empty() ? ("gpu_" + std::to_string(device_id))
+                                        : group.host_policy(),
+            SERVER_INSTANCEGROUPKIND_GPU, device_id);
+      }
+    } else if (group.kind() == inference::ModelInstanceGroup::KIND_MODEL) {
+      instance_settings.emplace_back(
+          group.host_policy().empty() ? "model" : group.host_policy(),
+          SERVER_INSTANCEGROUPKIND_MODEL, 0 /* device_id */);
+    } else {
+      auto msg = "instance_group kind " +
+                 inference::ModelInstanceGroup_Kind_Name(group.kind()) +
+                 " not supported";
+      return Status(Status::Code::INVALID_ARG, msg);
+    }
+    for (int32_t c = 0; c < group.count(); ++c) {
+      const std::string instance_name = group.name() + "_" + std::to_string(c);
+      const bool passive = group.passive();
+      for (const auto& is : instance_settings) {
+        const std::string& policy_name = std::get<0>(is);
+        const SERVER_InstanceGroupKind kind = std::get<1>(is);
+        const int32_t device_id = std::get<2>(is);
+        BackendModelInstance::Signature signature(group, device_id);
+        // Reuse an existing instance of the same signature.
+        auto itr = existing_instances.find(signature);
+        if (itr != existing_instances.end() && !itr->second.empty()) {
+          auto existing_instance = std::move(itr->second.back());
+          itr->second.pop_back();
+          if (itr->second.empty()) {
+            existing_instances.erase(itr);
+          }
+          RegisterBackgroundInstance(std::move(existing_instance), passive);
+          continue;
+        }
+        // Create a new instance. The local variables are captured by value.
+        const inference::ModelRateLimiter& rate_limiter_config = group.rate_limiter();
+        creations.emplace_back(
+          [this, instance_name, signature, kind, device_id, profile_names,
+           passive, policy_name, rate_limiter_config, secondary_devices,
+           added_instances, &added_mu]() {
+            std::shared_ptr<BackendModelInstance> new_instance;
+            RETURN_IF_ERROR(BackendModelInstance::CreateInstance(
+                this, instance_name, signature, kind, device_id, profile_names,
+                passive, policy_name, rate_limiter_config, secondary_devices,
+                &new_instance));
+            {
+              std::lock_guard<std::mutex> lock(added_mu);
+              added_instances->push_back(new_instance);
+            }
+            RegisterBackgroundInstance(std::move(new_instance), passive);
+            return Status::Success;
+          });
+      }
+    }
+  }
+  // Any existing instances not reused will be removed.
+  for (auto& pr : existing_instances) {
+    for (auto& instance : pr.second) {
+      removed_instances->push_back(std::move(instance));
+    }
+  }
+  // Instances are created and warmed up concurrently if the backend
+  // allows it. Fail if any failed.
+  std::vector<Status> results(creations.size());
+  auto create = [&creations, &results](size_t i) { results[i] = creations[i](); };
+  if (backend_->BackendAttributes().parallel_instance_loading_) {
+    server_->GetExecutor()->ParallelFor(0, creations.size(), create);
+  } else {
+    for (size_t i = 0; i < creations.size(); ++i) {
+      create(i);
+    }
+  }
+  for (const auto& result : results) {
+    RETURN_IF_ERROR(result);
+  }
   return Status::Success;
 }
 
 Status BackendModel::SetConfiguredScheduler(
   const std::vector<std::shared_ptr<BackendModelInstance>>& new_instances) {
+  std::unique_ptr<Scheduler> scheduler;
+  if (config_.has_sequence_batching()) {
+    auto msg = "sequence batching is not supported for model '" + Name() + "'";
+    return Status(Status::Code::UNSUPPORTED, msg);
+  }
+  std::set<int32_t> preferred_batch_sizes;
+  uint64_t max_queue_delay_microseconds = 0;
+  inference::ModelQueuePolicy default_queue_policy;
+  std::map<uint64_t, inference::ModelQueuePolicy> queue_policies;
+  if (config_.has_dynamic_batching()) {
+    for (const auto size : config_.dynamic_batching().preferred_batch_size()) {
+      preferred_batch_sizes.insert(size);
+    }
+    max_queue_delay_microseconds = config_.dynamic_batching().max_queue_delay_microseconds();
+    default_queue_policy = config_.dynamic_batching().default_queue_policy();
+    for (const auto& pr : config_.dynamic_batching().priority_queue_policy()) {
+      queue_policies[pr.first] = pr.second;
+    }
+  }
+  std::string queue_order;
+  RETURN_IF_ERROR(GetChoiceParameter(
+      config_, kQueueOrder, {"fifo", "deadline"}, &queue_order));
+  uint64_t latency_target_us = 0;
+  RETURN_IF_ERROR(GetUnsignedParameter(config_, kLatencyTarget, 0, &latency_target_us));
+  uint64_t admission_target_delay_us = 0;
+  RETURN_IF_ERROR(GetUnsignedParameter(
+      config_, kAdmissionTargetDelay, 0, &admission_target_delay_us));
+  if (admission_target_delay_us > 0) {
+    uint64_t admission_interval_ms = 0;
+    uint64_t protected_priority = 0;
+    RETURN_IF_ERROR(GetUnsignedParameter(
+        config_, kAdmissionInterval, kDefaultAdmissionIntervalMs, &admission_interval_ms));
+    RETURN_IF_ERROR(GetUnsignedParameter(
+        config_, kAdmissionProtectedPriority, 0, &protected_priority));
+    admission_controller_.reset(new AdmissionController(
+        Name(), admission_target_delay_us * 1000, admission_interval_ms * 1000 * 1000,
+        protected_priority));
+  }
+  // By default a standby is promoted once two full batches are waiting.
+  uint64_t standby_promote_queue_depth = 0;
+  uint64_t standby_demote_delay_ms = 0;
+  RETURN_IF_ERROR(GetUnsignedParameter(
+      config_, kStandbyPromoteQueueDepth,
+      2 * std::max(1, config_.max_batch_size()), &standby_promote_queue_depth));
+  RETURN_IF_ERROR(GetUnsignedParameter(
+      config_, kStandbyDemoteDelay, kDefaultStandbyDemoteDelayMs,
+      &standby_demote_delay_ms));
+  uint64_t pipeline_depth = 0;
+  RETURN_IF_ERROR(GetUnsignedParameter(
+      config_, kPipelineDepth, kDefaultPipelineDepth, &pipeline_depth));
+  if (pipeline_depth == 0) {
+    return Status(Status::Code::INVALID_ARG,
+                  "'" + std::string(kPipelineDepth) + "' must be positive for model '" +
+                  Name() + "'");
+  }
+  RETURN_IF_ERROR(DynamicBatchScheduler::Create(
+      this, SCHEDULER_DEFAULT_NICE, config_.has_dynamic_batching(),
+      config_.max_batch_size(), preferred_batch_sizes,
+      max_queue_delay_microseconds, standby_promote_queue_depth,
+      standby_demote_delay_ms, pipeline_depth, default_queue_policy,
+      queue_policies, (queue_order == "deadline"), latency_target_us, &scheduler));
+  RETURN_IF_ERROR(scheduler->Update(new_instances, {}));
+  return SetScheduler(std::move(scheduler));
+}
+
+std::vector<std::shared_ptr<BackendModelInstance>>
+BackendModel::GetInstancesByDevice(int32_t device_id) const {
+  std::vector<std::shared_ptr<BackendModelInstance>> result;
+  std::lock_guard<std::mutex> lock(bg_instances_mu_);
+  for (const auto& instance : bg_instances_) {
+    if (instance->DeviceId() == device_id) {
+      result.push_back(instance);
+    }
+  }
+  return result;
+}
+
+std::mutex& BackendModel::DeviceExecutionMutex(const int32_t device_id) {
+  std::lock_guard<std::mutex> lock(device_mu_);
+  auto& mu = device_execution_mutexes_[device_id];
+  if (mu == nullptr) {
+    mu.reset(new std::mutex());
+  }
+  return *mu;
+}
+
+void BackendModel::InstanceFailed(BackendModelInstance* instance, const Status& status) {
+  if (scheduler_ != nullptr) {
+    scheduler_->InstanceFailed(instance, status);
+  }
+}
+
+void BackendModel::GetMemoryUsage(ModelMemoryUsage* usage) const {
+  Model::GetMemoryUsage(usage);
+  AccumulateMemoryUsage(memory_usage_.Usage(), &usage->total_);
+  std::vector<std::shared_ptr<BackendModelInstance>> instances;
+  {
+    std::lock_guard<std::mutex> lock(bg_instances_mu_);
+    instances = instances_;
+    instances.insert(instances.end(), passive_instances_.begin(),
+                     passive_instances_.end());
+  }
+  for (const auto& instance : instances) {
+    const MemoryUsageMap instance_usage = instance->Memory().Usage();
+    AccumulateMemoryUsage(instance_usage, &usage->instances_[instance->Name()]);
+    AccumulateMemoryUsage(instance_usage, &usage->total_);
+  }
+}
+
+void BackendModel::RecordQueueDelay(const size_t request_count, const uint64_t queue_delay_ns) {
+  queued_request_count_ += request_count;
+  queue_delay_ns_ += queue_delay_ns;
+}
+
+Status BackendModel::BatchInitialize(void** userp) const {
+  *userp = nullptr;
+  RETURN_IF_SERVER_ERROR(backend_->ModelBatchInitFn()(batcher_, userp));
+  return Status::Success;
+}
+
+Status BackendModel::BatchIncludeRequest(InferenceRequest* request, void* userp,
+                                         bool* should_include) const {
+  *should_include = false;
+  RETURN_IF_SERVER_ERROR(backend_->ModelBatchInclFn()(
+      reinterpret_cast<BACKEND_Request*>(request), userp, should_include));
   return Status::Success;
 }
 
+void BackendModel::BatchFinalize(void* userp) const {
+  SERVER_Error* err = backend_->ModelBatchFiniFn()(userp);
+  if (err != nullptr) {
+    std::cerr << "failed finalizing a batch of model '" << Name() << "': "
+              << SERVER_ErrorMessage(err) << std::endl;
+    SERVER_ErrorDelete(err);
+  }
+}
+
+Status BackendModel::StartAutoscaler() {
+  AutoscalePolicy policy;
+  RETURN_IF_ERROR(GetUnsignedParameter(
+      config_, kAutoscaleMaxInstances, 0, &policy.max_instances_));
+  if (policy.max_instances_ == 0) {
+    return Status::Success;
+  }
+  RETURN_IF_ERROR(GetUnsignedParameter(
+      config_, kAutoscaleMinInstances, 1, &policy.min_instances_));
+  RETURN_IF_ERROR(GetUnsignedParameter(
+      config_, kAutoscaleInterval, kDefaultAutoscaleIntervalMs,
+      &policy.interval_ms_));
+  // By default the requests may wait twice the batching delay.
+  uint64_t target_queue_delay_us = 0;
+  RETURN_IF_ERROR(GetUnsignedParameter(
+      config_, kAutoscaleTargetQueueDelay,
+      std::max(kMinAutoscaleTargetQueueDelayUs,
+               2 * static_cast<uint64_t>(
+                   config_.dynamic_batching().max_queue_delay_microseconds())),
+      &target_queue_delay_us));
+  policy.target_queue_delay_ns_ = target_queue_delay_us * 1000;
+  if ((policy.min_instances_ == 0) ||
+      (policy.min_instances_ > policy.max_instances_)) {
+    return Status(Status::Code::INVALID_ARG,
+                  "'" + std::string(kAutoscaleMinInstances) + "' must be between 1 and '" +
+                  kAutoscaleMaxInstances + "' for model '" + Name() + "'");
+  }
+  if (policy.interval_ms_ == 0) {
+    return Status(Status::Code::INVALID_ARG,
+                  "'" + std::string(kAutoscaleInterval) + "' must be positive for model '" +
+                  Name() + "'");
+  }
+  RETURN_IF_ERROR(ValidateAutoscaledGroups(Name(), config_));
+  autoscale_policy_ = policy;
+  autoscaler_thread_ = std::thread(&BackendModel::AutoscalerThread, this);
+  return Status::Success;
+}
+
+void BackendModel::StopAutoscaler() {
+  {
+    std::lock_guard<std::mutex> lock(autoscaler_mu_);
+    autoscaler_exit_ = true;
+  }
+  autoscaler_cv_.notify_all();
+  if (autoscaler_thread_.joinable()) {
+    autoscaler_thread_.join();
+  }
+}
+
+void BackendModel::AutoscalerThread() {
+  const auto interval = std::chrono::milliseconds(autoscale_policy_.interval_ms_);
+  // The busy time of each instance at the start of the interval.
+  std::map<BackendModelInstance*, uint64_t> last_busy_ns;
+  uint64_t last_ns = CaptureTimeNs();
+  uint64_t last_request_count = queued_request_count_;
+  uint64_t last_queue_delay_ns = queue_delay_ns_;
+  std::unique_lock<std::mutex> lock(autoscaler_mu_);
+  while (!autoscaler_exit_) {
+    autoscaler_cv_.wait_for(lock, interval);
+    if (autoscaler_exit_) {
+      break;
+    }
+    std::vector<std::shared_ptr<BackendModelInstance>> instances;
+    {
+      std::lock_guard<std::mutex> instances_lock(bg_instances_mu_);
+      instances = instances_;
+    }
+    const uint64_t now_ns = CaptureTimeNs();
+    const uint64_t request_count = queued_request_count_;
+    const uint64_t queue_delay_ns = queue_delay_ns_;
+    const uint64_t oldest_queue_start_ns =
+        (scheduler_ == nullptr) ? 0 : scheduler_->OldestQueueStartNs();
+    // An instance created during the interval was busy since then only.
+    // The batches in progress count up to now, a batch taking longer than
+    // the interval would make a saturated instance look idle otherwise.
+    uint64_t busy_ns = 0;
+    std::map<BackendModelInstance*, uint64_t> current_busy_ns;
+    for (const auto& instance : instances) {
+      const uint64_t instance_busy_ns = instance->BusyNs(now_ns);
+      const auto itr = last_busy_ns.find(instance.get());
+      const uint64_t baseline_ns =
+          ((itr != last_busy_ns.end()) && (itr->second <= instance_busy_ns)) ? itr->second : 0;
+      busy_ns += instance_busy_ns - baseline_ns;
+      current_busy_ns[instance.get()] = instance_busy_ns;
+    }
+    const uint64_t elapsed_ns = std::max<uint64_t>(1, now_ns - last_ns);
+    const size_t count = instances.size();
+    const double utilization =
+        (count == 0) ? 0.0 : static_cast<double>(busy_ns) / (elapsed_ns * count);
+    // The requests still queued count with the wait of the oldest one, no
+    // request may leave the queue while the instances are saturated.
+    uint64_t avg_queue_delay_ns =
+        (request_count == last_request_count)
+            ? 0
+            : (queue_delay_ns - last_queue_delay_ns) / (request_count - last_request_count);
+    if ((oldest_queue_start_ns != 0) && (now_ns > oldest_queue_start_ns)) {
+      avg_queue_delay_ns = std::max(avg_queue_delay_ns, now_ns - oldest_queue_start_ns);
+    }
+    int delta = 0;
+    if ((avg_queue_delay_ns > autoscale_policy_.target_queue_delay_ns_) ||
+        (utilization > kScaleUpUtilization)) {
+      delta = 1;
+    } else if ((avg_queue_delay_ns < autoscale_policy_.target_queue_delay_ns_ / 2) &&
+               (count > 1) &&
+               (utilization * count / (count - 1) < kScaleDownUtilization)) {
+      delta = -1;
+    }
+    bool scaled = false;
+    if (delta != 0) {
+      // Preparing the instances may take long, the model can still be
+      // destroyed in the meantime.
+      lock.unlock();
+      scaled = ScaleInstanceGroup(delta);
+      if (scaled) {
+        std::cout << "autoscaled '" << Name() << "' version " << Version()
+                  << (delta > 0 ? " up" : " down") << ", queue delay "
+                  << avg_queue_delay_ns / 1000 << " us, utilization "
+                  << static_cast<int>(utilization * 100) << "%" << std::endl;
+      }
+      lock.lock();
+    }
+    // The next interval starts after a resize, so that it only observes
+    // the new set of instances.
+    last_busy_ns.swap(current_busy_ns);
+    if (scaled) {
+      last_busy_ns.clear();
+      std::lock_guard<std::mutex> instances_lock(bg_instances_mu_);
+      last_ns = CaptureTimeNs();
+      for (const auto& instance : instances_) {
+        last_busy_ns[instance.get()] = instance->BusyNs(last_ns);
+      }
+      last_request_count = queued_request_count_;
+      last_queue_delay_ns = queue_delay_ns_;
+    } else {
+      last_ns = now_ns;
+      last_request_count = request_count;
+      last_queue_delay_ns = queue_delay_ns;
+    }
+  }
+}
+
+bool BackendModel::ScaleInstanceGroup(const int delta) {
+  std::lock_guard<std::mutex> lock(update_mu_);
+  inference::ModelConfig model_config = config_;
+  *model_config.mutable_instance_group() = instance_groups_;
+  // There is a single non-passive group, see ValidateAutoscaledGroups().
+  for (auto& group : *model_config.mutable_instance_group()) {
+    if (group.passive()) {
+      continue;
+    }
+    // A count set out of the bounds by an update of the instance group is
+    // brought back within them.
+    const int64_t count = static_cast<int64_t>(group.count()) + delta;
+    if (((delta < 0) && (count < static_cast<int64_t>(autoscale_policy_.min_instances_))) ||
+        ((delta > 0) && (count > static_cast<int64_t>(autoscale_policy_.max_instances_)))) {
+      return false;
+    }
+    group.set_count(static_cast<int32_t>(count));
+    Status status = UpdateInstanceGroupLocked(model_config);
+    if (!status.IsOk()) {
+      std::cerr << "failed to autoscale '" << Name() << "' version " << Version()
+                << " to " << count << " instances: " << status.Message() << std::endl;
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+std::unordered_map<BackendModelInstance::Signature,
+                   std::vector<std::shared_ptr<BackendModelInstance>>>
+BackendModel::IndexInstances() const {
+  std::unordered_map<BackendModelInstance::Signature,
+                     std::vector<std::shared_ptr<BackendModelInstance>>> mapping;
+  for (const auto& instance : instances_) {
+    mapping[instance->GetSignature()].push_back(instance);
+  }
+  for (const auto& instance : passive_instances_) {
+    mapping[instance->GetSignature()].push_back(instance);
+  }
+  return mapping;
+}
+
+void BackendModel::RegisterBackgroundInstance(
+    std::shared_ptr<BackendModelInstance>&& instance, const bool passive) {
+  std::lock_guard<std::mutex> lock(bg_instances_mu_);
+  if (passive) {
+    bg_passive_instances_.push_back(std::move(instance));
+  } else {
+    bg_instances_.push_back(std::move(instance));
+  }
+}
+
 // Replace the foreground instances with background instances.
 void BackendModel::CommitInstances() {
-  instances_.swap(bg_instances_);
-  passive_instances_.swap(bg_passive_instances_);
-  ClearBackgroundInstances();
+  std::vector<std::shared_ptr<BackendModelInstance>> retired_instances, 
+    retired_passive_instances;
+  {
+    std::lock_guard<std::mutex> lock(bg_instances_mu_);
+    instances_.swap(bg_instances_);
+    passive_instances_.swap(bg_passive_instances_);
+    retired_instances.swap(bg_instances_);
+    retired_passive_instances.swap(bg_passive_instances_);
+  }
+  // The instances not carried over are destroyed here, outside of the
+  // lock, each one waits for its backend thread to finish.
 }
 
 void BackendModel::ClearBackgroundInstances() {
-  bg_instances_.clear();
-  bg_passive_instances_.clear();
+  std::vector<std::shared_ptr<BackendModelInstance>> instances, passive_instances;
+  {
+    std::lock_guard<std::mutex> lock(bg_instances_mu_);
+    instances.swap(bg_instances_);
+    passive_instances.swap(bg_passive_instances_);
+  }
 }
 
 // Gets the execution policy setting from the backend.
@@ -324,6 +922,443 @@ std::string BackendModel::AssembleCPPRuntimeLibraryName(const std::string& backe
 }
 
 BackendModel::~BackendModel() {
+  // Stop resizing the instances, then take them out of the scheduler and
+  // let every instance finish its backend thread. The batches released
+  // meanwhile call back into the scheduler, it is only destroyed once no
+  // batch is executing, then the model itself is finalized.
+  StopAutoscaler();
+  if (scheduler_ != nullptr) {
+    std::vector<std::shared_ptr<BackendModelInstance>> instances = instances_;
+    instances.insert(instances.end(), passive_instances_.begin(), passive_instances_.end());
+    scheduler_->Update({}, instances);
+  }
+  ClearBackgroundInstances();
+  instances_.clear();
+  passive_instances_.clear();
+  scheduler_.reset();
+  auto rate_limiter = server_->GetRateLimiter();
+  if (rate_limiter != nullptr) {
+    rate_limiter->UnregisterModel(this);
+  }
+  // No batch is formed any more.
+  if ((batcher_ != nullptr) && (backend_->ModelBatcherFiniFn() != nullptr)) {
+    SERVER_Error* err = backend_->ModelBatcherFiniFn()(batcher_);
+    if (err != nullptr) {
+      std::cerr << "failed finalizing the batcher of model '" << Name() << "': "
+                << SERVER_ErrorMessage(err) << std::endl;
+      SERVER_ErrorDelete(err);
+    }
+  }
+  // Model finalization is optional... The BACKEND_Model object is this
+  // BackendModel object.
+  if (backend_->ModelFiniFn() != nullptr) {
+    SERVER_Error* err = backend_->ModelFiniFn()(reinterpret_cast<BACKEND_Model*>(this));
+    if (err != nullptr) {
+      std::cerr << "failed finalizing model '" << Name() << "': "
+                << SERVER_ErrorMessage(err) << std::endl;
+      SERVER_ErrorDelete(err);
+    }
+  }
+}
+
+}
+
+extern "C" {
+
+//
+// BACKEND_Model
+//
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelReportMemoryUsage(BACKEND_Model* model,
+                                             SERVER_MemoryType memory_type,
+                                             int64_t memory_type_id,
+                                             uint64_t byte_size) {
+  core::BackendModel* backend_model = reinterpret_cast<core::BackendModel*>(model);
+  backend_model->Memory().Set(memory_type, memory_type_id, byte_size);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelGatherBatchInputs(BACKEND_Model* model) {
+  reinterpret_cast<core::BackendModel*>(model)->SetGatherBatchInputs();
+  return nullptr;
+}
+
+//
+// BACKEND_ModelInstance
+//
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceReportMemoryUsage(BACKEND_ModelInstance* instance,
+                                                     SERVER_MemoryType memory_type,
+                                                     int64_t memory_type_id,
+                                                     uint64_t byte_size) {
+  core::BackendModelInstance* backend_instance =
+    reinterpret_cast<core::BackendModelInstance*>(instance);
+  backend_instance->ReportMemoryUsage(memory_type, memory_type_id, byte_size);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceReportStatistics(BACKEND_ModelInstance* instance,
+                                                    const bool success,
+                                                    const uint64_t exec_start_ns,
+                                                    const uint64_t compute_start_ns,
+                                                    const uint64_t compute_end_ns,
+                                                    const uint64_t exec_end_ns) {
+  core::BackendModelInstance* backend_instance =
+    reinterpret_cast<core::BackendModelInstance*>(instance);
+  backend_instance->Model()->StatsAggregator().UpdateRequest(
+      success, exec_start_ns, compute_start_ns, compute_end_ns, exec_end_ns);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceReportBatchStatistics(BACKEND_ModelInstance* instance,
+                                                         const uint64_t batch_size,
+                                                         const uint64_t exec_start_ns,
+                                                         const uint64_t compute_start_ns,
+                                                         const uint64_t compute_end_ns,
+                                                         const uint64_t exec_end_ns) {
+  core::BackendModelInstance* backend_instance =
+    reinterpret_cast<core::BackendModelInstance*>(instance);
+  backend_instance->Model()->StatsAggregator().UpdateBatch(
+      batch_size, exec_start_ns, compute_start_ns, compute_end_ns, exec_end_ns);
+  return nullptr;
+}
+
+//
+// BACKEND_ModelInstanceResponseStatistics
+//
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceResponseStatisticsNew(
+    BACKEND_ModelInstanceResponseStatistics** response_statistics) {
+  *response_statistics = reinterpret_cast<BACKEND_ModelInstanceResponseStatistics*>(
+      new core::ResponseStatistics());
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceResponseStatisticsDelete(
+    BACKEND_ModelInstanceResponseStatistics* response_statistics) {
+  delete reinterpret_cast<core::ResponseStatistics*>(response_statistics);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceResponseStatisticsSetModelInstance(
+    BACKEND_ModelInstanceResponseStatistics* response_statistics,
+    BACKEND_ModelInstance* instance) {
+  core::ResponseStatistics* rs = reinterpret_cast<core::ResponseStatistics*>(response_statistics);
+  rs->instance_ = reinterpret_cast<core::BackendModelInstance*>(instance);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceResponseStatisticsSetResponseStart(
+    BACKEND_ModelInstanceResponseStatistics* response_statistics,
+    const uint64_t response_start_ns) {
+  core::ResponseStatistics* rs = reinterpret_cast<core::ResponseStatistics*>(response_statistics);
+  rs->response_start_ns_ = response_start_ns;
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceResponseStatisticsSetComputeOutputStart(
+    BACKEND_ModelInstanceResponseStatistics* response_statistics,
+    const uint64_t compute_output_start_ns) {
+  core::ResponseStatistics* rs = reinterpret_cast<core::ResponseStatistics*>(response_statistics);
+  rs->compute_output_start_ns_ = compute_output_start_ns;
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceResponseStatisticsSetResponseEnd(
+    BACKEND_ModelInstanceResponseStatistics* response_statistics,
+    const uint64_t response_end_ns) {
+  core::ResponseStatistics* rs = reinterpret_cast<core::ResponseStatistics*>(response_statistics);
+  rs->response_end_ns_ = response_end_ns;
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceResponseStatisticsSetError(
+    BACKEND_ModelInstanceResponseStatistics* response_statistics,
+    SERVER_Error* error) {
+  core::ResponseStatistics* rs = reinterpret_cast<core::ResponseStatistics*>(response_statistics);
+  rs->success_ = (error == nullptr);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceReportResponseStatistics(
+    BACKEND_ModelInstanceResponseStatistics* response_statistics) {
+  core::ResponseStatistics* rs = reinterpret_cast<core::ResponseStatistics*>(response_statistics);
+  if (rs->instance_ == nullptr) {
+    return SERVER_ErrorNew(SERVER_ERROR_INVALID_ARG,
+                           "the model instance of response statistics must be set");
+  }
+  rs->instance_->Model()->StatsAggregator().UpdateResponse(
+      rs->success_, rs->response_start_ns_, rs->compute_output_start_ns_, rs->response_end_ns_);
+  return nullptr;
+}
+
+//
+// BACKEND_Request
+//
+API_DECLSPEC
+SERVER_Error* BACKEND_RequestId(BACKEND_Request* request, const char** id) {
+  core::InferenceRequest* infer_request = reinterpret_cast<core::InferenceRequest*>(request);
+  *id = infer_request->Id().c_str();
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_RequestInputCount(BACKEND_Request* request, uint32_t* count) {
+  core::InferenceRequest* infer_request = reinterpret_cast<core::InferenceRequest*>(request);
+  *count = infer_request->Inputs().size();
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_RequestInput(BACKEND_Request* request, const uint32_t index,
+                                   BACKEND_Input** input) {
+  core::InferenceRequest* infer_request = reinterpret_cast<core::InferenceRequest*>(request);
+  if (index >= infer_request->Inputs().size()) {
+    return SERVER_ErrorNew(SERVER_ERROR_INVALID_ARG,
+                           ("out of bounds index " + std::to_string(index) + ": request has " +
+                            std::to_string(infer_request->Inputs().size()) + " inputs").c_str());
+  }
+  *input = reinterpret_cast<BACKEND_Input*>(
+      const_cast<core::InferenceRequest::Input*>(&infer_request->Inputs()[index]));
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_RequestInputByName(BACKEND_Request* request, const char* name,
+                                         BACKEND_Input** input) {
+  core::InferenceRequest* infer_request = reinterpret_cast<core::InferenceRequest*>(request);
+  core::InferenceRequest::Input* request_input = nullptr;
+  SERVER_Error* err = core::ServerErrorFromStatus(infer_request->MutableInput(name, &request_input));
+  if (err == nullptr) {
+    *input = reinterpret_cast<BACKEND_Input*>(request_input);
+  }
+  return err;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_RequestOutputCount(BACKEND_Request* request, uint32_t* count) {
+  core::InferenceRequest* infer_request = reinterpret_cast<core::InferenceRequest*>(request);
+  *count = infer_request->RequestedOutputs().size();
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_RequestOutputName(BACKEND_Request* request, const uint32_t index,
+                                        const char** name) {
+  core::InferenceRequest* infer_request = reinterpret_cast<core::InferenceRequest*>(request);
+  const std::set<std::string>& outputs = infer_request->RequestedOutputs();
+  if (index >= outputs.size()) {
+    return SERVER_ErrorNew(SERVER_ERROR_INVALID_ARG,
+                           ("out of bounds index " + std::to_string(index) + ": request has " +
+                            std::to_string(outputs.size()) + " requested outputs").c_str());
+  }
+  *name = std::next(outputs.begin(), index)->c_str();
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_RequestIsCancelled(BACKEND_Request* request, bool* is_cancelled) {
+  core::InferenceRequest* infer_request = reinterpret_cast<core::InferenceRequest*>(request);
+  *is_cancelled = infer_request->IsCancelled();
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_RequestRelease(BACKEND_Request* request, uint32_t release_flags) {
+  if (release_flags != SERVER_REQUEST_RELEASE_ALL) {
+    return SERVER_ErrorNew(SERVER_ERROR_INVALID_ARG,
+                           "a request must be released with SERVER_REQUEST_RELEASE_ALL");
+  }
+  std::unique_ptr<core::InferenceRequest> infer_request(
+      reinterpret_cast<core::InferenceRequest*>(request));
+  core::InferenceRequest::Release(std::move(infer_request));
+  return nullptr;
+}
+
+//
+// BACKEND_Input
+//
+API_DECLSPEC
+SERVER_Error* BACKEND_InputProperties(BACKEND_Input* input, const char** name,
+                                      SERVER_DataType* datatype, const int64_t** shape,
+                                      uint32_t* dims_count, uint64_t* byte_size,
+                                      uint32_t* buffer_count) {
+  core::InferenceRequest::Input* request_input =
+      reinterpret_cast<core::InferenceRequest::Input*>(input);
+  if (name != nullptr) {
+    *name = request_input->Name().c_str();
+  }
+  if (datatype != nullptr) {
+    *datatype = core::DataTypeToServerDataType(request_input->DType());
+  }
+  if (shape != nullptr) {
+    *shape = request_input->Shape().data();
+  }
+  if (dims_count != nullptr) {
+    *dims_count = request_input->Shape().size();
+  }
+  if (byte_size != nullptr) {
+    *byte_size = request_input->ByteSize();
+  }
+  if (buffer_count != nullptr) {
+    *buffer_count = request_input->Buffers().size();
+  }
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_InputBuffer(BACKEND_Input* input, const uint32_t index,
+                                  const void** buffer, uint64_t* buffer_byte_size,
+                                  SERVER_MemoryType* memory_type, int64_t* memory_type_id) {
+  core::InferenceRequest::Input* request_input =
+      reinterpret_cast<core::InferenceRequest::Input*>(input);
+  if (index >= request_input->Buffers().size()) {
+    return SERVER_ErrorNew(SERVER_ERROR_INVALID_ARG,
+                           ("out of bounds index " + std::to_string(index) + ": input '" +
+                            request_input->Name() + "' has " +
+                            std::to_string(request_input->Buffers().size()) + " buffers").c_str());
+  }
+  const core::InferenceRequest::Input::Buffer& input_buffer = request_input->Buffers()[index];
+  *buffer = input_buffer.base_;
+  *buffer_byte_size = input_buffer.byte_size_;
+  *memory_type = input_buffer.memory_type_;
+  *memory_type_id = input_buffer.memory_type_id_;
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ModelInstanceBatchInput(BACKEND_ModelInstance* instance, const char* name,
+                                              const void** buffer, uint64_t* byte_size) {
+  const core::BackendModelInstance* backend_instance =
+      reinterpret_cast<core::BackendModelInstance*>(instance);
+  size_t gathered_byte_size = 0;
+  SERVER_Error* err = core::ServerErrorFromStatus(
+      backend_instance->BatchInput(name, buffer, &gathered_byte_size));
+  if (err == nullptr) {
+    *byte_size = gathered_byte_size;
+  }
+  return err;
+}
+
+//
+// BACKEND_ResponseFactory
+//
+API_DECLSPEC
+SERVER_Error* BACKEND_ResponseFactoryNew(BACKEND_ResponseFactory** factory,
+                                         BACKEND_Request* request) {
+  core::InferenceRequest* infer_request = reinterpret_cast<core::InferenceRequest*>(request);
+  *factory = reinterpret_cast<BACKEND_ResponseFactory*>(
+      new std::shared_ptr<core::InferenceResponseFactory>(infer_request->ResponseFactory()));
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ResponseFactoryDelete(BACKEND_ResponseFactory* factory) {
+  delete reinterpret_cast<std::shared_ptr<core::InferenceResponseFactory>*>(factory);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ResponseFactorySendFlags(BACKEND_ResponseFactory* factory,
+                                               uint32_t send_flags) {
+  auto response_factory = reinterpret_cast<std::shared_ptr<core::InferenceResponseFactory>*>(factory);
+  return core::ServerErrorFromStatus((*response_factory)->Send(nullptr, send_flags));
+}
+
+//
+// BACKEND_Response
+//
+API_DECLSPEC
+SERVER_Error* BACKEND_ResponseNew(BACKEND_Response** response, BACKEND_Request* request) {
+  core::InferenceRequest* infer_request = reinterpret_cast<core::InferenceRequest*>(request);
+  *response = reinterpret_cast<BACKEND_Response*>(
+      infer_request->ResponseFactory()->CreateResponse().release());
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ResponseNewFromFactory(BACKEND_Response** response,
+                                             BACKEND_ResponseFactory* factory) {
+  auto response_factory = reinterpret_cast<std::shared_ptr<core::InferenceResponseFactory>*>(factory);
+  *response = reinterpret_cast<BACKEND_Response*>(
+      (*response_factory)->CreateResponse().release());
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ResponseDelete(BACKEND_Response* response) {
+  delete reinterpret_cast<core::InferenceResponse*>(response);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ResponseOutput(BACKEND_Response* response,
+                                     BACKEND_Output** output,
+                                     const char* name,
+                                     const int64_t* shape,
+                                     uint32_t dims_count) {
+  core::InferenceResponse* infer_response = reinterpret_cast<core::InferenceResponse*>(response);
+  core::InferenceResponse::Output* response_output = nullptr;
+  SERVER_Error* err = core::ServerErrorFromStatus(infer_response->AddOutput(
+      name, std::vector<int64_t>(shape, shape + dims_count), &response_output));
+  if (err == nullptr) {
+    *output = reinterpret_cast<BACKEND_Output*>(response_output);
+  }
+  return err;
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ResponseSend(BACKEND_Response* response,
+                                   uint32_t send_flags,
+                                   SERVER_Error* error) {
+  std::unique_ptr<core::InferenceResponse> infer_response(
+      reinterpret_cast<core::InferenceResponse*>(response));
+  if (error != nullptr) {
+    infer_response->SetResponseStatus(core::Status(
+        core::ServerErrorCodeToStatusCode(SERVER_ErrorCode(error)), SERVER_ErrorMessage(error)));
+  }
+  return core::ServerErrorFromStatus(
+      core::InferenceResponse::Send(std::move(infer_response), send_flags));
+}
+
+API_DECLSPEC
+SERVER_Error* BACKEND_ResponseSendBatch(BACKEND_Response** responses,
+                                        const uint32_t response_count,
+                                        uint32_t send_flags,
+                                        SERVER_Error** errors) {
+  SERVER_Error* first_err = nullptr;
+  for (uint32_t i = 0; i < response_count; ++i) {
+    SERVER_Error* err = BACKEND_ResponseSend(
+        responses[i], send_flags, (errors == nullptr) ? nullptr : errors[i]);
+    if (first_err == nullptr) {
+      first_err = err;
+    } else if (err != nullptr) {
+      SERVER_ErrorDelete(err);
+    }
+  }
+  return first_err;
+}
+
+//
+// BACKEND_Output
+//
+API_DECLSPEC
+SERVER_Error* BACKEND_OutputBuffer(BACKEND_Output* output, void** buffer, uint64_t byte_size,
+                                   SERVER_MemoryType* memory_type, int64_t* memory_type_id) {
+  core::InferenceResponse::Output* response_output =
+      reinterpret_cast<core::InferenceResponse::Output*>(output);
+  return core::ServerErrorFromStatus(
+      response_output->AllocateBuffer(byte_size, memory_type, memory_type_id, buffer));
 }
 
-}
\ No newline at end of file
+}  // extern "C"
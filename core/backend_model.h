@@ -1,13 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 
 #include "status.h"
 #include "model.h"
 #include "backend.h"
 #include "constants.h"
 #include "file_utils.h"
+#include "exec_time_estimator.h"
+#include "infer_stats.h"
 #include "backend_model.h"
 #include "backend_model_instance.h"
 
@@ -54,10 +62,50 @@ class BackendModel : public Model {
   void SetState(void* state) { state_ = state; }
   // True if different instances should be grouped by device; false otherwise.
   bool DeviceBlocking() const { return device_blocking_; }
-  // Update instance group.
+  // Update instance group. The instances whose signature is unchanged are
+  // reused, the new ones are created in the background while the current
+  // instances keep serving, then the scheduler is switched over to the
+  // new set of instances. Config() is read concurrently by the requests
+  // and keeps the instance groups the model was created with.
   Status UpdateInstanceGroup(const inference::ModelConfig& new_model_config);
   // Get a vector of non-passive background instances that share the device id.
   std::vector<std::shared_ptr<BackendModelInstance>> GetInstancesByDevice(int32_t device_id) const;
+  // The mutex serializing the executions on 'device_id' of a
+  // device-blocking model.
+  std::mutex& DeviceExecutionMutex(const int32_t device_id);
+  // Let the scheduler know 'instance' failed to execute a batch.
+  void InstanceFailed(BackendModelInstance* instance, const Status& status);
+  // The memory used by the model outside of its instances.
+  MemoryUsage& Memory() { return memory_usage_; }
+  // The size of the files of the model version, which an instance is
+  // taken to hold until the backend reports its memory.
+  uint64_t VersionByteSize() const { return version_byte_size_; }
+  // The execution times of the batches of the model.
+  ExecTimeEstimator& ExecEstimator() { return exec_estimator_; }
+  // The execution statistics the backend reports for the model.
+  InferenceStatsAggregator& StatsAggregator() { return stats_aggregator_; }
+  // \see Model::ExecutionStatistics()
+  const InferenceStatsAggregator* ExecutionStatistics() const override {
+    return &stats_aggregator_;
+  }
+  // \see Model::GetMemoryUsage()
+  void GetMemoryUsage(ModelMemoryUsage* usage) const override;
+  // Account 'request_count' requests that waited 'queue_delay_ns' in
+  // total before being sent to an instance.
+  void RecordQueueDelay(const size_t request_count, const uint64_t queue_delay_ns);
+  // Whether the inputs of the batches are gathered while the previous
+  // batch executes, as the backend asked with
+  // BACKEND_ModelGatherBatchInputs().
+  bool GathersBatchInputs() const { return gather_batch_inputs_; }
+  void SetGatherBatchInputs() { gather_batch_inputs_ = true; }
+  // Whether the backend decides which queued requests join a batch.
+  bool HasCustomBatching() const { return backend_->ModelBatchInclFn() != nullptr; }
+  // The custom batching hooks of the backend, see
+  // BACKEND_ModelBatchInitialize(). Only valid if HasCustomBatching().
+  Status BatchInitialize(void** userp) const;
+  Status BatchIncludeRequest(InferenceRequest* request, void* userp,
+                             bool* should_include) const;
+  void BatchFinalize(void* userp) const;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(BackendModel);
@@ -80,7 +128,14 @@ class BackendModel : public Model {
       device_blocking_(false),
       localized_model_dir_(localized_model_dir), 
       backend_(backend),
-      state_(nullptr) {}
+      state_(nullptr),
+      batcher_(nullptr),
+      version_byte_size_(0),
+      gather_batch_inputs_(false),
+      stats_aggregator_(config.max_batch_size()),
+      queued_request_count_(0),
+      queue_delay_ns_(0),
+      autoscaler_exit_(false) {}
   // Gets the execution policy setting from the backend.
   Status GetExecutionPolicy(const inference::ModelConfig& model_config);
   // Set the scheduler based on the model configuration and the provided
@@ -98,6 +153,27 @@ class BackendModel : public Model {
   void CommitInstances();
   // Clear all background instances.
   void ClearBackgroundInstances();
+  // Update the instance group, 'update_mu_' must be held.
+  Status UpdateInstanceGroupLocked(const inference::ModelConfig& new_model_config);
+  // Start the autoscaler thread if the model parameters enable it.
+  Status StartAutoscaler();
+  // Stop the autoscaler thread, waiting for a resize in progress.
+  void StopAutoscaler();
+  // Periodically grow or shrink the autoscaled instance group based on
+  // the queue delay and the utilization of the instances.
+  void AutoscalerThread();
+  // Change the count of the autoscaled instance group by 'delta'. Return
+  // false without updating if the count would leave its bounds, and
+  // false after logging the error if the update failed.
+  bool ScaleInstanceGroup(const int delta);
+  // Add a new instance into the background passive or non-passive list.
+  void RegisterBackgroundInstance(std::shared_ptr<BackendModelInstance>&& instance,
+                                  const bool passive);
+  // Gets the current instances, passive and non-passive, indexed by
+  // their signature.
+  std::unordered_map<BackendModelInstance::Signature,
+                     std::vector<std::shared_ptr<BackendModelInstance>>>
+  IndexInstances() const;
 
   // Merges the global backend configs with the specific
   // backend configs.
@@ -156,6 +232,8 @@ class BackendModel : public Model {
   std::shared_ptr<Backend> backend_;
   // Opaque state associated with this model.
   void* state_;
+  // The backend's batcher for custom batching, may be nullptr.
+  BACKEND_Batcher* batcher_;
   // The localized repo directory holding the model. If localization
   // required creation of a temporary local copy then that copy will
   // persist as along as this object is retained by this model.
@@ -182,6 +260,44 @@ class BackendModel : public Model {
   // effective until committed.
   std::vector<std::shared_ptr<BackendModelInstance>> bg_instances_;
   std::vector<std::shared_ptr<BackendModelInstance>> bg_passive_instances_;
+  // Protects the background instances, they are filled concurrently when
+  // the backend supports parallel instance loading.
+  mutable std::mutex bg_instances_mu_;
+  // Serializes the updates of the instance group.
+  std::mutex update_mu_;
+  // The instance groups in effect, 'config_' is never changed once the
+  // model serves. Protected by 'update_mu_'.
+  google::protobuf::RepeatedPtrField<inference::ModelInstanceGroup> instance_groups_;
+  // The execution mutexes of a device-blocking model, by device id.
+  std::mutex device_mu_;
+  std::map<int32_t, std::unique_ptr<std::mutex>> device_execution_mutexes_;
+  // Records of memory used by the model outside of its instances.
+  MemoryUsage memory_usage_;
+  uint64_t version_byte_size_;
+  std::atomic<bool> gather_batch_inputs_;
+  ExecTimeEstimator exec_estimator_;
+  InferenceStatsAggregator stats_aggregator_;
+  // The requests sent to the instances and the time they were queued, as
+  // observed by the autoscaler.
+  std::atomic<uint64_t> queued_request_count_;
+  std::atomic<uint64_t> queue_delay_ns_;
+  // The autoscaler resizes the only non-passive instance group between
+  // 'min_instances_' and 'max_instances_' instances, it is disabled when
+  // 'max_instances_' is 0.
+  struct AutoscalePolicy {
+    AutoscalePolicy()
+      : min_instances_(1), max_instances_(0), interval_ms_(0),
+        target_queue_delay_ns_(0) {}
+    uint64_t min_instances_;
+    uint64_t max_instances_;
+    uint64_t interval_ms_;
+    uint64_t target_queue_delay_ns_;
+  };
+  AutoscalePolicy autoscale_policy_;
+  std::mutex autoscaler_mu_;
+  std::condition_variable autoscaler_cv_;
+  bool autoscaler_exit_;
+  std::thread autoscaler_thread_;
 };
 
 }
\ No newline at end of file
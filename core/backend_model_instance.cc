@@ -1,9 +1,21 @@
 #include "backend_model_instance.h"
 
 #include <iostream>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "model.h"
+#include "server.h"
+#include "payload.h"
+#include "rate_limiter.h"
 #include "backend_model.h"
+#include "infer_request.h"
+#include "time_utils.h"
 
 namespace core {
 
@@ -24,6 +36,10 @@ Status BackendModelInstance::CreateInstance(BackendModel* model,
   if (policy_it != model->HostPolicyMap().end()) {
     host_policy = &policy_it->second;
   }
+  RETURN_IF_ERROR(Construct(model, name, signature, kind, device_id,
+                            profile_names, passive, host_policy_name,
+                            *host_policy, rate_limiter_config,
+                            secondary_devices, backend_model_instance));
   return Status::Success;
 }
 
@@ -39,25 +55,184 @@ Status BackendModelInstance::Construct(BackendModel* model,
                                        const inference::ModelRateLimiter& rate_limiter_config,
                                        const std::vector<SecondaryDevice>& secondary_devices,
                                        std::shared_ptr<BackendModelInstance>* model_instance) {
+  // Create the JSON representation of the host policy.
+  using namespace common;
+  Json::Value host_policy_json(Json::ValueType::OBJECT);
+  Json::Value policy_setting_json(host_policy_json, Json::ValueType::OBJECT);
+  for (const auto& pr : host_policy) {
+    RETURN_IF_ERROR(policy_setting_json.AddString(pr.first.c_str(), pr.second));
+  }
+  RETURN_IF_ERROR(host_policy_json.Add(host_policy_name.c_str(), std::move(policy_setting_json)));
+  Message host_policy_message(host_policy_json);
+  int numa_node = -1;
+  const auto numa_itr = host_policy.find("numa-node");
+  if (numa_itr != host_policy.end()) {
+    char* end = nullptr;
+    const long value = strtol(numa_itr->second.c_str(), &end, 10);
+    if (numa_itr->second.empty() || (*end != '\0') || (value < 0)) {
+      return Status(Status::Code::INVALID_ARG,
+                    "invalid 'numa-node' host policy '" + numa_itr->second +
+                    "' for instance " + name);
+    }
+    numa_node = static_cast<int>(value);
+  }
+  std::shared_ptr<BackendModelInstance> local_instance(new BackendModelInstance(
+      model, name, signature, kind, device_id, profile_names, passive,
+      host_policy, host_policy_message, rate_limiter_config, secondary_devices));
+  local_instance->numa_node_ = numa_node;
+  // Every instance, passive or not, gets its backend thread so that it
+  // can be put to use without being created again.
+  RETURN_IF_ERROR(local_instance->SetBackendThread(kind, device_id, model->DeviceBlocking()));
+  RETURN_IF_ERROR(local_instance->backend_thread_->InitAndWarmUpModelInstance(local_instance.get()));
+  // Unless the backend reported the memory of the instance while
+  // initializing it, the instance holds the files of the model version
+  // in the memory of its device.
+  if (local_instance->memory_usage_.TotalByteSize() == 0) {
+    local_instance->memory_usage_.Allocated(
+        (kind == SERVER_INSTANCEGROUPKIND_GPU) ? SERVER_MEMORY_GPU : SERVER_MEMORY_CPU,
+        (kind == SERVER_INSTANCEGROUPKIND_GPU) ? device_id : 0, model->VersionByteSize());
+    local_instance->estimated_byte_size_ = model->VersionByteSize();
+  }
+  *model_instance = std::move(local_instance);
   return Status::Success;
 }
 
 Status BackendModelInstance::SetBackendThread(const SERVER_InstanceGroupKind kind, 
                                               const int32_t device_id,
                                               const bool device_blocking) {
+  // Instances of a device-blocking model do not share a thread, their
+  // executions are serialized per device in Execute() instead. A shared
+  // thread could not retire an instance without stopping its siblings.
+  std::unique_ptr<BackendThread> local_backend_thread;
+  RETURN_IF_ERROR(BackendThread::CreateBackendThread(
+      name_, this, SCHEDULER_DEFAULT_NICE, device_id, &local_backend_thread));
+  backend_thread_ = std::move(local_backend_thread);
   return Status::Success;
 }
 
-void BackendModelInstance::Execute(std::vector<BACKEND_Request*>& backend_requests) {
-  
+Status BackendModelInstance::Initialize() {
+  auto inst_init_fn = model_->GetBackend()->ModelInstanceInitFn();
+  if (inst_init_fn != nullptr) {
+    RETURN_IF_SERVER_ERROR(inst_init_fn(reinterpret_cast<BACKEND_ModelInstance*>(this)));
+  }
+  return Status::Success;
 }
 
-Status BackendModelInstance::Schedule(std::vector<std::unique_ptr<InferenceRequest>>&& requests) {
-  return Status::Success;
+Status BackendModelInstance::Execute(std::vector<BACKEND_Request*>& backend_requests) {
+  auto inst_exec_fn = model_->GetBackend()->ModelInstanceExecFn();
+  SERVER_Error* err = nullptr;
+  {
+    // A device-blocking backend executes one instance at a time per device.
+    std::unique_lock<std::mutex> device_lock;
+    if (model_->DeviceBlocking()) {
+      device_lock = std::unique_lock<std::mutex>(model_->DeviceExecutionMutex(device_id_));
+    }
+    if (inst_exec_fn != nullptr) {
+      const uint64_t start_ns = CaptureTimeNs();
+      {
+        std::lock_guard<std::mutex> lock(busy_mu_);
+        busy_since_ns_ = start_ns;
+      }
+      err = inst_exec_fn(reinterpret_cast<BACKEND_ModelInstance*>(this),
+                         &backend_requests[0], backend_requests.size());
+      const uint64_t exec_ns = CaptureTimeNs() - start_ns;
+      {
+        std::lock_guard<std::mutex> lock(busy_mu_);
+        busy_ns_ += exec_ns;
+        busy_since_ns_ = 0;
+      }
+      // Each execution moves the average by an eighth of the difference,
+      // only this thread writes it.
+      const uint64_t recent_exec_ns = recent_exec_ns_;
+      recent_exec_ns_ = (recent_exec_ns == 0)
+                          ? exec_ns
+                          : recent_exec_ns - recent_exec_ns / 8 + exec_ns / 8;
+    } else {
+      err = SERVER_ErrorNew(SERVER_ERROR_UNSUPPORTED,
+                            "backend does not implement model instance execution");
+    }
+  }
+  // On error the requests were not taken by the backend, they are
+  // released here.
+  Status status;
+  if (err != nullptr) {
+    status = Status(ServerErrorCodeToStatusCode(SERVER_ErrorCode(err)),
+                    SERVER_ErrorMessage(err));
+    // An error that is not about the requests themselves means the
+    // instance is at fault, a standby may take over.
+    const Status::Code code = status.StatusCode();
+    if ((code == Status::Code::INTERNAL) || (code == Status::Code::UNKNOWN) ||
+        (code == Status::Code::UNAVAILABLE)) {
+      model_->InstanceFailed(this, status);
+    }
+    for (auto& backend_request : backend_requests) {
+      std::unique_ptr<InferenceRequest> request(
+          reinterpret_cast<InferenceRequest*>(backend_request));
+      InferenceRequest::RespondIfError(request, status, true /* release_request */);
+    }
+    SERVER_ErrorDelete(err);
+  }
+  return status;
 }
 
-BackendModelInstance::~BackendModelInstance() {
+void BackendModelInstance::ReportMemoryUsage(const SERVER_MemoryType memory_type,
+                                             const int64_t memory_type_id,
+                                             const size_t byte_size) {
+  const size_t estimated_byte_size = estimated_byte_size_.exchange(0);
+  if (estimated_byte_size > 0) {
+    memory_usage_.Released(
+        (kind_ == SERVER_INSTANCEGROUPKIND_GPU) ? SERVER_MEMORY_GPU : SERVER_MEMORY_CPU,
+        (kind_ == SERVER_INSTANCEGROUPKIND_GPU) ? device_id_ : 0, estimated_byte_size);
+  }
+  memory_usage_.Set(memory_type, memory_type_id, byte_size);
+}
 
+uint64_t BackendModelInstance::BusyNs(const uint64_t now_ns) const {
+  std::lock_guard<std::mutex> lock(busy_mu_);
+  if ((busy_since_ns_ == 0) || (now_ns <= busy_since_ns_)) {
+    return busy_ns_;
+  }
+  return busy_ns_ + (now_ns - busy_since_ns_);
+}
+
+Status BackendModelInstance::Schedule(std::vector<BACKEND_Request*>& backend_requests,
+                                      const Payload* payload) {
+  if (backend_requests.empty()) {
+    return Status::Success;
+  }
+  executing_payload_ = payload;
+  const Status status = Execute(backend_requests);
+  executing_payload_ = nullptr;
+  return status;
+}
+
+Status BackendModelInstance::BatchInput(const std::string& name, const void** buffer,
+                                        size_t* byte_size) const {
+  if (executing_payload_ == nullptr) {
+    return Status(Status::Code::INVALID_ARG,
+                  "instance " + name_ + " is not executing a batch");
+  }
+  return executing_payload_->GatheredInput(name, buffer, byte_size);
+}
+
+BackendModelInstance::~BackendModelInstance() {
+  // Stop taking the payloads of the model, then let the backend thread
+  // finish what it is executing before the instance goes away.
+  auto rate_limiter = model_->Server()->GetRateLimiter();
+  if (rate_limiter != nullptr) {
+    rate_limiter->UnregisterModelInstance(this);
+  }
+  backend_thread_.reset();
+  model_->ExecEstimator().RemoveInstance(this);
+  auto inst_fini_fn = model_->GetBackend()->ModelInstanceFiniFn();
+  if (inst_fini_fn != nullptr) {
+    SERVER_Error* err = inst_fini_fn(reinterpret_cast<BACKEND_ModelInstance*>(this));
+    if (err != nullptr) {
+      std::cerr << "failed finalizing model instance " << name_ << ": "
+                << SERVER_ErrorMessage(err) << std::endl;
+      SERVER_ErrorDelete(err);
+    }
+  }
 }
 
 Status BackendModelInstance::
@@ -67,7 +242,7 @@ BackendThread::CreateBackendThread(const std::string name,
                                    const int32_t device_id,
                                    std::unique_ptr<BackendThread>* backend_thread) {
   BackendThread* raw_backend_thread = new BackendThread(
-    name, model_instance->Model(), nice, device_id);
+    name, model_instance, nice, device_id);
   std::unique_ptr<BackendThread> runner(raw_backend_thread);
   runner->AddModelInstance(model_instance);
   runner->backend_thread_ = std::thread([raw_backend_thread]() {
@@ -80,7 +255,10 @@ BackendThread::CreateBackendThread(const std::string name,
 void BackendModelInstance::
 BackendThread::StopBackendThread() {
   if (backend_thread_.joinable()) {
-    // TODO: Signal the backend thread to exit and then wait for it...
+    // Signal the backend thread to exit and then wait for it...
+    auto rate_limiter = model_->Server()->GetRateLimiter();
+    auto exit_payload = rate_limiter->GetPayload(Payload::Operation::EXIT, model_instance_);
+    rate_limiter->EnqueuePayload(model_, exit_payload);
     backend_thread_.join();
   }
 }
@@ -92,7 +270,10 @@ BackendThread::AddModelInstance(BackendModelInstance* model_instance) {
 
 Status BackendModelInstance::
 BackendThread::InitAndWarmUpModelInstance(BackendModelInstance* model_instance) {
-  return Status::Success;
+  auto rate_limiter = model_->Server()->GetRateLimiter();
+  auto init_payload = rate_limiter->GetPayload(Payload::Operation::INIT, model_instance);
+  RETURN_IF_ERROR(rate_limiter->EnqueuePayload(model_, init_payload));
+  return init_payload->Wait();
 }
 
 void BackendModelInstance:: 
@@ -110,17 +291,18 @@ BackendThread::BackendThreadFunc() {
   std::cout << "Starting backend thread for " << name_
             << " at default nice on device " << device_id_ << "..." << std::endl;
 #endif
+  auto rate_limiter = model_->Server()->GetRateLimiter();
   bool should_exit = false;
   while (!should_exit) {
-    // std::shared_ptr<Payload> payload;
-    // model_->Server()->GetRateLimiter()->DequeuePayload(
-    //     model_instances_, &payload);
-    // NVTX_RANGE(nvtx_, "BackendThread " + name_);
-    // payload->Execute(&should_exit);
-    // model_instances_.push_back(payload->GetInstance());
-    // // Release the payload to the RateLimiter
-    // model_->Server()->GetRateLimiter()->PayloadRelease(payload);
+    std::shared_ptr<Payload> payload;
+    rate_limiter->DequeuePayload(model_instances_, &payload);
+    payload->SetState(Payload::State::EXECUTING);
+    payload->Execute(&should_exit);
+    model_instances_.push_back(payload->GetInstance());
+    // Release the payload to the RateLimiter
+    rate_limiter->PayloadRelease(payload);
   }
+  backend_thread_exit_ = true;
   std::cout << "Stopping the backend thread for " << name_ << " ..." << std::endl;
 }
 
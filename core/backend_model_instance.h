@@ -1,8 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <deque>
@@ -10,6 +12,7 @@
 #include "status.h"
 #include "message.h"
 #include "constants.h"
+#include "memory_usage.h"
 #include "interface/IServer.h"
 #include "interface/IBackend.h"
 #include "model_config_utils.h"
@@ -18,6 +21,7 @@ namespace core {
 
 class BackendModel;
 class InferenceRequest;
+class Payload;
 
 class BackendModelInstance {
  public:
@@ -35,8 +39,8 @@ class BackendModelInstance {
               int32_t device_id)
       : group_config_(group_config), 
         device_id_(device_id),
-        hash_(std::hash<std::string>{}(std::to_string(device_id_) +
-          InstanceConfigSignature(group_config_))) 
+        hash_(std::hash<std::string>{}(std::to_string(device_id) +
+          InstanceConfigSignature(group_config))) 
     {
     }
     std::size_t Hash() const { return hash_; }
@@ -65,7 +69,20 @@ class BackendModelInstance {
                                std::shared_ptr<BackendModelInstance>* backend_model_instance);
   ~BackendModelInstance();
 
-  Status Schedule(std::vector<std::unique_ptr<InferenceRequest>>&& requests);
+  // Initialize the instance in the backend. Called on the backend thread
+  // of the instance.
+  Status Initialize();
+
+  // Execute the gathered 'backend_requests' of 'payload' on the instance,
+  // the backend takes ownership of them. Called on the backend thread of
+  // the instance. Return the error of a failed execution, the requests
+  // were responded to with it already.
+  Status Schedule(std::vector<BACKEND_Request*>& backend_requests, const Payload* payload);
+
+  // Get the gathered data of input 'name' of the batch the instance
+  // executes, see Payload::GatheredInput(). Only valid on the backend
+  // thread while the batch executes.
+  Status BatchInput(const std::string& name, const void** buffer, size_t* byte_size) const;
 
   void* State() { return state_; }
   BackendModel* Model() const { return model_; }
@@ -79,6 +96,23 @@ class BackendModelInstance {
   const Message& HostPolicyMessage() const { return host_policy_message_; }
   const std::vector<std::string>& Profiles() const { return profile_names_; }
   const std::vector<SecondaryDevice>& SecondaryDevices() const { return secondary_devices_; }
+  const inference::ModelRateLimiter& RateLimiterConfig() const { return rate_limiter_config_; }
+  // The memory used by the instance.
+  MemoryUsage& Memory() { return memory_usage_; }
+  const MemoryUsage& Memory() const { return memory_usage_; }
+  // Record the usage of 'memory_type' / 'memory_type_id' the backend
+  // reports. The first report drops the estimate the instance was
+  // charged with when it was created.
+  void ReportMemoryUsage(const SERVER_MemoryType memory_type, const int64_t memory_type_id,
+                         const size_t byte_size);
+  // The total time in nanoseconds the instance spent executing batches
+  // up to 'now_ns', including the batch it is executing.
+  uint64_t BusyNs(const uint64_t now_ns) const;
+  // The decaying average of the batch execution time in nanoseconds, 0
+  // until the instance executed a batch.
+  uint64_t RecentExecNs() const { return recent_exec_ns_; }
+  // The NUMA node of the instance from its host policy, -1 if not set.
+  int NumaNode() const { return numa_node_; }
 
  private:
   class BackendThread {
@@ -91,22 +125,29 @@ class BackendModelInstance {
     ~BackendThread() {
       StopBackendThread();
     }
+    // Let the thread finish the payload it is executing and exit.
     void StopBackendThread();
     void AddModelInstance(BackendModelInstance* model_instance);
+    // Initialize 'model_instance' on the thread and wait for it to be done.
     Status InitAndWarmUpModelInstance(BackendModelInstance* model_instance);
 
    private:
     BackendThread(const std::string& name, 
-                  BackendModel* model, 
+                  BackendModelInstance* model_instance, 
                   const int nice,
                   const int32_t device_id)
-      : name_(name), nice_(nice), device_id_(device_id), model_(model) {}
+      : name_(name), nice_(nice), device_id_(device_id), 
+        model_(model_instance->Model()), model_instance_(model_instance),
+        backend_thread_exit_(false) {}
   
     void BackendThreadFunc();
     const std::string name_;
     const int nice_;
     const int32_t device_id_;
     BackendModel* model_;
+    // The instance the thread was created for, the EXIT payload is
+    // addressed to it.
+    BackendModelInstance* model_instance_;
     std::deque<BackendModelInstance*> model_instances_;
     std::thread backend_thread_;
     std::atomic<bool> backend_thread_exit_;
@@ -122,11 +163,15 @@ class BackendModelInstance {
                        const bool passive,
                        const HostPolicyCmdlineConfig& host_policy,
                        const Message& host_policy_message,
+                       const inference::ModelRateLimiter& rate_limiter_config,
                        const std::vector<SecondaryDevice>& secondary_devices)
     : model_(model), name_(name), signature_(signature), kind_(kind),
       device_id_(device_id), host_policy_(host_policy),
       host_policy_message_(host_policy_message), profile_names_(profile_names),
-      passive_(passive), secondary_devices_(secondary_devices), state_(nullptr)
+      passive_(passive), rate_limiter_config_(rate_limiter_config),
+      secondary_devices_(secondary_devices), numa_node_(-1), estimated_byte_size_(0),
+      busy_ns_(0),
+      busy_since_ns_(0), recent_exec_ns_(0), executing_payload_(nullptr), state_(nullptr)
     {}
   
   static Status Construct(BackendModel* model, 
@@ -144,7 +189,7 @@ class BackendModelInstance {
   Status SetBackendThread(const SERVER_InstanceGroupKind kind, 
                           const int32_t device_id,
                           const bool device_blocking);
-  void Execute(std::vector<BACKEND_Request*>& backend_requests);
+  Status Execute(std::vector<BACKEND_Request*>& backend_requests);
 
   // The BackendModel object that owns this instance. The instance
   // holds this as a raw pointer because the lifetime of the model is
@@ -161,10 +206,24 @@ class BackendModelInstance {
   Message host_policy_message_;
   std::vector<std::string> profile_names_;
   bool passive_;
+  const inference::ModelRateLimiter rate_limiter_config_;
   std::vector<SecondaryDevice> secondary_devices_;
+  int numa_node_;
   // Records of memory used for the model instance
-  // std::map<SERVER_MemoryType, std::map<int64_t, size_t>> memory_usage_;
-  mutable std::mutex usage_mtx_;
+  MemoryUsage memory_usage_;
+  // The memory charged when the instance was created, until the backend
+  // reports its own, 0 once dropped.
+  std::atomic<size_t> estimated_byte_size_;
+  // The total time of the executions done, and the start of the one in
+  // progress, 0 if none, see BusyNs(). Read together, a long execution
+  // would look idle otherwise.
+  mutable std::mutex busy_mu_;
+  uint64_t busy_ns_;
+  uint64_t busy_since_ns_;
+  // The average execution time, see RecentExecNs().
+  std::atomic<uint64_t> recent_exec_ns_;
+  // The payload executing, only used on the backend thread.
+  const Payload* executing_payload_;
   // Opaque state associated with this model instance.
   void* state_;
   std::shared_ptr<BackendThread> backend_thread_;
@@ -10,6 +10,10 @@ namespace core {
 
 #define SERVER_VERSION "1.0.0"
 
+constexpr char kModelConfigPbTxt[] = "config.pbtxt";
+
+constexpr char kEnsemblePlatform[] = "ensemble";
+
 constexpr char kQnnBackend[] = "qnn";
 constexpr char kQnnPlatform[] = "qualcomm";
 
@@ -0,0 +1,653 @@
+#include "dynamic_batch_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "server.h"
+#include "time_utils.h"
+#include "backend_model.h"
+#include "backend_model_instance.h"
+
+namespace core {
+
+namespace {
+// The time a failed instance stays out of rotation before it is retried,
+// doubled with each failure in a row.
+constexpr uint64_t kFailedInstanceRetryMs = 1000;
+
+// A backend failing to decide batches fails them all, its errors are
+// logged at most once per interval.
+constexpr uint64_t kBatchingErrorLogIntervalMs = 1000;
+
+// The deadline of 'request' for ordering, a request without a deadline
+// goes last.
+uint64_t DeadlineKey(const std::unique_ptr<InferenceRequest>& request) {
+  return (request->DeadlineNs() == 0) ? std::numeric_limits<uint64_t>::max()
+                                      : request->DeadlineNs();
+}
+
+// Release 'requests' with the error 'status'.
+void ReleaseRequests(std::vector<std::unique_ptr<InferenceRequest>>* requests,
+                     const Status& status) {
+  for (auto& request : *requests) {
+    InferenceRequest::RespondIfError(request, status, true /* release_request */);
+  }
+  requests->clear();
+}
+}  // namespace
+
+Status DynamicBatchScheduler::Create(BackendModel* model,
+                                     const int nice,
+                                     const bool dynamic_batching,
+                                     const int32_t max_batch_size,
+                                     const std::set<int32_t>& preferred_batch_sizes,
+                                     const uint64_t max_queue_delay_microseconds,
+                                     const size_t standby_promote_queue_depth,
+                                     const uint64_t standby_demote_delay_ms,
+                                     const size_t pipeline_depth,
+                                     const inference::ModelQueuePolicy& default_queue_policy,
+                                     const std::map<uint64_t, inference::ModelQueuePolicy>& queue_policies,
+                                     const bool deadline_order,
+                                     const uint64_t latency_target_microseconds,
+                                     std::unique_ptr<Scheduler>* scheduler) {
+  std::unique_ptr<DynamicBatchScheduler> local_scheduler(new DynamicBatchScheduler(
+      model, dynamic_batching, max_batch_size, preferred_batch_sizes,
+      max_queue_delay_microseconds, standby_promote_queue_depth,
+      standby_demote_delay_ms, pipeline_depth, default_queue_policy,
+      queue_policies, deadline_order, latency_target_microseconds));
+  DynamicBatchScheduler* raw = local_scheduler.get();
+  // A batch waiting for an idle instance is formed once one is.
+  model->Server()->GetRateLimiter()->SetIdleCallback(model, [raw]() { raw->NotifyBatcher(); });
+  local_scheduler->batcher_thread_ = std::thread([raw, nice]() {
+    raw->BatcherThread(nice);
+  });
+  *scheduler = std::move(local_scheduler);
+  return Status::Success;
+}
+
+DynamicBatchScheduler::DynamicBatchScheduler(BackendModel* model,
+                                             const bool dynamic_batching,
+                                             const int32_t max_batch_size,
+                                             const std::set<int32_t>& preferred_batch_sizes,
+                                             const uint64_t max_queue_delay_microseconds,
+                                             const size_t standby_promote_queue_depth,
+                                             const uint64_t standby_demote_delay_ms,
+                                             const size_t pipeline_depth,
+                                             const inference::ModelQueuePolicy& default_queue_policy,
+                                             const std::map<uint64_t, inference::ModelQueuePolicy>& queue_policies,
+                                             const bool deadline_order,
+                                             const uint64_t latency_target_microseconds)
+  : model_(model),
+    // A model that does not batch executes each request on its own.
+    dynamic_batching_enabled_(dynamic_batching && (max_batch_size > 0)),
+    max_batch_size_(std::max(1, max_batch_size)),
+    preferred_batch_sizes_(preferred_batch_sizes),
+    max_queue_delay_ns_(max_queue_delay_microseconds * 1000),
+    pipeline_depth_(std::max<size_t>(1, pipeline_depth)),
+    default_queue_policy_(default_queue_policy),
+    queue_policies_(queue_policies),
+    deadline_order_(deadline_order),
+    next_queue_sequence_(0),
+    deadline_count_(0),
+    exit_(false),
+    last_batching_error_ns_(0),
+    suppressed_batching_errors_(0),
+    rotation_(model->Name(), max_batch_size_, standby_promote_queue_depth,
+              standby_demote_delay_ms * 1000 * 1000, kFailedInstanceRetryMs * 1000 * 1000,
+              [model](BackendModelInstance* instance, const bool in_rotation) -> Status {
+                auto rate_limiter = model->Server()->GetRateLimiter();
+                if (!in_rotation) {
+                  rate_limiter->UnregisterModelInstance(instance);
+                  return Status::Success;
+                }
+                return rate_limiter->RegisterModelInstance(instance,
+                                                           instance->RateLimiterConfig());
+              }),
+    stop_(false),
+    inflight_(0),
+    batch_latency_ns_(0) {
+  timer_service_ = model_->Server()->GetTimerService();
+  if (dynamic_batching_enabled_ && (latency_target_microseconds > 0)) {
+    delay_tuner_.reset(new QueueDelayTuner(
+        &model_->ExecEstimator(), max_batch_size_, latency_target_microseconds * 1000, max_queue_delay_ns_));
+  }
+}
+
+DynamicBatchScheduler::~DynamicBatchScheduler() {
+  model_->Server()->GetRateLimiter()->SetIdleCallback(model_, nullptr);
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    exit_ = true;
+  }
+  cv_.notify_one();
+  if (batcher_thread_.joinable()) {
+    batcher_thread_.join();
+  }
+  // A timer that fired already may still be notifying the batcher.
+  for (const auto& request : queue_) {
+    timer_service_->Cancel(request->TimerId());
+  }
+  timer_service_->WaitForCallbacks();
+  // Release the requests that never made it to an instance.
+  for (auto& request : queue_) {
+    InferenceRequest::RespondIfError(
+        request,
+        Status(Status::Code::UNAVAILABLE,
+               "model '" + model_->Name() + "' is being unloaded"),
+        true /* release_request */);
+  }
+  queue_.clear();
+  for (auto& request : delayed_queue_) {
+    InferenceRequest::RespondIfError(
+        request,
+        Status(Status::Code::UNAVAILABLE,
+               "model '" + model_->Name() + "' is being unloaded"),
+        true /* release_request */);
+  }
+  delayed_queue_.clear();
+}
+
+const inference::ModelQueuePolicy& DynamicBatchScheduler::QueuePolicy(
+    const uint64_t priority) const {
+  const auto itr = queue_policies_.find(priority);
+  return (itr == queue_policies_.end()) ? default_queue_policy_ : itr->second;
+}
+
+Status DynamicBatchScheduler::Enqueue(std::unique_ptr<InferenceRequest>& request) {
+  if (stop_) {
+    auto msg = "Server is stopping, scheduler for model '" + model_->Name() +
+               "' has stopped accepting new inference requests";
+    return Status(Status::Code::UNAVAILABLE, msg);
+  }
+  if (request->BatchSize() > max_batch_size_) {
+    auto msg = "inference request batch-size must be <= " +
+               std::to_string(max_batch_size_) + " for '" + model_->Name() + "'";
+    return Status(Status::Code::INVALID_ARG, msg);
+  }
+  // A request may only shorten the timeout of its policy.
+  const auto& policy = QueuePolicy(request->Priority());
+  uint64_t timeout_us = policy.default_timeout_microseconds();
+  if (policy.allow_timeout_override() && (request->TimeoutMicroseconds() != 0) &&
+      ((timeout_us == 0) || (request->TimeoutMicroseconds() < timeout_us))) {
+    timeout_us = request->TimeoutMicroseconds();
+  }
+  const uint64_t queue_start_ns = request->CaptureQueueStartNs();
+  request->SetDeadlineNs((timeout_us == 0) ? 0 : queue_start_ns + timeout_us * 1000);
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    // The queue size is limited for each priority level.
+    size_t& queued_count = queued_counts_[request->Priority()];
+    if ((policy.max_queue_size() > 0) && (queued_count >= policy.max_queue_size())) {
+      return Status(Status::Code::UNAVAILABLE,
+                    "exceeds maximum queue size for model '" + model_->Name() + "'");
+    }
+    ++queued_count;
+    ++inflight_;
+    if (delay_tuner_ != nullptr) {
+      delay_tuner_->RecordArrival(queue_start_ns);
+    }
+    request->SetQueueSequence(next_queue_sequence_++);
+    if (request->DeadlineNs() != 0) {
+      ++deadline_count_;
+      ArmTimer(request.get());
+    }
+    const uint64_t trace_id = request->TraceId();
+    if (deadline_order_) {
+      // Behind the requests of the same deadline to keep them in order.
+      const uint64_t key = DeadlineKey(request);
+      const auto itr = std::upper_bound(
+          queue_.begin(), queue_.end(), key,
+          [](const uint64_t lhs, const std::unique_ptr<InferenceRequest>& rhs) {
+            return lhs < DeadlineKey(rhs);
+          });
+      queue_.insert(itr, std::move(request));
+    } else {
+      queue_.push_back(std::move(request));
+    }
+    // Only a request that made it into the queue is queued, the batcher
+    // can't take it before the lock is released.
+    InferenceTracer::Record(trace_id, TraceActivity::QUEUED, model_->TraceNameId());
+    UpdatePendingRequestCount();
+  }
+  cv_.notify_one();
+  return Status::Success;
+}
+
+std::unique_ptr<InferenceRequest> DynamicBatchScheduler::TakeRequest(
+    std::deque<std::unique_ptr<InferenceRequest>>::iterator itr) {
+  std::unique_ptr<InferenceRequest> request = std::move(*itr);
+  queue_.erase(itr);
+  const auto citr = queued_counts_.find(request->Priority());
+  if ((citr != queued_counts_.end()) && (--citr->second == 0)) {
+    queued_counts_.erase(citr);
+  }
+  if (request->DeadlineNs() != 0) {
+    --deadline_count_;
+    timer_service_->Cancel(request->TimerId());
+    request->SetTimerId(0);
+  }
+  return request;
+}
+
+void DynamicBatchScheduler::ArmTimer(InferenceRequest* request) {
+  // A request expires once it can't make its deadline even if it was
+  // sent right away.
+  const uint64_t latency_ns = batch_latency_ns_;
+  const uint64_t deadline_ns = request->DeadlineNs();
+  const uint64_t sequence = request->QueueSequence();
+  const uint64_t expiry_ns = (deadline_ns > latency_ns) ? deadline_ns - latency_ns : 0;
+  request->SetTimerId(timer_service_->Schedule(expiry_ns, [this, deadline_ns, sequence]() {
+    // The batcher only looks at the requests whose timer fired.
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      expired_timers_.emplace_back(deadline_ns, sequence);
+    }
+    cv_.notify_one();
+  }));
+}
+
+std::deque<std::unique_ptr<InferenceRequest>>::iterator DynamicBatchScheduler::FindRequest(
+    const uint64_t deadline_ns, const uint64_t sequence) {
+  if (!deadline_order_) {
+    const auto itr = std::lower_bound(
+        queue_.begin(), queue_.end(), sequence,
+        [](const std::unique_ptr<InferenceRequest>& lhs, const uint64_t rhs) {
+          return lhs->QueueSequence() < rhs;
+        });
+    return ((itr != queue_.end()) && ((*itr)->QueueSequence() == sequence)) ? itr
+                                                                            : queue_.end();
+  }
+  // The requests of the same deadline stay in arrival order.
+  for (auto itr = std::lower_bound(
+           queue_.begin(), queue_.end(), deadline_ns,
+           [](const std::unique_ptr<InferenceRequest>& lhs, const uint64_t rhs) {
+             return DeadlineKey(lhs) < rhs;
+           });
+       (itr != queue_.end()) && (DeadlineKey(*itr) == deadline_ns); ++itr) {
+    if ((*itr)->QueueSequence() == sequence) {
+      return itr;
+    }
+  }
+  return queue_.end();
+}
+
+void DynamicBatchScheduler::ExpireRequest(
+    std::deque<std::unique_ptr<InferenceRequest>>::iterator itr,
+    std::vector<std::unique_ptr<InferenceRequest>>* rejected) {
+  std::unique_ptr<InferenceRequest> request = TakeRequest(itr);
+  if (QueuePolicy(request->Priority()).timeout_action() ==
+      inference::ModelQueuePolicy::DELAY) {
+    request->SetDeadlineNs(0);
+    ++queued_counts_[request->Priority()];
+    delayed_queue_.push_back(std::move(request));
+  } else {
+    rejected->push_back(std::move(request));
+  }
+}
+
+void DynamicBatchScheduler::RemoveExpiredRequests(
+    std::vector<std::unique_ptr<InferenceRequest>>* rejected) {
+  std::vector<std::pair<uint64_t, uint64_t>> expired_timers;
+  expired_timers.swap(expired_timers_);
+  if (deadline_count_ == 0) {
+    return;
+  }
+  const uint64_t now_ns = CaptureTimeNs();
+  const uint64_t latency_ns = batch_latency_ns_;
+  if (deadline_order_) {
+    // The expired requests are at the front, including those whose timer
+    // is late since the batches got slower.
+    while (!queue_.empty() && (queue_.front()->DeadlineNs() != 0) &&
+           (now_ns + latency_ns > queue_.front()->DeadlineNs())) {
+      ExpireRequest(queue_.begin(), rejected);
+    }
+  }
+  for (const auto& timer : expired_timers) {
+    // The request may have been sent or expired already.
+    const auto itr = FindRequest(timer.first, timer.second);
+    if ((itr == queue_.end()) || ((*itr)->DeadlineNs() == 0)) {
+      continue;
+    }
+    if (now_ns + latency_ns <= (*itr)->DeadlineNs()) {
+      // The batches got faster since the timer was armed.
+      ArmTimer(itr->get());
+      continue;
+    }
+    ExpireRequest(itr, rejected);
+  }
+}
+
+Status DynamicBatchScheduler::Update(
+    const std::vector<std::shared_ptr<BackendModelInstance>>& added,
+    const std::vector<std::shared_ptr<BackendModelInstance>>& removed) {
+  std::lock_guard<std::mutex> lock(mu_);
+  // Take the new instances first, the model never runs out of instances
+  // while the group changes. Passive instances wait as standbys.
+  for (const auto& instance : added) {
+    RETURN_IF_ERROR(rotation_.Add(instance.get(), instance->Name(), instance->IsPassive()));
+  }
+  for (const auto& instance : removed) {
+    rotation_.Remove(instance.get());
+  }
+  cv_.notify_one();
+  return Status::Success;
+}
+
+void DynamicBatchScheduler::InstanceFailed(BackendModelInstance* instance,
+                                           const Status& status) {
+  std::lock_guard<std::mutex> lock(mu_);
+  rotation_.Failed(instance, status.Message(), CaptureTimeNs());
+  // The batcher waits for the instance to be retried.
+  cv_.notify_one();
+}
+
+uint64_t DynamicBatchScheduler::OldestQueueStartNs() {
+  std::lock_guard<std::mutex> lock(mu_);
+  return OldestQueueStartNsLocked();
+}
+
+uint64_t DynamicBatchScheduler::OldestQueueStartNsLocked() const {
+  if (queue_.empty()) {
+    return 0;
+  }
+  // The queue is in arrival order unless it is ordered by deadline. The
+  // delayed requests missed their deadline already, they are left out.
+  if (!deadline_order_) {
+    return queue_.front()->QueueStartNs();
+  }
+  uint64_t oldest_ns = std::numeric_limits<uint64_t>::max();
+  for (const auto& request : queue_) {
+    oldest_ns = std::min(oldest_ns, request->QueueStartNs());
+  }
+  return oldest_ns;
+}
+
+void DynamicBatchScheduler::RemoveCancelledRequests(
+    std::vector<std::unique_ptr<InferenceRequest>>* cancelled) {
+  for (size_t i = 0; i < queue_.size();) {
+    if (queue_[i]->IsCancelled()) {
+      cancelled->push_back(TakeRequest(queue_.begin() + i));
+    } else {
+      ++i;
+    }
+  }
+}
+
+void DynamicBatchScheduler::UpdatePendingRequestCount() {
+  model_->Metrics()->PendingRequestCount().Set(
+      static_cast<double>(queue_.size() + delayed_queue_.size()));
+}
+
+void DynamicBatchScheduler::NotifyBatcher() {
+  // Taking the lock orders the notification after the batcher either
+  // checked its condition or started waiting.
+  { std::lock_guard<std::mutex> lock(mu_); }
+  cv_.notify_one();
+}
+
+uint64_t DynamicBatchScheduler::GetDynamicBatch(size_t* request_count) {
+  if (!dynamic_batching_enabled_) {
+    *request_count = 1;
+    return 0;
+  }
+  const uint64_t now_ns = CaptureTimeNs();
+  const uint64_t oldest_ns = OldestQueueStartNsLocked();
+  // The requests without a deadline are at the back in arrival order, the
+  // first of them is the oldest. Once due, and left out of the batch by
+  // the requests with a deadline, it leads the batch instead. The batch
+  // is sent right away so the deadline order is back once it is taken.
+  if (deadline_order_ && (deadline_count_ > 0) && (deadline_count_ < queue_.size()) &&
+      (queue_[deadline_count_]->QueueStartNs() + max_queue_delay_ns_ <= now_ns)) {
+    size_t batch_size = std::max(1U, queue_[deadline_count_]->BatchSize());
+    for (size_t i = 0; (i < deadline_count_) && (batch_size <= max_batch_size_); ++i) {
+      batch_size += std::max(1U, queue_[i]->BatchSize());
+    }
+    if (batch_size > max_batch_size_) {
+      const auto itr = queue_.begin() + deadline_count_;
+      std::unique_ptr<InferenceRequest> request = std::move(*itr);
+      queue_.erase(itr);
+      queue_.push_front(std::move(request));
+    }
+  }
+  // Grow the batch from the front of the queue until it reaches the
+  // maximum batch size, remembering the largest preferred size on the
+  // way. The backend is only asked once the batch is sent, not on every
+  // wake-up.
+  size_t batch_size = 0;
+  size_t count = 0;
+  size_t preferred_count = 0;
+  uint64_t min_deadline_ns = std::numeric_limits<uint64_t>::max();
+  for (const auto& request : queue_) {
+    const size_t request_batch_size = std::max(1U, request->BatchSize());
+    if ((count > 0) && (batch_size + request_batch_size > max_batch_size_)) {
+      break;
+    }
+    batch_size += request_batch_size;
+    ++count;
+    min_deadline_ns = std::min(min_deadline_ns, DeadlineKey(request));
+    if (preferred_batch_sizes_.find(static_cast<int32_t>(batch_size)) != preferred_batch_sizes_.end()) {
+      preferred_count = count;
+    }
+  }
+  // The batch can't grow any further.
+  if ((batch_size >= max_batch_size_) || (count < queue_.size())) {
+    *request_count = CustomBatchCount(count);
+    return 0;
+  }
+  if ((preferred_count == count) && (count > 0)) {
+    *request_count = CustomBatchCount(count);
+    return 0;
+  }
+  // Wait for more requests unless the oldest request waited long enough,
+  // or waiting any longer would make a request of the batch miss its
+  // deadline. In deadline order the oldest request isn't at the front.
+  uint64_t due_ns = oldest_ns + max_queue_delay_ns_;
+  if (min_deadline_ns != std::numeric_limits<uint64_t>::max()) {
+    const uint64_t latency_ns = batch_latency_ns_;
+    due_ns = std::min(due_ns, (min_deadline_ns > latency_ns) ? min_deadline_ns - latency_ns : 0);
+  }
+  if (now_ns < due_ns) {
+    return due_ns - now_ns;
+  }
+  *request_count = CustomBatchCount((preferred_count > 0) ? preferred_count : count);
+  return 0;
+}
+
+size_t DynamicBatchScheduler::CustomBatchCount(const size_t count) {
+  if ((count == 0) || !model_->HasCustomBatching()) {
+    return count;
+  }
+  void* batch_userp = nullptr;
+  Status status = model_->BatchInitialize(&batch_userp);
+  if (!status.IsOk()) {
+    // The batch is formed by request count then.
+    LogBatchingError("initializing", status);
+    return count;
+  }
+  // The first request always makes a batch, the queue would stall
+  // otherwise. The backend is still asked so that it accounts for it.
+  size_t included = 0;
+  for (; included < count; ++included) {
+    bool should_include = false;
+    status = model_->BatchIncludeRequest(queue_[included].get(), batch_userp, &should_include);
+    if (!status.IsOk()) {
+      LogBatchingError("deciding", status);
+    }
+    if (!should_include && (included > 0)) {
+      break;
+    }
+  }
+  model_->BatchFinalize(batch_userp);
+  return included;
+}
+
+void DynamicBatchScheduler::LogBatchingError(const char* what, const Status& status) {
+  const uint64_t now_ns = CaptureTimeNs();
+  if ((last_batching_error_ns_ != 0) &&
+      (now_ns < last_batching_error_ns_ + kBatchingErrorLogIntervalMs * 1000 * 1000)) {
+    ++suppressed_batching_errors_;
+    return;
+  }
+  std::cerr << "failed " << what << " a batch of model '" << model_->Name()
+            << "': " << status.Message();
+  if (suppressed_batching_errors_ > 0) {
+    std::cerr << " (" << suppressed_batching_errors_ << " more errors since the last one logged)";
+  }
+  std::cerr << std::endl;
+  last_batching_error_ns_ = now_ns;
+  suppressed_batching_errors_ = 0;
+}
+
+void DynamicBatchScheduler::BatcherThread(const int nice) {
+#ifndef _WIN32
+  if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice) == 0) {
+    std::cout << "Starting dynamic-batcher thread for " << model_->Name()
+              << " at nice " << nice << "..." << std::endl;
+  } else {
+    std::cout << "Starting dynamic-batcher thread for " << model_->Name()
+              << " at default nice (requested nice " << nice << " failed)..."
+              << std::endl;
+  }
+#else
+  std::cout << "Starting dynamic-batcher thread for " << model_->Name()
+            << " at default nice..." << std::endl;
+#endif
+  auto rate_limiter = model_->Server()->GetRateLimiter();
+  std::unique_lock<std::mutex> lock(mu_);
+  while (!exit_) {
+    std::vector<std::unique_ptr<InferenceRequest>> expired, cancelled;
+    // Only look for expired requests once one of their timers fired.
+    if (!expired_timers_.empty()) {
+      RemoveExpiredRequests(&expired);
+    }
+    // Cancelling doesn't search the queue, the batcher drops the cancelled
+    // requests whenever it wakes up.
+    RemoveCancelledRequests(&cancelled);
+    if (!expired.empty() || !cancelled.empty()) {
+      inflight_ -= expired.size() + cancelled.size();
+      UpdatePendingRequestCount();
+      lock.unlock();
+      ReleaseRequests(&expired, Status(Status::Code::UNAVAILABLE, "request timeout expired"));
+      ReleaseRequests(&cancelled, Status(Status::Code::CANCELLED, "request was cancelled"));
+      lock.lock();
+      continue;
+    }
+    // The delayed requests run once no other request is waiting.
+    if (queue_.empty() && !delayed_queue_.empty()) {
+      queue_.swap(delayed_queue_);
+      // Renumbered so the queue stays in sequence order, the delayed
+      // requests have no timer left.
+      for (auto& request : queue_) {
+        request->SetQueueSequence(next_queue_sequence_++);
+      }
+    }
+    const uint64_t rotation_wait_ns = rotation_.Manage(queue_.size(), CaptureTimeNs());
+    // Only form a batch once an instance can take it, or have it ready
+    // when the pipeline allows, the batch keeps growing otherwise.
+    if (queue_.empty() || !rate_limiter->PayloadSlotAvailable(model_, pipeline_depth_)) {
+      if (rotation_wait_ns > 0) {
+        cv_.wait_for(lock, std::chrono::nanoseconds(rotation_wait_ns));
+      } else {
+        cv_.wait(lock);
+      }
+      continue;
+    }
+    if (delay_tuner_ != nullptr) {
+      max_queue_delay_ns_ = delay_tuner_->QueueDelayNs(CaptureTimeNs());
+    }
+    size_t request_count = 0;
+    const uint64_t wait_ns = GetDynamicBatch(&request_count);
+    if (wait_ns > 0) {
+      cv_.wait_for(lock, std::chrono::nanoseconds(wait_ns));
+      continue;
+    }
+    std::shared_ptr<Payload> payload = rate_limiter->GetPayload(Payload::Operation::INFER_RUN);
+    // The inputs are copied here, while the instances execute the batches
+    // formed before.
+    payload->SetGatherInputs(model_->GathersBatchInputs());
+    const uint64_t dispatch_ns = CaptureTimeNs();
+    uint64_t queue_delay_ns = 0;
+    uint64_t last_queue_start_ns = 0;
+    size_t batched_count = 0;
+    size_t batch_size = 0;
+    // Only kept for the tuner, which counts each request at its latency.
+    std::vector<uint64_t> queue_start_ns;
+    ModelMetrics* metrics = model_->Metrics();
+    for (size_t i = 0; i < request_count; ++i) {
+      std::unique_ptr<InferenceRequest> request = TakeRequest(queue_.begin());
+      if (request->IsCancelled()) {
+        cancelled.push_back(std::move(request));
+        continue;
+      }
+      last_queue_start_ns = std::max(last_queue_start_ns, request->QueueStartNs());
+      queue_delay_ns += dispatch_ns - request->QueueStartNs();
+      if (delay_tuner_ != nullptr) {
+        queue_start_ns.push_back(request->QueueStartNs());
+      }
+      metrics->QueueDurationUs().Observe((dispatch_ns - request->QueueStartNs()) / 1000);
+      batch_size += std::max(1U, request->BatchSize());
+      InferenceTracer::Record(request->TraceId(), TraceActivity::BATCH_FORMED,
+                              model_->TraceNameId());
+      payload->AddRequest(std::move(request));
+      ++batched_count;
+    }
+    UpdatePendingRequestCount();
+    if (batched_count > 0) {
+      metrics->BatchSize().Observe(batch_size);
+      metrics->InferenceCount().Increment(static_cast<double>(batch_size));
+      metrics->ExecutionCount().Increment(1);
+    }
+    if (!cancelled.empty()) {
+      inflight_ -= cancelled.size();
+      lock.unlock();
+      ReleaseRequests(&cancelled, Status(Status::Code::CANCELLED, "request was cancelled"));
+      lock.lock();
+    }
+    if (batched_count == 0) {
+      continue;
+    }
+    request_count = batched_count;
+    model_->RecordQueueDelay(request_count, queue_delay_ns);
+    if (model_->GetAdmissionController() != nullptr) {
+      model_->GetAdmissionController()->RecordQueueDelay(
+          dispatch_ns - last_queue_start_ns, dispatch_ns);
+      if (queue_.empty() && delayed_queue_.empty()) {
+        model_->GetAdmissionController()->RecordQueueEmpty();
+      }
+    }
+    payload->SetCallback([this]() { NotifyBatcher(); });
+    payload->AddInternalReleaseCallback(
+        [this, request_count, queue_start_ns, dispatch_ns]() {
+          const uint64_t release_ns = CaptureTimeNs();
+          if (delay_tuner_ != nullptr) {
+            for (const uint64_t start_ns : queue_start_ns) {
+              delay_tuner_->RecordLatency(release_ns - start_ns, 1);
+            }
+          }
+          // Decay by 1/8, a lost update between two instances only drops a
+          // sample.
+          const int64_t latency_ns = static_cast<int64_t>(release_ns - dispatch_ns);
+          const int64_t average_ns = static_cast<int64_t>(batch_latency_ns_.load());
+          batch_latency_ns_ = static_cast<uint64_t>(
+              (average_ns == 0) ? latency_ns : average_ns + (latency_ns - average_ns) / 8);
+          // Last, a drained model may be unloaded as soon as nothing is in
+          // flight, the scheduler must not be touched afterwards.
+          inflight_ -= request_count;
+        });
+    lock.unlock();
+    rate_limiter->EnqueuePayload(model_, std::move(payload));
+    lock.lock();
+  }
+  std::cout << "Stopping dynamic-batcher thread for " << model_->Name() << "..."
+            << std::endl;
+}
+
+} // namespace core
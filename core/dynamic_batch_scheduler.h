@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "status.h"
+#include "scheduler.h"
+#include "constants.h"
+#include "model_config.pb.h"
+#include "infer_request.h"
+#include "queue_delay_tuner.h"
+#include "instance_rotation.h"
+#include "timing_wheel.h"
+
+namespace core {
+
+class BackendModel;
+
+// Scheduler that forms batches of the queued requests and hands them to
+// the instances of a model through the rate limiter.
+class DynamicBatchScheduler : public Scheduler {
+ public:
+  // Create a scheduler for 'model'. If 'dynamic_batching' is false each
+  // request is executed on its own, otherwise requests are combined up to
+  // 'max_batch_size', preferring the sizes in 'preferred_batch_sizes' and
+  // delaying a request by at most 'max_queue_delay_microseconds' to
+  // grow its batch. Passive instances are kept as standbys, one is
+  // promoted once 'standby_promote_queue_depth' requests are queued and
+  // demoted again after the queue stayed below a full batch for
+  // 'standby_demote_delay_ms'. A failing instance is taken out of
+  // rotation for a while, see InstanceRotation. Each instance has up to
+  // 'pipeline_depth' batches formed, the one it executes and the ones
+  // ready next, with their inputs gathered if the backend asked for it.
+  // The timeouts and the queue size of the requests follow the queue
+  // policy of their priority level, 'default_queue_policy' for the levels
+  // missing from 'queue_policies'. If 'deadline_order' is true batches are
+  // formed from the requests with the earliest deadline first. A non-zero
+  // 'latency_target_microseconds' has the delay tuned online for the most
+  // throughput at that p99 latency, 'max_queue_delay_microseconds' is the
+  // delay to start from.
+  static Status Create(BackendModel* model,
+                       const int nice,
+                       const bool dynamic_batching,
+                       const int32_t max_batch_size,
+                       const std::set<int32_t>& preferred_batch_sizes,
+                       const uint64_t max_queue_delay_microseconds,
+                       const size_t standby_promote_queue_depth,
+                       const uint64_t standby_demote_delay_ms,
+                       const size_t pipeline_depth,
+                       const inference::ModelQueuePolicy& default_queue_policy,
+                       const std::map<uint64_t, inference::ModelQueuePolicy>& queue_policies,
+                       const bool deadline_order,
+                       const uint64_t latency_target_microseconds,
+                       std::unique_ptr<Scheduler>* scheduler);
+  ~DynamicBatchScheduler();
+
+  // \see Scheduler::Enqueue()
+  Status Enqueue(std::unique_ptr<InferenceRequest>& request) override;
+
+  // \see Scheduler::InflightInferenceCount()
+  size_t InflightInferenceCount() override { return inflight_; }
+
+  // \see Scheduler::Stop()
+  void Stop() override { stop_ = true; }
+
+  // \see Scheduler::Update()
+  Status Update(
+      const std::vector<std::shared_ptr<BackendModelInstance>>& added,
+      const std::vector<std::shared_ptr<BackendModelInstance>>& removed) override;
+
+  // \see Scheduler::InstanceFailed()
+  void InstanceFailed(BackendModelInstance* instance, const Status& status) override;
+
+  // \see Scheduler::OldestQueueStartNs()
+  uint64_t OldestQueueStartNs() override;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DynamicBatchScheduler);
+  DynamicBatchScheduler(BackendModel* model,
+                        const bool dynamic_batching,
+                        const int32_t max_batch_size,
+                        const std::set<int32_t>& preferred_batch_sizes,
+                        const uint64_t max_queue_delay_microseconds,
+                        const size_t standby_promote_queue_depth,
+                        const uint64_t standby_demote_delay_ms,
+                        const size_t pipeline_depth,
+                        const inference::ModelQueuePolicy& default_queue_policy,
+                        const std::map<uint64_t, inference::ModelQueuePolicy>& queue_policies,
+                        const bool deadline_order,
+                        const uint64_t latency_target_microseconds);
+
+  void BatcherThread(const int nice);
+
+  // Decide how many requests from the front of the queue form the next
+  // batch. Return the time in nanoseconds to wait for more requests
+  // before the batch is due, 0 if the batch is to be sent now. A batch
+  // is sent early if waiting longer would miss the deadline of one of
+  // its requests. In deadline order the oldest request without a
+  // deadline is moved to the front once it waited the maximum queue
+  // delay, it would wait behind the requests with a deadline forever
+  // otherwise. Must be called with 'mu_' held.
+  uint64_t GetDynamicBatch(size_t* request_count);
+
+  // Let the custom batching of the backend, if any, trim the batch of the
+  // first 'count' requests of the queue about to be sent. Return the
+  // number of requests the backend keeps, at least one. Must be called
+  // with 'mu_' held.
+  size_t CustomBatchCount(const size_t count);
+
+  // Log the failure 'status' of the custom batching while 'what', at most
+  // once per interval. Must be called with 'mu_' held.
+  void LogBatchingError(const char* what, const Status& status);
+
+  // The queue policy of the requests of 'priority'.
+  const inference::ModelQueuePolicy& QueuePolicy(const uint64_t priority) const;
+
+  // Take the requests whose timer fired and that can no longer finish by
+  // their deadline out of the queue. Those of a REJECT policy are moved
+  // to 'rejected', those of a DELAY policy run once the other requests
+  // are done. The timers that fired early are armed again. Must be
+  // called with 'mu_' held.
+  void RemoveExpiredRequests(std::vector<std::unique_ptr<InferenceRequest>>* rejected);
+
+  // Move the expired request at 'itr' to 'rejected' or 'delayed_queue_'
+  // by its queue policy. Must be called with 'mu_' held.
+  void ExpireRequest(std::deque<std::unique_ptr<InferenceRequest>>::iterator itr,
+                     std::vector<std::unique_ptr<InferenceRequest>>* rejected);
+
+  // The queued request of 'deadline_ns' and 'sequence', 'queue_.end()'
+  // if it was taken already. Must be called with 'mu_' held.
+  std::deque<std::unique_ptr<InferenceRequest>>::iterator FindRequest(
+      const uint64_t deadline_ns, const uint64_t sequence);
+
+  // Schedule the timer waking up the batcher once 'request' can no longer
+  // make its deadline. Must be called with 'mu_' held.
+  void ArmTimer(InferenceRequest* request);
+
+  // Remove the request at 'itr' from 'queue_', cancelling its timer.
+  // Must be called with 'mu_' held.
+  std::unique_ptr<InferenceRequest> TakeRequest(
+      std::deque<std::unique_ptr<InferenceRequest>>::iterator itr);
+
+  // \see OldestQueueStartNs(), must be called with 'mu_' held.
+  uint64_t OldestQueueStartNsLocked() const;
+
+  // Move the cancelled requests out of the queue, wherever they are, to
+  // 'cancelled'. Must be called with 'mu_' held.
+  void RemoveCancelledRequests(std::vector<std::unique_ptr<InferenceRequest>>* cancelled);
+
+  // Wake up the batcher thread.
+  void NotifyBatcher();
+
+  // Report the requests waiting in the queues to the metrics of the
+  // model. Must be called with 'mu_' held.
+  void UpdatePendingRequestCount();
+
+  BackendModel* model_;
+  const bool dynamic_batching_enabled_;
+  const size_t max_batch_size_;
+  const std::set<int32_t> preferred_batch_sizes_;
+  // Tuned by 'delay_tuner_' if set.
+  uint64_t max_queue_delay_ns_;
+  const size_t pipeline_depth_;
+  const inference::ModelQueuePolicy default_queue_policy_;
+  const std::map<uint64_t, inference::ModelQueuePolicy> queue_policies_;
+  const bool deadline_order_;
+  std::unique_ptr<QueueDelayTuner> delay_tuner_;
+  std::shared_ptr<TimerService> timer_service_;
+
+  // Protects 'queue_', 'exit_', 'rotation_' and the batching error log.
+  std::mutex mu_;
+  std::condition_variable cv_;
+  // The requests in arrival order, or by deadline if 'deadline_order_'.
+  std::deque<std::unique_ptr<InferenceRequest>> queue_;
+  // The sequence of the next queued request, arrival order is also
+  // sequence order.
+  uint64_t next_queue_sequence_;
+  // The deadline and sequence of the requests whose timer fired since
+  // the batcher last looked for expired requests.
+  std::vector<std::pair<uint64_t, uint64_t>> expired_timers_;
+  // The number of requests in 'queue_' that have a deadline.
+  size_t deadline_count_;
+  // The requests that missed their deadline under a DELAY policy.
+  std::deque<std::unique_ptr<InferenceRequest>> delayed_queue_;
+  // The number of requests in both queues by priority level.
+  std::map<uint64_t, size_t> queued_counts_;
+  bool exit_;
+  // When a custom batching error was last logged, and the errors not
+  // logged since.
+  uint64_t last_batching_error_ns_;
+  size_t suppressed_batching_errors_;
+  // The instances taking the batches, the standbys and the failed ones.
+  InstanceRotation rotation_;
+  std::thread batcher_thread_;
+
+  // Whether new requests are rejected.
+  std::atomic<bool> stop_;
+  // The requests enqueued and not yet released by an instance.
+  std::atomic<size_t> inflight_;
+  // The decaying average time from sending a batch to an instance until
+  // it is released, the time a request needs ahead of its deadline.
+  std::atomic<uint64_t> batch_latency_ns_;
+};
+
+} // namespace core
@@ -0,0 +1,36 @@
+#include "ensemble_model.h"
+
+#include "server.h"
+
+namespace core {
+
+Status EnsembleModel::Create(InferenceServer* server,
+                             const std::string& path,
+                             const int64_t version,
+                             const inference::ModelConfig& model_config,
+                             const bool is_config_provided,
+                             std::unique_ptr<Model>* model) {
+  model->reset();
+  if (model_config.ensemble_scheduling().step_size() == 0) {
+    auto msg = "ensemble '" + model_config.name() +
+               "' must specify one or more 'step's";
+    return Status(Status::Code::INVALID_ARG, msg);
+  }
+  // The components are loaded ahead of the ensemble, so every step must
+  // resolve to a model that is available right now.
+  for (const auto& step : model_config.ensemble_scheduling().step()) {
+    std::shared_ptr<Model> component;
+    Status status = server->GetModel(step.model_name(), step.model_version(), &component);
+    if (!status.IsOk()) {
+      auto msg = "ensemble '" + model_config.name() +
+                 "' depends on '" + step.model_name() +
+                 "' which is not available: " + status.Message();
+      return Status(Status::Code::INVALID_ARG, msg);
+    }
+  }
+  return Status(Status::Code::UNSUPPORTED,
+                "ensemble '" + model_config.name() +
+                "' cannot be served, executing ensembles is not supported");
+}
+
+} // namespace core
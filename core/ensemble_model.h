@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "model.h"
+#include "status.h"
+#include "constants.h"
+
+namespace core {
+
+class InferenceServer;
+
+// A model composed of other models. The component models must be
+// loaded before the ensemble itself. Executing the steps of an ensemble
+// is not supported, an ensemble is checked against its components and
+// then left UNAVAILABLE rather than reported READY without a scheduler
+// to serve its requests.
+class EnsembleModel : public Model {
+ public:
+  // Check 'model_config' and the components of the ensemble. Always
+  // fails, with UNSUPPORTED once the ensemble is found valid.
+  static Status Create(InferenceServer* server,
+                       const std::string& path,
+                       const int64_t version,
+                       const inference::ModelConfig& model_config,
+                       const bool is_config_provided,
+                       std::unique_ptr<Model>* model);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(EnsembleModel);
+};
+
+} // namespace core
@@ -0,0 +1,192 @@
+#include "exec_time_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace core {
+
+namespace {
+// The weight of a new execution once the average is warmed up.
+constexpr double kDecay = 1.0 / 8;
+
+// Move the 'quantile' estimate 'value' towards 'sample', it settles
+// where a fraction 'quantile' of the samples is below it.
+void UpdateQuantile(const double quantile, const double sample, const double step,
+                    double* value) {
+  if (sample > *value) {
+    *value += step * quantile;
+  } else {
+    *value = std::max(0.0, *value - step * (1 - quantile));
+  }
+}
+
+ExecTimeEstimator::Estimate Interpolate(const ExecTimeEstimator::Estimate& lower,
+                                        const ExecTimeEstimator::Estimate& upper,
+                                        const double ratio) {
+  ExecTimeEstimator::Estimate estimate;
+  estimate.count_ = std::min(lower.count_, upper.count_);
+  estimate.mean_ns_ = lower.mean_ns_ + (upper.mean_ns_ - lower.mean_ns_) * ratio;
+  estimate.p50_ns_ = lower.p50_ns_ + (upper.p50_ns_ - lower.p50_ns_) * ratio;
+  estimate.p90_ns_ = lower.p90_ns_ + (upper.p90_ns_ - lower.p90_ns_) * ratio;
+  estimate.p99_ns_ = lower.p99_ns_ + (upper.p99_ns_ - lower.p99_ns_) * ratio;
+  return estimate;
+}
+
+// 'estimate' no lower than 'bound' if 'at_least', no higher otherwise.
+ExecTimeEstimator::Estimate Bound(const ExecTimeEstimator::Estimate& estimate,
+                                  const ExecTimeEstimator::Estimate& bound,
+                                  const bool at_least) {
+  auto pick = [at_least](const double value, const double limit) {
+    return at_least ? std::max(value, limit) : std::min(value, limit);
+  };
+  ExecTimeEstimator::Estimate bounded = estimate;
+  bounded.mean_ns_ = pick(estimate.mean_ns_, bound.mean_ns_);
+  bounded.p50_ns_ = pick(estimate.p50_ns_, bound.p50_ns_);
+  bounded.p90_ns_ = pick(estimate.p90_ns_, bound.p90_ns_);
+  bounded.p99_ns_ = pick(estimate.p99_ns_, bound.p99_ns_);
+  return bounded;
+}
+}  // namespace
+
+void ExecTimeEstimator::Stats::Add(const double exec_ns) {
+  ++count_;
+  if (count_ == 1) {
+    mean_ns_ = p50_ns_ = p90_ns_ = p99_ns_ = exec_ns;
+    return;
+  }
+  // A plain average until there are enough executions to decay.
+  const double weight = std::max(kDecay, 1.0 / count_);
+  deviation_ns_ += (std::fabs(exec_ns - mean_ns_) - deviation_ns_) * weight;
+  mean_ns_ += (exec_ns - mean_ns_) * weight;
+  // The quantiles step by a fraction of the spread of the executions.
+  const double step = std::max(deviation_ns_, mean_ns_ * 0.01) / 2;
+  UpdateQuantile(0.5, exec_ns, step, &p50_ns_);
+  UpdateQuantile(0.9, exec_ns, step, &p90_ns_);
+  UpdateQuantile(0.99, exec_ns, step, &p99_ns_);
+  // The steps may cross the quantiles over while they settle.
+  p90_ns_ = std::max(p90_ns_, p50_ns_);
+  p99_ns_ = std::max(p99_ns_, p90_ns_);
+}
+
+void ExecTimeEstimator::Record(const BackendModelInstance* instance, const size_t batch_size,
+                               const uint32_t shape_bucket, const uint64_t exec_ns) {
+  const size_t index = std::max<size_t>(1, batch_size);
+  std::lock_guard<std::mutex> lock(mu_);
+  auto add = [this, index, shape_bucket, exec_ns](const BackendModelInstance* owner) {
+    std::vector<Stats>& stats = stats_[Key(owner, shape_bucket)];
+    if (stats.size() <= index) {
+      stats.resize(index + 1);
+    }
+    stats[index].Add(static_cast<double>(exec_ns));
+  };
+  add(nullptr);
+  if (instance != nullptr) {
+    add(instance);
+  }
+}
+
+bool ExecTimeEstimator::Get(const BackendModelInstance* instance, const size_t batch_size,
+                            const uint32_t shape_bucket, Estimate* estimate) const {
+  const size_t index = std::max<size_t>(1, batch_size);
+  std::lock_guard<std::mutex> lock(mu_);
+  const auto itr = stats_.find(Key(instance, shape_bucket));
+  if (itr == stats_.end()) {
+    return false;
+  }
+  const std::vector<Stats>& stats = itr->second;
+  // The nearest measured sizes below and above, the cost grows linearly
+  // in between. Past them it follows the line through the two nearest
+  // measured sizes, a fixed cost plus a cost per item.
+  size_t lower = 0, upper = 0;
+  for (size_t size = std::min(index, stats.size() - 1); size >= 1; --size) {
+    if (stats[size].count_ != 0) {
+      lower = size;
+      break;
+    }
+  }
+  for (size_t size = index; size < stats.size(); ++size) {
+    if (stats[size].count_ != 0) {
+      upper = size;
+      break;
+    }
+  }
+  if ((lower == 0) && (upper == 0)) {
+    return false;
+  }
+  auto to_estimate = [&stats](const size_t size, const double scale) {
+    Estimate scaled;
+    scaled.count_ = stats[size].count_;
+    scaled.mean_ns_ = stats[size].mean_ns_ * scale;
+    scaled.p50_ns_ = stats[size].p50_ns_ * scale;
+    scaled.p90_ns_ = stats[size].p90_ns_ * scale;
+    scaled.p99_ns_ = stats[size].p99_ns_ * scale;
+    return scaled;
+  };
+  if ((lower != 0) && (upper != 0)) {
+    if (lower == upper) {
+      *estimate = to_estimate(lower, 1.0);
+    } else {
+      *estimate = Interpolate(to_estimate(lower, 1.0), to_estimate(upper, 1.0),
+                              static_cast<double>(index - lower) / (upper - lower));
+    }
+  } else if (lower != 0) {
+    size_t second = lower - 1;
+    while ((second >= 1) && (stats[second].count_ == 0)) {
+      --second;
+    }
+    if (second == 0) {
+      // A single size gives no fixed cost, the cost is taken as per item.
+      *estimate = to_estimate(lower, static_cast<double>(index) / lower);
+    } else {
+      // A larger batch never costs less than the largest measured.
+      *estimate = Bound(Interpolate(to_estimate(second, 1.0), to_estimate(lower, 1.0),
+                                    static_cast<double>(index - second) / (lower - second)),
+                        to_estimate(lower, 1.0), true /* at_least */);
+    }
+  } else {
+    size_t second = upper + 1;
+    while ((second < stats.size()) && (stats[second].count_ == 0)) {
+      ++second;
+    }
+    if (second == stats.size()) {
+      *estimate = to_estimate(upper, static_cast<double>(index) / upper);
+    } else {
+      // A smaller batch never costs more than the smallest measured, nor
+      // less than its share of it.
+      *estimate = Bound(Interpolate(to_estimate(upper, 1.0), to_estimate(second, 1.0),
+                                    -static_cast<double>(upper - index) / (second - upper)),
+                        to_estimate(upper, 1.0), false /* at_least */);
+      *estimate = Bound(*estimate, to_estimate(upper, static_cast<double>(index) / upper),
+                        true /* at_least */);
+    }
+  }
+  return true;
+}
+
+size_t ExecTimeEstimator::LargestBatchSize(const BackendModelInstance* instance,
+                                           const uint32_t shape_bucket) const {
+  std::lock_guard<std::mutex> lock(mu_);
+  const auto itr = stats_.find(Key(instance, shape_bucket));
+  if (itr == stats_.end()) {
+    return 0;
+  }
+  for (size_t size = itr->second.size(); size-- > 1;) {
+    if (itr->second[size].count_ != 0) {
+      return size;
+    }
+  }
+  return 0;
+}
+
+void ExecTimeEstimator::RemoveInstance(const BackendModelInstance* instance) {
+  std::lock_guard<std::mutex> lock(mu_);
+  for (auto itr = stats_.begin(); itr != stats_.end();) {
+    if (std::get<0>(itr->first) == instance) {
+      itr = stats_.erase(itr);
+    } else {
+      ++itr;
+    }
+  }
+}
+
+}
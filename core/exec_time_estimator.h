@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "constants.h"
+
+namespace core {
+
+class BackendModelInstance;
+
+// Estimates the execution time of a batch from the executions measured
+// so far, by instance, batch size and shape bucket. Each combination
+// keeps a decaying average and decaying quantiles, so the estimates
+// follow changes of the load or of the hardware within a few dozen
+// executions. The scheduling decisions that need the expected cost of a
+// batch, when to stop waiting for requests, which instance to pick and
+// whether to admit a request, read the estimates.
+class ExecTimeEstimator {
+ public:
+  struct Estimate {
+    // The number of executions the estimate is based on, those of the
+    // nearest batch sizes if the batch size itself was not measured.
+    uint64_t count_;
+    double mean_ns_;
+    double p50_ns_;
+    double p90_ns_;
+    double p99_ns_;
+  };
+
+  ExecTimeEstimator() = default;
+
+  // Record that 'instance' executed a batch of 'batch_size' in
+  // 'shape_bucket' in 'exec_ns'. The execution also counts for the model
+  // as a whole.
+  void Record(const BackendModelInstance* instance, const size_t batch_size,
+              const uint32_t shape_bucket, const uint64_t exec_ns);
+
+  // Estimate the execution time of a batch of 'batch_size' in
+  // 'shape_bucket' on 'instance', or on any instance if nullptr. A batch
+  // size that was not measured is interpolated linearly from the nearest
+  // sizes that were, and extrapolated from the fixed cost and the cost
+  // per item the two nearest sizes give. With a single size measured the
+  // cost is taken as per item. Return false if nothing was measured.
+  bool Get(const BackendModelInstance* instance, const size_t batch_size,
+           const uint32_t shape_bucket, Estimate* estimate) const;
+
+  // The largest batch size measured in 'shape_bucket' on 'instance', or
+  // on any instance if nullptr, 0 if none was.
+  size_t LargestBatchSize(const BackendModelInstance* instance,
+                          const uint32_t shape_bucket) const;
+
+  // Forget the executions of 'instance', those of the model as a whole
+  // are kept.
+  void RemoveInstance(const BackendModelInstance* instance);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ExecTimeEstimator);
+
+  // The execution times of one batch size.
+  struct Stats {
+    Stats() : count_(0), mean_ns_(0), deviation_ns_(0), p50_ns_(0), p90_ns_(0), p99_ns_(0) {}
+    void Add(const double exec_ns);
+    uint64_t count_;
+    double mean_ns_;
+    // The decaying mean absolute deviation, the step of the quantiles.
+    double deviation_ns_;
+    double p50_ns_;
+    double p90_ns_;
+    double p99_ns_;
+  };
+
+  // The instance, nullptr for the model as a whole, and the shape bucket.
+  using Key = std::tuple<const BackendModelInstance*, uint32_t>;
+
+  mutable std::mutex mu_;
+  // The stats of each key indexed by batch size.
+  std::map<Key, std::vector<Stats>> stats_;
+};
+
+}
@@ -0,0 +1,258 @@
+#include "executor.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace core {
+
+namespace {
+// The executor and worker index of the calling thread, if it is a worker.
+thread_local const Executor* current_executor = nullptr;
+thread_local size_t current_worker = 0;
+
+// Parse a CPU list such as "0-3,8-11".
+std::vector<int> ParseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    const size_t dash = range.find('-');
+    const int first = atoi(range.substr(0, dash).c_str());
+    const int last = (dash == std::string::npos) ? first : atoi(range.substr(dash + 1).c_str());
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// The CPUs of each NUMA node of the host, empty if unknown.
+std::map<int, std::vector<int>> NumaNodeCpus() {
+  std::map<int, std::vector<int>> nodes;
+#ifdef __linux__
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string list;
+  if (!std::getline(online, list)) {
+    return nodes;
+  }
+  for (const int node : ParseCpuList(list)) {
+    std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string cpus;
+    if (std::getline(cpulist, cpus) && !ParseCpuList(cpus).empty()) {
+      nodes[node] = ParseCpuList(cpus);
+    }
+  }
+#endif
+  return nodes;
+}
+
+// Bind the calling thread to 'cpus', best effort.
+void BindToCpus(const std::vector<int>& cpus) {
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (const int cpu : cpus) {
+    if ((cpu >= 0) && (cpu < CPU_SETSIZE)) {
+      CPU_SET(cpu, &cpuset);
+    }
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#endif
+}
+}  // namespace
+
+Status Executor::Create(const size_t thread_count, std::unique_ptr<Executor>* executor) {
+  if (thread_count == 0) {
+    return Status(Status::Code::INVALID_ARG, "executor thread count must be greater than 0");
+  }
+  std::unique_ptr<Executor> local_executor(new Executor());
+  const auto nodes = NumaNodeCpus();
+  std::vector<int> node_ids;
+  for (const auto& pr : nodes) {
+    node_ids.push_back(pr.first);
+  }
+  for (size_t i = 0; i < thread_count; ++i) {
+    std::unique_ptr<Worker> worker(new Worker());
+    worker->numa_node_ = node_ids.empty() ? -1 : node_ids[i % node_ids.size()];
+    local_executor->workers_.push_back(std::move(worker));
+  }
+  // Steal from the workers of the same node first, starting next to the
+  // thief so that the thieves don't all pick the same victim.
+  auto& workers = local_executor->workers_;
+  for (size_t i = 0; i < thread_count; ++i) {
+    std::vector<size_t> near, far;
+    for (size_t offset = 1; offset < thread_count; ++offset) {
+      const size_t victim = (i + offset) % thread_count;
+      if (workers[victim]->numa_node_ == workers[i]->numa_node_) {
+        near.push_back(victim);
+      } else {
+        far.push_back(victim);
+      }
+    }
+    workers[i]->victims_ = near;
+    workers[i]->victims_.insert(workers[i]->victims_.end(), far.begin(), far.end());
+  }
+  // Binding only pays off when there are several nodes to keep apart.
+  const bool bind = (nodes.size() > 1);
+  for (size_t i = 0; i < thread_count; ++i) {
+    Executor* raw_executor = local_executor.get();
+    std::vector<int> cpus;
+    if (bind) {
+      cpus = nodes.at(workers[i]->numa_node_);
+    }
+    workers[i]->thread_ = std::thread([raw_executor, i, cpus]() {
+      if (!cpus.empty()) {
+        BindToCpus(cpus);
+      }
+      raw_executor->WorkerThread(i);
+    });
+  }
+  std::cout << "started executor with " << thread_count << " threads on "
+            << std::max<size_t>(1, nodes.size()) << " NUMA nodes" << std::endl;
+  *executor = std::move(local_executor);
+  return Status::Success;
+}
+
+Executor::~Executor() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    exit_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    if (worker->thread_.joinable()) {
+      worker->thread_.join();
+    }
+  }
+}
+
+void Executor::Submit(std::function<void()> task, const int numa_node) {
+  size_t index = 0;
+  if (current_executor == this) {
+    index = current_worker;
+  } else {
+    index = next_worker_++ % workers_.size();
+    if (numa_node >= 0) {
+      // The next worker of the node, if the node has any.
+      for (size_t offset = 0; offset < workers_.size(); ++offset) {
+        const size_t candidate = (index + offset) % workers_.size();
+        if (workers_[candidate]->numa_node_ == numa_node) {
+          index = candidate;
+          break;
+        }
+      }
+    }
+  }
+  // Counting the task under 'mu_' orders it with a worker going to
+  // sleep. It is counted before it is queued so that taking it never
+  // brings the count below zero.
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    ++pending_;
+  }
+  {
+    std::lock_guard<std::mutex> lock(workers_[index]->mu_);
+    workers_[index]->tasks_.push_back(std::move(task));
+  }
+  cv_.notify_one();
+}
+
+void Executor::ParallelFor(const size_t begin, const size_t end,
+                           const std::function<void(size_t)>& fn) {
+  if (begin >= end) {
+    return;
+  }
+  const size_t count = end - begin;
+  if (count == 1) {
+    fn(begin);
+    return;
+  }
+  // The helpers may start after all the indices are taken, they only
+  // touch the shared state then, never 'fn'.
+  struct State {
+    std::atomic<size_t> next_;
+    std::atomic<size_t> done_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+  };
+  std::shared_ptr<State> state(new State());
+  state->next_ = begin;
+  state->done_ = 0;
+  const std::function<void(size_t)>* fn_ptr = &fn;
+  auto run = [state, fn_ptr, end, count]() {
+    size_t ran = 0;
+    for (size_t i = state->next_++; i < end; i = state->next_++) {
+      (*fn_ptr)(i);
+      ++ran;
+    }
+    if ((ran > 0) && ((state->done_ += ran) == count)) {
+      std::lock_guard<std::mutex> lock(state->mu_);
+      state->cv_.notify_all();
+    }
+  };
+  const size_t helpers = std::min(count - 1, workers_.size());
+  for (size_t i = 0; i < helpers; ++i) {
+    Submit(run);
+  }
+  run();
+  std::unique_lock<std::mutex> lock(state->mu_);
+  state->cv_.wait(lock, [&state, count]() { return state->done_ == count; });
+}
+
+bool Executor::NextTask(const size_t index, std::function<void()>* task) {
+  {
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mu_);
+    if (!worker.tasks_.empty()) {
+      *task = std::move(worker.tasks_.back());
+      worker.tasks_.pop_back();
+      --pending_;
+      return true;
+    }
+  }
+  for (const size_t victim_index : workers_[index]->victims_) {
+    Worker& victim = *workers_[victim_index];
+    std::lock_guard<std::mutex> lock(victim.mu_);
+    if (!victim.tasks_.empty()) {
+      *task = std::move(victim.tasks_.front());
+      victim.tasks_.pop_front();
+      --pending_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Executor::WorkerThread(const size_t index) {
+  current_executor = this;
+  current_worker = index;
+  while (true) {
+    std::function<void()> task;
+    if (NextTask(index, &task)) {
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this]() { return exit_ || (pending_ > 0); });
+    if (exit_ && (pending_ == 0)) {
+      break;
+    }
+  }
+  current_executor = nullptr;
+}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "status.h"
+#include "constants.h"
+
+namespace core {
+
+// A pool of worker threads shared by the parts of the core that need
+// parallelism, such as loading models and scanning the repositories.
+// Each worker runs the tasks of its own deque, newest first, and steals
+// the oldest tasks of the other workers once it runs dry, trying the
+// workers of its own NUMA node before the others.
+//
+// The responses are delivered on an executor of their own, the client
+// callbacks would otherwise hold up the work of the core and wait
+// behind it.
+//
+// Tasks may block and may submit more tasks. Long-lived loops that wait
+// for work, like the backend threads of the instances, must keep their
+// own thread instead.
+class Executor {
+ public:
+  // Create an executor of 'thread_count' workers. The workers are spread
+  // over the NUMA nodes of the host and bound to the CPUs of their node
+  // when there is more than one node.
+  static Status Create(const size_t thread_count, std::unique_ptr<Executor>* executor);
+  // Run the tasks submitted so far, then stop the workers.
+  ~Executor();
+
+  size_t ThreadCount() const { return workers_.size(); }
+
+  // Run 'task' on a worker. A task submitted by a worker goes to the
+  // deque of that worker, otherwise to a worker of 'numa_node', any
+  // worker if -1.
+  void Submit(std::function<void()> task, const int numa_node = -1);
+
+  // Call 'fn' for each index in [begin, end) and return once all the
+  // calls are done. The calling thread takes part, so that a ParallelFor
+  // issued from a task makes progress even when all the workers are busy.
+  void ParallelFor(const size_t begin, const size_t end,
+                   const std::function<void(size_t)>& fn);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Executor);
+  Executor() : pending_(0), exit_(false), next_worker_(0) {}
+
+  struct Worker {
+    std::mutex mu_;
+    std::deque<std::function<void()>> tasks_;
+    // The NUMA node of the worker, -1 if unknown.
+    int numa_node_;
+    // The workers to steal from, those of the same node first.
+    std::vector<size_t> victims_;
+    std::thread thread_;
+  };
+
+  void WorkerThread(const size_t index);
+
+  // Take the next task of worker 'index', stealing if its own deque is
+  // empty. Return false if no task is queued anywhere.
+  bool NextTask(const size_t index, std::function<void()>* task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // The number of queued tasks, the idle workers wait on 'cv_' until it
+  // is positive.
+  std::atomic<size_t> pending_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool exit_;
+  // Spreads the tasks submitted from outside of the workers.
+  std::atomic<size_t> next_worker_;
+};
+
+}
@@ -1,7 +1,11 @@
 #include "file_utils.h"
 #include <fstream>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
 #include <filesystem>
 
@@ -103,6 +107,106 @@ std::string DirName(const std::string& path) {
   return path.substr(0, idx);
 }
 
+Status GetDirectoryContents(const std::string& path, 
+                            std::set<std::string>* contents) {
+  contents->clear();
+#ifdef _WIN32
+  WIN32_FIND_DATAA entry;
+  HANDLE dir = FindFirstFileA(JoinPath({path, "*"}).c_str(), &entry);
+  if (dir == INVALID_HANDLE_VALUE) {
+    auto msg = "failed to open directory " + path;
+    return Status(Status::Code::INTERNAL, msg);
+  }
+  do {
+    const std::string entryname = entry.cFileName;
+    if ((entryname != ".") && (entryname != "..")) {
+      contents->insert(entryname);
+    }
+  } while (FindNextFileA(dir, &entry));
+  FindClose(dir);
+#else
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) {
+    auto msg = "failed to open directory " + path + ": " + strerror(errno);
+    return Status(Status::Code::INTERNAL, msg);
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    const std::string entryname = entry->d_name;
+    if ((entryname != ".") && (entryname != "..")) {
+      contents->insert(entryname);
+    }
+  }
+  closedir(dir);
+#endif
+  return Status::Success;
+}
+
+Status GetDirectorySubdirs(const std::string& path, 
+                           std::set<std::string>* subdirs) {
+  RETURN_IF_ERROR(GetDirectoryContents(path, subdirs));
+  // Erase non-directory entries...
+  for (auto iter = subdirs->begin(); iter != subdirs->end();) {
+    bool is_dir = false;
+    RETURN_IF_ERROR(IsDirectory(JoinPath({path, *iter}), &is_dir));
+    if (!is_dir) {
+      iter = subdirs->erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  return Status::Success;
+}
+
+Status FileModificationTime(const std::string& path, int64_t* mtime_ns) {
+  bool is_dir;
+  uint64_t size;
+  return GetFileStat(path, &is_dir, &size, mtime_ns);
+}
+
+Status GetFileStat(const std::string& path, 
+                   bool* is_dir, 
+                   uint64_t* size, 
+                   int64_t* mtime_ns) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    auto msg = "failed to stat file " + path;
+    return Status(Status::Code::INTERNAL, msg);
+  }
+  *is_dir = S_ISDIR(st.st_mode);
+  *size = static_cast<uint64_t>(st.st_size);
+#ifdef _WIN32
+  *mtime_ns = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#else
+  *mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + 
+              st.st_mtim.tv_nsec;
+#endif
+  return Status::Success;
+}
+
+Status GetPathByteSize(const std::string& path, uint64_t* byte_size) {
+  *byte_size = 0;
+  std::vector<std::string> paths{path};
+  while (!paths.empty()) {
+    const std::string current = paths.back();
+    paths.pop_back();
+    bool is_dir = false;
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    RETURN_IF_ERROR(GetFileStat(current, &is_dir, &size, &mtime_ns));
+    if (!is_dir) {
+      *byte_size += size;
+      continue;
+    }
+    std::set<std::string> contents;
+    RETURN_IF_ERROR(GetDirectoryContents(current, &contents));
+    for (const auto& child : contents) {
+      paths.push_back(JoinPath({current, child}));
+    }
+  }
+  return Status::Success;
+}
+
 Status FileExists(const std::string& path, bool* exists) {
   *exists = (access(path.c_str(), F_OK) == 0);
   return Status::Success;
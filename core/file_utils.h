@@ -1,5 +1,6 @@
 #pragma once
 
+#include <set>
 #include <string>
 #include <vector>
 #include <memory>
@@ -77,6 +78,45 @@ Status FileExists(const std::string& path, bool* exists);
 /// \return Status.
 Status IsDirectory(const std::string& path, bool* is_dir);
 
+/// Get the names of all entries of a directory, excluding '.' and '..'.
+/// \param path The directory path.
+/// \param contents Returns the names of the entries.
+/// \return Status.
+Status GetDirectoryContents(const std::string& path, 
+                            std::set<std::string>* contents);
+
+/// Get the names of the immediate sub-directories of a directory.
+/// \param path The directory path.
+/// \param subdirs Returns the names of the sub-directories.
+/// \return Status.
+Status GetDirectorySubdirs(const std::string& path, 
+                           std::set<std::string>* subdirs);
+
+/// Get the modification time of a single file or directory entry.
+/// \param path The file path.
+/// \param mtime_ns Returns the modification time in nanoseconds.
+/// \return Status.
+Status FileModificationTime(const std::string& path, int64_t* mtime_ns);
+
+/// Get the type, size and modification time of a path with a single
+/// stat.
+/// \param path The file path.
+/// \param is_dir Returns whether the path is a directory.
+/// \param size Returns the size in bytes.
+/// \param mtime_ns Returns the modification time in nanoseconds.
+/// \return Status.
+Status GetFileStat(const std::string& path, 
+                   bool* is_dir, 
+                   uint64_t* size, 
+                   int64_t* mtime_ns);
+
+/// Get the total size of the files of a path, of every file below it
+/// for a directory.
+/// \param path The file or directory path.
+/// \param byte_size Returns the size in bytes.
+/// \return Status.
+Status GetPathByteSize(const std::string& path, uint64_t* byte_size);
+
 /// check the child path escaping the parent path or not.
 /// \param child_path The child path.
 /// \param parent_path The parent path.
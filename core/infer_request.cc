@@ -0,0 +1,214 @@
+#include "infer_request.h"
+
+#include "model.h"
+#include "model_config.h"
+#include "time_utils.h"
+
+namespace core {
+
+InferenceRequest::InferenceRequest(const std::shared_ptr<Model>& model,
+                                   const int64_t requested_model_version)
+  : model_shared_(model),
+    requested_model_version_(requested_model_version),
+    priority_(0),
+    batch_size_(1),
+    timeout_us_(0),
+    queue_start_ns_(0),
+    deadline_ns_(0),
+    timer_id_(0),
+    queue_sequence_(0),
+    trace_id_(0),
+    cancelled_(false),
+    response_executor_(nullptr),
+    response_allocator_(nullptr),
+    response_alloc_userp_(nullptr) {
+  SetPriority(0);
+}
+
+const std::string& InferenceRequest::ModelName() const {
+  return model_shared_->Name();
+}
+
+int64_t InferenceRequest::ActualModelVersion() const {
+  return model_shared_->Version();
+}
+
+void InferenceRequest::SetPriority(uint64_t priority) {
+  // Priority values outside of the range of the model select the
+  // model's default level.
+  if ((priority == 0) || (priority > model_shared_->MaxPriorityLevel())) {
+    priority_ = model_shared_->DefaultPriorityLevel();
+  } else {
+    priority_ = priority;
+  }
+}
+
+void InferenceRequest::Input::AppendData(const void* base, const size_t byte_size,
+                                         const SERVER_MemoryType memory_type,
+                                         const int64_t memory_type_id) {
+  buffers_.push_back(Buffer{base, byte_size, memory_type, memory_type_id});
+  byte_size_ += byte_size;
+}
+
+Status InferenceRequest::AddInput(const std::string& name, const inference::DataType datatype,
+                                  const std::vector<int64_t>& shape, Input** input) {
+  Input* existing = nullptr;
+  if (MutableInput(name, &existing).IsOk()) {
+    return Status(Status::Code::ALREADY_EXISTS,
+                  "input '" + name + "' already exists in request");
+  }
+  inputs_.emplace_back(name, datatype, shape);
+  *input = &inputs_.back();
+  return Status::Success;
+}
+
+Status InferenceRequest::MutableInput(const std::string& name, Input** input) {
+  for (auto& request_input : inputs_) {
+    if (request_input.Name() == name) {
+      *input = &request_input;
+      return Status::Success;
+    }
+  }
+  return Status(Status::Code::NOT_FOUND, "input '" + name + "' does not exist in request");
+}
+
+Status InferenceRequest::PrepareForInference() {
+  const inference::ModelConfig& config = model_shared_->Config();
+  // The first dimension of the inputs of a batching model is the batch.
+  const bool batching = (config.max_batch_size() > 0);
+  uint32_t batch_size = 0;
+  size_t required_input_count = 0;
+  for (const auto& input : inputs_) {
+    const inference::ModelInput* input_config = nullptr;
+    RETURN_IF_ERROR(model_shared_->GetInput(input.Name(), &input_config));
+    if (!input_config->optional()) {
+      ++required_input_count;
+    }
+    if (input.DType() != input_config->data_type()) {
+      return Status(Status::Code::INVALID_ARG,
+                    "inference input '" + input.Name() + "' data-type is '" +
+                    DataTypeToProtocolString(input.DType()) + "', but model '" +
+                    model_shared_->Name() + "' expects '" +
+                    DataTypeToProtocolString(input_config->data_type()) + "'");
+    }
+    std::vector<int64_t> dims = input.Shape();
+    if (batching) {
+      if (dims.empty() || (dims[0] <= 0) ||
+          ((batch_size != 0) && (static_cast<uint32_t>(dims[0]) != batch_size))) {
+        return Status(Status::Code::INVALID_ARG,
+                      "inference input '" + input.Name() + "' of model '" +
+                      model_shared_->Name() + "' must start with the batch size of the request");
+      }
+      batch_size = static_cast<uint32_t>(dims[0]);
+      dims.erase(dims.begin());
+    }
+    bool shape_matches = (dims.size() == static_cast<size_t>(input_config->dims_size()));
+    for (size_t i = 0; shape_matches && (i < dims.size()); ++i) {
+      shape_matches = (input_config->dims(i) == WILDCARD_DIM) || (input_config->dims(i) == dims[i]);
+    }
+    if (!shape_matches) {
+      return Status(Status::Code::INVALID_ARG,
+                    "unexpected shape for input '" + input.Name() + "' for model '" +
+                    model_shared_->Name() + "'. Expected " +
+                    DimsListToString(input_config->dims()) + ", got " +
+                    DimsListToString(dims));
+    }
+    const int64_t byte_size = GetByteSize(input.DType(), input.Shape());
+    if ((byte_size >= 0) && (static_cast<size_t>(byte_size) != input.ByteSize())) {
+      return Status(Status::Code::INVALID_ARG,
+                    "inference input '" + input.Name() + "' holds " +
+                    std::to_string(input.ByteSize()) + " bytes of data, its shape takes " +
+                    std::to_string(byte_size));
+    }
+  }
+  if (required_input_count != model_shared_->RequiredInputCount()) {
+    return Status(Status::Code::INVALID_ARG,
+                  "expected " + std::to_string(model_shared_->RequiredInputCount()) +
+                  " inputs but got " + std::to_string(required_input_count) +
+                  " inputs for model '" + model_shared_->Name() + "'");
+  }
+  for (const auto& name : requested_outputs_) {
+    const inference::ModelOutput* output_config = nullptr;
+    RETURN_IF_ERROR(model_shared_->GetOutput(name, &output_config));
+  }
+  if (batch_size != 0) {
+    batch_size_ = batch_size;
+  }
+  return Status::Success;
+}
+
+uint64_t InferenceRequest::CaptureQueueStartNs() {
+  queue_start_ns_ = CaptureTimeNs();
+  return queue_start_ns_;
+}
+
+void InferenceRequest::Cancel() {
+  cancelled_ = true;
+  std::shared_ptr<InferenceResponseFactory> factory;
+  {
+    std::lock_guard<std::mutex> lock(response_factory_mu_);
+    factory = response_factory_;
+  }
+  if (factory != nullptr) {
+    factory->Cancel();
+  }
+}
+
+std::shared_ptr<InferenceResponseFactory> InferenceRequest::ResponseFactory() {
+  std::lock_guard<std::mutex> lock(response_factory_mu_);
+  if (response_factory_ == nullptr) {
+    response_factory_ = std::make_shared<InferenceResponseFactory>(
+        model_shared_, id_, std::move(response_fn_), response_executor_,
+        response_allocator_, response_alloc_userp_, trace_id_);
+    // A request cancelled before its first response does not make the
+    // backend wait either.
+    if (cancelled_) {
+      response_factory_->Cancel();
+    }
+  }
+  return response_factory_;
+}
+
+void InferenceRequest::Release(std::unique_ptr<InferenceRequest>&& request) {
+  if (request == nullptr) {
+    return;
+  }
+  ModelMetrics* metrics = request->model_shared_->Metrics();
+  if ((metrics != nullptr) && (request->queue_start_ns_ != 0)) {
+    metrics->RequestDurationUs().Observe((CaptureTimeNs() - request->queue_start_ns_) / 1000);
+  }
+  InferenceTracer::Record(request->trace_id_, TraceActivity::RELEASED,
+                          request->model_shared_->TraceNameId());
+  // Move the callback out of the request, the callback takes ownership
+  // and may destroy the request.
+  ReleaseFn release_fn = std::move(request->release_fn_);
+  if (release_fn) {
+    release_fn(std::move(request));
+  } else {
+    request.reset();
+  }
+}
+
+void InferenceRequest::RespondIfError(std::unique_ptr<InferenceRequest>& request,
+                                      const Status& status,
+                                      const bool release_request) {
+  if (status.IsOk() || (request == nullptr)) {
+    return;
+  }
+  request->failure_status_ = status;
+  // The client gets the error as the final response, unless the model
+  // ended the responses already. The factory holds the model, it is let
+  // go before the request so that the caller does not hold the model
+  // once the request is released.
+  {
+    std::shared_ptr<InferenceResponseFactory> factory = request->ResponseFactory();
+    std::unique_ptr<InferenceResponse> response = factory->CreateResponse();
+    response->SetResponseStatus(status);
+    factory->Send(std::move(response), SERVER_RESPONSE_COMPLETE_FINAL);
+  }
+  if (release_request) {
+    Release(std::move(request));
+  }
+}
+
+} // namespace core
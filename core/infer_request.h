@@ -1,9 +1,217 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "status.h"
+#include "constants.h"
+#include "model_config.h"
+#include "infer_response.h"
+
 namespace core {
 
+class Model;
+class Executor;
+
+// An inference request for a model. The request is handed to the
+// model's scheduler, ownership is given back to the creator through
+// the release callback once the core and the backend are done with it.
 class InferenceRequest {
+ public:
+  // The callback invoked when the request is released. It takes back
+  // ownership of the request.
+  using ReleaseFn = std::function<void(std::unique_ptr<InferenceRequest>&& request)>;
+
+  // An input tensor of the request. The data stays where the client put
+  // it, in one or more buffers, and must stay valid until the request is
+  // released.
+  class Input {
+   public:
+    struct Buffer {
+      const void* base_;
+      size_t byte_size_;
+      SERVER_MemoryType memory_type_;
+      int64_t memory_type_id_;
+    };
+
+    Input(const std::string& name, const inference::DataType datatype,
+          const std::vector<int64_t>& shape)
+      : name_(name), datatype_(datatype), shape_(shape), byte_size_(0) {}
+
+    const std::string& Name() const { return name_; }
+    inference::DataType DType() const { return datatype_; }
+    const std::vector<int64_t>& Shape() const { return shape_; }
+
+    // Append a buffer to the data of the input.
+    void AppendData(const void* base, const size_t byte_size,
+                    const SERVER_MemoryType memory_type, const int64_t memory_type_id);
+    const std::vector<Buffer>& Buffers() const { return buffers_; }
+    // The size of the data over all the buffers.
+    size_t ByteSize() const { return byte_size_; }
+
+   private:
+    std::string name_;
+    inference::DataType datatype_;
+    std::vector<int64_t> shape_;
+    std::vector<Buffer> buffers_;
+    size_t byte_size_;
+  };
+
+  InferenceRequest(const std::shared_ptr<Model>& model,
+                   const int64_t requested_model_version);
+
+  // The name of the model the request is for.
+  const std::string& ModelName() const;
+  // The version requested by the client, -1 for the latest.
+  int64_t RequestedModelVersion() const { return requested_model_version_; }
+  // The version of the model that executes the request.
+  int64_t ActualModelVersion() const;
+  // The model the request is for. The request holds a reference so the
+  // model stays alive while the request is in flight.
+  Model* ModelRaw() const { return model_shared_.get(); }
+
+  const std::string& Id() const { return id_; }
+  void SetId(const std::string& id) { id_ = id; }
+
+  // Add the input 'name', returned in 'input' to append its data.
+  Status AddInput(const std::string& name, const inference::DataType datatype,
+                  const std::vector<int64_t>& shape, Input** input);
+  // Get the input 'name', NOT_FOUND if it was not added.
+  Status MutableInput(const std::string& name, Input** input);
+  const std::deque<Input>& Inputs() const { return inputs_; }
+
+  // The outputs the client asked for, empty for all of them.
+  void AddRequestedOutput(const std::string& name) { requested_outputs_.insert(name); }
+  const std::set<std::string>& RequestedOutputs() const { return requested_outputs_; }
+
+  // Check the inputs and the requested outputs against the configuration
+  // of the model, and take the batch size from the inputs of a model
+  // that batches.
+  Status PrepareForInference();
+
+  // The priority level of the request, a lower value is a higher
+  // priority. Zero or a level above the model's maximum selects the
+  // model's default level.
+  uint64_t Priority() const { return priority_; }
+  void SetPriority(uint64_t priority);
+
+  // The batch size of the request, 1 unless the request holds a batch
+  // of samples.
+  uint32_t BatchSize() const { return batch_size_; }
+  void SetBatchSize(uint32_t batch_size) { batch_size_ = batch_size; }
+
+  // The timeout of the request in microseconds, 0 for none. The queue
+  // policy of the model decides whether it overrides the default timeout.
+  uint64_t TimeoutMicroseconds() const { return timeout_us_; }
+  void SetTimeoutMicroseconds(uint64_t timeout_us) { timeout_us_ = timeout_us; }
+
+  // The time the request entered the scheduler queue.
+  uint64_t QueueStartNs() const { return queue_start_ns_; }
+  uint64_t CaptureQueueStartNs();
+
+  // The time by which the request must be done, 0 for no deadline. Set
+  // by the scheduler from the timeout when the request is queued.
+  uint64_t DeadlineNs() const { return deadline_ns_; }
+  void SetDeadlineNs(uint64_t deadline_ns) { deadline_ns_ = deadline_ns; }
+
+  // The timer expiring the request at its deadline while it is queued,
+  // 0 for none.
+  uint64_t TimerId() const { return timer_id_; }
+  void SetTimerId(uint64_t timer_id) { timer_id_ = timer_id; }
+
+  // The order the request was queued in by the scheduler, telling the
+  // request of a fired timer apart from the others.
+  uint64_t QueueSequence() const { return queue_sequence_; }
+  void SetQueueSequence(uint64_t queue_sequence) { queue_sequence_ = queue_sequence; }
+
+  // The id the request is traced with, 0 if it is not traced. Must be
+  // set before the request is enqueued.
+  uint64_t TraceId() const { return trace_id_; }
+  void SetTraceId(uint64_t trace_id) { trace_id_ = trace_id; }
+
+  // Cancel the request, it is dropped without being executed if it is
+  // still queued, and the backend executing it may stop early. Only
+  // valid until the request is released. A backend waiting to send a
+  // response of the request stops waiting.
+  void Cancel();
+  bool IsCancelled() const { return cancelled_; }
+
+  // The error the request failed with before it could be executed, if any.
+  const Status& FailureStatus() const { return failure_status_; }
+
+  // Set the callback taking the responses of the request, run on
+  // 'executor', or on the thread sending the response if nullptr. Must
+  // be set before the request is enqueued.
+  void SetResponseCallback(InferenceResponseFactory::ResponseFn response_fn,
+                           Executor* executor = nullptr) {
+    response_fn_ = std::move(response_fn);
+    response_executor_ = executor;
+  }
+  // Set the executor the response callback runs on, for a callback set
+  // before the executor was known.
+  void SetResponseExecutor(Executor* executor) { response_executor_ = executor; }
+
+  // Set the allocator of the output buffers of the responses, with the
+  // 'alloc_userp' it is called with. Must be set before the request is
+  // enqueued.
+  void SetResponseAllocator(const ResponseAllocator* allocator, void* alloc_userp) {
+    response_allocator_ = allocator;
+    response_alloc_userp_ = alloc_userp;
+  }
+
+  // The factory of the responses of the request, created on first use.
+  // It stays valid after the request is released, a decoupled model may
+  // keep responding.
+  std::shared_ptr<InferenceResponseFactory> ResponseFactory();
+
+  // Set the callback invoked when the request is released.
+  void SetReleaseCallback(ReleaseFn release_fn) {
+    release_fn_ = std::move(release_fn);
+  }
+
+  // Release the request, handing it back through the release callback.
+  // A request without a release callback is destroyed.
+  static void Release(std::unique_ptr<InferenceRequest>&& request);
+
+  // Record 'status' as the failure of the request if it is not OK, send
+  // it to the client as the final response, and release the request if
+  // 'release_request' is true.
+  static void RespondIfError(std::unique_ptr<InferenceRequest>& request,
+                             const Status& status,
+                             const bool release_request = false);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(InferenceRequest);
 
+  std::shared_ptr<Model> model_shared_;
+  const int64_t requested_model_version_;
+  std::string id_;
+  // A deque keeps the inputs in place as more are added.
+  std::deque<Input> inputs_;
+  std::set<std::string> requested_outputs_;
+  uint64_t priority_;
+  uint32_t batch_size_;
+  uint64_t timeout_us_;
+  uint64_t queue_start_ns_;
+  uint64_t deadline_ns_;
+  uint64_t timer_id_;
+  uint64_t queue_sequence_;
+  uint64_t trace_id_;
+  std::atomic<bool> cancelled_;
+  Status failure_status_;
+  ReleaseFn release_fn_;
+  InferenceResponseFactory::ResponseFn response_fn_;
+  Executor* response_executor_;
+  const ResponseAllocator* response_allocator_;
+  void* response_alloc_userp_;
+  std::mutex response_factory_mu_;
+  std::shared_ptr<InferenceResponseFactory> response_factory_;
 };
 
-}
\ No newline at end of file
+} // namespace core
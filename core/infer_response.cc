@@ -0,0 +1,195 @@
+#include "infer_response.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "model.h"
+#include "executor.h"
+#include "interface/IServer.h"
+
+namespace core {
+
+InferenceResponse::Output::~Output() {
+  if (buffer_ == nullptr) {
+    return;
+  }
+  memory_usage_->Released(memory_type_, memory_type_id_, byte_size_);
+  if (allocator_ == nullptr) {
+    delete[] static_cast<char*>(buffer_);
+    return;
+  }
+  SERVER_Error* err = allocator_->ReleaseFn()(
+      reinterpret_cast<SERVER_ResponseAllocator*>(const_cast<ResponseAllocator*>(allocator_)),
+      buffer_, buffer_userp_, byte_size_, memory_type_, memory_type_id_);
+  if (err != nullptr) {
+    std::cerr << "failed to release the buffer of output '" << name_
+              << "': " << SERVER_ErrorMessage(err) << std::endl;
+    SERVER_ErrorDelete(err);
+  }
+}
+
+Status InferenceResponse::Output::AllocateBuffer(const size_t byte_size,
+                                                 SERVER_MemoryType* memory_type,
+                                                 int64_t* memory_type_id,
+                                                 void** buffer) {
+  if (buffer_ != nullptr) {
+    return Status(Status::Code::ALREADY_EXISTS,
+                  "the buffer of output '" + name_ + "' is already allocated");
+  }
+  if (allocator_ == nullptr) {
+    buffer_ = new char[byte_size];
+    memory_type_ = SERVER_MEMORY_CPU;
+    memory_type_id_ = 0;
+  } else {
+    void* allocated = nullptr;
+    void* buffer_userp = nullptr;
+    SERVER_MemoryType actual_memory_type = *memory_type;
+    int64_t actual_memory_type_id = *memory_type_id;
+    RETURN_IF_SERVER_ERROR(allocator_->AllocFn()(
+        reinterpret_cast<SERVER_ResponseAllocator*>(const_cast<ResponseAllocator*>(allocator_)),
+        name_.c_str(), byte_size, *memory_type, *memory_type_id, alloc_userp_, &allocated,
+        &buffer_userp, &actual_memory_type, &actual_memory_type_id));
+    if ((allocated == nullptr) && (byte_size > 0)) {
+      return Status(Status::Code::UNAVAILABLE,
+                    "response allocator returned no buffer for output '" + name_ + "'");
+    }
+    buffer_ = allocated;
+    buffer_userp_ = buffer_userp;
+    memory_type_ = actual_memory_type;
+    memory_type_id_ = actual_memory_type_id;
+  }
+  byte_size_ = byte_size;
+  memory_usage_->Allocated(memory_type_, memory_type_id_, byte_size_);
+  *memory_type = memory_type_;
+  *memory_type_id = memory_type_id_;
+  *buffer = buffer_;
+  return Status::Success;
+}
+
+InferenceResponse::InferenceResponse(const std::shared_ptr<InferenceResponseFactory>& factory,
+                                     const std::shared_ptr<Model>& model,
+                                     const std::string& id)
+  : factory_(factory), model_(model), id_(id) {}
+
+Status InferenceResponse::AddOutput(const std::string& name,
+                                    const std::vector<int64_t>& shape,
+                                    Output** output) {
+  const inference::ModelOutput* config = nullptr;
+  RETURN_IF_ERROR(model_->GetOutput(name, &config));
+  outputs_.emplace_back(name, config->data_type(), shape, factory_->Allocator(),
+                        factory_->AllocatorUserp(), &model_->OutputMemory());
+  *output = &outputs_.back();
+  return Status::Success;
+}
+
+Status InferenceResponse::Send(std::unique_ptr<InferenceResponse>&& response,
+                               const uint32_t flags) {
+  std::shared_ptr<InferenceResponseFactory> factory = response->factory_;
+  return factory->Send(std::move(response), flags);
+}
+
+InferenceResponseFactory::InferenceResponseFactory(const std::shared_ptr<Model>& model,
+                                                   const std::string& id,
+                                                   ResponseFn response_fn,
+                                                   Executor* executor,
+                                                   const ResponseAllocator* allocator,
+                                                   void* alloc_userp,
+                                                   const uint64_t trace_id)
+  : model_(model),
+    id_(id),
+    decoupled_(model->IsDecoupled()),
+    buffer_size_(model->ResponseBufferSize()),
+    send_timeout_ms_(model->ResponseSendTimeoutMs()),
+    response_fn_(std::move(response_fn)),
+    executor_(executor),
+    allocator_(allocator),
+    alloc_userp_(alloc_userp),
+    trace_id_(trace_id),
+    delivering_(false),
+    final_sent_(false),
+    cancelled_(false) {}
+
+std::unique_ptr<InferenceResponse> InferenceResponseFactory::CreateResponse() {
+  return std::unique_ptr<InferenceResponse>(
+      new InferenceResponse(shared_from_this(), model_, id_));
+}
+
+Status InferenceResponseFactory::Send(std::unique_ptr<InferenceResponse>&& response,
+                                      const uint32_t flags) {
+  const bool final = ((flags & SERVER_RESPONSE_COMPLETE_FINAL) != 0);
+  if (!decoupled_ && ((response == nullptr) || !final)) {
+    return Status(Status::Code::INVALID_ARG,
+                  "model '" + model_->Name() + "' is not decoupled, request '" + id_ +
+                  "' must get exactly one response, sent with the final flag");
+  }
+  bool deliver = false;
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    if (final_sent_) {
+      return Status(Status::Code::INVALID_ARG,
+                    "response of request '" + id_ + "' to model '" + model_->Name() +
+                    "' sent after the final response");
+    }
+    // A response delivered on the sending thread never waits in the
+    // buffer.
+    if (executor_ != nullptr) {
+      auto has_room = [this]() { return cancelled_ || (buffer_.size() < buffer_size_); };
+      if (send_timeout_ms_ == 0) {
+        cv_.wait(lock, has_room);
+      } else {
+        cv_.wait_for(lock, std::chrono::milliseconds(send_timeout_ms_), has_room);
+      }
+      if ((buffer_.size() >= buffer_size_) && !final) {
+        return Status(Status::Code::UNAVAILABLE,
+                      std::string("response of request '") + id_ + "' to model '" +
+                      model_->Name() + "' dropped, " +
+                      (cancelled_ ? "the request is cancelled"
+                                  : "the client did not take the previous responses in time"));
+      }
+    }
+    final_sent_ = final;
+    buffer_.emplace_back(std::move(response), flags);
+    if (!delivering_) {
+      delivering_ = true;
+      deliver = true;
+    }
+  }
+  if (deliver) {
+    if (executor_ != nullptr) {
+      std::shared_ptr<InferenceResponseFactory> self = shared_from_this();
+      executor_->Submit([self]() { self->Deliver(); });
+    } else {
+      Deliver();
+    }
+  }
+  return Status::Success;
+}
+
+void InferenceResponseFactory::Cancel() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    cancelled_ = true;
+  }
+  cv_.notify_all();
+}
+
+void InferenceResponseFactory::Deliver() {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (!buffer_.empty()) {
+    std::pair<std::unique_ptr<InferenceResponse>, uint32_t> entry = std::move(buffer_.front());
+    buffer_.pop_front();
+    lock.unlock();
+    cv_.notify_one();
+    if (entry.first != nullptr) {
+      InferenceTracer::Record(trace_id_, TraceActivity::RESPONSE_SENT, model_->TraceNameId());
+    }
+    if (response_fn_) {
+      response_fn_(std::move(entry.first), entry.second);
+    }
+    entry.first.reset();
+    lock.lock();
+  }
+  delivering_ = false;
+}
+
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "status.h"
+#include "constants.h"
+#include "memory_usage.h"
+#include "model_config.h"
+#include "interface/IServer.h"
+
+namespace core {
+
+class Model;
+class Executor;
+class InferenceResponseFactory;
+
+// The allocator of the output buffers of the responses to a request, set
+// by the application so that the backend writes the outputs straight
+// into the memory the application reads them from.
+class ResponseAllocator {
+ public:
+  ResponseAllocator(SERVER_ResponseAllocatorAllocFn_t alloc_fn,
+                    SERVER_ResponseAllocatorReleaseFn_t release_fn)
+    : alloc_fn_(alloc_fn), release_fn_(release_fn) {}
+
+  SERVER_ResponseAllocatorAllocFn_t AllocFn() const { return alloc_fn_; }
+  SERVER_ResponseAllocatorReleaseFn_t ReleaseFn() const { return release_fn_; }
+
+ private:
+  SERVER_ResponseAllocatorAllocFn_t alloc_fn_;
+  SERVER_ResponseAllocatorReleaseFn_t release_fn_;
+};
+
+// A response to an inference request, holding the outputs the backend
+// produced. A request gets exactly one response from a model that is not
+// decoupled, and any number of them from a decoupled one.
+class InferenceResponse {
+ public:
+  // An output tensor of the response.
+  class Output {
+   public:
+    // The buffer is accounted in 'memory_usage' while allocated.
+    Output(const std::string& name, const inference::DataType datatype,
+           const std::vector<int64_t>& shape, const ResponseAllocator* allocator,
+           void* alloc_userp, MemoryUsage* memory_usage)
+      : name_(name), datatype_(datatype), shape_(shape), allocator_(allocator),
+        alloc_userp_(alloc_userp), memory_usage_(memory_usage), buffer_(nullptr),
+        buffer_userp_(nullptr), byte_size_(0), memory_type_(SERVER_MEMORY_CPU),
+        memory_type_id_(0) {}
+    // Give the buffer back to where it was allocated from.
+    ~Output();
+
+    const std::string& Name() const { return name_; }
+    inference::DataType DType() const { return datatype_; }
+    const std::vector<int64_t>& Shape() const { return shape_; }
+
+    // Allocate the 'byte_size' bytes of the output for the backend to
+    // write, from the response allocator of the request, or in CPU
+    // memory if the request has none. 'memory_type' and 'memory_type_id'
+    // give the preferred memory and return the memory of the buffer.
+    Status AllocateBuffer(const size_t byte_size, SERVER_MemoryType* memory_type,
+                          int64_t* memory_type_id, void** buffer);
+
+    // The data of the output, nullptr until allocated.
+    const void* Buffer() const { return buffer_; }
+    size_t ByteSize() const { return byte_size_; }
+    SERVER_MemoryType MemoryType() const { return memory_type_; }
+    int64_t MemoryTypeId() const { return memory_type_id_; }
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(Output);
+
+    const std::string name_;
+    const inference::DataType datatype_;
+    const std::vector<int64_t> shape_;
+    const ResponseAllocator* allocator_;
+    void* alloc_userp_;
+    MemoryUsage* memory_usage_;
+    void* buffer_;
+    // The allocator's own data about the buffer, handed back on release.
+    void* buffer_userp_;
+    size_t byte_size_;
+    SERVER_MemoryType memory_type_;
+    int64_t memory_type_id_;
+  };
+
+  InferenceResponse(const std::shared_ptr<InferenceResponseFactory>& factory,
+                    const std::shared_ptr<Model>& model, const std::string& id);
+
+  // The id of the request the response is for.
+  const std::string& Id() const { return id_; }
+
+  // The error the response carries, the outputs are to be ignored then.
+  const Status& ResponseStatus() const { return status_; }
+  void SetResponseStatus(const Status& status) { status_ = status; }
+
+  // Add the output 'name' of 'shape', which must be an output of the
+  // model. The output stays owned by the response.
+  Status AddOutput(const std::string& name, const std::vector<int64_t>& shape,
+                   Output** output);
+  const std::deque<Output>& Outputs() const { return outputs_; }
+
+  // Send 'response' to the client of its request with 'flags', a
+  // combination of SERVER_ResponseCompleteFlag. Blocks while the client
+  // is behind on the responses of the request, see
+  // InferenceResponseFactory::Send().
+  static Status Send(std::unique_ptr<InferenceResponse>&& response, const uint32_t flags);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(InferenceResponse);
+
+  std::shared_ptr<InferenceResponseFactory> factory_;
+  std::shared_ptr<Model> model_;
+  const std::string id_;
+  Status status_;
+  // A deque keeps the outputs in place as more are added.
+  std::deque<Output> outputs_;
+};
+
+// Creates the responses of a request and hands them to the client of the
+// request in the order they were sent. The responses wait in a buffer
+// until the client takes them, the client callback runs on an executor
+// so that a backend is not held up by a client. Once the buffer is full
+// the backend sending a response waits for the client to catch up, a
+// slow client slows down the stream of its request rather than growing
+// the memory of the server.
+class InferenceResponseFactory
+    : public std::enable_shared_from_this<InferenceResponseFactory> {
+ public:
+  // The callback taking the responses of a request with their flags, a
+  // combination of SERVER_ResponseCompleteFlag. The response is nullptr
+  // if only the flags were sent.
+  using ResponseFn =
+      std::function<void(std::unique_ptr<InferenceResponse>&& response, const uint32_t flags)>;
+
+  // Create the factory of the responses of the request 'id' to 'model',
+  // buffering up to the response buffer size of the model. The responses
+  // go to 'response_fn' on 'executor', on the thread sending them if
+  // nullptr, and are dropped if 'response_fn' is empty. The outputs are
+  // allocated from 'allocator' with 'alloc_userp' if not nullptr. The
+  // responses are traced with 'trace_id' if not 0.
+  InferenceResponseFactory(const std::shared_ptr<Model>& model, const std::string& id,
+                           ResponseFn response_fn, Executor* executor,
+                           const ResponseAllocator* allocator = nullptr,
+                           void* alloc_userp = nullptr, const uint64_t trace_id = 0);
+
+  // Create a response for the request.
+  std::unique_ptr<InferenceResponse> CreateResponse();
+
+  // Send 'response', nullptr to only send 'flags'. A model that is not
+  // decoupled must send exactly one response, with the final flag.
+  // Nothing can be sent after the final flag. Return once the response
+  // is buffered, waiting while the buffer is full. Return UNAVAILABLE if
+  // the buffer is still full after the send timeout of the model or once
+  // the request is cancelled. A final response is buffered regardless so
+  // that the client always sees the end of the stream.
+  Status Send(std::unique_ptr<InferenceResponse>&& response, const uint32_t flags);
+
+  // Stop waiting for the client, a send waiting for room in the buffer
+  // returns at once.
+  void Cancel();
+
+  const ResponseAllocator* Allocator() const { return allocator_; }
+  void* AllocatorUserp() const { return alloc_userp_; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(InferenceResponseFactory);
+
+  // Hand the buffered responses to the client until the buffer is empty.
+  void Deliver();
+
+  std::shared_ptr<Model> model_;
+  const std::string id_;
+  const bool decoupled_;
+  const size_t buffer_size_;
+  const uint64_t send_timeout_ms_;
+  const ResponseFn response_fn_;
+  Executor* const executor_;
+  const ResponseAllocator* const allocator_;
+  void* const alloc_userp_;
+  const uint64_t trace_id_;
+
+  std::mutex mu_;
+  // Signaled when a response leaves the buffer.
+  std::condition_variable cv_;
+  std::deque<std::pair<std::unique_ptr<InferenceResponse>, uint32_t>> buffer_;
+  // Whether a delivery is running, at most one is so that the responses
+  // arrive in order.
+  bool delivering_;
+  bool final_sent_;
+  bool cancelled_;
+};
+
+}
@@ -0,0 +1,174 @@
+#include "infer_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace core {
+
+namespace {
+// The buckets of a power of two, as bits.
+constexpr size_t kSubBucketBits = 2;
+constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+// The values below hold a bucket each.
+constexpr uint64_t kLinearLimit = 2 * kSubBuckets;
+
+// The position of the highest bit set in 'value', which is not 0.
+size_t HighestBit(const uint64_t value) {
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(value);
+#else
+  size_t bit = 0;
+  for (uint64_t v = value >> 1; v != 0; v >>= 1) {
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+// A later timestamp taken from an earlier one, 0 if out of order.
+uint64_t Elapsed(const uint64_t start_ns, const uint64_t end_ns) {
+  return (end_ns > start_ns) ? end_ns - start_ns : 0;
+}
+}  // namespace
+
+constexpr size_t LatencyHistogram::kBuckets;
+
+LatencyHistogram::LatencyHistogram() : count_(0), sum_ns_(0) {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t LatencyHistogram::BucketIndex(const uint64_t ns) {
+  if (ns < kLinearLimit) {
+    return static_cast<size_t>(ns);
+  }
+  const size_t bit = HighestBit(ns);
+  const size_t sub_bucket = (ns >> (bit - kSubBucketBits)) & (kSubBuckets - 1);
+  return kLinearLimit + (bit - kSubBucketBits - 1) * kSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(const size_t index) {
+  if (index < kLinearLimit) {
+    return index;
+  }
+  const size_t bit = (index - kLinearLimit) / kSubBuckets + kSubBucketBits + 1;
+  const uint64_t sub_bucket = (index - kLinearLimit) % kSubBuckets;
+  const size_t shift = bit - kSubBucketBits;
+  const uint64_t lower = (kSubBuckets + sub_bucket) << shift;
+  return lower + ((1ULL << shift) - 1);
+}
+
+void LatencyHistogram::Record(const uint64_t ns) {
+  buckets_[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::QuantileNs(const double quantile) const {
+  // The buckets are read one by one while they may be updated, the count
+  // is taken from them so that the rank is always reached.
+  uint64_t counts[kBuckets];
+  for (size_t i = 0; i < kBuckets; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  return BucketQuantile(counts, quantile);
+}
+
+uint64_t LatencyHistogram::BucketQuantile(const uint64_t* counts, const double quantile) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    total += counts[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  const uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(std::min(1.0, std::max(0.0, quantile)) * total)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return BucketUpperBound(i);
+    }
+  }
+  return BucketUpperBound(kBuckets - 1);
+}
+
+InferenceStatsAggregator::InferenceStatsAggregator(const size_t max_batch_size)
+  : max_batch_size_(std::max<size_t>(1, max_batch_size)),
+    batch_stats_(new std::atomic<StageStats*>[max_batch_size_ + 1]) {
+  for (size_t i = 0; i <= max_batch_size_; ++i) {
+    batch_stats_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+InferenceStatsAggregator::~InferenceStatsAggregator() {
+  for (size_t i = 0; i <= max_batch_size_; ++i) {
+    delete batch_stats_[i].load(std::memory_order_relaxed);
+  }
+}
+
+void InferenceStatsAggregator::UpdateStages(StageStats* stats, const bool success,
+                                            const uint64_t exec_start_ns,
+                                            const uint64_t compute_start_ns,
+                                            const uint64_t compute_end_ns,
+                                            const uint64_t exec_end_ns) {
+  if (!success) {
+    // A failed execution has no meaningful stages.
+    stats->failure_count_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  stats->success_count_.fetch_add(1, std::memory_order_relaxed);
+  stats->compute_input_.Record(Elapsed(exec_start_ns, compute_start_ns));
+  stats->compute_infer_.Record(Elapsed(compute_start_ns, compute_end_ns));
+  stats->compute_output_.Record(Elapsed(compute_end_ns, exec_end_ns));
+  stats->execution_.Record(Elapsed(exec_start_ns, exec_end_ns));
+}
+
+void InferenceStatsAggregator::UpdateRequest(const bool success, const uint64_t exec_start_ns,
+                                             const uint64_t compute_start_ns,
+                                             const uint64_t compute_end_ns,
+                                             const uint64_t exec_end_ns) {
+  UpdateStages(&request_stats_, success, exec_start_ns, compute_start_ns, compute_end_ns,
+               exec_end_ns);
+}
+
+void InferenceStatsAggregator::UpdateBatch(const size_t batch_size, const uint64_t exec_start_ns,
+                                           const uint64_t compute_start_ns,
+                                           const uint64_t compute_end_ns,
+                                           const uint64_t exec_end_ns) {
+  std::atomic<StageStats*>& slot = batch_stats_[std::min(batch_size, max_batch_size_)];
+  StageStats* stats = slot.load(std::memory_order_acquire);
+  if (stats == nullptr) {
+    // Racing first executions of a size keep the stats created first.
+    std::unique_ptr<StageStats> created(new StageStats());
+    if (slot.compare_exchange_strong(stats, created.get(), std::memory_order_acq_rel)) {
+      stats = created.release();
+    }
+  }
+  UpdateStages(stats, true, exec_start_ns, compute_start_ns, compute_end_ns, exec_end_ns);
+}
+
+void InferenceStatsAggregator::UpdateResponse(const bool success,
+                                              const uint64_t response_start_ns,
+                                              const uint64_t compute_output_start_ns,
+                                              const uint64_t response_end_ns) {
+  if (!success) {
+    response_stats_.failure_count_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  response_stats_.success_count_.fetch_add(1, std::memory_order_relaxed);
+  response_stats_.compute_infer_.Record(Elapsed(response_start_ns, compute_output_start_ns));
+  response_stats_.compute_output_.Record(Elapsed(compute_output_start_ns, response_end_ns));
+}
+
+const InferenceStatsAggregator::StageStats* InferenceStatsAggregator::BatchStats(
+    const size_t batch_size) const {
+  if (batch_size > max_batch_size_) {
+    return nullptr;
+  }
+  return batch_stats_[batch_size].load(std::memory_order_acquire);
+}
+
+}
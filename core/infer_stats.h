@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+#include "constants.h"
+
+namespace core {
+
+// A histogram of durations in nanoseconds. The buckets grow
+// logarithmically, four per power of two, so a value is within 25% of
+// the bounds of its bucket whatever its magnitude. Recording takes a few
+// relaxed atomic increments, any number of threads may record while
+// others read.
+class LatencyHistogram {
+ public:
+  // Buckets 0 to 7 hold their own value, then four per power of two up
+  // to 2^64.
+  static constexpr size_t kBuckets = 8 + 61 * 4;
+
+  LatencyHistogram();
+
+  void Record(const uint64_t ns);
+
+  uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t SumNs() const { return sum_ns_.load(std::memory_order_relaxed); }
+  uint64_t BucketCount(const size_t index) const {
+    return buckets_[index].load(std::memory_order_relaxed);
+  }
+
+  // The upper bound of the bucket holding the 'quantile' of the recorded
+  // values, 0 if none was recorded.
+  uint64_t QuantileNs(const double quantile) const;
+
+  // The bucket holding 'ns', and the largest value a bucket holds.
+  static size_t BucketIndex(const uint64_t ns);
+  static uint64_t BucketUpperBound(const size_t index);
+  // The upper bound of the bucket holding the 'quantile' of the values
+  // counted in the 'kBuckets' of 'counts', 0 if there is none.
+  static uint64_t BucketQuantile(const uint64_t* counts, const double quantile);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LatencyHistogram);
+
+  std::atomic<uint64_t> buckets_[kBuckets];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_ns_;
+};
+
+// The execution statistics of a model as reported by its backend, each
+// execution split into its stages: preparing the inputs, the inference
+// itself and collecting the outputs. Executions are accounted per
+// request and per batch size, so that a slow stage can be told apart
+// from a slow model and from batches that are too large. Updates don't
+// take a lock, the statistics of a batch size are created on its first
+// execution.
+class InferenceStatsAggregator {
+ public:
+  // The durations of the stages of the executions of a request or of a
+  // batch.
+  struct StageStats {
+    StageStats() : success_count_(0), failure_count_(0) {}
+    std::atomic<uint64_t> success_count_;
+    std::atomic<uint64_t> failure_count_;
+    LatencyHistogram compute_input_;
+    LatencyHistogram compute_infer_;
+    LatencyHistogram compute_output_;
+    // The whole execution, from the start of the input to the end of the
+    // output.
+    LatencyHistogram execution_;
+  };
+
+  // The responses of a decoupled model, each timed from when the backend
+  // started producing it, split at when it started writing its outputs.
+  struct ResponseStats {
+    ResponseStats() : success_count_(0), failure_count_(0) {}
+    std::atomic<uint64_t> success_count_;
+    std::atomic<uint64_t> failure_count_;
+    LatencyHistogram compute_infer_;
+    LatencyHistogram compute_output_;
+  };
+
+  // Batches larger than 'max_batch_size' are counted with the largest.
+  explicit InferenceStatsAggregator(const size_t max_batch_size);
+  ~InferenceStatsAggregator();
+
+  // Account the execution of a request, the timestamps are of the steady
+  // clock in nanoseconds and in order.
+  void UpdateRequest(const bool success, const uint64_t exec_start_ns,
+                     const uint64_t compute_start_ns, const uint64_t compute_end_ns,
+                     const uint64_t exec_end_ns);
+
+  // Account the execution of a batch of 'batch_size'.
+  void UpdateBatch(const size_t batch_size, const uint64_t exec_start_ns,
+                   const uint64_t compute_start_ns, const uint64_t compute_end_ns,
+                   const uint64_t exec_end_ns);
+
+  // Account a response of a decoupled model.
+  void UpdateResponse(const bool success, const uint64_t response_start_ns,
+                      const uint64_t compute_output_start_ns,
+                      const uint64_t response_end_ns);
+
+  const StageStats& RequestStats() const { return request_stats_; }
+  const ResponseStats& ResponseStatistics() const { return response_stats_; }
+  size_t MaxBatchSize() const { return max_batch_size_; }
+  // The statistics of the batches of 'batch_size', nullptr if none was
+  // executed.
+  const StageStats* BatchStats(const size_t batch_size) const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(InferenceStatsAggregator);
+
+  static void UpdateStages(StageStats* stats, const bool success,
+                           const uint64_t exec_start_ns, const uint64_t compute_start_ns,
+                           const uint64_t compute_end_ns, const uint64_t exec_end_ns);
+
+  const size_t max_batch_size_;
+  StageStats request_stats_;
+  ResponseStats response_stats_;
+  // Indexed by batch size, set once by the first execution of the size.
+  std::unique_ptr<std::atomic<StageStats*>[]> batch_stats_;
+};
+
+}
@@ -0,0 +1,276 @@
+#include "infer_trace.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "time_utils.h"
+
+namespace core {
+
+namespace {
+// The events kept per thread, the older ones are overwritten.
+constexpr size_t kRingCapacity = 8192;
+constexpr size_t kActivityCount = static_cast<size_t>(TraceActivity::RELEASED) + 1;
+
+// An event, written by the thread of its ring while an export may read
+// it.
+struct Event {
+  std::atomic<uint64_t> trace_id_{0};
+  std::atomic<uint64_t> ns_{0};
+  std::atomic<uint32_t> activity_{0};
+  std::atomic<uint32_t> model_name_id_{0};
+};
+
+// The events recorded by one thread at a time. An export reads the
+// events in place and drops those the thread overwrote meanwhile.
+struct Ring {
+  Ring() : claimed_(0), head_(0), in_use_(true) {}
+  Event events_[kRingCapacity];
+  // The events whose slot was taken, and the events written, the event
+  // of index 'i' being in slot 'i % kRingCapacity'.
+  std::atomic<uint64_t> claimed_;
+  std::atomic<uint64_t> head_;
+  // Whether a thread records into the ring, a thread that exits hands
+  // its ring over to the next thread that records.
+  std::atomic<bool> in_use_;
+};
+
+// An event as read by an export.
+struct RecordedEvent {
+  uint64_t trace_id_;
+  uint64_t ns_;
+  uint32_t activity_;
+  uint32_t model_name_id_;
+};
+
+struct TraceRegistry {
+  TraceRegistry() : next_trace_id_(1) {}
+  std::mutex mu_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+  std::vector<std::string> model_names_;
+  std::atomic<uint64_t> next_trace_id_;
+};
+
+// Never destroyed, threads may record while the process exits.
+TraceRegistry& GetTraceRegistry() {
+  static TraceRegistry* registry = new TraceRegistry();
+  return *registry;
+}
+
+Ring* AcquireRing() {
+  TraceRegistry& registry = GetTraceRegistry();
+  std::lock_guard<std::mutex> lock(registry.mu_);
+  for (auto& ring : registry.rings_) {
+    bool in_use = false;
+    if (ring->in_use_.compare_exchange_strong(in_use, true, std::memory_order_acq_rel)) {
+      return ring.get();
+    }
+  }
+  registry.rings_.emplace_back(new Ring());
+  return registry.rings_.back().get();
+}
+
+// The ring of the calling thread, acquired on its first event.
+class ThreadRing {
+ public:
+  ThreadRing() : ring_(nullptr) {}
+  ~ThreadRing() {
+    if (ring_ != nullptr) {
+      ring_->in_use_.store(false, std::memory_order_release);
+    }
+  }
+  Ring* Get() {
+    if (ring_ == nullptr) {
+      ring_ = AcquireRing();
+    }
+    return ring_;
+  }
+
+ private:
+  Ring* ring_;
+};
+
+// Append the events of 'ring' still in place to 'events'.
+void ReadRing(const Ring& ring, std::vector<RecordedEvent>* events) {
+  const uint64_t head = ring.head_.load(std::memory_order_acquire);
+  const uint64_t begin = (head > kRingCapacity) ? head - kRingCapacity : 0;
+  const size_t first = events->size();
+  for (uint64_t i = begin; i < head; ++i) {
+    const Event& event = ring.events_[i % kRingCapacity];
+    RecordedEvent recorded;
+    recorded.trace_id_ = event.trace_id_.load(std::memory_order_relaxed);
+    recorded.ns_ = event.ns_.load(std::memory_order_relaxed);
+    recorded.activity_ = event.activity_.load(std::memory_order_relaxed);
+    recorded.model_name_id_ = event.model_name_id_.load(std::memory_order_relaxed);
+    events->push_back(recorded);
+  }
+  // The slots claimed since may have been overwritten while read.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t claimed = ring.claimed_.load(std::memory_order_relaxed);
+  if (claimed > begin + kRingCapacity) {
+    const uint64_t overwritten = std::min(head, claimed - kRingCapacity) - begin;
+    events->erase(events->begin() + first, events->begin() + first + overwritten);
+  }
+}
+
+std::string EscapeJson(const std::string& value) {
+  std::string escaped;
+  for (const char c : value) {
+    if ((c == '"') || (c == '\\')) {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      escaped += buffer;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+// Nanoseconds as the microseconds of a Chrome trace.
+std::string Microseconds(const uint64_t ns) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%llu.%03llu",
+           static_cast<unsigned long long>(ns / 1000),
+           static_cast<unsigned long long>(ns % 1000));
+  return buffer;
+}
+
+// Add the complete event 'name' from 'start_ns' to 'end_ns' of the
+// request 'trace_id', if both ends were recorded.
+void AppendSpan(const char* name, const uint64_t trace_id, const uint32_t pid,
+                const uint64_t start_ns, const uint64_t end_ns,
+                std::vector<std::string>* trace_events) {
+  if ((start_ns == 0) || (end_ns < start_ns)) {
+    return;
+  }
+  trace_events->push_back("{\"name\":\"" + std::string(name) + "\",\"ph\":\"X\",\"pid\":" +
+                          std::to_string(pid) + ",\"tid\":" + std::to_string(trace_id) +
+                          ",\"ts\":" + Microseconds(start_ns) +
+                          ",\"dur\":" + Microseconds(end_ns - start_ns) + "}");
+}
+}  // namespace
+
+constexpr uint32_t InferenceTracer::kDefaultRate;
+
+uint64_t InferenceTracer::Sample(const uint32_t rate) {
+  if (rate == 0) {
+    return 0;
+  }
+  // Counting per thread keeps the requests that are not traced off any
+  // shared cache line. The threads start apart so that threads sending
+  // few requests each are not all traced.
+  thread_local uint64_t count = std::hash<std::thread::id>()(std::this_thread::get_id());
+  if ((count++ % rate) != 0) {
+    return 0;
+  }
+  return GetTraceRegistry().next_trace_id_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t InferenceTracer::InternModelName(const std::string& name) {
+  TraceRegistry& registry = GetTraceRegistry();
+  std::lock_guard<std::mutex> lock(registry.mu_);
+  const auto itr = std::find(registry.model_names_.begin(), registry.model_names_.end(), name);
+  if (itr != registry.model_names_.end()) {
+    return static_cast<uint32_t>(itr - registry.model_names_.begin());
+  }
+  registry.model_names_.push_back(name);
+  return static_cast<uint32_t>(registry.model_names_.size() - 1);
+}
+
+void InferenceTracer::RecordEvent(const uint64_t trace_id, const TraceActivity activity,
+                                  const uint32_t model_name_id) {
+  thread_local ThreadRing thread_ring;
+  Ring* ring = thread_ring.Get();
+  const uint64_t head = ring->head_.load(std::memory_order_relaxed);
+  // Claim the slot before writing it, an export reading the slot then
+  // sees it was claimed.
+  ring->claimed_.store(head + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  Event& event = ring->events_[head % kRingCapacity];
+  event.trace_id_.store(trace_id, std::memory_order_relaxed);
+  event.ns_.store(CaptureTimeNs(), std::memory_order_relaxed);
+  event.activity_.store(static_cast<uint32_t>(activity), std::memory_order_relaxed);
+  event.model_name_id_.store(model_name_id, std::memory_order_relaxed);
+  ring->head_.store(head + 1, std::memory_order_release);
+}
+
+void InferenceTracer::ExportChromeTrace(std::string* json) {
+  std::vector<RecordedEvent> events;
+  std::vector<std::string> model_names;
+  {
+    TraceRegistry& registry = GetTraceRegistry();
+    std::lock_guard<std::mutex> lock(registry.mu_);
+    for (const auto& ring : registry.rings_) {
+      ReadRing(*ring, &events);
+    }
+    model_names = registry.model_names_;
+  }
+  // The events of a request come from several threads.
+  std::sort(events.begin(), events.end(),
+            [](const RecordedEvent& lhs, const RecordedEvent& rhs) {
+              return (lhs.trace_id_ != rhs.trace_id_) ? (lhs.trace_id_ < rhs.trace_id_)
+                                                      : (lhs.ns_ < rhs.ns_);
+            });
+  // Each model is a process, each request a thread of it.
+  std::vector<std::string> trace_events;
+  for (size_t i = 0; i < model_names.size(); ++i) {
+    trace_events.push_back("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" +
+                           std::to_string(i) + ",\"args\":{\"name\":\"" +
+                           EscapeJson(model_names[i]) + "\"}}");
+  }
+  size_t begin = 0;
+  while (begin < events.size()) {
+    const uint64_t trace_id = events[begin].trace_id_;
+    size_t end = begin;
+    uint64_t first_ns[kActivityCount] = {0};
+    while ((end < events.size()) && (events[end].trace_id_ == trace_id)) {
+      const RecordedEvent& event = events[end];
+      if ((event.activity_ < kActivityCount) && (first_ns[event.activity_] == 0)) {
+        first_ns[event.activity_] = event.ns_;
+      }
+      ++end;
+    }
+    const uint32_t pid = events[begin].model_name_id_;
+    // The request spans its first and last events if the ends were
+    // overwritten.
+    AppendSpan("request", trace_id, pid, events[begin].ns_, events[end - 1].ns_, &trace_events);
+    AppendSpan("prepare", trace_id, pid,
+               first_ns[static_cast<size_t>(TraceActivity::REQUEST_RECEIVED)],
+               first_ns[static_cast<size_t>(TraceActivity::QUEUED)], &trace_events);
+    AppendSpan("queue", trace_id, pid, first_ns[static_cast<size_t>(TraceActivity::QUEUED)],
+               first_ns[static_cast<size_t>(TraceActivity::BATCH_FORMED)], &trace_events);
+    AppendSpan("dispatch", trace_id, pid,
+               first_ns[static_cast<size_t>(TraceActivity::BATCH_FORMED)],
+               first_ns[static_cast<size_t>(TraceActivity::COMPUTE_START)], &trace_events);
+    AppendSpan("compute", trace_id, pid,
+               first_ns[static_cast<size_t>(TraceActivity::COMPUTE_START)],
+               first_ns[static_cast<size_t>(TraceActivity::COMPUTE_END)], &trace_events);
+    // A decoupled model may send any number of responses.
+    for (size_t i = begin; i < end; ++i) {
+      if (events[i].activity_ == static_cast<uint32_t>(TraceActivity::RESPONSE_SENT)) {
+        trace_events.push_back("{\"name\":\"response\",\"ph\":\"i\",\"s\":\"t\",\"pid\":" +
+                               std::to_string(pid) + ",\"tid\":" + std::to_string(trace_id) +
+                               ",\"ts\":" + Microseconds(events[i].ns_) + "}");
+      }
+    }
+    begin = end;
+  }
+  *json += "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (size_t i = 0; i < trace_events.size(); ++i) {
+    *json += (i == 0) ? "\n" : ",\n";
+    *json += trace_events[i];
+  }
+  *json += "\n]}\n";
+}
+
+}
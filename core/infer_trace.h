@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "constants.h"
+
+namespace core {
+
+// The points in the life of a request that are traced.
+enum class TraceActivity : uint32_t {
+  // The application handed the request to the server.
+  REQUEST_RECEIVED = 0,
+  // The request entered the queue of the scheduler.
+  QUEUED = 1,
+  // The request was taken out of the queue into a batch.
+  BATCH_FORMED = 2,
+  // The instance started and ended executing the batch of the request.
+  COMPUTE_START = 3,
+  COMPUTE_END = 4,
+  // A response was handed to the application.
+  RESPONSE_SENT = 5,
+  // The request was released back to the application.
+  RELEASED = 6
+};
+
+// Traces a sample of the requests. A sampled request gets a trace id and
+// the times it reaches each activity are recorded, from the steady
+// clock, into a ring buffer of the recording thread: recording takes no
+// lock and doesn't allocate, and a request that isn't sampled costs a
+// branch. The rings keep the latest events of each thread, they are
+// exported as a Chrome trace, which Perfetto reads as well, showing
+// each request as a track of its stages. Each server samples at its own
+// rate, the events and the trace ids are shared by the servers of the
+// process.
+class InferenceTracer {
+ public:
+  // A server traces one in 100 requests unless set otherwise.
+  static constexpr uint32_t kDefaultRate = 100;
+
+  // Decide whether to trace a new request, tracing one in 'rate'
+  // requests and none if 'rate' is 0. Return its trace id, or 0 if it
+  // isn't traced.
+  static uint64_t Sample(const uint32_t rate);
+
+  // The id the events of the model 'name' are recorded with, so that
+  // the model name is not copied on every event.
+  static uint32_t InternModelName(const std::string& name);
+
+  // Record that the request of 'trace_id' reached 'activity', if it is
+  // traced. 'model_name_id' is from InternModelName().
+  static void Record(const uint64_t trace_id, const TraceActivity activity,
+                     const uint32_t model_name_id) {
+    if (trace_id != 0) {
+      RecordEvent(trace_id, activity, model_name_id);
+    }
+  }
+
+  // Append the recorded events to 'json' as a Chrome trace.
+  static void ExportChromeTrace(std::string* json);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(InferenceTracer);
+
+  static void RecordEvent(const uint64_t trace_id, const TraceActivity activity,
+                          const uint32_t model_name_id);
+};
+
+}
@@ -0,0 +1,234 @@
+#include "instance_rotation.h"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+namespace core {
+
+namespace {
+// The retry delay of a failed instance stops doubling at 64 times the
+// initial one.
+constexpr uint32_t kMaxRetryDoublings = 6;
+
+// The earlier of two waits, 0 standing for none.
+uint64_t MinWait(const uint64_t a_ns, const uint64_t b_ns) {
+  if ((a_ns == 0) || (b_ns == 0)) {
+    return std::max(a_ns, b_ns);
+  }
+  return std::min(a_ns, b_ns);
+}
+}  // namespace
+
+InstanceRotation::InstanceRotation(const std::string& model_name, const size_t max_batch_size,
+                                   const size_t promote_queue_depth,
+                                   const uint64_t demote_delay_ns,
+                                   const uint64_t retry_delay_ns, ChangeFn change_fn)
+  : model_name_(model_name),
+    max_batch_size_(max_batch_size),
+    promote_queue_depth_(std::max<size_t>(1, promote_queue_depth)),
+    demote_delay_ns_(demote_delay_ns),
+    retry_delay_ns_(retry_delay_ns),
+    change_fn_(std::move(change_fn)),
+    last_busy_ns_(0) {}
+
+Status InstanceRotation::Add(BackendModelInstance* instance, const std::string& name,
+                             const bool passive) {
+  Instance& info = instances_[instance];
+  info.name_ = name;
+  info.passive_ = passive;
+  if (passive) {
+    standbys_.push_back(instance);
+    return Status::Success;
+  }
+  RETURN_IF_ERROR(change_fn_(instance, true));
+  active_.insert(instance);
+  return Status::Success;
+}
+
+void InstanceRotation::Remove(BackendModelInstance* instance) {
+  if (active_.erase(instance) > 0) {
+    Change(instance, false);
+  }
+  instances_.erase(instance);
+  standbys_.erase(std::remove(standbys_.begin(), standbys_.end(), instance), standbys_.end());
+  promoted_.erase(std::remove(promoted_.begin(), promoted_.end(), instance), promoted_.end());
+  failed_.erase(instance);
+  for (auto& pr : failed_) {
+    if (pr.second.replacement_ == instance) {
+      pr.second.replacement_ = nullptr;
+    }
+  }
+}
+
+void InstanceRotation::Failed(BackendModelInstance* instance, const std::string& reason,
+                              const uint64_t now_ns) {
+  // A standby fails a batch it got before it was demoted, and an
+  // instance out of rotation already fails the other batches it had.
+  if (active_.find(instance) == active_.end()) {
+    return;
+  }
+  BackendModelInstance* standby = nullptr;
+  while ((standby == nullptr) && !standbys_.empty()) {
+    standby = standbys_.front();
+    standbys_.pop_front();
+    if (Change(standby, true)) {
+      active_.insert(standby);
+    } else {
+      MarkFailed(standby, now_ns);
+      standby = nullptr;
+    }
+  }
+  if ((standby == nullptr) && (active_.size() == 1)) {
+    // Failing the requests beats leaving them queued with no instance.
+    return;
+  }
+  // A failing instance returns quickly and would otherwise take most of
+  // the requests. One that can't be taken out keeps serving, next to the
+  // standby promoted for it.
+  if (!Change(instance, false)) {
+    if (standby != nullptr) {
+      promoted_.push_back(standby);
+      last_busy_ns_ = now_ns;
+    }
+    return;
+  }
+  active_.erase(instance);
+  const uint64_t retry_ns = MarkFailed(instance, now_ns);
+  FailedInstance& failed = failed_[instance];
+  failed.replacement_ = standby;
+  // The standby takes the place of a promoted standby, the one replacing
+  // an instance of the group is demoted once that instance is back.
+  const auto itr = std::find(promoted_.begin(), promoted_.end(), instance);
+  if (itr != promoted_.end()) {
+    if (standby != nullptr) {
+      *itr = standby;
+    } else {
+      promoted_.erase(itr);
+    }
+    failed.replacement_ = nullptr;
+  }
+  last_busy_ns_ = now_ns;
+  std::cerr << "instance " << instances_[instance].name_ << " of '" << model_name_
+            << "' failed: " << reason << ", out of rotation for " << retry_ns / 1000000
+            << "ms";
+  if (standby != nullptr) {
+    std::cerr << ", promoting standby " << instances_[standby].name_;
+  }
+  std::cerr << std::endl;
+}
+
+uint64_t InstanceRotation::Manage(const size_t queue_size, const uint64_t now_ns) {
+  const uint64_t retry_wait_ns = RetryFailed(now_ns);
+  if (standbys_.empty() && promoted_.empty()) {
+    return retry_wait_ns;
+  }
+  if (queue_size >= max_batch_size_) {
+    last_busy_ns_ = now_ns;
+  }
+  // Promoting only takes putting the instance in rotation, it is loaded
+  // and its backend thread is waiting already.
+  uint64_t wait_ns = retry_wait_ns;
+  if ((queue_size >= promote_queue_depth_) && !standbys_.empty()) {
+    BackendModelInstance* instance = standbys_.front();
+    standbys_.pop_front();
+    if (Change(instance, true)) {
+      active_.insert(instance);
+      promoted_.push_back(instance);
+      last_busy_ns_ = now_ns;
+      std::cout << "promoted standby instance " << instances_[instance].name_ << " of '"
+                << model_name_ << "', " << queue_size << " requests queued" << std::endl;
+    } else {
+      wait_ns = MinWait(wait_ns, MarkFailed(instance, now_ns));
+    }
+  }
+  if (promoted_.empty()) {
+    return wait_ns;
+  }
+  const uint64_t due_ns = last_busy_ns_ + demote_delay_ns_;
+  if (now_ns < due_ns) {
+    return MinWait(wait_ns, due_ns - now_ns);
+  }
+  // The instance finishes the payload it is executing, if any. One that
+  // can't be taken out is tried again after another quiet period.
+  BackendModelInstance* instance = promoted_.back();
+  if (!Change(instance, false)) {
+    last_busy_ns_ = now_ns;
+    return MinWait(wait_ns, demote_delay_ns_);
+  }
+  promoted_.pop_back();
+  active_.erase(instance);
+  standbys_.push_front(instance);
+  std::cout << "demoted instance " << instances_[instance].name_ << " of '" << model_name_
+            << "' to standby" << std::endl;
+  // Demote the next one only after another quiet period.
+  last_busy_ns_ = now_ns;
+  return MinWait(wait_ns, promoted_.empty() ? 0 : demote_delay_ns_);
+}
+
+bool InstanceRotation::Change(BackendModelInstance* instance, const bool in_rotation) {
+  const Status status = change_fn_(instance, in_rotation);
+  if (!status.IsOk()) {
+    std::cerr << "failed to " << (in_rotation ? "put" : "take") << " instance "
+              << instances_[instance].name_ << " of '" << model_name_
+              << (in_rotation ? "' in" : "' out of") << " rotation: " << status.Message()
+              << std::endl;
+  }
+  return status.IsOk();
+}
+
+uint64_t InstanceRotation::MarkFailed(BackendModelInstance* instance, const uint64_t now_ns) {
+  FailedInstance& failed = failed_[instance];
+  failed.probing_ = false;
+  ++failed.failures_;
+  const uint64_t retry_ns =
+      retry_delay_ns_ << std::min(failed.failures_ - 1, kMaxRetryDoublings);
+  failed.due_ns_ = now_ns + retry_ns;
+  return retry_ns;
+}
+
+uint64_t InstanceRotation::RetryFailed(const uint64_t now_ns) {
+  uint64_t wait_ns = 0;
+  for (auto itr = failed_.begin(); itr != failed_.end();) {
+    FailedInstance& failed = itr->second;
+    if (now_ns < failed.due_ns_) {
+      wait_ns = MinWait(wait_ns, failed.due_ns_ - now_ns);
+      ++itr;
+      continue;
+    }
+    // The instance went a retry delay without failing.
+    if (failed.probing_) {
+      itr = failed_.erase(itr);
+      continue;
+    }
+    BackendModelInstance* instance = itr->first;
+    const Instance& info = instances_[instance];
+    if (info.passive_) {
+      standbys_.push_back(instance);
+    } else if (Change(instance, true)) {
+      active_.insert(instance);
+    } else {
+      // Stays out of rotation until the next retry.
+      wait_ns = MinWait(wait_ns, MarkFailed(instance, now_ns));
+      ++itr;
+      continue;
+    }
+    BackendModelInstance* replacement = failed.replacement_;
+    if ((replacement != nullptr) && (active_.find(replacement) != active_.end()) &&
+        (std::find(promoted_.begin(), promoted_.end(), replacement) == promoted_.end())) {
+      // Demoted after a quiet period, like a standby promoted now.
+      promoted_.push_back(replacement);
+      last_busy_ns_ = now_ns;
+    }
+    std::cout << "retrying instance " << info.name_ << " of '" << model_name_ << "' after "
+              << failed.failures_ << " failures in a row" << std::endl;
+    failed.probing_ = true;
+    failed.replacement_ = nullptr;
+    failed.due_ns_ = now_ns + retry_delay_ns_;
+    wait_ns = MinWait(wait_ns, retry_delay_ns_);
+    ++itr;
+  }
+  return wait_ns;
+}
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+
+#include "status.h"
+#include "constants.h"
+
+namespace core {
+
+class BackendModelInstance;
+
+// Decides which instances of a model take its requests. The passive
+// instances wait as standbys, one is promoted while the queue is deep
+// and demoted again once the queue stayed below a full batch long
+// enough. An instance failing a batch is taken out of rotation, a
+// standby taking its place if there is one, and put back after a
+// retry delay that doubles with each failure in a row. The instance is
+// probed by the batches it gets then, and it is trusted again once it
+// went a retry delay without failing.
+//
+// The rotation is not thread-safe, the scheduler calls it under its
+// own lock.
+class InstanceRotation {
+ public:
+  // Put 'instance' in rotation if 'in_rotation' is true, take it out
+  // otherwise.
+  using ChangeFn = std::function<Status(BackendModelInstance* instance, const bool in_rotation)>;
+
+  // Rotate the instances of 'model_name' batching up to 'max_batch_size'
+  // by 'change_fn'. A standby is promoted once 'promote_queue_depth'
+  // requests are queued and demoted after 'demote_delay_ns' without a
+  // full batch queued. A failed instance is retried after
+  // 'retry_delay_ns'.
+  InstanceRotation(const std::string& model_name, const size_t max_batch_size,
+                   const size_t promote_queue_depth, const uint64_t demote_delay_ns,
+                   const uint64_t retry_delay_ns, ChangeFn change_fn);
+
+  // Take 'instance' of 'name' into account, a passive instance waits as
+  // a standby and the others are put in rotation.
+  Status Add(BackendModelInstance* instance, const std::string& name, const bool passive);
+
+  // Forget 'instance', taking it out of rotation.
+  void Remove(BackendModelInstance* instance);
+
+  // Record 'instance' failing a batch at 'now_ns' with 'reason'. The
+  // instance keeps serving if no other instance would be left.
+  void Failed(BackendModelInstance* instance, const std::string& reason, const uint64_t now_ns);
+
+  // Promote or demote a standby for 'queue_size' requests queued at
+  // 'now_ns', and put back the failed instances due for a retry. Return
+  // the time in nanoseconds until the next change is due, 0 if none is
+  // pending.
+  uint64_t Manage(const size_t queue_size, const uint64_t now_ns);
+
+  // The instances in rotation, the standbys and the promoted standbys.
+  const std::set<BackendModelInstance*>& Active() const { return active_; }
+  const std::deque<BackendModelInstance*>& Standbys() const { return standbys_; }
+  const std::deque<BackendModelInstance*>& Promoted() const { return promoted_; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(InstanceRotation);
+
+  struct Instance {
+    std::string name_;
+    bool passive_;
+  };
+
+  // An instance that failed lately.
+  struct FailedInstance {
+    // Whether the instance is back in rotation, probed by its batches.
+    bool probing_;
+    // When the instance is put back in rotation, or trusted again while
+    // probing.
+    uint64_t due_ns_;
+    // The failures in a row.
+    uint32_t failures_;
+    // The standby that took the place of the instance, if any.
+    BackendModelInstance* replacement_;
+  };
+
+  // Put 'instance' in rotation or take it out by 'change_fn_'. Return
+  // false after logging the error if it failed.
+  bool Change(BackendModelInstance* instance, const bool in_rotation);
+
+  // Record 'instance' failing at 'now_ns', out of rotation until its
+  // retry delay passed. Return the retry delay.
+  uint64_t MarkFailed(BackendModelInstance* instance, const uint64_t now_ns);
+
+  // Put back the failed instances due at 'now_ns'. Return the time until
+  // the next one is due, 0 if none.
+  uint64_t RetryFailed(const uint64_t now_ns);
+
+  const std::string model_name_;
+  const size_t max_batch_size_;
+  const size_t promote_queue_depth_;
+  const uint64_t demote_delay_ns_;
+  const uint64_t retry_delay_ns_;
+  const ChangeFn change_fn_;
+
+  std::map<BackendModelInstance*, Instance> instances_;
+  std::set<BackendModelInstance*> active_;
+  // The standbys waiting to be promoted, and the promoted ones in the
+  // order they were promoted.
+  std::deque<BackendModelInstance*> standbys_;
+  std::deque<BackendModelInstance*> promoted_;
+  std::map<BackendModelInstance*, FailedInstance> failed_;
+  // The last time the queue held at least a full batch.
+  uint64_t last_busy_ns_;
+};
+
+}
@@ -0,0 +1,375 @@
+#include "local_transport.h"
+
+#include <iostream>
+#include <vector>
+
+#include "infer_request.h"
+#include "model_config.h"
+#include "server.h"
+#include "libipc/shm.h"
+
+namespace core {
+
+namespace {
+// How often the receive thread checks whether the transport exits.
+constexpr uint64_t kReceivePollMs = 100;
+// The outputs are aligned for any element type and vector loads.
+constexpr size_t kOutputAlignment = 64;
+}  // namespace
+
+// A segment of a client mapped into the server.
+struct LocalTransport::Segment {
+  ipc::shm::handle handle_;
+  uint64_t byte_size_;
+};
+
+struct LocalTransport::Client {
+  // The name of the response channel, which the names of the segments
+  // of the client start with.
+  std::string channel_name_;
+  // Serializes the responses to the client, which may be sent from
+  // several threads.
+  std::mutex mu_;
+  ipc::channel channel_;
+  // The segments mapped by name, only accessed by the receive thread.
+  // The requests in flight hold the segments they use.
+  std::map<std::string, std::shared_ptr<Segment>> segments_;
+};
+
+// A request in flight. The final response is only sent once the request
+// is released as well, the client then reuses the segments of the
+// request.
+class LocalTransport::RequestContext {
+ public:
+  RequestContext(LocalTransport* transport, const std::shared_ptr<Client>& client,
+                 const uint64_t sequence_id)
+    : transport_(transport), client_(client), sequence_id_(sequence_id),
+      output_segment_byte_size_(0), output_base_(nullptr), output_begin_(0), output_end_(0), output_used_(0), pending_(2) {
+    transport_->AddInflight();
+  }
+  ~RequestContext() { transport_->RemoveInflight(); }
+
+  // Use 'region' of 'segment', mapped at 'base', for the outputs.
+  void SetOutputRegion(const std::shared_ptr<Segment>& segment,
+                       const common::ShmRegion& region, char* base) {
+    segments_.push_back(segment);
+    output_segment_ = region.segment_;
+    output_segment_byte_size_ = region.segment_byte_size_;
+    output_base_ = base - region.offset_;
+    output_begin_ = region.offset_;
+    output_end_ = region.offset_ + region.byte_size_;
+    output_used_ = output_begin_;
+  }
+  // Keep 'segment' mapped while the request is in flight.
+  void HoldSegment(const std::shared_ptr<Segment>& segment) { segments_.push_back(segment); }
+
+  // Allocate 'byte_size' bytes of the output region.
+  Status AllocateOutput(const std::string& name, const size_t byte_size, void** buffer) {
+    std::lock_guard<std::mutex> lock(mu_);
+    const uint64_t offset =
+        (output_used_ + kOutputAlignment - 1) / kOutputAlignment * kOutputAlignment;
+    if ((offset > output_end_) || (output_end_ - offset < byte_size)) {
+      return Status(Status::Code::INVALID_ARG,
+                    "output '" + name + "' of " + std::to_string(byte_size) +
+                    " bytes doesn't fit in the output region of " +
+                    std::to_string(output_end_ - output_begin_) + " bytes");
+    }
+    output_used_ = offset + byte_size;
+    *buffer = output_base_ + offset;
+    return Status::Success;
+  }
+
+  void Respond(std::unique_ptr<InferenceResponse>&& response, const uint32_t flags) {
+    common::LocalInferResponse local_response;
+    local_response.sequence_id_ = sequence_id_;
+    local_response.flags_ = flags;
+    if (response != nullptr) {
+      const Status& status = response->ResponseStatus();
+      local_response.error_code_ = static_cast<uint32_t>(status.StatusCode());
+      local_response.error_message_ = status.Message();
+      for (const auto& output : response->Outputs()) {
+        common::LocalTensor tensor;
+        tensor.name_ = output.Name();
+        tensor.datatype_ = DataTypeToServerDataType(output.DType());
+        tensor.shape_ = output.Shape();
+        tensor.region_.segment_ = output_segment_;
+        tensor.region_.segment_byte_size_ = output_segment_byte_size_;
+        tensor.region_.offset_ =
+            (output.Buffer() == nullptr)
+                ? output_begin_
+                : static_cast<const char*>(output.Buffer()) - output_base_;
+        tensor.region_.byte_size_ = output.ByteSize();
+        local_response.outputs_.push_back(tensor);
+      }
+    }
+    if ((flags & SERVER_RESPONSE_COMPLETE_FINAL) == 0) {
+      Send(client_.get(), local_response);
+      return;
+    }
+    final_response_ = std::move(local_response);
+    Complete(this);
+  }
+
+  // Called when the final response is ready and when the request is
+  // released, the second call sends the final response.
+  static void Complete(RequestContext* context) {
+    if (context->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      Send(context->client_.get(), context->final_response_);
+      delete context;
+    }
+  }
+
+ private:
+  LocalTransport* const transport_;
+  const std::shared_ptr<Client> client_;
+  const uint64_t sequence_id_;
+  std::vector<std::shared_ptr<Segment>> segments_;
+
+  std::mutex mu_;
+  std::string output_segment_;
+  uint64_t output_segment_byte_size_;
+  // The start of the output segment, and the part of it the outputs
+  // are allocated in.
+  char* output_base_;
+  uint64_t output_begin_;
+  uint64_t output_end_;
+  uint64_t output_used_;
+
+  std::atomic<int> pending_;
+  common::LocalInferResponse final_response_;
+};
+
+LocalTransport::LocalTransport(InferenceServer* server, const std::string& name)
+  : server_(server), name_(name), allocator_(AllocOutput, ReleaseOutput), exiting_(false),
+    inflight_(0) {}
+
+Status LocalTransport::Create(InferenceServer* server, const std::string& name,
+                              std::unique_ptr<LocalTransport>* transport) {
+  if (name.empty()) {
+    return Status(Status::Code::INVALID_ARG, "a local transport needs a name");
+  }
+  std::unique_ptr<LocalTransport> local_transport(new LocalTransport(server, name));
+  if (!local_transport->channel_.connect(name.c_str(), ipc::receiver)) {
+    return Status(Status::Code::UNAVAILABLE,
+                  "failed to open the channel of local transport '" + name + "'");
+  }
+  local_transport->receive_thread_ = std::thread(&LocalTransport::Receive, local_transport.get());
+  *transport = std::move(local_transport);
+  return Status::Success;
+}
+
+LocalTransport::~LocalTransport() {
+  exiting_ = true;
+  if (receive_thread_.joinable()) {
+    receive_thread_.join();
+  }
+  std::unique_lock<std::mutex> lock(inflight_mu_);
+  inflight_cv_.wait(lock, [this]() { return inflight_ == 0; });
+}
+
+void LocalTransport::Receive() {
+  while (!exiting_) {
+    ipc::buff_t message = channel_.recv(kReceivePollMs);
+    if (message.empty()) {
+      continue;
+    }
+    common::LocalMessageType type;
+    Status status(common::LocalMessageTypeOf(message.data(), message.size(), &type));
+    if (!status.IsOk()) {
+      std::cerr << "local transport '" << name_ << "': " << status.Message() << std::endl;
+      continue;
+    }
+    switch (type) {
+      case common::LocalMessageType::INFER_REQUEST:
+        HandleRequest(message.data(), message.size());
+        break;
+      case common::LocalMessageType::DISCONNECT:
+        HandleDisconnect(message.data(), message.size());
+        break;
+      default:
+        std::cerr << "local transport '" << name_ << "': ignoring message of type "
+                  << static_cast<uint32_t>(type) << std::endl;
+        break;
+    }
+  }
+}
+
+void LocalTransport::HandleRequest(const void* base, const size_t byte_size) {
+  common::LocalInferRequest local_request;
+  Status status(common::DeserializeLocalRequest(base, byte_size, &local_request));
+  if (!status.IsOk()) {
+    std::cerr << "local transport '" << name_ << "': " << status.Message() << std::endl;
+    return;
+  }
+  std::shared_ptr<Client> client = GetClient(local_request.client_);
+  // Declared before the request so that a request failing to start is
+  // deleted before its context.
+  std::unique_ptr<RequestContext> context(
+      new RequestContext(this, client, local_request.sequence_id_));
+  std::unique_ptr<InferenceRequest> request;
+  status = CreateRequest(local_request, client, context.get(), &request);
+  if (status.IsOk()) {
+    status = server_->InferAsync(request);
+    if (status.IsOk()) {
+      // Deleted by its final response or its release, whichever comes
+      // last.
+      context.release();
+      return;
+    }
+  }
+  common::LocalInferResponse response;
+  response.sequence_id_ = local_request.sequence_id_;
+  response.flags_ = SERVER_RESPONSE_COMPLETE_FINAL;
+  response.error_code_ = static_cast<uint32_t>(status.StatusCode());
+  response.error_message_ = status.Message();
+  Send(client.get(), response);
+}
+
+void LocalTransport::HandleDisconnect(const void* base, const size_t byte_size) {
+  std::string client;
+  Status status(common::DeserializeLocalDisconnect(base, byte_size, &client));
+  if (!status.IsOk()) {
+    std::cerr << "local transport '" << name_ << "': " << status.Message() << std::endl;
+    return;
+  }
+  // The segments are unmapped once the requests in flight are done.
+  clients_.erase(client);
+}
+
+std::shared_ptr<LocalTransport::Client> LocalTransport::GetClient(const std::string& name) {
+  std::shared_ptr<Client>& client = clients_[name];
+  if (client == nullptr) {
+    client.reset(new Client());
+    client->channel_name_ = common::LocalResponseChannelName(name_, name);
+    client->channel_.connect(client->channel_name_.c_str(), ipc::sender);
+  }
+  return client;
+}
+
+Status LocalTransport::CreateRequest(const common::LocalInferRequest& local_request,
+                                     const std::shared_ptr<Client>& client,
+                                     RequestContext* context,
+                                     std::unique_ptr<InferenceRequest>* request) {
+  std::shared_ptr<Model> model;
+  RETURN_IF_ERROR(
+      server_->GetModel(local_request.model_name_, local_request.model_version_, &model));
+  std::unique_ptr<InferenceRequest> lrequest(
+      new InferenceRequest(model, local_request.model_version_));
+  lrequest->SetId(local_request.client_ + ":" + std::to_string(local_request.sequence_id_));
+  for (const auto& local_input : local_request.inputs_) {
+    std::shared_ptr<Segment> segment;
+    char* base = nullptr;
+    RETURN_IF_ERROR(MapRegion(client.get(), local_input.region_, &segment, &base));
+    context->HoldSegment(segment);
+    InferenceRequest::Input* input = nullptr;
+    RETURN_IF_ERROR(lrequest->AddInput(
+        local_input.name_,
+        ServerDataTypeToDataType(static_cast<SERVER_DataType>(local_input.datatype_)),
+        local_input.shape_, &input));
+    // Read in place, the client leaves the region alone until the
+    // final response.
+    input->AppendData(base, local_input.region_.byte_size_, SERVER_MEMORY_CPU, 0);
+  }
+  for (const auto& name : local_request.requested_outputs_) {
+    lrequest->AddRequestedOutput(name);
+  }
+  std::shared_ptr<Segment> output_segment;
+  char* output_base = nullptr;
+  RETURN_IF_ERROR(
+      MapRegion(client.get(), local_request.output_region_, &output_segment, &output_base));
+  context->SetOutputRegion(output_segment, local_request.output_region_, output_base);
+
+  lrequest->SetResponseAllocator(&allocator_, context);
+  lrequest->SetResponseCallback(
+      [context](std::unique_ptr<InferenceResponse>&& response, const uint32_t flags) {
+        context->Respond(std::move(response), flags);
+      });
+  lrequest->SetReleaseCallback([context](std::unique_ptr<InferenceRequest>&& released) {
+    released.reset();
+    RequestContext::Complete(context);
+  });
+  *request = std::move(lrequest);
+  return Status::Success;
+}
+
+Status LocalTransport::MapRegion(Client* client, const common::ShmRegion& region,
+                                 std::shared_ptr<Segment>* segment, char** base) {
+  // A client only maps segments named after it.
+  const std::string& client_prefix = client->channel_name_;
+  if (region.segment_.compare(0, client_prefix.size() + 1, client_prefix + ".") != 0) {
+    return Status(Status::Code::INVALID_ARG,
+                  "segment '" + region.segment_ + "' is not a segment of the client");
+  }
+  if ((region.offset_ > region.segment_byte_size_) ||
+      (region.segment_byte_size_ - region.offset_ < region.byte_size_)) {
+    return Status(Status::Code::INVALID_ARG,
+                  "region of " + std::to_string(region.byte_size_) + " bytes at offset " +
+                  std::to_string(region.offset_) + " is outside of segment '" +
+                  region.segment_ + "' of " + std::to_string(region.segment_byte_size_) +
+                  " bytes");
+  }
+  std::shared_ptr<Segment>& mapped = client->segments_[region.segment_];
+  // A client recreating a segment with another size is mapped again.
+  if ((mapped == nullptr) || (mapped->byte_size_ != region.segment_byte_size_)) {
+    std::shared_ptr<Segment> local_segment(new Segment());
+    if (!local_segment->handle_.acquire(region.segment_.c_str(), region.segment_byte_size_,
+                                        ipc::shm::open)) {
+      client->segments_.erase(region.segment_);
+      return Status(Status::Code::NOT_FOUND,
+                    "failed to map segment '" + region.segment_ + "'");
+    }
+    local_segment->byte_size_ = region.segment_byte_size_;
+    mapped = local_segment;
+  }
+  *segment = mapped;
+  *base = static_cast<char*>(mapped->handle_.get()) + region.offset_;
+  return Status::Success;
+}
+
+void LocalTransport::Send(Client* client, const common::LocalInferResponse& response) {
+  std::string message;
+  common::SerializeLocalResponse(response, &message);
+  std::lock_guard<std::mutex> lock(client->mu_);
+  // A client that went away doesn't take its responses.
+  client->channel_.send(message.data(), message.size());
+}
+
+SERVER_Error* LocalTransport::AllocOutput(SERVER_ResponseAllocator* allocator,
+                                          const char* tensor_name, size_t byte_size,
+                                          SERVER_MemoryType memory_type, int64_t memory_type_id,
+                                          void* userp, void** buffer, void** buffer_userp,
+                                          SERVER_MemoryType* actual_memory_type,
+                                          int64_t* actual_memory_type_id) {
+  Status status =
+      reinterpret_cast<RequestContext*>(userp)->AllocateOutput(tensor_name, byte_size, buffer);
+  if (!status.IsOk()) {
+    return SERVER_ErrorNew(StatusCodeToServerErrorCode(status.StatusCode()),
+                           status.Message().c_str());
+  }
+  *buffer_userp = nullptr;
+  *actual_memory_type = SERVER_MEMORY_CPU;
+  *actual_memory_type_id = 0;
+  return nullptr;
+}
+
+SERVER_Error* LocalTransport::ReleaseOutput(SERVER_ResponseAllocator* allocator, void* buffer,
+                                            void* buffer_userp, size_t byte_size,
+                                            SERVER_MemoryType memory_type,
+                                            int64_t memory_type_id) {
+  // The client owns the output segment.
+  return nullptr;
+}
+
+void LocalTransport::AddInflight() {
+  std::lock_guard<std::mutex> lock(inflight_mu_);
+  ++inflight_;
+}
+
+void LocalTransport::RemoveInflight() {
+  std::lock_guard<std::mutex> lock(inflight_mu_);
+  if (--inflight_ == 0) {
+    inflight_cv_.notify_all();
+  }
+}
+
+}
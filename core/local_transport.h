@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "status.h"
+#include "constants.h"
+#include "infer_response.h"
+#include "common/local_transport_protocol.h"
+#include "libipc/ipc.h"
+
+namespace core {
+
+class InferenceServer;
+class InferenceRequest;
+
+// Serves inferences to the processes on the same host, without the
+// copies and the serialization of a network protocol. A client writes
+// its inputs into shared memory segments of its own and sends their
+// descriptors on the channel of the transport, the server reads the
+// inputs in place and has the backends write the outputs straight into
+// the output segment of the client, and sends back their descriptors.
+// See common/local_transport_protocol.h for the messages.
+class LocalTransport {
+ public:
+  // Serve the clients of the transport 'name', a name no other
+  // transport on the host uses, with 'server', which must outlive the
+  // transport.
+  static Status Create(InferenceServer* server, const std::string& name,
+                       std::unique_ptr<LocalTransport>* transport);
+  // Stop receiving requests and wait for the requests in flight.
+  ~LocalTransport();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LocalTransport);
+  LocalTransport(InferenceServer* server, const std::string& name);
+
+  struct Segment;
+  struct Client;
+  class RequestContext;
+
+  // Receive and dispatch the messages of the clients until exiting.
+  void Receive();
+  void HandleRequest(const void* base, const size_t byte_size);
+  void HandleDisconnect(const void* base, const size_t byte_size);
+
+  // Get the client 'name', connecting to its response channel the first
+  // time.
+  std::shared_ptr<Client> GetClient(const std::string& name);
+  // Create the request described by 'local_request', its tensors in the
+  // segments of 'client'.
+  Status CreateRequest(const common::LocalInferRequest& local_request,
+                       const std::shared_ptr<Client>& client, RequestContext* context,
+                       std::unique_ptr<InferenceRequest>* request);
+  // Map 'region' of a segment of 'client', returning the segment and
+  // the start of the region in it.
+  Status MapRegion(Client* client, const common::ShmRegion& region,
+                   std::shared_ptr<Segment>* segment, char** base);
+  // Send 'response' to 'client'.
+  static void Send(Client* client, const common::LocalInferResponse& response);
+
+  // The functions of the response allocator, the outputs are allocated
+  // in the output region of the request, owned by the client.
+  static SERVER_Error* AllocOutput(SERVER_ResponseAllocator* allocator, const char* tensor_name,
+                                   size_t byte_size, SERVER_MemoryType memory_type,
+                                   int64_t memory_type_id, void* userp, void** buffer,
+                                   void** buffer_userp, SERVER_MemoryType* actual_memory_type,
+                                   int64_t* actual_memory_type_id);
+  static SERVER_Error* ReleaseOutput(SERVER_ResponseAllocator* allocator, void* buffer,
+                                     void* buffer_userp, size_t byte_size,
+                                     SERVER_MemoryType memory_type, int64_t memory_type_id);
+
+  // Count the requests in flight, waited for on exit.
+  void AddInflight();
+  void RemoveInflight();
+
+  InferenceServer* const server_;
+  const std::string name_;
+  // Writes the outputs into the output segments of the clients.
+  const ResponseAllocator allocator_;
+
+  ipc::channel channel_;
+  std::atomic<bool> exiting_;
+  std::thread receive_thread_;
+  // The clients by name, only accessed by the receive thread.
+  std::map<std::string, std::shared_ptr<Client>> clients_;
+
+  std::mutex inflight_mu_;
+  std::condition_variable inflight_cv_;
+  size_t inflight_;
+};
+
+}
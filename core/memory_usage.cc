@@ -0,0 +1,134 @@
+#include "memory_usage.h"
+
+#include <algorithm>
+
+namespace core {
+
+namespace {
+// The memory type and id of an entry folded into a non-zero key.
+constexpr int kMemoryTypeShift = 48;
+constexpr uint64_t kMemoryTypeIdMask = (1ULL << kMemoryTypeShift) - 1;
+
+uint64_t EntryKey(const SERVER_MemoryType memory_type, const int64_t memory_type_id) {
+  return ((static_cast<uint64_t>(memory_type) + 1) << kMemoryTypeShift) |
+         (static_cast<uint64_t>(memory_type_id) & kMemoryTypeIdMask);
+}
+
+SERVER_MemoryType EntryMemoryType(const uint64_t key) {
+  return static_cast<SERVER_MemoryType>((key >> kMemoryTypeShift) - 1);
+}
+
+int64_t EntryMemoryTypeId(const uint64_t key) {
+  return static_cast<int64_t>(key & kMemoryTypeIdMask);
+}
+
+// The shard of the calling thread, threads are spread round robin.
+size_t ThreadShard(const size_t shard_count) {
+  static std::atomic<size_t> next_shard{0};
+  thread_local const size_t shard = next_shard++;
+  return shard % shard_count;
+}
+}  // namespace
+
+size_t TotalByteSize(const MemoryUsageMap& usage) {
+  size_t total = 0;
+  for (const auto& type : usage) {
+    for (const auto& id : type.second) {
+      total += id.second;
+    }
+  }
+  return total;
+}
+
+void AccumulateMemoryUsage(const MemoryUsageMap& usage, MemoryUsageMap* total) {
+  for (const auto& type : usage) {
+    for (const auto& id : type.second) {
+      (*total)[type.first][id.first] += id.second;
+    }
+  }
+}
+
+int64_t MemoryUsage::Entry::Sum() const {
+  int64_t sum = 0;
+  for (const auto& shard : shards_) {
+    sum += shard.byte_size_.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+MemoryUsage::Entry* MemoryUsage::FindEntry(const uint64_t key) {
+  for (auto& entry : entries_) {
+    uint64_t current = entry.key_.load(std::memory_order_acquire);
+    if ((current == 0) &&
+        entry.key_.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+      return &entry;
+    }
+    // Either taken before or claimed by another thread in the meantime,
+    // 'current' holds the key of the entry now.
+    if (current == key) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void MemoryUsage::Add(const SERVER_MemoryType memory_type,
+                      const int64_t memory_type_id,
+                      const int64_t delta) {
+  Entry* entry = FindEntry(EntryKey(memory_type, memory_type_id));
+  if (entry != nullptr) {
+    entry->shards_[ThreadShard(kShardCount)].byte_size_.fetch_add(
+        delta, std::memory_order_relaxed);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(overflow_mu_);
+  overflow_[std::make_pair(memory_type, memory_type_id)] += delta;
+}
+
+void MemoryUsage::Set(const SERVER_MemoryType memory_type,
+                      const int64_t memory_type_id,
+                      const size_t byte_size) {
+  Entry* entry = FindEntry(EntryKey(memory_type, memory_type_id));
+  if (entry != nullptr) {
+    // The other shards are emptied and the first one is moved by the
+    // difference to the new value, so that an addition made to any shard
+    // meanwhile is kept rather than overwritten. Two sets can't both
+    // count.
+    std::lock_guard<std::mutex> lock(set_mu_);
+    for (size_t i = 1; i < kShardCount; ++i) {
+      entry->shards_[i].byte_size_.store(0, std::memory_order_relaxed);
+    }
+    std::atomic<int64_t>& first = entry->shards_[0].byte_size_;
+    first.fetch_add(static_cast<int64_t>(byte_size) - first.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(overflow_mu_);
+  overflow_[std::make_pair(memory_type, memory_type_id)] = static_cast<int64_t>(byte_size);
+}
+
+MemoryUsageMap MemoryUsage::Usage() const {
+  MemoryUsageMap usage;
+  for (const auto& entry : entries_) {
+    const uint64_t key = entry.key_.load(std::memory_order_acquire);
+    if (key == 0) {
+      continue;
+    }
+    // The shards are read one by one, concurrent updates may make the
+    // sum briefly negative.
+    usage[EntryMemoryType(key)][EntryMemoryTypeId(key)] +=
+        static_cast<size_t>(std::max<int64_t>(0, entry.Sum()));
+  }
+  std::lock_guard<std::mutex> lock(overflow_mu_);
+  for (const auto& pr : overflow_) {
+    usage[pr.first.first][pr.first.second] +=
+        static_cast<size_t>(std::max<int64_t>(0, pr.second));
+  }
+  return usage;
+}
+
+size_t MemoryUsage::TotalByteSize() const {
+  return core::TotalByteSize(Usage());
+}
+
+} // namespace core
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "constants.h"
+#include "interface/IServer.h"
+
+namespace core {
+
+// Bytes in use by memory type and memory type id.
+using MemoryUsageMap = std::map<SERVER_MemoryType, std::map<int64_t, size_t>>;
+
+// The memory used by a model version.
+struct ModelMemoryUsage {
+  // The memory of the model as a whole, its instances included.
+  MemoryUsageMap total_;
+  // The memory of each instance, by instance name.
+  std::map<std::string, MemoryUsageMap> instances_;
+};
+
+/// Get the total bytes in 'usage'.
+size_t TotalByteSize(const MemoryUsageMap& usage);
+
+/// Add the bytes in 'usage' to 'total'.
+void AccumulateMemoryUsage(const MemoryUsageMap& usage, MemoryUsageMap* total);
+
+// Tracks the memory used by a model or an instance. Each thread adds to
+// its own shard of the counters so that accounting allocations on the
+// execution path stays cheap and uncontended, reading the usage sums the
+// shards.
+class MemoryUsage {
+ public:
+  MemoryUsage() = default;
+
+  // Record that 'byte_size' bytes of 'memory_type' / 'memory_type_id'
+  // were allocated or released.
+  void Allocated(const SERVER_MemoryType memory_type,
+                 const int64_t memory_type_id,
+                 const size_t byte_size) {
+    Add(memory_type, memory_type_id, static_cast<int64_t>(byte_size));
+  }
+  void Released(const SERVER_MemoryType memory_type,
+                const int64_t memory_type_id,
+                const size_t byte_size) {
+    Add(memory_type, memory_type_id, -static_cast<int64_t>(byte_size));
+  }
+
+  // Set the usage of 'memory_type' / 'memory_type_id' to 'byte_size', for
+  // usage that is reported as a total, such as by the backends. The
+  // updates made before are replaced and the ones made concurrently are
+  // added on top, an allocation and its release on either side of a set
+  // leave the usage off by their size.
+  void Set(const SERVER_MemoryType memory_type,
+           const int64_t memory_type_id,
+           const size_t byte_size);
+
+  // Get the current usage.
+  MemoryUsageMap Usage() const;
+
+  // Get the total bytes over all memory types.
+  size_t TotalByteSize() const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MemoryUsage);
+
+  static constexpr size_t kMaxEntries = 8;
+  static constexpr size_t kShardCount = 8;
+
+  // A counter on its own cache line.
+  struct Shard {
+    std::atomic<int64_t> byte_size_{0};
+    char padding_[64 - sizeof(std::atomic<int64_t>)];
+  };
+
+  // The counters of one memory type and id, 'key_' is 0 while unused.
+  struct Entry {
+    std::atomic<uint64_t> key_{0};
+    Shard shards_[kShardCount];
+    int64_t Sum() const;
+  };
+
+  void Add(const SERVER_MemoryType memory_type,
+           const int64_t memory_type_id,
+           const int64_t delta);
+
+  // Get the entry of 'key', claiming a free one if needed. Null if all
+  // the entries are taken by other keys.
+  Entry* FindEntry(const uint64_t key);
+
+  Entry entries_[kMaxEntries];
+
+  // Serializes Set(), which moves the counts between the shards.
+  std::mutex set_mu_;
+
+  // The usage of the memory ids that did not fit in 'entries_'.
+  mutable std::mutex overflow_mu_;
+  std::map<std::pair<SERVER_MemoryType, int64_t>, int64_t> overflow_;
+};
+
+} // namespace core
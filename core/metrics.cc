@@ -0,0 +1,381 @@
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+
+namespace {
+// The quantiles a histogram is rendered with.
+constexpr double kQuantiles[] = {0.5, 0.9, 0.99};
+
+// The families by name, the families that are gone are dropped lazily.
+struct Registry {
+  std::mutex mu_;
+  std::map<std::string, std::weak_ptr<MetricFamily>> families_;
+};
+
+// Never destroyed, metrics held by static objects may outlive it
+// otherwise.
+Registry& GetRegistry() {
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+// The shard of the calling CPU. Where the CPU is unknown the threads are
+// spread round robin.
+size_t CpuShard(const size_t shard_count) {
+#if defined(__linux__)
+  const int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    return static_cast<size_t>(cpu) % shard_count;
+  }
+#endif
+  static std::atomic<size_t> next_shard{0};
+  thread_local const size_t shard = next_shard++;
+  return shard % shard_count;
+}
+
+// A thread moved to another CPU may share its shard, so the shards are
+// still updated atomically, uncontended the first exchange succeeds. A
+// gauge is updated here directly.
+void AtomicAdd(std::atomic<double>* value, const double delta) {
+  double current = value->load(std::memory_order_relaxed);
+  while (!value->compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+  }
+}
+
+bool IsValidName(const std::string& name, const bool allow_colon) {
+  if (name.empty()) {
+    return false;
+  }
+  for (size_t i = 0; i < name.size(); ++i) {
+    const char c = name[i];
+    const bool valid = ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) ||
+                       (c == '_') || (allow_colon && (c == ':')) ||
+                       ((i > 0) && (c >= '0') && (c <= '9'));
+    if (!valid) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Escape 'value' for the text format, quotes only need escaping in
+// label values.
+std::string Escape(const std::string& value, const bool escape_quotes) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (const char c : value) {
+    if (c == '\\') {
+      escaped += "\\\\";
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else if (escape_quotes && (c == '"')) {
+      escaped += "\\\"";
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+void AppendValue(const double value, std::string* text) {
+  if (std::isnan(value)) {
+    *text += "NaN";
+  } else if (std::isinf(value)) {
+    *text += (value > 0) ? "+Inf" : "-Inf";
+  } else if ((value == std::floor(value)) && (std::fabs(value) < 9007199254740992.0)) {
+    // Integral values, most of them, are rendered exactly.
+    *text += std::to_string(static_cast<int64_t>(value));
+  } else {
+    // The shorter form unless it doesn't read back as the same value.
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.15g", value);
+    if (strtod(buffer, nullptr) != value) {
+      snprintf(buffer, sizeof(buffer), "%.17g", value);
+    }
+    *text += buffer;
+  }
+}
+
+// Append the sample 'name{labels}' of 'value', with the extra label
+// 'extra' if not empty.
+void AppendSample(const std::string& name, const std::string& labels,
+                  const std::string& extra, const double value, std::string* text) {
+  *text += name;
+  if (!labels.empty() || !extra.empty()) {
+    *text += '{';
+    *text += labels;
+    if (!labels.empty() && !extra.empty()) {
+      *text += ',';
+    }
+    *text += extra;
+    *text += '}';
+  }
+  *text += ' ';
+  AppendValue(value, text);
+  *text += '\n';
+}
+
+Status CreateModelMetric(const SERVER_MetricKind kind, const std::string& name,
+                         const std::string& description,
+                         const std::map<std::string, std::string>& labels,
+                         std::shared_ptr<Metric>* metric) {
+  std::shared_ptr<MetricFamily> family;
+  RETURN_IF_ERROR(MetricFamily::Create(kind, name, description, &family));
+  return family->CreateMetric(labels, metric);
+}
+}  // namespace
+
+constexpr size_t Metric::kMaxHistogramShards;
+
+Metric::Metric(const std::shared_ptr<MetricFamily>& family, const std::string& labels)
+  : family_(family),
+    kind_(family->Kind()),
+    labels_(labels),
+    shards_(nullptr),
+    gauge_(0),
+    histogram_count_(0) {
+  if (kind_ == SERVER_METRIC_KIND_COUNTER) {
+    // new only aligns to the fundamental alignment before C++17.
+    const size_t shard_count = ShardCount();
+    size_t space = shard_count * sizeof(Shard) + alignof(Shard);
+    shard_buffer_.reset(new char[space]);
+    void* base = shard_buffer_.get();
+    shards_ = static_cast<Shard*>(
+        std::align(alignof(Shard), shard_count * sizeof(Shard), base, space));
+    for (size_t i = 0; i < shard_count; ++i) {
+      new (&shards_[i]) Shard();
+    }
+  } else if (kind_ == SERVER_METRIC_KIND_HISTOGRAM) {
+    histogram_count_ = std::min(ShardCount(), kMaxHistogramShards);
+    histograms_.reset(new LatencyHistogram[histogram_count_]);
+  }
+}
+
+size_t Metric::ShardCount() {
+  // The CPUs configured rather than online, sched_getcpu() may return
+  // any of them.
+  static const size_t count = []() -> size_t {
+#if defined(__linux__)
+    const long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    if (cpus > 0) {
+      return static_cast<size_t>(cpus);
+    }
+#endif
+    return std::max(1u, std::thread::hardware_concurrency());
+  }();
+  return count;
+}
+
+void Metric::Increment(const double value) {
+  if (kind_ == SERVER_METRIC_KIND_GAUGE) {
+    AtomicAdd(&gauge_, value);
+    return;
+  }
+  AtomicAdd(&shards_[CpuShard(ShardCount())].value_, value);
+}
+
+void Metric::Set(const double value) {
+  gauge_.store(value, std::memory_order_relaxed);
+}
+
+double Metric::Value() const {
+  if (kind_ == SERVER_METRIC_KIND_GAUGE) {
+    return gauge_.load(std::memory_order_relaxed);
+  }
+  double value = 0;
+  for (size_t i = 0; i < ShardCount(); ++i) {
+    value += shards_[i].value_.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+void Metric::Observe(const uint64_t value) {
+  histograms_[CpuShard(histogram_count_)].Record(value);
+}
+
+uint64_t Metric::Count() const {
+  uint64_t count = 0;
+  for (size_t i = 0; i < histogram_count_; ++i) {
+    count += histograms_[i].Count();
+  }
+  return count;
+}
+
+uint64_t Metric::Sum() const {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < histogram_count_; ++i) {
+    sum += histograms_[i].SumNs();
+  }
+  return sum;
+}
+
+uint64_t Metric::Quantile(const double quantile) const {
+  std::vector<uint64_t> counts(LatencyHistogram::kBuckets, 0);
+  for (size_t i = 0; i < histogram_count_; ++i) {
+    for (size_t bucket = 0; bucket < LatencyHistogram::kBuckets; ++bucket) {
+      counts[bucket] += histograms_[i].BucketCount(bucket);
+    }
+  }
+  return LatencyHistogram::BucketQuantile(counts.data(), quantile);
+}
+
+Status MetricFamily::Create(const SERVER_MetricKind kind, const std::string& name,
+                            const std::string& description,
+                            std::shared_ptr<MetricFamily>* family) {
+  if (!IsValidName(name, true /* allow_colon */)) {
+    return Status(Status::Code::INVALID_ARG, "invalid metric family name '" + name + "'");
+  }
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mu_);
+  std::weak_ptr<MetricFamily>& registered = registry.families_[name];
+  std::shared_ptr<MetricFamily> existing = registered.lock();
+  if (existing != nullptr) {
+    if (existing->Kind() != kind) {
+      return Status(Status::Code::ALREADY_EXISTS,
+                    "metric family '" + name + "' exists with another kind");
+    }
+    *family = existing;
+    return Status::Success;
+  }
+  *family = std::make_shared<MetricFamily>(kind, name, description);
+  registered = *family;
+  return Status::Success;
+}
+
+Status MetricFamily::CreateMetric(const std::map<std::string, std::string>& labels,
+                                  std::shared_ptr<Metric>* metric) {
+  std::string rendered;
+  for (const auto& label : labels) {
+    if (!IsValidName(label.first, false /* allow_colon */) ||
+        (label.first.compare(0, 2, "__") == 0) ||
+        ((kind_ == SERVER_METRIC_KIND_HISTOGRAM) && (label.first == "quantile"))) {
+      return Status(Status::Code::INVALID_ARG,
+                    "invalid label name '" + label.first + "' for metric family '" + name_ + "'");
+    }
+    if (!rendered.empty()) {
+      rendered += ',';
+    }
+    rendered += label.first + "=\"" + Escape(label.second, true /* escape_quotes */) + "\"";
+  }
+  std::lock_guard<std::mutex> lock(mu_);
+  std::weak_ptr<Metric>& registered = metrics_[rendered];
+  *metric = registered.lock();
+  if (*metric == nullptr) {
+    *metric = std::make_shared<Metric>(shared_from_this(), rendered);
+    registered = *metric;
+  }
+  return Status::Success;
+}
+
+void MetricFamily::Render(std::string* text) {
+  std::vector<std::shared_ptr<Metric>> metrics;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    for (auto itr = metrics_.begin(); itr != metrics_.end();) {
+      std::shared_ptr<Metric> metric = itr->second.lock();
+      if (metric == nullptr) {
+        itr = metrics_.erase(itr);
+        continue;
+      }
+      metrics.push_back(std::move(metric));
+      ++itr;
+    }
+  }
+  if (metrics.empty()) {
+    return;
+  }
+  *text += "# HELP " + name_ + " " + Escape(description_, false /* escape_quotes */) + "\n";
+  *text += "# TYPE " + name_ + " ";
+  switch (kind_) {
+    case SERVER_METRIC_KIND_COUNTER:
+      *text += "counter\n";
+      break;
+    case SERVER_METRIC_KIND_GAUGE:
+      *text += "gauge\n";
+      break;
+    case SERVER_METRIC_KIND_HISTOGRAM:
+      *text += "summary\n";
+      break;
+  }
+  for (const auto& metric : metrics) {
+    if (kind_ != SERVER_METRIC_KIND_HISTOGRAM) {
+      AppendSample(name_, metric->Labels(), "", metric->Value(), text);
+      continue;
+    }
+    for (const double quantile : kQuantiles) {
+      std::string extra = "quantile=\"";
+      AppendValue(quantile, &extra);
+      extra += "\"";
+      AppendSample(name_, metric->Labels(), extra, metric->Quantile(quantile), text);
+    }
+    AppendSample(name_ + "_sum", metric->Labels(), "", metric->Sum(), text);
+    AppendSample(name_ + "_count", metric->Labels(), "", metric->Count(), text);
+  }
+}
+
+void RenderMetrics(std::string* text) {
+  std::vector<std::shared_ptr<MetricFamily>> families;
+  {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mu_);
+    for (auto itr = registry.families_.begin(); itr != registry.families_.end();) {
+      std::shared_ptr<MetricFamily> family = itr->second.lock();
+      if (family == nullptr) {
+        itr = registry.families_.erase(itr);
+        continue;
+      }
+      families.push_back(std::move(family));
+      ++itr;
+    }
+  }
+  for (const auto& family : families) {
+    family->Render(text);
+  }
+}
+
+Status ModelMetrics::Create(const std::string& model_name, const int64_t version,
+                            std::unique_ptr<ModelMetrics>* metrics) {
+  const std::map<std::string, std::string> labels = {
+      {"model", model_name}, {"version", std::to_string(version)}};
+  std::unique_ptr<ModelMetrics> local_metrics(new ModelMetrics());
+  RETURN_IF_ERROR(CreateModelMetric(
+      SERVER_METRIC_KIND_GAUGE, "inference_pending_request_count",
+      "Number of requests waiting in the queue of the model", labels,
+      &local_metrics->pending_request_count_));
+  RETURN_IF_ERROR(CreateModelMetric(
+      SERVER_METRIC_KIND_COUNTER, "inference_count",
+      "Number of samples executed, a batch of requests counts their batch sizes", labels,
+      &local_metrics->inference_count_));
+  RETURN_IF_ERROR(CreateModelMetric(
+      SERVER_METRIC_KIND_COUNTER, "inference_exec_count",
+      "Number of batches executed", labels, &local_metrics->execution_count_));
+  RETURN_IF_ERROR(CreateModelMetric(
+      SERVER_METRIC_KIND_HISTOGRAM, "inference_batch_size",
+      "Number of samples in the batches executed", labels, &local_metrics->batch_size_));
+  RETURN_IF_ERROR(CreateModelMetric(
+      SERVER_METRIC_KIND_HISTOGRAM, "inference_queue_duration_us",
+      "Time the requests waited in the queue of the model, in microseconds", labels,
+      &local_metrics->queue_duration_us_));
+  RETURN_IF_ERROR(CreateModelMetric(
+      SERVER_METRIC_KIND_HISTOGRAM, "inference_request_duration_us",
+      "Time from enqueuing a request to its release, in microseconds", labels,
+      &local_metrics->request_duration_us_));
+  *metrics = std::move(local_metrics);
+  return Status::Success;
+}
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "status.h"
+#include "constants.h"
+#include "infer_stats.h"
+#include "interface/IServer.h"
+
+namespace core {
+
+class MetricFamily;
+
+// A metric of a family, identified by its labels. A counter only goes
+// up, a gauge goes up and down or is set, and a histogram counts values
+// in log buckets and is exposed by its quantiles. Each CPU updates its
+// own shard of a counter or a histogram so that the threads updating it
+// on the hot path don't contend, reading the metric sums the shards. A
+// gauge is a single value, it is set at once.
+class Metric {
+ public:
+  Metric(const std::shared_ptr<MetricFamily>& family, const std::string& labels);
+
+  SERVER_MetricKind Kind() const { return kind_; }
+  // The labels as rendered in the Prometheus text format, without braces.
+  const std::string& Labels() const { return labels_; }
+
+  // Add 'value' to a counter or a gauge.
+  void Increment(const double value);
+  // Set a gauge to 'value'.
+  void Set(const double value);
+  // The value of a counter or a gauge.
+  double Value() const;
+
+  // Count 'value' in a histogram.
+  void Observe(const uint64_t value);
+  // The number of values and their sum in a histogram.
+  uint64_t Count() const;
+  uint64_t Sum() const;
+  // The upper bound of the bucket holding the 'quantile' of the values
+  // of a histogram, 0 if it is empty.
+  uint64_t Quantile(const double quantile) const;
+
+  // The shards of a counter, one for each CPU of the host.
+  static size_t ShardCount();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Metric);
+
+  // A histogram shard takes a few kilobytes, past this many CPUs they
+  // share the shards.
+  static constexpr size_t kMaxHistogramShards = 16;
+
+  // A value on its own cache line.
+  struct alignas(64) Shard {
+    std::atomic<double> value_{0};
+  };
+
+  // Holds the family so that it outlives its metrics.
+  std::shared_ptr<MetricFamily> family_;
+  const SERVER_MetricKind kind_;
+  const std::string labels_;
+  // The shards of a counter, aligned to the cache lines in
+  // 'shard_buffer_', nullptr for the other kinds.
+  std::unique_ptr<char[]> shard_buffer_;
+  Shard* shards_;
+  // The value of a gauge.
+  std::atomic<double> gauge_;
+  // The shards of a histogram, nullptr for the other kinds.
+  size_t histogram_count_;
+  std::unique_ptr<LatencyHistogram[]> histograms_;
+};
+
+// A named family of metrics of one kind, the metrics tell apart by
+// their labels. Creating a family or a metric that exists already
+// returns the existing one, the family and its metrics are
+// unregistered once their last holder is gone.
+class MetricFamily : public std::enable_shared_from_this<MetricFamily> {
+ public:
+  MetricFamily(const SERVER_MetricKind kind, const std::string& name,
+               const std::string& description)
+    : kind_(kind), name_(name), description_(description) {}
+
+  // Get the family 'name', registered with 'kind' and 'description' if
+  // it isn't yet. 'name' must be a valid Prometheus metric name, and an
+  // existing family must be of the same kind.
+  static Status Create(const SERVER_MetricKind kind, const std::string& name,
+                       const std::string& description,
+                       std::shared_ptr<MetricFamily>* family);
+
+  SERVER_MetricKind Kind() const { return kind_; }
+  const std::string& Name() const { return name_; }
+  const std::string& Description() const { return description_; }
+
+  // Get the metric of 'labels', created if it doesn't exist yet.
+  Status CreateMetric(const std::map<std::string, std::string>& labels,
+                      std::shared_ptr<Metric>* metric);
+
+  // Append the family and its metrics to 'text' in the Prometheus text
+  // format, a family without metrics is left out.
+  void Render(std::string* text);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MetricFamily);
+
+  const SERVER_MetricKind kind_;
+  const std::string name_;
+  const std::string description_;
+
+  std::mutex mu_;
+  // By rendered labels, the metrics that are gone are dropped lazily.
+  std::map<std::string, std::weak_ptr<Metric>> metrics_;
+};
+
+/// Render every registered metric in the Prometheus text format.
+///
+/// \param text Returns the metrics.
+void RenderMetrics(std::string* text);
+
+// The metrics every model reports, labeled with the name and the
+// version of the model.
+class ModelMetrics {
+ public:
+  static Status Create(const std::string& model_name, const int64_t version,
+                       std::unique_ptr<ModelMetrics>* metrics);
+
+  // The requests waiting in the queue of the scheduler.
+  Metric& PendingRequestCount() { return *pending_request_count_; }
+  // The samples executed, the batch size of each request, and the
+  // executions of batches.
+  Metric& InferenceCount() { return *inference_count_; }
+  Metric& ExecutionCount() { return *execution_count_; }
+  // The batch sizes the model executes.
+  Metric& BatchSize() { return *batch_size_; }
+  // The time the requests waited in the queue, and the time from their
+  // enqueuing to their release, in microseconds.
+  Metric& QueueDurationUs() { return *queue_duration_us_; }
+  Metric& RequestDurationUs() { return *request_duration_us_; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ModelMetrics);
+  ModelMetrics() = default;
+
+  std::shared_ptr<Metric> pending_request_count_;
+  std::shared_ptr<Metric> inference_count_;
+  std::shared_ptr<Metric> execution_count_;
+  std::shared_ptr<Metric> batch_size_;
+  std::shared_ptr<Metric> queue_duration_us_;
+  std::shared_ptr<Metric> request_duration_us_;
+};
+
+}
@@ -3,6 +3,18 @@
 
 namespace core {
 
+namespace {
+// The model parameter bounding the responses of a request waiting for
+// the client, the backend waits once that many are buffered.
+constexpr char kResponseBufferSize[] = "response_buffer_size";
+constexpr uint64_t kDefaultResponseBufferSize = 16;
+// The model parameter bounding how long the backend waits for room in
+// the buffer, the response is rejected after that. 0 waits as long as
+// it takes.
+constexpr char kResponseSendTimeoutMs[] = "response_send_timeout_ms";
+constexpr uint64_t kDefaultResponseSendTimeoutMs = 60000;
+}  // namespace
+
 Status Model::SetModelConfig(const inference::ModelConfig& config) {
   config_ = config;
   set_model_config_ = true;
@@ -57,6 +69,10 @@ Status Model::Init(const bool is_config_provided) {
   }
   RETURN_IF_ERROR(ValidateModelConfig(config_, min_compute_capability_));
   RETURN_IF_ERROR(ValidateModelIOConfig(config_));
+  if (config_.has_dynamic_batching()) {
+    max_priority_level_ = config_.dynamic_batching().priority_levels();
+    default_priority_level_ = config_.dynamic_batching().default_priority_level();
+  }
   // Initialize the input map
   for (const auto& io : config_.input()) {
     input_map_.insert(std::make_pair(io.name(), io));
@@ -68,6 +84,19 @@ Status Model::Init(const bool is_config_provided) {
   for (const auto& io : config_.output()) {
     output_map_.insert(std::make_pair(io.name(), io));
   }
+  uint64_t response_buffer_size = 0;
+  RETURN_IF_ERROR(GetUnsignedParameter(
+      config_, kResponseBufferSize, kDefaultResponseBufferSize, &response_buffer_size));
+  if (response_buffer_size == 0) {
+    return Status(Status::Code::INVALID_ARG,
+                  "'" + std::string(kResponseBufferSize) + "' must be positive for model '" +
+                  Name() + "'");
+  }
+  response_buffer_size_ = response_buffer_size;
+  RETURN_IF_ERROR(GetUnsignedParameter(
+      config_, kResponseSendTimeoutMs, kDefaultResponseSendTimeoutMs, &response_send_timeout_ms_));
+  RETURN_IF_ERROR(ModelMetrics::Create(Name(), version_, &metrics_));
+  trace_name_id_ = InferenceTracer::InternModelName(Name());
   return Status::Success;
 }
 
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <memory>
 #include <unordered_map>
 
 #include "status.h"
 #include "scheduler.h"
+#include "admission_controller.h"
+#include "memory_usage.h"
+#include "metrics.h"
+#include "infer_trace.h"
 #include "model_config.h"
+#include "time_utils.h"
 
 namespace core {
 
@@ -19,6 +25,11 @@ class Model {
       version_(version), 
       required_input_count_(0), 
       model_dir_(model_dir),
+      default_priority_level_(0),
+      max_priority_level_(0),
+      response_buffer_size_(1),
+      response_send_timeout_ms_(0),
+      trace_name_id_(0),
       set_model_config_(false)
   {
   }
@@ -47,27 +58,80 @@ class Model {
 
   uint64_t DefaultPriorityLevel() const { return default_priority_level_; }
 
+  // Whether the model sends any number of responses per request, from
+  // any thread and at any time, rather than exactly one.
+  bool IsDecoupled() const { return config_.model_transaction_policy().decoupled(); }
+
+  // The number of responses of a request buffered for the client before
+  // the backend has to wait.
+  size_t ResponseBufferSize() const { return response_buffer_size_; }
+
+  // How long the backend waits for room in the response buffer, in
+  // milliseconds, 0 for as long as it takes.
+  uint64_t ResponseSendTimeoutMs() const { return response_send_timeout_ms_; }
+
   // Initialize the instance for Triton core usage
   Status Init(const bool is_config_provided);
 
   // Enqueue a request for execution. If Status::Success is returned
   // then the model has taken ownership of the request object and so
   // 'request' will be nullptr. If non-success is returned then the
-  // caller still retains ownership of 'request'.
+  // caller still retains ownership of 'request'. A request may be
+  // rejected right away while the model is overloaded.
   Status Enqueue(std::unique_ptr<InferenceRequest>& request) {
+    if (scheduler_ == nullptr) {
+      return Status(Status::Code::UNAVAILABLE, 
+                    "model '" + Name() + "' has no scheduler");
+    }
+    if ((admission_controller_ != nullptr) &&
+        !admission_controller_->Admit(
+            (request->Priority() == 0) ? default_priority_level_ : request->Priority(),
+            CaptureTimeNs())) {
+      return Status(Status::Code::UNAVAILABLE,
+                    "model '" + Name() + "' is overloaded, request rejected");
+    }
     return scheduler_->Enqueue(request);
   }
 
+  // The admission control of the model, nullptr if disabled.
+  AdmissionController* GetAdmissionController() { return admission_controller_.get(); }
+
   // Return the number of in-flight inferences.
   size_t InflightInferenceCount() {
-    return scheduler_->InflightInferenceCount();
+    return (scheduler_ == nullptr) ? 0 : scheduler_->InflightInferenceCount();
   }
 
   // Stop processing future requests unless they are considered as in-flight.
-  void Stop() { scheduler_->Stop(); }
+  void Stop() {
+    if (scheduler_ != nullptr) {
+      scheduler_->Stop();
+    }
+  }
+
+  // The metrics of the model, nullptr until the model is initialized.
+  ModelMetrics* Metrics() { return metrics_.get(); }
+
+  // The id the traces of the requests to the model are recorded with,
+  // see InferenceTracer::InternModelName().
+  uint32_t TraceNameId() const { return trace_name_id_; }
+
+  // Get the memory used by the model and its instances.
+  virtual void GetMemoryUsage(ModelMemoryUsage* usage) const {
+    *usage = ModelMemoryUsage();
+    usage->total_ = output_memory_usage_.Usage();
+  }
+
+  // The memory held by the output buffers of the responses not yet
+  // deleted.
+  MemoryUsage& OutputMemory() { return output_memory_usage_; }
+
+  // The execution statistics reported by the backend of the model,
+  // nullptr for a model that doesn't execute itself.
+  virtual const InferenceStatsAggregator* ExecutionStatistics() const { return nullptr; }
 
  protected:
-  // Set the configuration of the model being served.
+  // Set the configuration of the model being served. Only before the
+  // model takes requests, Config() is read without a lock.
   Status SetModelConfig(const inference::ModelConfig& config);
 
   // Explicitly set the scheduler to use for inference requests to the
@@ -80,6 +144,15 @@ class Model {
   // The scheduler to use for this model.
   std::unique_ptr<Scheduler> scheduler_;
 
+  // Sheds requests ahead of the scheduler while the model is overloaded.
+  std::unique_ptr<AdmissionController> admission_controller_;
+
+  // The metrics of the model, labeled with its name and version.
+  std::unique_ptr<ModelMetrics> metrics_;
+
+  // The memory of the output buffers, see OutputMemory().
+  MemoryUsage output_memory_usage_;
+
  private:
   // The minimum supported CUDA compute capability.
   const double min_compute_capability_;
@@ -98,6 +171,12 @@ class Model {
   // The largest priority value for the model.
   uint64_t max_priority_level_;
 
+  size_t response_buffer_size_;
+
+  uint64_t response_send_timeout_ms_;
+
+  uint32_t trace_name_id_;
+
   // Whether or not model config has been set.
   bool set_model_config_;
 
@@ -329,4 +329,20 @@ inference::DataType ProtocolStringToDataType(const std::string& dtype) {
   return ProtocolStringToDataType(dtype.c_str(), dtype.size());
 }
 
+inference::DataType ServerDataTypeToDataType(const SERVER_DataType dtype) {
+  // The types of the C API are in the order of the configuration, bytes
+  // being the configuration's strings.
+  if ((dtype < SERVER_TYPE_INVALID) || (dtype > SERVER_TYPE_BF16)) {
+    return inference::DataType::TYPE_INVALID;
+  }
+  return static_cast<inference::DataType>(dtype);
+}
+
+SERVER_DataType DataTypeToServerDataType(const inference::DataType dtype) {
+  if ((dtype < inference::DataType::TYPE_INVALID) || (dtype > inference::DataType::TYPE_BF16)) {
+    return SERVER_TYPE_INVALID;
+  }
+  return static_cast<SERVER_DataType>(dtype);
+}
+
 } // namespace core
\ No newline at end of file
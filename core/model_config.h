@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include "model_config.pb.h"
+#include "interface/IServer.h"
 
 namespace core { 
 
@@ -195,4 +196,17 @@ inference::DataType ProtocolStringToDataType(const std::string& dtype);
 /// \return The data type.
 inference::DataType ProtocolStringToDataType(const char* dtype, size_t len);
 
+/// Get the datatype of the model configuration corresponding to a
+/// datatype of the C API.
+/// \param dtype The data type of the C API.
+/// \return The data type, TYPE_INVALID if there is none.
+inference::DataType ServerDataTypeToDataType(const SERVER_DataType dtype);
+
+/// Get the datatype of the C API corresponding to a datatype of the
+/// model configuration.
+/// \param dtype The data type.
+/// \return The data type of the C API, SERVER_TYPE_INVALID if there is
+/// none.
+SERVER_DataType DataTypeToServerDataType(const inference::DataType dtype);
+
 } // namespace core
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "constants.h"
 #include "file_utils.h"
 #include "platform.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <algorithm>
 #include <set>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/text_format.h>
@@ -407,4 +410,52 @@ Status NormalizeInstanceGroup(const double min_compute_capability,
   return Status::Success;
 }
 
-} // namespace core
\ No newline at end of file
+Status GetUnsignedParameter(const inference::ModelConfig& config,
+                            const std::string& name,
+                            const uint64_t default_value,
+                            uint64_t* value) {
+  *value = default_value;
+  const auto itr = config.parameters().find(name);
+  if (itr == config.parameters().end()) {
+    return Status::Success;
+  }
+  const std::string& str = itr->second.string_value();
+  if (str.empty() || (str.find_first_not_of("0123456789") != std::string::npos)) {
+    auto msg = "parameter '" + name + "' of model '" + config.name() +
+               "' must be a non-negative integer, got '" + str + "'";
+    return Status(Status::Code::INVALID_ARG, msg);
+  }
+  errno = 0;
+  *value = strtoull(str.c_str(), nullptr, 10);
+  if (errno != 0) {
+    auto msg = "parameter '" + name + "' of model '" + config.name() +
+               "' is out of range: '" + str + "'";
+    return Status(Status::Code::INVALID_ARG, msg);
+  }
+  return Status::Success;
+}
+
+Status GetChoiceParameter(const inference::ModelConfig& config,
+                          const std::string& name,
+                          const std::vector<std::string>& choices,
+                          std::string* value) {
+  *value = choices.front();
+  const auto itr = config.parameters().find(name);
+  if (itr == config.parameters().end()) {
+    return Status::Success;
+  }
+  const std::string& str = itr->second.string_value();
+  if (std::find(choices.begin(), choices.end(), str) == choices.end()) {
+    std::string accepted;
+    for (const auto& choice : choices) {
+      accepted += (accepted.empty() ? "'" : ", '") + choice + "'";
+    }
+    auto msg = "parameter '" + name + "' of model '" + config.name() +
+               "' must be one of " + accepted + ", got '" + str + "'";
+    return Status(Status::Code::INVALID_ARG, msg);
+  }
+  *value = str;
+  return Status::Success;
+}
+
+} // namespace core
@@ -86,6 +86,31 @@ BackendType GetBackendType(const std::string& backend_name);
 /// is not recognized.
 BackendType GetBackendTypeFromPlatform(const std::string& platform_name);
 
+/// Get a non-negative integer from the 'parameters' of a model
+/// configuration.
+/// \param config The model configuration.
+/// \param name The name of the parameter.
+/// \param default_value The value if the parameter is not set.
+/// \param value Returns the value of the parameter.
+/// \return The error status, INVALID_ARG if the parameter is set to
+/// something other than a non-negative integer.
+Status GetUnsignedParameter(const inference::ModelConfig& config,
+                            const std::string& name,
+                            const uint64_t default_value,
+                            uint64_t* value);
+
+/// Get one of 'choices' from the 'parameters' of a model configuration.
+/// \param config The model configuration.
+/// \param name The name of the parameter.
+/// \param choices The accepted values, the first one is the default.
+/// \param value Returns the value of the parameter.
+/// \return The error status, INVALID_ARG if the parameter is set to
+/// something other than one of 'choices'.
+Status GetChoiceParameter(const inference::ModelConfig& config,
+                          const std::string& name,
+                          const std::vector<std::string>& choices,
+                          std::string* value);
+
 /// [FIXME] better formalize config normalization / validation
 /// Validate instance group setting.
 /// \param config The model configuration to validate.
@@ -0,0 +1,1243 @@
+#include "model_repository_manager.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "server.h"
+#include "file_utils.h"
+#include "time_utils.h"
+#include "backend_model.h"
+#include "ensemble_model.h"
+#include "model_config_utils.h"
+
+namespace core {
+
+const char* ModelReadyStateString(ModelReadyState state) {
+  switch (state) {
+    case ModelReadyState::UNKNOWN:
+      return "UNKNOWN";
+    case ModelReadyState::READY:
+      return "READY";
+    case ModelReadyState::UNAVAILABLE:
+      return "UNAVAILABLE";
+    case ModelReadyState::LOADING:
+      return "LOADING";
+    case ModelReadyState::UNLOADING:
+      return "UNLOADING";
+  }
+  return "<invalid>";
+}
+
+std::set<std::string> GetModelDependencies(const inference::ModelConfig& config) {
+  std::set<std::string> dependencies;
+  if (config.has_ensemble_scheduling()) {
+    for (const auto& step : config.ensemble_scheduling().step()) {
+      dependencies.insert(step.model_name());
+    }
+  }
+  return dependencies;
+}
+
+namespace {
+// FNV-1a, used to fold the content of a model directory into its
+// fingerprint.
+constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+uint64_t HashBytes(const void* data, const size_t size, uint64_t hash) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+template <typename T>
+uint64_t HashValue(const T& value, uint64_t hash) {
+  return HashBytes(&value, sizeof(value), hash);
+}
+}  // namespace
+
+Status GetModelFingerprint(const std::string& model_path,
+                           ModelFingerprint* fingerprint) {
+  *fingerprint = ModelFingerprint();
+  uint64_t hash = kFnvOffsetBasis;
+  uint64_t files_hash = kFnvOffsetBasis;
+  // Model files can be large, only the configuration is hashed by
+  // content. Everything else contributes its relative path, size and
+  // modification time.
+  std::string config;
+  bool config_exists = false;
+  const auto config_path = JoinPath({model_path, kModelConfigPbTxt});
+  RETURN_IF_ERROR(FileExists(config_path, &config_exists));
+  if (config_exists) {
+    RETURN_IF_ERROR(ReadTextFile(config_path, &config));
+    hash = HashBytes(config.data(), config.size(), hash);
+  }
+  std::vector<std::string> paths{std::string()};
+  while (!paths.empty()) {
+    const std::string relative_path = paths.back();
+    paths.pop_back();
+    const std::string path =
+      relative_path.empty() ? model_path : JoinPath({model_path, relative_path});
+    bool is_dir = false;
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    RETURN_IF_ERROR(GetFileStat(path, &is_dir, &size, &mtime_ns));
+    fingerprint->mtime_ns_ = std::max(fingerprint->mtime_ns_, mtime_ns);
+    hash = HashBytes(relative_path.data(), relative_path.size(), hash);
+    hash = HashValue(mtime_ns, hash);
+    // Rewriting the configuration touches the file and possibly the model
+    // directory itself, neither says anything about the model files.
+    const bool is_config = (relative_path == kModelConfigPbTxt);
+    if (!is_config) {
+      files_hash = HashBytes(relative_path.data(), relative_path.size(), files_hash);
+      if (!relative_path.empty()) {
+        files_hash = HashValue(mtime_ns, files_hash);
+      }
+    }
+    if (!is_dir) {
+      fingerprint->size_ += size;
+      hash = HashValue(size, hash);
+      if (!is_config) {
+        files_hash = HashValue(size, files_hash);
+      }
+      continue;
+    }
+    std::set<std::string> contents;
+    RETURN_IF_ERROR(GetDirectoryContents(path, &contents));
+    for (const auto& child : contents) {
+      paths.push_back(relative_path.empty() ? child : JoinPath({relative_path, child}));
+    }
+  }
+  fingerprint->hash_ = hash;
+  fingerprint->files_hash_ = files_hash;
+  return Status::Success;
+}
+
+namespace {
+// The model parameters controlling how the traffic moves to a new version.
+constexpr char kVersionTrafficSteps[] = "version_traffic_steps";
+constexpr char kVersionTrafficStepInterval[] = "version_traffic_step_interval_ms";
+constexpr uint64_t kDefaultVersionTrafficStepIntervalMs = 10000;
+
+// The state reason of a model loaded on demand that is not loaded.
+constexpr char kModelNotLoaded[] = "not loaded, loaded on its next request";
+
+// How often the lifecycle thread looks for drained models while models
+// are draining, nothing signals the release of their last request.
+constexpr uint64_t kDrainPollMs = 10;
+
+// Parse a non-negative decimal number, return false if 'str' is not one.
+bool ParseUnsigned(const std::string& str, uint64_t* value) {
+  if (str.empty() || (str.find_first_not_of("0123456789") != std::string::npos)) {
+    return false;
+  }
+  errno = 0;
+  *value = strtoull(str.c_str(), nullptr, 10);
+  return (errno == 0);
+}
+}  // namespace
+
+Status GetVersionTrafficSteps(const inference::ModelConfig& config,
+                              std::vector<uint32_t>* steps,
+                              uint64_t* interval_ms) {
+  steps->clear();
+  *interval_ms = kDefaultVersionTrafficStepIntervalMs;
+  const auto& parameters = config.parameters();
+  const auto sitr = parameters.find(kVersionTrafficSteps);
+  if (sitr == parameters.end()) {
+    return Status::Success;
+  }
+  std::stringstream ss(sitr->second.string_value());
+  std::string token;
+  uint64_t previous = 0;
+  while (std::getline(ss, token, ',')) {
+    token.erase(0, token.find_first_not_of(' '));
+    token.erase(token.find_last_not_of(' ') + 1);
+    uint64_t percent = 0;
+    if (!ParseUnsigned(token, &percent) || (percent <= previous) || (percent > 100)) {
+      auto msg = "'" + std::string(kVersionTrafficSteps) + "' of model '" +
+                 config.name() + "' must be increasing percentages between "
+                 "1 and 100, got '" + sitr->second.string_value() + "'";
+      return Status(Status::Code::INVALID_ARG, msg);
+    }
+    steps->push_back(static_cast<uint32_t>(percent));
+    previous = percent;
+  }
+  if (steps->empty() || (steps->back() != 100)) {
+    steps->push_back(100);
+  }
+  return GetUnsignedParameter(config, kVersionTrafficStepInterval,
+                              kDefaultVersionTrafficStepIntervalMs, interval_ms);
+}
+
+Status GetVersionsToLoad(const std::string& model_path,
+                         const inference::ModelConfig& config,
+                         std::set<int64_t>* versions) {
+  versions->clear();
+  // Only sub-directories named by a number are versions.
+  std::set<std::string> subdirs;
+  RETURN_IF_ERROR(GetDirectorySubdirs(model_path, &subdirs));
+  std::set<int64_t, std::greater<int64_t>> existing_versions;
+  for (const auto& subdir : subdirs) {
+    if (subdir.empty() ||
+        (subdir.find_first_not_of("0123456789") != std::string::npos)) {
+      continue;
+    }
+    int64_t version;
+    RETURN_IF_ERROR(GetModelVersionFromPath(JoinPath({model_path, subdir}), &version));
+    existing_versions.insert(version);
+  }
+  const auto& policy = config.version_policy();
+  if (policy.has_specific()) {
+    for (const auto& version : policy.specific().versions()) {
+      if (existing_versions.find(version) == existing_versions.end()) {
+        auto msg = "version " + std::to_string(version) +
+                   " is specified for model '" + config.name() +
+                   "', but the version directory is not present";
+        return Status(Status::Code::NOT_FOUND, msg);
+      }
+      versions->insert(version);
+    }
+  } else if (policy.has_all()) {
+    versions->insert(existing_versions.begin(), existing_versions.end());
+  } else {
+    // Latest is the default policy, serving the single latest version
+    // unless told otherwise.
+    uint32_t num_versions = 1;
+    if (policy.has_latest() && (policy.latest().num_versions() > 0)) {
+      num_versions = policy.latest().num_versions();
+    }
+    for (const auto& version : existing_versions) {
+      if (versions->size() >= num_versions) {
+        break;
+      }
+      versions->insert(version);
+    }
+  }
+  if (versions->empty()) {
+    auto msg = "at least one version must be available under the version "
+               "policy of model '" + config.name() + "'";
+    return Status(Status::Code::INVALID_ARG, msg);
+  }
+  return Status::Success;
+}
+
+Status ModelRepositoryManager::Create(InferenceServer* server,
+                                      const std::set<std::string>& repository_paths,
+                                      const BackendCmdlineConfigMap& backend_cmdline_config_map,
+                                      const HostPolicyCmdlineConfigMap& host_policy_map,
+                                      const size_t model_load_thread_count,
+                                      const ModelLoadOptions& load_options,
+                                      std::unique_ptr<ModelRepositoryManager>* model_repository_manager) {
+  if (model_load_thread_count == 0) {
+    auto msg = "model load thread count must be greater than 0";
+    return Status(Status::Code::INVALID_ARG, msg);
+  }
+  // The manager is published before the first poll because loading an
+  // ensemble looks up its components through the server.
+  model_repository_manager->reset(new ModelRepositoryManager(
+      server, repository_paths, backend_cmdline_config_map, host_policy_map,
+      model_load_thread_count, load_options));
+  return (*model_repository_manager)->Start();
+}
+
+Status ModelRepositoryManager::Start() {
+  lifecycle_thread_ = std::thread([this]() { LifecycleThread(); });
+  Status status = RepositoryWatcher::Create(repository_paths_, &watcher_);
+  if (!status.IsOk()) {
+    std::cerr << "repository changes are not watched, every poll rescans "
+              << "the repositories: " << status.Message() << std::endl;
+  }
+  return PollAndUpdate();
+}
+
+ModelRepositoryManager::~ModelRepositoryManager() {
+  UnloadAllModels();
+  {
+    std::lock_guard<std::mutex> lock(lifecycle_mu_);
+    exiting_ = true;
+    lifecycle_changed_ = true;
+  }
+  lifecycle_cv_.notify_one();
+  if (lifecycle_thread_.joinable()) {
+    lifecycle_thread_.join();
+  }
+}
+
+Status ModelRepositoryManager::PollAndUpdate() {
+  std::lock_guard<std::mutex> lock(poll_mu_);
+  // Without a watcher, or if events were lost, every model is visited
+  // again. Models whose fingerprint did not change still skip parsing.
+  bool rescan = !scanned_ || (watcher_ == nullptr);
+  std::set<std::string> names;
+  if (!rescan) {
+    RETURN_IF_ERROR(watcher_->Changes(&names, &rescan));
+  }
+  if (rescan) {
+    names.clear();
+    for (const auto& pr : infos_) {
+      names.insert(pr.first);
+    }
+    for (const auto& repository_path : repository_paths_) {
+      std::set<std::string> subdirs;
+      RETURN_IF_ERROR(GetDirectorySubdirs(repository_path, &subdirs));
+      names.insert(subdirs.begin(), subdirs.end());
+    }
+  }
+  if (names.empty()) {
+    return Status::Success;
+  }
+  ModelInfoMap infos = infos_;
+  RETURN_IF_ERROR(Poll(names, &infos));
+  scanned_ = true;
+  // Diff the models found against the ones from the previous poll.
+  std::set<std::string> deleted, changed;
+  for (const auto& pr : infos_) {
+    if (infos.find(pr.first) == infos.end()) {
+      deleted.insert(pr.first);
+    }
+  }
+  for (const auto& pr : infos) {
+    const auto itr = infos_.find(pr.first);
+    if ((itr == infos_.end()) ||
+        (itr->second.fingerprint_ != pr.second.fingerprint_) ||
+        (itr->second.model_path_ != pr.second.model_path_)) {
+      changed.insert(pr.first);
+    }
+  }
+  // An ensemble has to be reloaded whenever any model it is composed
+  // of is reloaded or removed.
+  bool grown = true;
+  while (grown) {
+    grown = false;
+    for (const auto& pr : infos) {
+      if (changed.find(pr.first) != changed.end()) {
+        continue;
+      }
+      for (const auto& dependency : GetModelDependencies(pr.second.model_config_)) {
+        if ((changed.find(dependency) != changed.end()) ||
+            (deleted.find(dependency) != deleted.end())) {
+          changed.insert(pr.first);
+          grown = true;
+          break;
+        }
+      }
+    }
+  }
+  for (const auto& name : deleted) {
+    UnloadModel(name);
+  }
+  if (load_options_.on_demand_) {
+    RegisterModels(infos, &changed);
+  }
+  LoadModels(infos, changed);
+  infos_ = std::move(infos);
+  return Status::Success;
+}
+
+Status ModelRepositoryManager::Poll(const std::set<std::string>& names,
+                                    ModelInfoMap* infos) {
+  // Reading a model fingerprints its files, so the models are read in
+  // parallel and the results applied in order afterwards.
+  const std::vector<std::string> name_list(names.begin(), names.end());
+  std::vector<std::string> model_paths(name_list.size());
+  std::vector<ModelInfo> read_infos(name_list.size());
+  std::vector<Status> statuses(name_list.size());
+  server_->GetExecutor()->ParallelFor(0, name_list.size(), [&](size_t i) {
+    statuses[i] = FindModel(name_list[i], &model_paths[i]);
+    if (statuses[i].IsOk() && !model_paths[i].empty()) {
+      statuses[i] = ReadModelInfo(name_list[i], model_paths[i], &read_infos[i]);
+    }
+  });
+  for (size_t i = 0; i < name_list.size(); ++i) {
+    const std::string& name = name_list[i];
+    const std::string& model_path = model_paths[i];
+    const Status& status = statuses[i];
+    if (status.IsOk() && model_path.empty()) {
+      infos->erase(name);
+      continue;
+    }
+    ModelInfo& info = read_infos[i];
+    if (!status.IsOk()) {
+      std::cerr << "failed to read model '" << name << "': "
+                << status.Message() << std::endl;
+      // A model whose files are being rewritten keeps serving the
+      // versions loaded from its previous information.
+      SetModelFailed(name, status.Message());
+      continue;
+    }
+    if (watcher_ != nullptr) {
+      const Status watch_status = watcher_->WatchModel(name, model_path);
+      if (!watch_status.IsOk()) {
+        std::cerr << "changes to model '" << name << "' are not watched: "
+                  << watch_status.Message() << std::endl;
+      }
+    }
+    (*infos)[name] = std::move(info);
+  }
+  return Status::Success;
+}
+
+Status ModelRepositoryManager::FindModel(const std::string& name,
+                                         std::string* model_path) {
+  model_path->clear();
+  for (const auto& repository_path : repository_paths_) {
+    const auto path = JoinPath({repository_path, name});
+    bool exists = false;
+    RETURN_IF_ERROR(FileExists(path, &exists));
+    if (!exists) {
+      continue;
+    }
+    bool is_dir = false;
+    RETURN_IF_ERROR(IsDirectory(path, &is_dir));
+    if (!is_dir) {
+      continue;
+    }
+    if (!model_path->empty()) {
+      auto msg = "model '" + name + "' appears in multiple repositories: '" +
+                 *model_path + "' and '" + path + "'";
+      return Status(Status::Code::INVALID_ARG, msg);
+    }
+    *model_path = path;
+  }
+  return Status::Success;
+}
+
+Status ModelRepositoryManager::ReadModelInfo(const std::string& name,
+                                             const std::string& path,
+                                             ModelInfo* info) {
+  info->model_path_ = path;
+  RETURN_IF_ERROR(GetModelFingerprint(path, &info->fingerprint_));
+  const auto itr = infos_.find(name);
+  if ((itr != infos_.end()) && (itr->second.model_path_ == path) &&
+      (itr->second.fingerprint_ == info->fingerprint_)) {
+    *info = itr->second;
+    return Status::Success;
+  }
+  const auto config_path = JoinPath({path, kModelConfigPbTxt});
+  RETURN_IF_ERROR(FileExists(config_path, &info->is_config_provided_));
+  if (info->is_config_provided_) {
+    RETURN_IF_ERROR(LoadModelConfigFormTextProto(config_path, &info->model_config_));
+  }
+  if (info->model_config_.name().empty()) {
+    info->model_config_.set_name(name);
+  } else if (info->model_config_.name() != name) {
+    auto msg = "unexpected directory name '" + name + "' for model '" +
+               info->model_config_.name() +
+               "', directory name must equal model name";
+    return Status(Status::Code::INVALID_ARG, msg);
+  }
+  return Status::Success;
+}
+
+void ModelRepositoryManager::RegisterModels(const ModelInfoMap& infos,
+                                            std::set<std::string>* names) {
+  std::lock_guard<std::mutex> lock(mu_);
+  for (auto itr = names->begin(); itr != names->end();) {
+    auto& slot = models_[*itr];
+    slot.info_ = infos.at(*itr);
+    slot.load_failed_ = false;
+    // A loaded model is reloaded right away like any other model.
+    if (!slot.versions_.empty() || slot.loading_) {
+      ++itr;
+      continue;
+    }
+    slot.states_.clear();
+    slot.states_[-1] = std::make_pair(ModelReadyState::UNAVAILABLE,
+                                      std::string(kModelNotLoaded));
+    itr = names->erase(itr);
+  }
+}
+
+Status ModelRepositoryManager::LoadModelOnDemand(const std::string& name,
+                                                 std::unique_lock<std::mutex>* lock) {
+  auto itr = models_.find(name);
+  while ((itr != models_.end()) && itr->second.loading_) {
+    load_cv_.wait(*lock);
+    itr = models_.find(name);
+  }
+  if ((itr == models_.end()) || itr->second.info_.model_path_.empty()) {
+    auto msg = "model '" + name + "' is not available";
+    return Status(Status::Code::UNAVAILABLE, msg);
+  }
+  auto& slot = itr->second;
+  if (!slot.versions_.empty()) {
+    return Status::Success;
+  }
+  if (slot.load_failed_) {
+    auto msg = "model '" + name + "' failed to load, it is loaded again "
+               "once it changes in the model repository";
+    return Status(Status::Code::UNAVAILABLE, msg);
+  }
+  // Two models loading each other on demand would wait for one another
+  // forever.
+  std::set<std::string> visited;
+  if (DependsOn(name, name, &visited)) {
+    slot.load_failed_ = true;
+    slot.states_.clear();
+    slot.states_[-1] = std::make_pair(ModelReadyState::UNAVAILABLE,
+                                      std::string("circular dependency between models"));
+    auto msg = "failed to load '" + name + "': circular dependency between models";
+    return Status(Status::Code::INVALID_ARG, msg);
+  }
+  const ModelInfo info = slot.info_;
+  std::vector<std::shared_ptr<Model>> retired;
+  EvictForBudget(name, info.fingerprint_.size_, &retired);
+  slot.loading_ = true;
+  lock->unlock();
+  RetireModels(std::move(retired));
+  Status status = LoadModel(name, info);
+  if (status.IsOk()) {
+    std::cout << "successfully loaded '" << name << "' on demand" << std::endl;
+  } else {
+    std::cerr << "failed to load '" << name << "' on demand: "
+              << status.Message() << std::endl;
+  }
+  lock->lock();
+  itr = models_.find(name);
+  if (itr != models_.end()) {
+    auto& loaded_slot = itr->second;
+    loaded_slot.loading_ = false;
+    loaded_slot.load_failed_ = loaded_slot.versions_.empty();
+    loaded_slot.last_used_ns_ = CaptureTimeNs();
+    // The model is unloaded once it stays idle from now on.
+    WakeLifecycleThread();
+    // The model was removed from the repositories while it was loading.
+    if (loaded_slot.info_.model_path_.empty()) {
+      for (auto& pr : loaded_slot.versions_) {
+        retired.push_back(std::move(pr.second));
+      }
+      models_.erase(itr);
+    }
+  }
+  load_cv_.notify_all();
+  if (!retired.empty()) {
+    lock->unlock();
+    RetireModels(std::move(retired));
+    lock->lock();
+  }
+  return status;
+}
+
+bool ModelRepositoryManager::DependsOn(const std::string& name,
+                                       const std::string& target,
+                                       std::set<std::string>* visited) {
+  const auto itr = models_.find(name);
+  if ((itr == models_.end()) || !visited->insert(name).second) {
+    return false;
+  }
+  for (const auto& dependency : GetModelDependencies(itr->second.info_.model_config_)) {
+    if ((dependency == target) || DependsOn(dependency, target, visited)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t ModelRepositoryManager::ResidentBytes(const ModelSlot& slot) {
+  uint64_t bytes = 0;
+  for (const auto& pr : slot.versions_) {
+    ModelMemoryUsage usage;
+    pr.second->GetMemoryUsage(&usage);
+    bytes += TotalByteSize(usage.total_);
+  }
+  // Until the memory of the model is known the size of its files is a
+  // fair estimate.
+  if ((bytes == 0) && (!slot.versions_.empty() || slot.loading_)) {
+    bytes = slot.info_.fingerprint_.size_;
+  }
+  return bytes;
+}
+
+void ModelRepositoryManager::EvictForBudget(const std::string& name,
+                                            const uint64_t required_bytes,
+                                            std::vector<std::shared_ptr<Model>>* retired) {
+  const uint64_t budget = load_options_.memory_budget_bytes_;
+  if (budget == 0) {
+    return;
+  }
+  uint64_t usage = 0;
+  std::vector<std::pair<uint64_t, std::string>> candidates;
+  for (const auto& pr : models_) {
+    usage += ResidentBytes(pr.second);
+    if ((pr.first != name) && !pr.second.versions_.empty() && !pr.second.loading_) {
+      candidates.emplace_back(pr.second.last_used_ns_, pr.first);
+    }
+  }
+  // Least recently requested first.
+  std::sort(candidates.begin(), candidates.end());
+  for (const auto& candidate : candidates) {
+    if (usage + required_bytes <= budget) {
+      break;
+    }
+    auto& slot = models_[candidate.second];
+    usage -= std::min(usage, ResidentBytes(slot));
+    EvictModel(candidate.second, "to stay within the memory budget", &slot, retired);
+  }
+  if (usage + required_bytes > budget) {
+    std::cerr << "loading '" << name << "' exceeds the memory budget of "
+              << budget << " bytes" << std::endl;
+  }
+}
+
+void ModelRepositoryManager::EvictModel(const std::string& name,
+                                        const char* reason,
+                                        ModelSlot* slot,
+                                        std::vector<std::shared_ptr<Model>>* retired) {
+  std::cout << "unloading '" << name << "' " << reason << std::endl;
+  for (auto& pr : slot->versions_) {
+    retired->push_back(std::move(pr.second));
+  }
+  slot->versions_.clear();
+  slot->traffic_.clear();
+  slot->retiring_.clear();
+  slot->rollout_ = Rollout();
+  slot->states_.clear();
+  slot->states_[-1] = std::make_pair(ModelReadyState::UNAVAILABLE,
+                                     std::string(kModelNotLoaded));
+}
+
+void ModelRepositoryManager::LoadModels(const ModelInfoMap& infos,
+                                        const std::set<std::string>& names) {
+  if (names.empty()) {
+    return;
+  }
+  // Only dependencies loaded in this same pass impose an order, the
+  // others are either served already or will be reported as missing
+  // when the dependent model is created.
+  std::map<std::string, size_t> pending;
+  std::map<std::string, std::vector<std::string>> downstreams;
+  std::deque<std::string> ready;
+  for (const auto& name : names) {
+    size_t& count = pending[name];
+    for (const auto& dependency : GetModelDependencies(infos.at(name).model_config_)) {
+      if (names.find(dependency) != names.end()) {
+        ++count;
+        downstreams[dependency].push_back(name);
+      }
+    }
+    if (count == 0) {
+      ready.push_back(name);
+    }
+  }
+
+  std::mutex mu;
+  std::condition_variable cv;
+  size_t in_flight = 0;
+  std::set<std::string> failed;
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(mu);
+    while (true) {
+      cv.wait(lock, [&]() { return !ready.empty() || (in_flight == 0); });
+      // Nothing is being loaded and nothing can start, so nothing ever
+      // will be.
+      if (ready.empty()) {
+        break;
+      }
+      const std::string name = ready.front();
+      ready.pop_front();
+      ++in_flight;
+      std::string failed_dependency;
+      for (const auto& dependency : GetModelDependencies(infos.at(name).model_config_)) {
+        if (failed.find(dependency) != failed.end()) {
+          failed_dependency = dependency;
+          break;
+        }
+      }
+      lock.unlock();
+      Status status;
+      if (failed_dependency.empty()) {
+        status = LoadModel(name, infos.at(name));
+      } else {
+        status = Status(Status::Code::INVALID_ARG,
+                        "failed to load dependency '" + failed_dependency + "'");
+        SetModelFailed(name, status.Message());
+      }
+      if (status.IsOk()) {
+        std::cout << "successfully loaded '" << name << "'" << std::endl;
+      } else {
+        std::cerr << "failed to load '" << name << "': "
+                  << status.Message() << std::endl;
+      }
+      lock.lock();
+      --in_flight;
+      if (!status.IsOk()) {
+        failed.insert(name);
+      }
+      for (const auto& downstream : downstreams[name]) {
+        if (--pending[downstream] == 0) {
+          ready.push_back(downstream);
+        }
+      }
+      cv.notify_all();
+    }
+  };
+
+  // Each loader takes the ready models until none is left, so at most
+  // 'model_load_thread_count_' models are loaded at a time.
+  const size_t loader_count = std::min(model_load_thread_count_, names.size());
+  server_->GetExecutor()->ParallelFor(0, loader_count, [&worker](size_t) { worker(); });
+  // Anything still pending is part of a dependency cycle.
+  for (const auto& pr : pending) {
+    if (pr.second != 0) {
+      SetModelFailed(pr.first, "circular dependency between models");
+      std::cerr << "failed to load '" << pr.first
+                << "': circular dependency between models" << std::endl;
+    }
+  }
+}
+
+Status ModelRepositoryManager::LoadModel(const std::string& name,
+                                         const ModelInfo& info) {
+  std::set<int64_t> versions;
+  Status status = GetVersionsToLoad(info.model_path_, info.model_config_, &versions);
+  std::vector<uint32_t> traffic_steps;
+  uint64_t traffic_step_interval_ms = 0;
+  if (status.IsOk()) {
+    status = GetVersionTrafficSteps(info.model_config_, &traffic_steps,
+                                    &traffic_step_interval_ms);
+  }
+  if (!status.IsOk()) {
+    SetModelFailed(name, status.Message());
+    return status;
+  }
+  bool updated = false;
+  status = UpdateInstanceGroups(name, info, versions, &updated);
+  if (updated) {
+    return status;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto& states = models_[name].states_;
+    for (const auto version : versions) {
+      states[version] = std::make_pair(ModelReadyState::LOADING, std::string());
+    }
+  }
+  // The versions are created without holding the lock so that the
+  // currently loaded versions keep serving in the meantime.
+  std::map<int64_t, std::shared_ptr<Model>> loaded;
+  VersionStateMap states;
+  for (const auto version : versions) {
+    std::unique_ptr<Model> model;
+    Status version_status = CreateModel(info, version, &model);
+    if (version_status.IsOk()) {
+      loaded.emplace(version, std::move(model));
+      states[version] = std::make_pair(ModelReadyState::READY, std::string());
+    } else {
+      states[version] = std::make_pair(ModelReadyState::UNAVAILABLE, version_status.Message());
+      status = version_status;
+    }
+  }
+  std::map<int64_t, std::shared_ptr<Model>> replaced;
+  std::vector<std::shared_ptr<Model>> retired;
+  bool rollout_started = false;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto& slot = models_[name];
+    // The version serving the unversioned requests until now.
+    int64_t previous_latest = -1;
+    for (auto itr = slot.versions_.rbegin(); itr != slot.versions_.rend(); ++itr) {
+      if (slot.retiring_.find(itr->first) == slot.retiring_.end()) {
+        previous_latest = itr->first;
+        break;
+      }
+    }
+    for (auto& pr : slot.versions_) {
+      // Keep serving a version that was loaded before but failed to
+      // reload, drop the versions the policy no longer selects.
+      if ((loaded.find(pr.first) == loaded.end()) &&
+          (versions.find(pr.first) != versions.end())) {
+        loaded.emplace(pr.first, pr.second);
+        states[pr.first].first = ModelReadyState::READY;
+      } else {
+        replaced.emplace(pr.first, std::move(pr.second));
+      }
+    }
+    // A rollout in progress is cut short, its retiring version is
+    // replaced like any other version the policy dropped.
+    slot.traffic_.clear();
+    slot.retiring_.clear();
+    slot.rollout_ = Rollout();
+    // If the latest version changed, the previous latest version keeps
+    // serving next to the new one until the unversioned traffic moved
+    // over to the new version.
+    const int64_t latest = loaded.empty() ? -1 : loaded.rbegin()->first;
+    const auto ritr = replaced.find(previous_latest);
+    const bool previous_available =
+      (loaded.find(previous_latest) != loaded.end()) ||
+      ((ritr != replaced.end()) && (versions.find(previous_latest) == versions.end()));
+    if (!traffic_steps.empty() && (previous_latest != -1) && (latest != -1) &&
+        (latest != previous_latest) && previous_available) {
+      if (loaded.find(previous_latest) == loaded.end()) {
+        loaded.emplace(previous_latest, std::move(ritr->second));
+        replaced.erase(ritr);
+        states[previous_latest] = std::make_pair(ModelReadyState::READY, std::string());
+        slot.retiring_.insert(previous_latest);
+      }
+      slot.rollout_.from_version_ = previous_latest;
+      slot.rollout_.to_version_ = latest;
+      slot.rollout_.steps_ = traffic_steps;
+      slot.rollout_.interval_ns_ = traffic_step_interval_ms * 1000 * 1000;
+    }
+    slot.versions_.swap(loaded);
+    slot.states_.swap(states);
+    slot.fingerprint_ = info.fingerprint_;
+    slot.config_ = info.model_config_;
+    rollout_started = slot.rollout_.Active();
+    if (rollout_started) {
+      StepRollout(name, &slot, &retired);
+    }
+  }
+  for (auto& pr : replaced) {
+    retired.push_back(std::move(pr.second));
+  }
+  RetireModels(std::move(retired));
+  if (rollout_started) {
+    WakeLifecycleThread();
+  }
+  return status;
+}
+
+void ModelRepositoryManager::StepRollout(const std::string& name,
+                                         ModelSlot* slot,
+                                         std::vector<std::shared_ptr<Model>>* retired) {
+  auto& rollout = slot->rollout_;
+  const uint32_t percent = rollout.steps_[rollout.next_step_++];
+  std::cout << "moving " << percent << "% of the traffic of '" << name
+            << "' from version " << rollout.from_version_ << " to version "
+            << rollout.to_version_ << std::endl;
+  if (percent >= 100) {
+    // Done, the latest version serves everything again.
+    slot->traffic_.clear();
+    slot->rollout_ = Rollout();
+  } else {
+    slot->traffic_.clear();
+    slot->traffic_[rollout.from_version_] = 100 - percent;
+    slot->traffic_[rollout.to_version_] = percent;
+    rollout.next_step_ns_ = CaptureTimeNs() + rollout.interval_ns_;
+  }
+  RemoveIdleVersions(slot, retired);
+}
+
+void ModelRepositoryManager::RemoveIdleVersions(ModelSlot* slot,
+                                                std::vector<std::shared_ptr<Model>>* retired) {
+  for (auto itr = slot->retiring_.begin(); itr != slot->retiring_.end();) {
+    if (slot->traffic_.find(*itr) != slot->traffic_.end()) {
+      ++itr;
+      continue;
+    }
+    const auto vitr = slot->versions_.find(*itr);
+    if (vitr != slot->versions_.end()) {
+      retired->push_back(std::move(vitr->second));
+      slot->versions_.erase(vitr);
+    }
+    slot->states_.erase(*itr);
+    itr = slot->retiring_.erase(itr);
+  }
+}
+
+void ModelRepositoryManager::RetireModels(std::vector<std::shared_ptr<Model>>&& models) {
+  if (models.empty()) {
+    return;
+  }
+  // A retired model rejects new requests but finishes the ones it has
+  // accepted. It is released by the lifecycle thread once drained, so
+  // that the model is never destroyed by one of its own backend threads.
+  for (const auto& model : models) {
+    model->Stop();
+  }
+  {
+    std::lock_guard<std::mutex> lock(lifecycle_mu_);
+    for (auto& model : models) {
+      draining_.push_back(std::move(model));
+    }
+    lifecycle_changed_ = true;
+  }
+  models.clear();
+  lifecycle_cv_.notify_one();
+}
+
+void ModelRepositoryManager::WakeLifecycleThread() {
+  {
+    std::lock_guard<std::mutex> lock(lifecycle_mu_);
+    lifecycle_changed_ = true;
+  }
+  lifecycle_cv_.notify_one();
+}
+
+uint64_t ModelRepositoryManager::AdvanceRollouts() {
+  const uint64_t now_ns = CaptureTimeNs();
+  uint64_t due_ns = std::numeric_limits<uint64_t>::max();
+  std::vector<std::shared_ptr<Model>> retired;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    for (auto& pr : models_) {
+      auto& slot = pr.second;
+      if (slot.rollout_.Active() && (now_ns >= slot.rollout_.next_step_ns_)) {
+        StepRollout(pr.first, &slot, &retired);
+      }
+      if (slot.rollout_.Active()) {
+        due_ns = std::min(due_ns, slot.rollout_.next_step_ns_);
+      }
+    }
+  }
+  RetireModels(std::move(retired));
+  return due_ns;
+}
+
+uint64_t ModelRepositoryManager::UnloadIdleModels() {
+  uint64_t due_ns = std::numeric_limits<uint64_t>::max();
+  if (!load_options_.on_demand_ || (load_options_.idle_unload_timeout_ms_ == 0)) {
+    return due_ns;
+  }
+  const uint64_t now_ns = CaptureTimeNs();
+  const uint64_t timeout_ns = load_options_.idle_unload_timeout_ms_ * 1000 * 1000;
+  std::vector<std::shared_ptr<Model>> retired;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    for (auto& pr : models_) {
+      auto& slot = pr.second;
+      if (slot.versions_.empty() || slot.loading_) {
+        continue;
+      }
+      const uint64_t idle_ns = slot.last_used_ns_ + timeout_ns;
+      if (now_ns >= idle_ns) {
+        EvictModel(pr.first, "after being idle", &slot, &retired);
+      } else {
+        due_ns = std::min(due_ns, idle_ns);
+      }
+    }
+  }
+  RetireModels(std::move(retired));
+  return due_ns;
+}
+
+void ModelRepositoryManager::LifecycleThread() {
+  std::unique_lock<std::mutex> lock(lifecycle_mu_);
+  // When the next rollout step or idle unload is due.
+  uint64_t due_ns = std::numeric_limits<uint64_t>::max();
+  // When the models still draining at shutdown are released anyway.
+  uint64_t give_up_ns = 0;
+  while (!exiting_ || !draining_.empty()) {
+    // Sleep until something is due, or until the rollouts, the models
+    // loaded on demand or the draining models change.
+    uint64_t wake_ns = due_ns;
+    if (!draining_.empty()) {
+      wake_ns = std::min(wake_ns, CaptureTimeNs() + kDrainPollMs * 1000 * 1000);
+    }
+    if (wake_ns == std::numeric_limits<uint64_t>::max()) {
+      lifecycle_cv_.wait(lock, [this] { return lifecycle_changed_; });
+    } else {
+      const uint64_t now_ns = CaptureTimeNs();
+      if (now_ns < wake_ns) {
+        lifecycle_cv_.wait_for(lock, std::chrono::nanoseconds(wake_ns - now_ns),
+                               [this] { return lifecycle_changed_; });
+      }
+    }
+    lifecycle_changed_ = false;
+    std::vector<std::shared_ptr<Model>> drained;
+    for (auto itr = draining_.begin(); itr != draining_.end();) {
+      if ((*itr)->InflightInferenceCount() == 0) {
+        drained.push_back(std::move(*itr));
+        itr = draining_.erase(itr);
+      } else {
+        ++itr;
+      }
+    }
+    const bool exiting = exiting_;
+    if (exiting && !draining_.empty()) {
+      const uint64_t now_ns = CaptureTimeNs();
+      if (give_up_ns == 0) {
+        give_up_ns = now_ns + load_options_.drain_timeout_ms_ * 1000 * 1000;
+      }
+      // A request stuck in a backend must not hang the shutdown, its
+      // model then goes with the last reference the requests hold.
+      if (now_ns >= give_up_ns) {
+        std::cerr << "releasing " << draining_.size() << " model(s) with requests "
+                  << "still in flight after " << load_options_.drain_timeout_ms_
+                  << " ms" << std::endl;
+        for (auto& model : draining_) {
+          drained.push_back(std::move(model));
+        }
+        draining_.clear();
+      }
+    }
+    lock.unlock();
+    // The manager's references are dropped here, a model is destroyed
+    // unless a client still holds it.
+    drained.clear();
+    if (!exiting) {
+      due_ns = std::min(AdvanceRollouts(), UnloadIdleModels());
+    }
+    lock.lock();
+  }
+}
+
+Status ModelRepositoryManager::UpdateInstanceGroups(const std::string& name,
+                                                    const ModelInfo& info,
+                                                    const std::set<int64_t>& versions,
+                                                    bool* updated) {
+  *updated = false;
+  std::vector<std::shared_ptr<Model>> models;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    const auto itr = models_.find(name);
+    if (itr == models_.end()) {
+      return Status::Success;
+    }
+    const auto& slot = itr->second;
+    // Only the same versions of the same model files with a configuration
+    // differing in the instance groups alone can be updated in place.
+    if (slot.versions_.empty() || (slot.versions_.size() != versions.size()) ||
+        (slot.fingerprint_.files_hash_ != info.fingerprint_.files_hash_) ||
+        !EquivalentInNonInstanceGroupConfig(slot.config_, info.model_config_)) {
+      return Status::Success;
+    }
+    for (const auto& pr : slot.versions_) {
+      if ((versions.find(pr.first) == versions.end()) ||
+          (dynamic_cast<BackendModel*>(pr.second.get()) == nullptr)) {
+        return Status::Success;
+      }
+      models.push_back(pr.second);
+    }
+  }
+  // The versions keep serving with their current instances while the
+  // new ones are created. A version that fails to update keeps its
+  // current instances.
+  *updated = true;
+  Status status;
+  for (const auto& model : models) {
+    Status model_status = static_cast<BackendModel*>(model.get())->UpdateInstanceGroup(
+        info.model_config_);
+    if (!model_status.IsOk()) {
+      std::cerr << "failed to update instance group of '" << name
+                << "' version " << model->Version() << ": "
+                << model_status.Message() << std::endl;
+      status = model_status;
+    }
+  }
+  if (status.IsOk()) {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto& slot = models_[name];
+    slot.fingerprint_ = info.fingerprint_;
+    slot.config_ = info.model_config_;
+  }
+  return status;
+}
+
+Status ModelRepositoryManager::CreateModel(const ModelInfo& info,
+                                           const int64_t version,
+                                           std::unique_ptr<Model>* model) {
+  const auto& config = info.model_config_;
+  if ((config.platform() == kEnsemblePlatform) || config.has_ensemble_scheduling()) {
+    return EnsembleModel::Create(server_, info.model_path_, version, config,
+                                 info.is_config_provided_, model);
+  }
+  std::unique_ptr<BackendModel> backend_model;
+  RETURN_IF_ERROR(BackendModel::Create(server_, info.model_path_,
+                                       backend_cmdline_config_map_,
+                                       host_policy_map_, version, config,
+                                       info.is_config_provided_, &backend_model));
+  *model = std::move(backend_model);
+  return Status::Success;
+}
+
+void ModelRepositoryManager::SetModelFailed(const std::string& name,
+                                            const std::string& reason) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto& slot = models_[name];
+  if (slot.states_.empty()) {
+    slot.states_[-1] = std::make_pair(ModelReadyState::UNAVAILABLE, reason);
+    return;
+  }
+  for (auto& pr : slot.states_) {
+    if (slot.versions_.find(pr.first) == slot.versions_.end()) {
+      pr.second = std::make_pair(ModelReadyState::UNAVAILABLE, reason);
+    }
+  }
+}
+
+void ModelRepositoryManager::UnloadModel(const std::string& name) {
+  ModelSlot slot;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    const auto itr = models_.find(name);
+    if (itr == models_.end()) {
+      return;
+    }
+    slot = std::move(itr->second);
+    models_.erase(itr);
+  }
+  // The requests already accepted by the versions are completed before
+  // the versions are released.
+  if (slot.versions_.empty()) {
+    return;
+  }
+  std::vector<std::shared_ptr<Model>> retired;
+  for (auto& pr : slot.versions_) {
+    retired.push_back(std::move(pr.second));
+  }
+  RetireModels(std::move(retired));
+  std::cout << "successfully unloaded '" << name << "'" << std::endl;
+}
+
+Status ModelRepositoryManager::UnloadAllModels() {
+  std::set<std::string> names;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    for (const auto& pr : models_) {
+      names.insert(pr.first);
+    }
+  }
+  for (const auto& name : names) {
+    UnloadModel(name);
+  }
+  return Status::Success;
+}
+
+const ModelRepositoryManager::ModelStateMap ModelRepositoryManager::ModelStates() {
+  ModelStateMap states;
+  std::lock_guard<std::mutex> lock(mu_);
+  for (const auto& pr : models_) {
+    states.emplace(pr.first, pr.second.states_);
+  }
+  return states;
+}
+
+Status ModelRepositoryManager::GetModel(const std::string& model_name,
+                                        const int64_t model_version,
+                                        std::shared_ptr<Model>* model) {
+  std::unique_lock<std::mutex> lock(mu_);
+  auto itr = models_.find(model_name);
+  if (load_options_.on_demand_) {
+    if ((itr == models_.end()) || itr->second.versions_.empty()) {
+      RETURN_IF_ERROR(LoadModelOnDemand(model_name, &lock));
+      itr = models_.find(model_name);
+    }
+    if (itr != models_.end()) {
+      itr->second.last_used_ns_ = CaptureTimeNs();
+    }
+  }
+  if ((itr == models_.end()) || itr->second.versions_.empty()) {
+    auto msg = "model '" + model_name + "' is not available";
+    return Status(Status::Code::UNAVAILABLE, msg);
+  }
+  const auto& versions = itr->second.versions_;
+  if (model_version == -1) {
+    *model = versions.rbegin()->second;
+    const auto& traffic = itr->second.traffic_;
+    if (!traffic.empty()) {
+      uint64_t total_weight = 0;
+      for (const auto& pr : traffic) {
+        total_weight += pr.second;
+      }
+      thread_local std::mt19937_64 generator(std::random_device{}());
+      uint64_t pick = std::uniform_int_distribution<uint64_t>(0, total_weight - 1)(generator);
+      for (const auto& pr : traffic) {
+        if (pick < pr.second) {
+          const auto vitr = versions.find(pr.first);
+          if (vitr != versions.end()) {
+            *model = vitr->second;
+          }
+          break;
+        }
+        pick -= pr.second;
+      }
+    }
+    return Status::Success;
+  }
+  const auto vitr = versions.find(model_version);
+  if (vitr == versions.end()) {
+    auto msg = "model '" + model_name + "' version " +
+               std::to_string(model_version) + " is not available";
+    return Status(Status::Code::UNAVAILABLE, msg);
+  }
+  *model = vitr->second;
+  return Status::Success;
+}
+
+Status ModelRepositoryManager::SetVersionTraffic(const std::string& model_name,
+                                                const VersionWeightMap& weights) {
+  std::vector<std::shared_ptr<Model>> retired;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    const auto itr = models_.find(model_name);
+    if ((itr == models_.end()) || itr->second.versions_.empty()) {
+      auto msg = "model '" + model_name + "' is not available";
+      return Status(Status::Code::UNAVAILABLE, msg);
+    }
+    auto& slot = itr->second;
+    VersionWeightMap traffic;
+    for (const auto& pr : weights) {
+      if (slot.versions_.find(pr.first) == slot.versions_.end()) {
+        auto msg = "model '" + model_name + "' version " +
+                   std::to_string(pr.first) + " is not available";
+        return Status(Status::Code::INVALID_ARG, msg);
+      }
+      if (pr.second > 0) {
+        traffic.emplace(pr.first, pr.second);
+      }
+    }
+    if (!weights.empty() && traffic.empty()) {
+      auto msg = "at least one version of model '" + model_name +
+                 "' must have a non-zero weight";
+      return Status(Status::Code::INVALID_ARG, msg);
+    }
+    slot.traffic_.swap(traffic);
+    slot.rollout_ = Rollout();
+    RemoveIdleVersions(&slot, &retired);
+  }
+  RetireModels(std::move(retired));
+  return Status::Success;
+}
+
+Status ModelRepositoryManager::VersionTraffic(const std::string& model_name,
+                                             VersionWeightMap* weights) {
+  std::lock_guard<std::mutex> lock(mu_);
+  const auto itr = models_.find(model_name);
+  if (itr == models_.end()) {
+    auto msg = "model '" + model_name + "' is not available";
+    return Status(Status::Code::UNAVAILABLE, msg);
+  }
+  *weights = itr->second.traffic_;
+  return Status::Success;
+}
+
+Status ModelRepositoryManager::GetMemoryUsage(const std::string& model_name,
+                                             std::map<int64_t, ModelMemoryUsage>* usage) {
+  usage->clear();
+  std::map<int64_t, std::shared_ptr<Model>> models;
+  RETURN_IF_ERROR(GetLoadedVersions(model_name, &models));
+  for (const auto& pr : models) {
+    pr.second->GetMemoryUsage(&(*usage)[pr.first]);
+  }
+  return Status::Success;
+}
+
+Status ModelRepositoryManager::GetLoadedVersions(
+    const std::string& model_name, std::map<int64_t, std::shared_ptr<Model>>* models) {
+  models->clear();
+  std::lock_guard<std::mutex> lock(mu_);
+  const auto itr = models_.find(model_name);
+  if (itr == models_.end()) {
+    auto msg = "model '" + model_name + "' is not available";
+    return Status(Status::Code::UNAVAILABLE, msg);
+  }
+  *models = itr->second.versions_;
+  return Status::Success;
+}
+
+} // namespace core
@@ -0,0 +1,427 @@
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "model.h"
+#include "status.h"
+#include "constants.h"
+#include "model_config.h"
+#include "repository_watcher.h"
+
+namespace core {
+
+class InferenceServer;
+
+// Readiness status for models.
+enum class ModelReadyState {
+  // The model is in an unknown state. The model is not available for
+  // inferencing.
+  UNKNOWN,
+
+  // The model is ready and available for inferencing.
+  READY,
+
+  // The model is unavailable, indicating that the model failed to
+  // load or has been implicitly or explicitly unloaded. The model is
+  // not available for inferencing.
+  UNAVAILABLE,
+
+  // The model is being loaded by the inference server. The model is
+  // not available for inferencing.
+  LOADING,
+
+  // The model is being unloaded by the inference server. The model is
+  // not available for inferencing.
+  UNLOADING
+};
+
+/// Get the string representation for a ModelReadyState
+const char* ModelReadyStateString(ModelReadyState state);
+
+// A cheap summary of the content of a model directory, used to tell
+// whether a model has to be reloaded without parsing its configuration.
+struct ModelFingerprint {
+  // The most recent modification time of anything in the model directory.
+  int64_t mtime_ns_ = 0;
+  // The total size of the files in the model directory.
+  uint64_t size_ = 0;
+  // Hash of the configuration content and of the path, size and
+  // modification time of every entry below the model directory.
+  uint64_t hash_ = 0;
+  // Same as 'hash_' but leaving out the configuration, it only changes
+  // when the model files change.
+  uint64_t files_hash_ = 0;
+
+  bool operator==(const ModelFingerprint& rhs) const {
+    return (mtime_ns_ == rhs.mtime_ns_) && (size_ == rhs.size_) &&
+           (hash_ == rhs.hash_) && (files_hash_ == rhs.files_hash_);
+  }
+  bool operator!=(const ModelFingerprint& rhs) const { return !(*this == rhs); }
+};
+
+// How the models found in the repositories are loaded.
+struct ModelLoadOptions {
+  // Only register the models found in the repositories and load a model
+  // when it is first requested.
+  bool on_demand_ = false;
+  // Unload a model loaded on demand once it has not been requested for
+  // this long, 0 keeps it loaded.
+  uint64_t idle_unload_timeout_ms_ = 0;
+  // Unload the least recently requested models to keep the memory of the
+  // models loaded on demand within this many bytes, 0 for no budget.
+  uint64_t memory_budget_bytes_ = 0;
+  // How long the manager waits at shutdown for the requests in flight
+  // of the unloaded models, the models are released anyway afterwards.
+  uint64_t drain_timeout_ms_ = 30000;
+};
+
+// Scans the model repositories and owns the models found there. Models
+// are loaded concurrently, an ensemble is only loaded once all the models
+// it is composed of are done loading. Ensembles are checked but not served,
+// see EnsembleModel.
+class ModelRepositoryManager {
+ public:
+  // Map from version to the state and the reason of that state.
+  using VersionStateMap = std::map<int64_t, std::pair<ModelReadyState, std::string>>;
+  // Map from model name to the states of its versions.
+  using ModelStateMap = std::map<std::string, VersionStateMap>;
+  // Map from version to its share of the requests that do not ask for a
+  // specific version.
+  using VersionWeightMap = std::map<int64_t, uint32_t>;
+
+  /// Create a manager for the given repositories and load all the
+  /// models found in them.
+  /// \param server The server that owns the models.
+  /// \param repository_paths The paths of the model repositories.
+  /// \param backend_cmdline_config_map The backend command line configs.
+  /// \param host_policy_map The host policy command line configs.
+  /// \param model_load_thread_count The number of models that may be
+  /// loaded at the same time.
+  /// \param load_options Whether and how models are loaded on demand.
+  /// \param model_repository_manager Returns the manager.
+  /// \return The error status.
+  static Status Create(InferenceServer* server,
+                       const std::set<std::string>& repository_paths,
+                       const BackendCmdlineConfigMap& backend_cmdline_config_map,
+                       const HostPolicyCmdlineConfigMap& host_policy_map,
+                       const size_t model_load_thread_count,
+                       const ModelLoadOptions& load_options,
+                       std::unique_ptr<ModelRepositoryManager>* model_repository_manager);
+  virtual ~ModelRepositoryManager();
+
+  // Poll the model repositories and compare the models found with the
+  // models currently served. Load the models that were added, reload
+  // the ones whose fingerprint changed (and the ensembles depending on
+  // them) and unload the ones that were removed. When the repositories
+  // are watched only the models touched since the last poll are
+  // revisited.
+  Status PollAndUpdate();
+
+  // Unload all the models served by the manager.
+  Status UnloadAllModels();
+
+  // Return the states of all the models known to the manager.
+  const ModelStateMap ModelStates();
+
+  // Get the model of 'model_name' with 'model_version'. If the version
+  // is -1 the version is picked according to the version traffic of the
+  // model, the latest ready version by default. A model loaded on demand
+  // is loaded by the first request, concurrent requests wait for that
+  // same load.
+  Status GetModel(const std::string& model_name,
+                  const int64_t model_version,
+                  std::shared_ptr<Model>* model);
+
+  // Spread the requests of 'model_name' that do not ask for a version
+  // over its loaded versions by weight. An empty map sends them all to
+  // the latest version again. Setting the traffic stops a rollout in
+  // progress, the versions it was retiring are unloaded once they no
+  // longer receive traffic.
+  Status SetVersionTraffic(const std::string& model_name,
+                           const VersionWeightMap& weights);
+
+  // Get the version traffic of 'model_name', empty if all the requests
+  // go to the latest version.
+  Status VersionTraffic(const std::string& model_name, VersionWeightMap* weights);
+
+  // Get the memory used by each loaded version of 'model_name'. A model
+  // that is registered but not loaded has no versions.
+  Status GetMemoryUsage(const std::string& model_name,
+                        std::map<int64_t, ModelMemoryUsage>* usage);
+
+  // Get the loaded versions of 'model_name' by version. A model that is
+  // registered but not loaded has no versions.
+  Status GetLoadedVersions(const std::string& model_name,
+                           std::map<int64_t, std::shared_ptr<Model>>* models);
+
+ protected:
+  // A model as found in one of the repositories.
+  struct ModelInfo {
+    // Path to the model directory.
+    std::string model_path_;
+    // The fingerprint of the model directory.
+    ModelFingerprint fingerprint_;
+    // The model configuration read from the repository.
+    inference::ModelConfig model_config_;
+    // Whether the configuration was read from 'config.pbtxt'.
+    bool is_config_provided_ = false;
+  };
+
+  ModelRepositoryManager(InferenceServer* server,
+                         const std::set<std::string>& repository_paths,
+                         const BackendCmdlineConfigMap& backend_cmdline_config_map,
+                         const HostPolicyCmdlineConfigMap& host_policy_map,
+                         const size_t model_load_thread_count,
+                         const ModelLoadOptions& load_options)
+    : server_(server),
+      repository_paths_(repository_paths),
+      backend_cmdline_config_map_(backend_cmdline_config_map),
+      host_policy_map_(host_policy_map),
+      model_load_thread_count_(model_load_thread_count),
+      load_options_(load_options),
+      scanned_(false),
+      lifecycle_changed_(false),
+      exiting_(false) {}
+
+  // Start the lifecycle thread and the repository watcher and load the
+  // models found in the repositories.
+  Status Start();
+
+  // Create the model of a single version, an ensemble or a model served
+  // by a backend.
+  virtual Status CreateModel(const ModelInfo& info,
+                             const int64_t version,
+                             std::unique_ptr<Model>* model);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ModelRepositoryManager);
+
+  using ModelInfoMap = std::map<std::string, ModelInfo>;
+
+  // Moves the unversioned traffic of a model from the version that was
+  // the latest to the newly loaded latest version in steps.
+  struct Rollout {
+    int64_t from_version_ = -1;
+    int64_t to_version_ = -1;
+    // The share of the traffic in percent the new version gets at each
+    // step, the last step is 100.
+    std::vector<uint32_t> steps_;
+    size_t next_step_ = 0;
+    uint64_t interval_ns_ = 0;
+    uint64_t next_step_ns_ = 0;
+
+    bool Active() const { return next_step_ < steps_.size(); }
+  };
+
+  // The loaded versions of a model.
+  struct ModelSlot {
+    std::map<int64_t, std::shared_ptr<Model>> versions_;
+    VersionStateMap states_;
+    // The fingerprint and configuration the versions were loaded from.
+    ModelFingerprint fingerprint_;
+    inference::ModelConfig config_;
+    // The weights of the versions serving unversioned requests, empty if
+    // the latest version serves them all.
+    VersionWeightMap traffic_;
+    // Versions no longer selected by the version policy that keep
+    // serving until the traffic has moved away from them.
+    std::set<int64_t> retiring_;
+    Rollout rollout_;
+    // The latest information found in the repositories, a model loaded on
+    // demand is loaded from it.
+    ModelInfo info_;
+    // Whether an on-demand load of the model is in progress.
+    bool loading_ = false;
+    // Whether the last on-demand load failed, the model is not loaded
+    // again until it changes in the repositories.
+    bool load_failed_ = false;
+    // When the model was last requested.
+    uint64_t last_used_ns_ = 0;
+  };
+
+  // Revisit the models in 'names', updating 'infos' with what is now
+  // found in the repositories. Models whose directory cannot be read are
+  // reported and keep their previous information in 'infos', if any.
+  Status Poll(const std::set<std::string>& names, ModelInfoMap* infos);
+
+  // Find the directory of model 'name' in the repositories, 'model_path'
+  // is set to empty if there is none.
+  Status FindModel(const std::string& name, std::string* model_path);
+
+  // Read the model in directory 'path' of the repository. The
+  // configuration is only parsed again if the fingerprint differs from
+  // the previous poll.
+  Status ReadModelInfo(const std::string& name,
+                       const std::string& path,
+                       ModelInfo* info);
+
+  // Record the models in 'names' to be loaded on demand. The models that
+  // are not loaded are removed from 'names', they are loaded from the new
+  // information on their next request.
+  void RegisterModels(const ModelInfoMap& infos, std::set<std::string>* names);
+
+  // Load 'name' for a request unless it is loaded already, waiting for
+  // the load another request started. Must be called with 'lock' held on
+  // 'mu_', the lock is released while the model is loaded.
+  Status LoadModelOnDemand(const std::string& name,
+                           std::unique_lock<std::mutex>* lock);
+
+  // Return true if 'name' depends on 'target', directly or through other
+  // models. Must be called with 'mu_' held.
+  bool DependsOn(const std::string& name,
+                 const std::string& target,
+                 std::set<std::string>* visited);
+
+  // Unload the least recently requested models until 'required_bytes'
+  // more fit in the memory budget, 'name' is never unloaded. Must be
+  // called with 'mu_' held.
+  void EvictForBudget(const std::string& name,
+                      const uint64_t required_bytes,
+                      std::vector<std::shared_ptr<Model>>* retired);
+
+  // Unload the versions of a model loaded on demand, keeping it
+  // registered. Must be called with 'mu_' held.
+  void EvictModel(const std::string& name,
+                  const char* reason,
+                  ModelSlot* slot,
+                  std::vector<std::shared_ptr<Model>>* retired);
+
+  // The memory a model loaded on demand takes, or is expected to take
+  // while it is loading. Must be called with 'mu_' held.
+  static uint64_t ResidentBytes(const ModelSlot& slot);
+
+  // Load the models in 'names'. Models are loaded on the executor of the
+  // server and a model is only started once the models it depends on are
+  // done.
+  void LoadModels(const ModelInfoMap& infos, const std::set<std::string>& names);
+
+  // Load every version of a model selected by its version policy and
+  // make them visible once loaded.
+  Status LoadModel(const std::string& name, const ModelInfo& info);
+
+  // Apply a change limited to the instance groups to the loaded versions
+  // of 'name' without reloading them. 'updated' is set to false if the
+  // change needs a reload.
+  Status UpdateInstanceGroups(const std::string& name,
+                              const ModelInfo& info,
+                              const std::set<int64_t>& versions,
+                              bool* updated);
+
+  // Record that 'name' could not be loaded.
+  void SetModelFailed(const std::string& name, const std::string& reason);
+
+  // Move the unversioned traffic of 'name' to the next step of its
+  // rollout. Must be called with 'mu_' held.
+  void StepRollout(const std::string& name,
+                   ModelSlot* slot,
+                   std::vector<std::shared_ptr<Model>>* retired);
+
+  // Remove the retiring versions of 'slot' that no longer receive traffic
+  // and return them in 'retired'. Must be called with 'mu_' held.
+  void RemoveIdleVersions(ModelSlot* slot,
+                          std::vector<std::shared_ptr<Model>>* retired);
+
+  // Stop 'models' from accepting requests and release them once the
+  // requests already accepted are done.
+  void RetireModels(std::vector<std::shared_ptr<Model>>&& models);
+
+  // Advance the rollouts that are due and release the drained models,
+  // sleeping until the next rollout step or idle unload is due. At
+  // shutdown the models are waited for until the drain timeout.
+  void LifecycleThread();
+  // Make the lifecycle thread look at the models again, their next
+  // rollout step or idle unload may be due earlier than it thinks.
+  void WakeLifecycleThread();
+
+  // Advance the rollouts that are due. Return when the next step is due,
+  // the maximum value if no rollout is in progress.
+  uint64_t AdvanceRollouts();
+
+  // Unload the models loaded on demand that stayed idle for too long.
+  // Return when the next one is due to be unloaded, the maximum value if
+  // none.
+  uint64_t UnloadIdleModels();
+
+  // Stop serving all versions of 'name'.
+  void UnloadModel(const std::string& name);
+
+  // The server object that owns this manager.
+  InferenceServer* server_;
+  const std::set<std::string> repository_paths_;
+  const BackendCmdlineConfigMap backend_cmdline_config_map_;
+  const HostPolicyCmdlineConfigMap host_policy_map_;
+  const size_t model_load_thread_count_;
+  const ModelLoadOptions load_options_;
+
+  // Serializes polls of the repositories.
+  std::mutex poll_mu_;
+  // The models found by the last poll.
+  ModelInfoMap infos_;
+  // Whether the repositories have been fully scanned once.
+  bool scanned_;
+  // Reports the models touched between polls. Null if the platform has
+  // no file system notification, every poll is a full scan then.
+  std::unique_ptr<RepositoryWatcher> watcher_;
+
+  // Protects 'models_'. Never held while a model is being loaded.
+  std::mutex mu_;
+  std::map<std::string, ModelSlot> models_;
+  // Signaled when an on-demand load completes.
+  std::condition_variable load_cv_;
+
+  // Protects 'draining_', 'lifecycle_changed_' and 'exiting_'.
+  std::mutex lifecycle_mu_;
+  std::condition_variable lifecycle_cv_;
+  // The models no longer served that still have requests in flight.
+  std::vector<std::shared_ptr<Model>> draining_;
+  // Whether the lifecycle thread has to look at the models before it
+  // is due to.
+  bool lifecycle_changed_;
+  bool exiting_;
+  std::thread lifecycle_thread_;
+};
+
+/// Get the models a model depends on. Only an ensemble has dependencies.
+/// \param config The model configuration.
+/// \return The names of the models 'config' depends on.
+std::set<std::string> GetModelDependencies(const inference::ModelConfig& config);
+
+/// Compute the fingerprint of a model directory. Only the configuration
+/// is read, the other files only contribute their metadata.
+/// \param model_path The path to the model directory.
+/// \param fingerprint Returns the fingerprint.
+/// \return The error status.
+Status GetModelFingerprint(const std::string& model_path,
+                           ModelFingerprint* fingerprint);
+
+/// Get how the unversioned traffic moves to a new latest version of a
+/// model, from the "version_traffic_steps" parameter, a comma separated
+/// list of increasing percentages such as "1,10,100", and the
+/// "version_traffic_step_interval_ms" parameter.
+/// \param config The model configuration.
+/// \param steps Returns the percentages, ending with 100. Empty if the
+/// traffic moves at once.
+/// \param interval_ms Returns the time between two steps.
+/// \return The error status.
+Status GetVersionTrafficSteps(const inference::ModelConfig& config,
+                              std::vector<uint32_t>* steps,
+                              uint64_t* interval_ms);
+
+/// Get the versions of a model to be loaded according to its version
+/// policy.
+/// \param model_path The path to the model directory.
+/// \param config The model configuration.
+/// \param versions Returns the versions to be loaded.
+/// \return The error status.
+Status GetVersionsToLoad(const std::string& model_path,
+                         const inference::ModelConfig& config,
+                         std::set<int64_t>* versions);
+
+} // namespace core
@@ -0,0 +1,200 @@
+#include "payload.h"
+
+#include <algorithm>
+
+#include "backend_model.h"
+#include "backend_model_instance.h"
+#include "time_utils.h"
+
+namespace core {
+
+Payload::Payload()
+  : op_type_(Operation::INFER_RUN),
+    state_(State::UNINITIALIZED),
+    instance_(nullptr),
+    batch_size_(0),
+    exec_ns_(0),
+    gather_inputs_(false),
+    gathered_input_count_(0),
+    executed_(false) {}
+
+void Payload::Reset(const Operation op_type, BackendModelInstance* instance) {
+  op_type_ = op_type;
+  state_ = State::READY;
+  instance_ = instance;
+  requests_.clear();
+  backend_requests_.clear();
+  trace_ids_.clear();
+  batch_size_ = 0;
+  exec_ns_ = 0;
+  on_callback_ = nullptr;
+  release_callbacks_.clear();
+  gather_inputs_ = false;
+  gathered_input_count_ = 0;
+  std::lock_guard<std::mutex> lock(status_mu_);
+  executed_ = false;
+  status_ = Status::Success;
+}
+
+void Payload::AddRequest(std::unique_ptr<InferenceRequest> request) {
+  batch_size_ += std::max(1U, request->BatchSize());
+  if (gather_inputs_) {
+    GatherInputs(*request);
+  }
+  backend_requests_.push_back(reinterpret_cast<BACKEND_Request*>(request.get()));
+  requests_.push_back(std::move(request));
+}
+
+void Payload::GatherInputs(const InferenceRequest& request) {
+  for (const auto& input : request.Inputs()) {
+    GatheredInputData* gathered = nullptr;
+    for (size_t i = 0; i < gathered_input_count_; ++i) {
+      if (gathered_inputs_[i].name_ == input.Name()) {
+        gathered = &gathered_inputs_[i];
+        break;
+      }
+    }
+    if (gathered == nullptr) {
+      if (gathered_input_count_ == gathered_inputs_.size()) {
+        gathered_inputs_.emplace_back();
+      }
+      gathered = &gathered_inputs_[gathered_input_count_++];
+      gathered->name_ = input.Name();
+      gathered->data_.clear();
+      gathered->request_count_ = 0;
+      gathered->gathered_ = true;
+    }
+    ++gathered->request_count_;
+    if (!gathered->gathered_) {
+      continue;
+    }
+    for (const auto& buffer : input.Buffers()) {
+      if ((buffer.memory_type_ != SERVER_MEMORY_CPU) &&
+          (buffer.memory_type_ != SERVER_MEMORY_CPU_PINNED)) {
+        gathered->gathered_ = false;
+        gathered->data_.clear();
+        break;
+      }
+      const char* base = reinterpret_cast<const char*>(buffer.base_);
+      gathered->data_.insert(gathered->data_.end(), base, base + buffer.byte_size_);
+    }
+  }
+}
+
+Status Payload::GatheredInput(const std::string& name, const void** buffer,
+                              size_t* byte_size) const {
+  for (size_t i = 0; i < gathered_input_count_; ++i) {
+    const GatheredInputData& gathered = gathered_inputs_[i];
+    if (gathered.name_ != name) {
+      continue;
+    }
+    if (!gathered.gathered_ || (gathered.request_count_ != backend_requests_.size())) {
+      break;
+    }
+    *buffer = gathered.data_.data();
+    *byte_size = gathered.data_.size();
+    return Status::Success;
+  }
+  return Status(Status::Code::UNAVAILABLE, "input '" + name + "' of the batch is not gathered");
+}
+
+void Payload::Callback() {
+  if (on_callback_) {
+    on_callback_();
+  }
+}
+
+void Payload::AddInternalReleaseCallback(std::function<void()>&& callback) {
+  release_callbacks_.emplace_back(std::move(callback));
+}
+
+void Payload::OnRelease() {
+  // Invoke the release callbacks added internally before releasing the
+  // request to user provided callback.
+  for (auto it = release_callbacks_.rbegin(); it != release_callbacks_.rend(); it++) {
+    (*it)();
+  }
+  release_callbacks_.clear();
+}
+
+void Payload::DropCancelledRequests() {
+  if (std::none_of(requests_.begin(), requests_.end(),
+                   [](const std::unique_ptr<InferenceRequest>& request) {
+                     return request->IsCancelled();
+                   })) {
+    return;
+  }
+  // Gather the batch again without the cancelled requests.
+  std::vector<std::unique_ptr<InferenceRequest>> requests;
+  requests.swap(requests_);
+  backend_requests_.clear();
+  batch_size_ = 0;
+  gathered_input_count_ = 0;
+  for (auto& request : requests) {
+    if (request->IsCancelled()) {
+      InferenceRequest::RespondIfError(
+          request, Status(Status::Code::CANCELLED, "request was cancelled"),
+          true /* release_request */);
+    } else {
+      AddRequest(std::move(request));
+    }
+  }
+}
+
+void Payload::Execute(bool* should_exit) {
+  *should_exit = false;
+  Status status;
+  switch (op_type_) {
+    case Operation::INFER_RUN: {
+      DropCancelledRequests();
+      // A batch whose requests were all cancelled has nothing to execute.
+      if (backend_requests_.empty()) {
+        break;
+      }
+      // Ownership of the gathered requests goes to the backend.
+      const uint32_t trace_name_id = instance_->Model()->TraceNameId();
+      for (auto& request : requests_) {
+        if (request->TraceId() != 0) {
+          trace_ids_.push_back(request->TraceId());
+          InferenceTracer::Record(request->TraceId(), TraceActivity::COMPUTE_START, trace_name_id);
+        }
+        request.release();
+      }
+      requests_.clear();
+      const uint64_t start_ns = CaptureTimeNs();
+      status = instance_->Schedule(backend_requests_, this);
+      exec_ns_ = CaptureTimeNs() - start_ns;
+      for (const uint64_t trace_id : trace_ids_) {
+        InferenceTracer::Record(trace_id, TraceActivity::COMPUTE_END, trace_name_id);
+      }
+      trace_ids_.clear();
+      // The requests carry no tensor shapes, all batches share a bucket.
+      // A failed execution says nothing of the time a batch takes.
+      if (status.IsOk()) {
+        instance_->Model()->ExecEstimator().Record(instance_, batch_size_, 0, exec_ns_);
+      }
+      backend_requests_.clear();
+      break;
+    }
+    case Operation::INIT:
+      status = instance_->Initialize();
+      break;
+    case Operation::EXIT:
+      *should_exit = true;
+      break;
+  }
+  {
+    std::lock_guard<std::mutex> lock(status_mu_);
+    executed_ = true;
+    status_ = status;
+  }
+  status_cv_.notify_all();
+}
+
+Status Payload::Wait() {
+  std::unique_lock<std::mutex> lock(status_mu_);
+  status_cv_.wait(lock, [this]() { return executed_; });
+  return status_;
+}
+
+} // namespace core
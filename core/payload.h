@@ -0,0 +1,135 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "status.h"
+#include "infer_request.h"
+
+struct BACKEND_Request;
+
+namespace core {
+
+class BackendModelInstance;
+
+// A unit of work handed from a scheduler to a model instance through
+// the rate limiter. An INFER_RUN payload carries a batch of requests,
+// the other operations manage the lifetime of the instance that
+// executes them.
+class Payload {
+ public:
+  enum Operation { INFER_RUN = 0, INIT = 1, EXIT = 2 };
+  enum State {
+    UNINITIALIZED = 0,
+    READY = 1,
+    REQUESTED = 2,
+    SCHEDULED = 3,
+    EXECUTING = 4,
+    RELEASED = 5
+  };
+
+  Payload();
+
+  // Prepare the payload for a new operation. A payload for a specific
+  // instance is only executed by that instance, otherwise any instance
+  // of the model may pick it up.
+  void Reset(const Operation op_type, BackendModelInstance* instance = nullptr);
+
+  Operation GetOpType() const { return op_type_; }
+  State GetState() const { return state_; }
+  void SetState(State state) { state_ = state; }
+  BackendModelInstance* GetInstance() const { return instance_; }
+  void SetInstance(BackendModelInstance* instance) { instance_ = instance; }
+
+  // The number of requests and the total batch size of the payload.
+  size_t RequestCount() const { return requests_.size(); }
+  size_t BatchSize() const { return batch_size_; }
+  // Add 'request' to the batch. The request is gathered for the backend
+  // right away, on the thread forming the batch, so that the instance
+  // finds the batch ready while it executes the previous one.
+  void AddRequest(std::unique_ptr<InferenceRequest> request);
+
+  // Copy the inputs of the requests added from now on into the buffers
+  // of the payload, see GatheredInput().
+  void SetGatherInputs(const bool gather_inputs) { gather_inputs_ = gather_inputs; }
+  // Get the data of input 'name' of all the requests of the batch,
+  // concatenated in the order of the requests. UNAVAILABLE if the input
+  // was not gathered for every request.
+  Status GatheredInput(const std::string& name, const void** buffer,
+                       size_t* byte_size) const;
+
+  // Set the callback invoked once an instance takes the payload.
+  void SetCallback(std::function<void()> on_callback) {
+    on_callback_ = std::move(on_callback);
+  }
+  void Callback();
+
+  // Add a callback invoked once the payload is released after its
+  // execution.
+  void AddInternalReleaseCallback(std::function<void()>&& callback);
+  void OnRelease();
+
+  // Execute the operation on the instance. 'should_exit' is set if the
+  // instance must stop taking payloads.
+  void Execute(bool* should_exit);
+
+  // Release the requests cancelled since they were added to the batch.
+  // Execute() does so before the batch goes to the instance.
+  void DropCancelledRequests();
+
+  // The time the instance took to execute the batch.
+  uint64_t ExecNs() const { return exec_ns_; }
+
+  // Wait for the operation to be executed and return its status.
+  Status Wait();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Payload);
+
+  // An input of the batch gathered into one buffer in CPU memory.
+  struct GatheredInputData {
+    std::string name_;
+    std::vector<char> data_;
+    // The requests the input was gathered from, the input is only usable
+    // if that is all of them.
+    size_t request_count_;
+    // False once a request held the input outside of CPU memory.
+    bool gathered_;
+  };
+
+  // Append the inputs of 'request' to the gathered inputs.
+  void GatherInputs(const InferenceRequest& request);
+
+  Operation op_type_;
+  State state_;
+  BackendModelInstance* instance_;
+  std::vector<std::unique_ptr<InferenceRequest>> requests_;
+  // The requests as handed to the backend. The payload owns them through
+  // 'requests_' until it is executed. The buffers keep their capacity
+  // when the payload is reused.
+  std::vector<BACKEND_Request*> backend_requests_;
+  // The trace ids of the traced requests of the batch, the requests are
+  // gone once the backend released them.
+  std::vector<uint64_t> trace_ids_;
+  size_t batch_size_;
+  uint64_t exec_ns_;
+  std::function<void()> on_callback_;
+  std::vector<std::function<void()>> release_callbacks_;
+  bool gather_inputs_;
+  // The buffers keep their capacity when the payload is reused, a batch
+  // is gathered into the buffers of its payload while the instance
+  // executes the previous payload out of its own.
+  std::vector<GatheredInputData> gathered_inputs_;
+  size_t gathered_input_count_;
+  // The status of the executed operation, see Wait().
+  std::mutex status_mu_;
+  std::condition_variable status_cv_;
+  bool executed_;
+  Status status_;
+};
+
+} // namespace core
@@ -4,7 +4,7 @@ namespace core {
 
 Status GetSupportedGPUs(std::set<int>* supported_gpus, 
                         const double min_compute_capability) {
-  if (supported_gpus = nullptr) {
+  if (supported_gpus != nullptr) {
     supported_gpus->clear();
 #if defined(NT22) || defined(NT30)
     supported_gpus->insert(0); // npu0
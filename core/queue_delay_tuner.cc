@@ -0,0 +1,139 @@
+#include "queue_delay_tuner.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace core {
+
+namespace {
+constexpr uint64_t kTuneIntervalNs = 500 * 1000 * 1000;
+constexpr size_t kLatencySamples = 1024;
+// The delays tried are this many even steps up to the latency target.
+constexpr size_t kDelaySteps = 32;
+// Among the delays within this fraction of the best throughput the
+// shortest one is picked.
+constexpr double kThroughputTolerance = 0.02;
+// Every this many intervals a batch size larger than any measured is
+// tried, the estimates past the measured sizes are only extrapolated.
+constexpr size_t kExploreIntervals = 8;
+}  // namespace
+
+QueueDelayTuner::QueueDelayTuner(const ExecTimeEstimator* estimator,
+                                 const size_t max_batch_size,
+                                 const uint64_t latency_target_ns,
+                                 const uint64_t initial_delay_ns)
+  : estimator_(estimator),
+    max_batch_size_(std::max<size_t>(1, max_batch_size)),
+    latency_target_ns_(latency_target_ns),
+    delay_ns_(std::min(initial_delay_ns, latency_target_ns)),
+    interval_start_ns_(0),
+    interval_arrivals_(0),
+    arrival_rate_(0),
+    next_latency_(0),
+    slack_(1.0),
+    retune_count_(0) {
+  latencies_ns_.reserve(kLatencySamples);
+}
+
+void QueueDelayTuner::RecordArrival(const uint64_t now_ns) {
+  std::lock_guard<std::mutex> lock(mu_);
+  if (interval_start_ns_ == 0) {
+    interval_start_ns_ = now_ns;
+  }
+  ++interval_arrivals_;
+}
+
+void QueueDelayTuner::RecordLatency(const uint64_t latency_ns, const size_t count) {
+  std::lock_guard<std::mutex> lock(mu_);
+  for (size_t i = 0; i < std::min(count, kLatencySamples); ++i) {
+    if (latencies_ns_.size() < kLatencySamples) {
+      latencies_ns_.push_back(latency_ns);
+    } else {
+      latencies_ns_[next_latency_] = latency_ns;
+      next_latency_ = (next_latency_ + 1) % kLatencySamples;
+    }
+  }
+}
+
+uint64_t QueueDelayTuner::QueueDelayNs(const uint64_t now_ns) {
+  std::lock_guard<std::mutex> lock(mu_);
+  if ((interval_start_ns_ != 0) && (now_ns >= interval_start_ns_ + kTuneIntervalNs)) {
+    Retune(now_ns);
+  }
+  return delay_ns_;
+}
+
+void QueueDelayTuner::Retune(const uint64_t now_ns) {
+  const double rate = static_cast<double>(interval_arrivals_) / (now_ns - interval_start_ns_);
+  arrival_rate_ = (arrival_rate_ == 0) ? rate : arrival_rate_ + (rate - arrival_rate_) / 4;
+  interval_start_ns_ = now_ns;
+  interval_arrivals_ = 0;
+
+  if (!latencies_ns_.empty()) {
+    std::vector<uint64_t> latencies(latencies_ns_);
+    const size_t p99_index = latencies.size() * 99 / 100;
+    std::nth_element(latencies.begin(), latencies.begin() + p99_index, latencies.end());
+    const uint64_t p99_ns = latencies[p99_index];
+    if (p99_ns > latency_target_ns_) {
+      slack_ = std::max(0.05, slack_ * 0.75);
+    } else if (p99_ns < latency_target_ns_ * 3 / 4) {
+      slack_ = std::min(1.0, slack_ * 1.1);
+    }
+    // The latencies count for one interval only, an interval without
+    // completions leaves the slack as it is.
+    latencies_ns_.clear();
+    next_latency_ = 0;
+  }
+
+  // A batch is sent once it is full or its first request waited the
+  // delay, by then the arrival rate brought in about 'rate * delay' more.
+  const double budget_ns = latency_target_ns_ * slack_;
+  // Until a batch of more than one request is measured, and now and then
+  // while the largest size isn't, wait long enough for a larger batch to
+  // form if that fits the budget. A wait that doesn't fit is no use.
+  ++retune_count_;
+  const size_t measured_size = estimator_->LargestBatchSize(nullptr, 0);
+  if ((measured_size < max_batch_size_) &&
+      ((measured_size <= 1) || (retune_count_ % kExploreIntervals == 0))) {
+    const size_t batch_size = std::max<size_t>(2, measured_size + 1);
+    const double delay_ns = (arrival_rate_ > 0) ? (batch_size - 1) / arrival_rate_ : budget_ns;
+    if (delay_ns < budget_ns) {
+      delay_ns_ = static_cast<uint64_t>(delay_ns);
+      return;
+    }
+    if (measured_size == 0) {
+      delay_ns_ = 0;
+      return;
+    }
+  }
+  double best_throughput = 0;
+  std::vector<std::pair<uint64_t, double>> candidates;
+  for (size_t step = 0; step <= kDelaySteps; ++step) {
+    const uint64_t delay_ns = latency_target_ns_ * step / kDelaySteps;
+    const size_t batch_size = std::min<size_t>(
+        max_batch_size_, 1 + static_cast<size_t>(arrival_rate_ * delay_ns));
+    // Measured above, the estimate is there.
+    ExecTimeEstimator::Estimate estimate;
+    estimator_->Get(nullptr, batch_size, 0, &estimate);
+    const double exec_ns = std::max(1.0, estimate.mean_ns_);
+    if (delay_ns + exec_ns > budget_ns) {
+      break;
+    }
+    const double throughput = batch_size / exec_ns;
+    candidates.emplace_back(delay_ns, throughput);
+    best_throughput = std::max(best_throughput, throughput);
+  }
+  // Even an immediate batch misses the budget, waiting only adds to it.
+  if (candidates.empty()) {
+    delay_ns_ = 0;
+    return;
+  }
+  for (const auto& candidate : candidates) {
+    if (candidate.second >= best_throughput * (1 - kThroughputTolerance)) {
+      delay_ns_ = candidate.first;
+      break;
+    }
+  }
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <vector>
+
+#include "constants.h"
+#include "exec_time_estimator.h"
+
+namespace core {
+
+// Tunes the time the dynamic batcher lets a request wait for more
+// requests to join its batch. From the arrival rate and the estimated
+// execution time of each batch size, it picks the delay giving the most
+// throughput while the request latency stays within a target, and
+// tightens the choice while the measured p99 latency is above the target.
+// Now and then it waits for a batch larger than any measured, so that
+// the estimates of the larger sizes are measured rather than guessed.
+class QueueDelayTuner {
+ public:
+  // Tune the delay of batches up to 'max_batch_size' for a p99 latency
+  // of 'latency_target_ns', starting from 'initial_delay_ns'. The
+  // execution times come from 'estimator', which must outlive the tuner.
+  QueueDelayTuner(const ExecTimeEstimator* estimator, const size_t max_batch_size,
+                  const uint64_t latency_target_ns, const uint64_t initial_delay_ns);
+
+  // Record a request arriving at 'now_ns'.
+  void RecordArrival(const uint64_t now_ns);
+
+  // Record 'count' requests completing in 'latency_ns' from their arrival.
+  void RecordLatency(const uint64_t latency_ns, const size_t count);
+
+  // Return the delay to use at 'now_ns', retuned once per interval.
+  uint64_t QueueDelayNs(const uint64_t now_ns);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(QueueDelayTuner);
+
+  // Pick the delay from the measurements of the last interval. Must be
+  // called with 'mu_' held.
+  void Retune(const uint64_t now_ns);
+
+  const ExecTimeEstimator* estimator_;
+  const size_t max_batch_size_;
+  const uint64_t latency_target_ns_;
+
+  std::mutex mu_;
+  uint64_t delay_ns_;
+  uint64_t interval_start_ns_;
+  size_t interval_arrivals_;
+  // The decaying average of the arrivals per nanosecond.
+  double arrival_rate_;
+  // The most recent request latencies of the interval, overwritten in a
+  // ring.
+  std::vector<uint64_t> latencies_ns_;
+  size_t next_latency_;
+  // The fraction of the target the estimated latency may use, lowered
+  // while the measured p99 misses the target.
+  double slack_;
+  // The intervals tuned so far.
+  size_t retune_count_;
+};
+
+}
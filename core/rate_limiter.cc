@@ -0,0 +1,331 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "backend_model.h"
+#include "backend_model_instance.h"
+
+namespace core {
+
+namespace {
+// The cost factor of an instance on another NUMA node than the one the
+// payload was gathered on.
+constexpr double kRemoteNumaPenalty = 1.5;
+
+// The number of released payloads kept for reuse.
+constexpr size_t kMaxPooledPayloads = 64;
+
+// The NUMA node of the calling thread, -1 if unknown.
+int CurrentNumaNode() {
+#ifdef __linux__
+  unsigned cpu = 0, node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return static_cast<int>(node);
+  }
+#endif
+  return -1;
+}
+}  // namespace
+
+Status RateLimiter::Create(std::shared_ptr<RateLimiter>* rate_limiter) {
+  rate_limiter->reset(new RateLimiter());
+  return Status::Success;
+}
+
+Status RateLimiter::RegisterModelInstance(BackendModelInstance* instance,
+                                          const inference::ModelRateLimiter& rate_limiter_config) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto& context = model_contexts_[instance->Model()];
+    context.instances_.insert(instance);
+    // The instance may be waiting for work that is already queued.
+    AssignPayloads(&context);
+  }
+  cv_.notify_all();
+  return Status::Success;
+}
+
+void RateLimiter::UnregisterModelInstance(BackendModelInstance* instance) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    const auto itr = model_contexts_.find(instance->Model());
+    if (itr == model_contexts_.end()) {
+      return;
+    }
+    ModelContext& context = itr->second;
+    context.instances_.erase(instance);
+    context.idle_.erase(instance);
+    // The inference payloads assigned to the instance go back to the
+    // model queue for the other instances.
+    const auto qitr = instance_queues_.find(instance);
+    if (qitr != instance_queues_.end()) {
+      for (auto pitr = qitr->second.rbegin(); pitr != qitr->second.rend(); ++pitr) {
+        if ((*pitr)->GetOpType() == Payload::Operation::INFER_RUN) {
+          (*pitr)->SetInstance(nullptr);
+          context.queue_.push_front(std::move(*pitr));
+        }
+      }
+      instance_queues_.erase(qitr);
+      AssignPayloads(&context);
+    }
+  }
+  cv_.notify_all();
+}
+
+void RateLimiter::UnregisterModel(const BackendModel* model) {
+  std::lock_guard<std::mutex> lock(mu_);
+  model_contexts_.erase(model);
+  for (auto itr = instance_queues_.begin(); itr != instance_queues_.end();) {
+    if (itr->first->Model() == model) {
+      itr = instance_queues_.erase(itr);
+    } else {
+      ++itr;
+    }
+  }
+}
+
+bool RateLimiter::PayloadSlotAvailable(const BackendModel* model, const size_t pipeline_depth) {
+  std::lock_guard<std::mutex> lock(mu_);
+  const auto itr = model_contexts_.find(model);
+  if (itr == model_contexts_.end()) {
+    return false;
+  }
+  const ModelContext& context = itr->second;
+  for (const auto& idle : context.idle_) {
+    if (context.instances_.find(idle.first) != context.instances_.end()) {
+      return true;
+    }
+  }
+  // Past the waiting payloads allowed, the scheduler keeps growing the
+  // next batch instead.
+  return context.queue_.size() < context.instances_.size() * (pipeline_depth - 1);
+}
+
+void RateLimiter::SetIdleCallback(const BackendModel* model, std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(idle_callback_mu_);
+  if (callback) {
+    idle_callbacks_[model] = std::move(callback);
+  } else {
+    idle_callbacks_.erase(model);
+  }
+}
+
+void RateLimiter::NotifyIdle(const InstanceList& instances) {
+  std::set<const BackendModel*> models;
+  for (auto instance : instances) {
+    models.insert(instance->Model());
+  }
+  std::lock_guard<std::mutex> lock(idle_callback_mu_);
+  for (auto model : models) {
+    const auto itr = idle_callbacks_.find(model);
+    if (itr != idle_callbacks_.end()) {
+      itr->second();
+    }
+  }
+}
+
+Status RateLimiter::EnqueuePayload(const BackendModel* model,
+                                   std::shared_ptr<Payload> payload) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    payload->SetState(Payload::State::REQUESTED);
+    if (payload->GetInstance() != nullptr) {
+      instance_queues_[payload->GetInstance()].push_back(std::move(payload));
+    } else {
+      auto& context = model_contexts_[model];
+      context.queue_.push_back(std::move(payload));
+      context.numa_node_ = CurrentNumaNode();
+      AssignPayloads(&context);
+    }
+  }
+  cv_.notify_all();
+  return Status::Success;
+}
+
+std::shared_ptr<Payload> RateLimiter::NextPayload(InstanceList& instances) {
+  // The payloads addressed to an instance go first, they manage the
+  // lifetime of the instance. The payloads of the model queues were
+  // assigned to the instance by AssignPayloads().
+  for (auto itr = instances.begin(); itr != instances.end(); ++itr) {
+    auto qitr = instance_queues_.find(*itr);
+    if ((qitr == instance_queues_.end()) || qitr->second.empty()) {
+      continue;
+    }
+    std::shared_ptr<Payload> payload = std::move(qitr->second.front());
+    qitr->second.pop_front();
+    if (qitr->second.empty()) {
+      instance_queues_.erase(qitr);
+    }
+    if (payload->GetOpType() == Payload::Operation::INFER_RUN) {
+      ++device_payloads_[DeviceKey(*itr)];
+    }
+    // The instance is busy until it comes back in 'instances'.
+    const auto citr = model_contexts_.find((*itr)->Model());
+    if (citr != model_contexts_.end()) {
+      citr->second.idle_.erase(*itr);
+    }
+    instances.erase(itr);
+    return payload;
+  }
+  return nullptr;
+}
+
+bool RateLimiter::SetIdle(InstanceList& instances, const bool idle) {
+  std::set<ModelContext*> contexts;
+  for (auto instance : instances) {
+    // The instance may wait before it is registered.
+    auto& context = model_contexts_[instance->Model()];
+    if (idle) {
+      if (context.idle_.insert(std::make_pair(instance, &instances)).second) {
+        contexts.insert(&context);
+      }
+    } else {
+      context.idle_.erase(instance);
+    }
+  }
+  for (auto context : contexts) {
+    AssignPayloads(context);
+  }
+  return !contexts.empty();
+}
+
+void RateLimiter::AssignPayloads(ModelContext* context) {
+  std::vector<BackendModelInstance*> candidates;
+  while (!context->queue_.empty()) {
+    candidates.clear();
+    for (const auto& idle : context->idle_) {
+      if (context->instances_.find(idle.first) != context->instances_.end()) {
+        candidates.push_back(idle.first);
+      }
+    }
+    if (candidates.empty()) {
+      return;
+    }
+    // Comparing two random instances avoids herding every payload onto
+    // the instance that looks best while the loads change.
+    BackendModelInstance* instance = candidates[0];
+    if (candidates.size() > 1) {
+      std::uniform_int_distribution<size_t> pick(0, candidates.size() - 1);
+      const size_t first = pick(rng_);
+      size_t second = pick(rng_);
+      if (second == first) {
+        second = (first + 1) % candidates.size();
+      }
+      const Payload& next = *context->queue_.front();
+      instance = (LoadScore(candidates[first], next, context->numa_node_) <=
+                  LoadScore(candidates[second], next, context->numa_node_))
+                     ? candidates[first]
+                     : candidates[second];
+    }
+    std::shared_ptr<Payload> payload = std::move(context->queue_.front());
+    context->queue_.pop_front();
+    payload->SetInstance(instance);
+    instance_queues_[instance].push_back(std::move(payload));
+    // The backend thread of the instance is busy from now on.
+    SetIdle(*context->idle_[instance], false);
+  }
+}
+
+double RateLimiter::LoadScore(const BackendModelInstance* instance, const Payload& payload,
+                              const int numa_node) const {
+  // The expected execution time of the batch on the instance, stretched
+  // by the payloads sharing its device. Before the batch size was
+  // measured on the instance its recent execution time stands in, an
+  // instance that has not executed yet looks cheapest so that it gets
+  // measured.
+  const auto itr = device_payloads_.find(DeviceKey(instance));
+  const size_t outstanding = (itr == device_payloads_.end()) ? 0 : itr->second;
+  ExecTimeEstimator::Estimate estimate;
+  const double exec_ns =
+      instance->Model()->ExecEstimator().Get(instance, payload.BatchSize(), 0, &estimate)
+          ? estimate.mean_ns_
+          : static_cast<double>(instance->RecentExecNs());
+  double score = std::max(1.0, exec_ns) * (outstanding + 1);
+  if ((numa_node >= 0) && (instance->NumaNode() >= 0) && (numa_node != instance->NumaNode())) {
+    score *= kRemoteNumaPenalty;
+  }
+  return score;
+}
+
+std::pair<int, int32_t> RateLimiter::DeviceKey(const BackendModelInstance* instance) {
+  return std::make_pair(static_cast<int>(instance->Kind()), instance->DeviceId());
+}
+
+void RateLimiter::DequeuePayload(InstanceList& instances,
+                                 std::shared_ptr<Payload>* payload) {
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    *payload = NextPayload(instances);
+    if (*payload == nullptr) {
+      // Queued payloads may be assigned to the instances right away.
+      SetIdle(instances, true);
+      cv_.notify_all();
+      // A scheduler waiting for an idle instance may form its batch now.
+      // It checks for a slot with its own lock held, so it is told
+      // without this one.
+      lock.unlock();
+      NotifyIdle(instances);
+      lock.lock();
+      cv_.wait(lock, [this, &instances, payload]() {
+        *payload = NextPayload(instances);
+        // An instance unregistered meanwhile is no longer marked idle,
+        // it is marked again in case it was registered again.
+        if ((*payload == nullptr) && SetIdle(instances, true)) {
+          cv_.notify_all();
+          *payload = NextPayload(instances);
+        }
+        return (*payload != nullptr);
+      });
+      SetIdle(instances, false);
+    }
+    (*payload)->SetState(Payload::State::SCHEDULED);
+  }
+  // Let the scheduler know a slot opened up.
+  (*payload)->Callback();
+}
+
+std::shared_ptr<Payload> RateLimiter::GetPayload(const Payload::Operation op_type,
+                                                 BackendModelInstance* instance) {
+  std::shared_ptr<Payload> payload;
+  {
+    std::lock_guard<std::mutex> lock(payload_mu_);
+    if (!payload_pool_.empty()) {
+      payload = std::move(payload_pool_.back());
+      payload_pool_.pop_back();
+    }
+  }
+  if (payload == nullptr) {
+    payload.reset(new Payload());
+  }
+  payload->Reset(op_type, instance);
+  return payload;
+}
+
+void RateLimiter::PayloadRelease(std::shared_ptr<Payload>& payload) {
+  if ((payload->GetOpType() == Payload::Operation::INFER_RUN) &&
+      (payload->GetInstance() != nullptr)) {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto itr = device_payloads_.find(DeviceKey(payload->GetInstance()));
+    if ((itr != device_payloads_.end()) && (--itr->second == 0)) {
+      device_payloads_.erase(itr);
+    }
+  }
+  payload->OnRelease();
+  payload->SetState(Payload::State::RELEASED);
+  // No one can get hold of the payload anymore if this is the last
+  // reference, such as one waiting for the payload to execute.
+  if (payload.use_count() == 1) {
+    std::lock_guard<std::mutex> lock(payload_mu_);
+    if (payload_pool_.size() < kMaxPooledPayloads) {
+      payload_pool_.push_back(std::move(payload));
+    }
+  }
+  payload.reset();
+}
+
+} // namespace core
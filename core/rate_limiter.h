@@ -1,10 +1,130 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "status.h"
+#include "payload.h"
+#include "model_config.h"
+
 namespace core {
 
+class BackendModel;
+class BackendModelInstance;
+
 // Limits the rate at which requests are dispatched to the model instances
 class RateLimiter {
+ public:
+  // The instances served by one backend thread.
+  using InstanceList = std::deque<BackendModelInstance*>;
+
+  static Status Create(std::shared_ptr<RateLimiter>* rate_limiter);
+
+  // Allow 'instance' to take the payloads enqueued for its model.
+  // Registering an instance twice is a no-op.
+  Status RegisterModelInstance(BackendModelInstance* instance,
+                               const inference::ModelRateLimiter& rate_limiter_config);
+
+  // Stop giving the payloads of the model to 'instance'. The payload the
+  // instance is executing, if any, runs to completion, the inference
+  // payloads assigned to the instance go to the other instances of the
+  // model and the others are dropped.
+  void UnregisterModelInstance(BackendModelInstance* instance);
+
+  // Remove everything the rate limiter holds for 'model'.
+  void UnregisterModel(const BackendModel* model);
+
+  // Return true if the model can take another payload. A payload is
+  // taken when an instance is idle, and up to 'pipeline_depth' - 1
+  // payloads per instance may wait for the instances to finish their
+  // current payload.
+  bool PayloadSlotAvailable(const BackendModel* model, const size_t pipeline_depth);
+
+  // Call 'callback' whenever an instance of 'model' starts waiting for a
+  // payload, a null 'callback' removes it. The callback is called without
+  // the rate limiter lock held.
+  void SetIdleCallback(const BackendModel* model, std::function<void()> callback);
+
+  // Enqueue 'payload'. A payload for a specific instance is only given
+  // to that instance, otherwise it goes to the least loaded of two idle
+  // registered instances of 'model' picked at random.
+  Status EnqueuePayload(const BackendModel* model, std::shared_ptr<Payload> payload);
+
+  // Block until one of 'instances' has a payload to execute. The
+  // instance is removed from 'instances' and set on the payload.
+  void DequeuePayload(InstanceList& instances,
+                      std::shared_ptr<Payload>* payload);
+
+  // Get a payload ready for 'op_type'. Released payloads are reused.
+  std::shared_ptr<Payload> GetPayload(const Payload::Operation op_type,
+                                      BackendModelInstance* instance = nullptr);
+
+  // Release 'payload' once it has been executed. The payload is kept
+  // for reuse unless someone else still holds it.
+  void PayloadRelease(std::shared_ptr<Payload>& payload);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RateLimiter);
+  RateLimiter() = default;
+
+  // The payloads of a model that any of its instances can execute and
+  // the instances allowed to execute them.
+  struct ModelContext {
+    ModelContext() : numa_node_(-1) {}
+    std::deque<std::shared_ptr<Payload>> queue_;
+    std::set<BackendModelInstance*> instances_;
+    // The instances whose backend thread waits for a payload, with all
+    // the instances of that thread.
+    std::map<BackendModelInstance*, InstanceList*> idle_;
+    // The NUMA node the payloads were last enqueued from, -1 if unknown.
+    int numa_node_;
+  };
+
+  // Return the payload queued for one of 'instances', or null.
+  std::shared_ptr<Payload> NextPayload(InstanceList& instances);
+
+  // Mark the backend thread serving 'instances' as waiting or not.
+  // Return true if an instance was newly marked as waiting.
+  bool SetIdle(InstanceList& instances, const bool idle);
+
+  // Call the idle callbacks of the models of 'instances'.
+  void NotifyIdle(const InstanceList& instances);
+
+  // Hand the queued payloads of 'context' to its idle registered
+  // instances, each one picked by the power of two choices.
+  void AssignPayloads(ModelContext* context);
+
+  // The expected cost of running 'payload' gathered on 'numa_node' on
+  // 'instance', the lower the better.
+  double LoadScore(const BackendModelInstance* instance, const Payload& payload,
+                   const int numa_node) const;
+
+  // The key counting the payloads executing on the device of 'instance'.
+  static std::pair<int, int32_t> DeviceKey(const BackendModelInstance* instance);
 
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::map<const BackendModel*, ModelContext> model_contexts_;
+  // Payloads addressed to a specific instance.
+  std::map<BackendModelInstance*, std::deque<std::shared_ptr<Payload>>> instance_queues_;
+  // The inference payloads executing on each device.
+  std::map<std::pair<int, int32_t>, size_t> device_payloads_;
+  std::mt19937 rng_{std::random_device{}()};
+  // Held while an idle callback runs, so that a removed callback is no
+  // longer running.
+  std::mutex idle_callback_mu_;
+  std::map<const BackendModel*, std::function<void()>> idle_callbacks_;
+  // The released payloads kept for reuse.
+  std::mutex payload_mu_;
+  std::vector<std::shared_ptr<Payload>> payload_pool_;
 };
 
-}
\ No newline at end of file
+} // namespace core
@@ -0,0 +1,145 @@
+#include "repository_watcher.h"
+
+#include <errno.h>
+#include <string.h>
+#include <vector>
+
+#include "file_utils.h"
+
+#ifndef _WIN32
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+
+#ifndef _WIN32
+namespace {
+// Changes to the entries of a repository add or remove models.
+constexpr uint32_t kRepositoryMask =
+  IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+// Changes below a model directory modify the model.
+constexpr uint32_t kModelMask =
+  IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+  IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_ONLYDIR;
+}  // namespace
+#endif
+
+Status RepositoryWatcher::Create(const std::set<std::string>& repository_paths,
+                                 std::unique_ptr<RepositoryWatcher>* watcher) {
+#ifdef _WIN32
+  return Status(Status::Code::UNSUPPORTED, "repository watching is not supported");
+#else
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    auto msg = std::string("failed to initialize inotify: ") + strerror(errno);
+    return Status(Status::Code::UNSUPPORTED, msg);
+  }
+  std::unique_ptr<RepositoryWatcher> local_watcher(new RepositoryWatcher(fd));
+  for (const auto& path : repository_paths) {
+    RETURN_IF_ERROR(local_watcher->AddWatch(path, std::string(), kRepositoryMask));
+  }
+  *watcher = std::move(local_watcher);
+  return Status::Success;
+#endif
+}
+
+RepositoryWatcher::~RepositoryWatcher() {
+#ifndef _WIN32
+  close(fd_);
+#endif
+}
+
+Status RepositoryWatcher::AddWatch(const std::string& path,
+                                   const std::string& name,
+                                   const uint32_t mask) {
+#ifdef _WIN32
+  return Status(Status::Code::UNSUPPORTED, "repository watching is not supported");
+#else
+  if (watched_paths_.find(path) != watched_paths_.end()) {
+    return Status::Success;
+  }
+  int wd = inotify_add_watch(fd_, path.c_str(), mask);
+  if (wd < 0) {
+    auto msg = "failed to watch " + path + ": " + strerror(errno);
+    return Status(Status::Code::INTERNAL, msg);
+  }
+  watches_[wd] = Watch{path, name};
+  watched_paths_.insert(path);
+  return Status::Success;
+#endif
+}
+
+Status RepositoryWatcher::WatchModel(const std::string& name,
+                                     const std::string& model_path) {
+#ifdef _WIN32
+  return Status(Status::Code::UNSUPPORTED, "repository watching is not supported");
+#else
+  std::lock_guard<std::mutex> lock(mu_);
+  // inotify is not recursive, each directory of the model is watched.
+  std::vector<std::string> dirs{model_path};
+  while (!dirs.empty()) {
+    const std::string dir = dirs.back();
+    dirs.pop_back();
+    RETURN_IF_ERROR(AddWatch(dir, name, kModelMask));
+    std::set<std::string> subdirs;
+    RETURN_IF_ERROR(GetDirectorySubdirs(dir, &subdirs));
+    for (const auto& subdir : subdirs) {
+      dirs.push_back(JoinPath({dir, subdir}));
+    }
+  }
+  return Status::Success;
+#endif
+}
+
+Status RepositoryWatcher::Changes(std::set<std::string>* models, bool* rescan) {
+  models->clear();
+  *rescan = false;
+#ifdef _WIN32
+  *rescan = true;
+  return Status::Success;
+#else
+  std::lock_guard<std::mutex> lock(mu_);
+  alignas(struct inotify_event) char buffer[16 * 1024];
+  while (true) {
+    ssize_t len = read(fd_, buffer, sizeof(buffer));
+    if (len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN) {
+        break;
+      }
+      auto msg = std::string("failed to read repository events: ") + strerror(errno);
+      return Status(Status::Code::INTERNAL, msg);
+    }
+    for (char* ptr = buffer; ptr < buffer + len;) {
+      const struct inotify_event* event =
+        reinterpret_cast<const struct inotify_event*>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        *rescan = true;
+        continue;
+      }
+      const auto itr = watches_.find(event->wd);
+      if (itr == watches_.end()) {
+        continue;
+      }
+      if (!itr->second.name_.empty()) {
+        models->insert(itr->second.name_);
+      } else if (event->len > 0) {
+        models->insert(event->name);
+      }
+      // The directory is gone, so is its watch. It is added again if the
+      // directory comes back and the model is revisited.
+      if (event->mask & IN_IGNORED) {
+        watched_paths_.erase(itr->second.path_);
+        watches_.erase(itr);
+      }
+    }
+  }
+  return Status::Success;
+#endif
+}
+
+} // namespace core
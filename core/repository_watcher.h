@@ -0,0 +1,58 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "status.h"
+#include "constants.h"
+
+namespace core {
+
+// Watches the model repositories for changes so that a poll only has
+// to revisit the models that were touched since the previous poll.
+// Only changes made through the local kernel are reported, which for a
+// network mounted repository means changes made by other hosts are not
+// seen until the next full rescan.
+class RepositoryWatcher {
+ public:
+  // Create a watcher on the top level of the given repositories. Return
+  // UNSUPPORTED if the platform has no file system notification.
+  static Status Create(const std::set<std::string>& repository_paths,
+                       std::unique_ptr<RepositoryWatcher>* watcher);
+  ~RepositoryWatcher();
+
+  // Watch the directory of model 'name' and every directory below it.
+  // Watching a directory that is already watched is a no-op.
+  Status WatchModel(const std::string& name, const std::string& model_path);
+
+  // Collect the names of the models touched since the last call.
+  // 'rescan' is set if events were lost and every model has to be
+  // revisited.
+  Status Changes(std::set<std::string>* models, bool* rescan);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RepositoryWatcher);
+  explicit RepositoryWatcher(int fd) : fd_(fd) {}
+
+  Status AddWatch(const std::string& path, const std::string& name, const uint32_t mask);
+
+  // The notification file descriptor.
+  const int fd_;
+  std::mutex mu_;
+  // A watched directory and the model it belongs to. Repository
+  // directories have an empty name, the model is then given by the name
+  // of the entry that changed.
+  struct Watch {
+    std::string path_;
+    std::string name_;
+  };
+  // Map from watch descriptor to the watched directory.
+  std::map<int, Watch> watches_;
+  // The paths being watched.
+  std::set<std::string> watched_paths_;
+};
+
+} // namespace core
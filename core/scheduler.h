@@ -9,6 +9,8 @@
 
 namespace core {
 
+class BackendModelInstance;
+
 // Scheduler interface.
 class Scheduler {
  public:
@@ -53,6 +55,26 @@ class Scheduler {
   // Instruct the scheduler to stop processing future requests unless they are
   // considered as in-flight.
   virtual void Stop() = 0;
+
+  // Start dispatching requests to 'added' instances and stop dispatching
+  // to 'removed' instances. The added instances are taken into use before
+  // the removed ones are dropped so that requests keep flowing while the
+  // instances change.
+  virtual Status Update(
+      const std::vector<std::shared_ptr<BackendModelInstance>>& added,
+      const std::vector<std::shared_ptr<BackendModelInstance>>& removed) {
+    return Status(Status::Code::UNSUPPORTED,
+                  "scheduler does not support instance updates");
+  }
+
+  // Called when 'instance' failed to execute a batch with an error that
+  // is not caused by the requests, the scheduler may stop dispatching to
+  // the instance for a while.
+  virtual void InstanceFailed(BackendModelInstance* instance, const Status& status) {}
+
+  // Return the time the oldest queued request was enqueued, 0 if none is
+  // queued.
+  virtual uint64_t OldestQueueStartNs() { return 0; }
 };
 
 }
\ No newline at end of file
@@ -1,7 +1,19 @@
 #include "interface/IServer.h"
 #include "backend_model.h"
+#include "infer_request.h"
+#include "infer_response.h"
+#include "infer_trace.h"
+#include "local_transport.h"
+#include "message.h"
+#include "metrics.h"
+#include "model.h"
+#include "model_config.h"
 #include "server.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
 #if defined(_MSC_VER)
 #define API_DECLSPEC __declspec(dllexport)
 #elif defined(__GNUC__)
@@ -12,32 +24,278 @@
 
 namespace core {
 
+namespace {
+// The request timeouts expire within 100us of their deadline.
+constexpr uint64_t kTimerResolutionNs = 100 * 1000;
+
+// Append the bytes of each memory type and id of 'usage' to the array
+// 'json' of 'document'.
+Status AppendMemoryUsage(common::Json::Value& document, const MemoryUsageMap& usage,
+                         common::Json::Value* json) {
+  for (const auto& type : usage) {
+    for (const auto& id : type.second) {
+      common::Json::Value entry(document, common::Json::ValueType::OBJECT);
+      RETURN_IF_ERROR(entry.AddStringRef("memory_type", SERVER_MemoryTypeString(type.first)));
+      RETURN_IF_ERROR(entry.AddInt("memory_type_id", id.first));
+      RETURN_IF_ERROR(entry.AddUInt("byte_size", id.second));
+      RETURN_IF_ERROR(json->Append(std::move(entry)));
+    }
+  }
+  return Status::Success;
+}
+
+// The memory usage of the versions of 'model_name' as the JSON of
+// SERVER_ServerModelMemoryUsage().
+Status ModelMemoryUsageJson(const std::string& model_name,
+                            const std::map<int64_t, ModelMemoryUsage>& usage,
+                            std::unique_ptr<Message>* message) {
+  common::Json::Value document(common::Json::ValueType::OBJECT);
+  RETURN_IF_ERROR(document.AddString("name", model_name));
+  common::Json::Value versions(document, common::Json::ValueType::ARRAY);
+  for (const auto& pr : usage) {
+    common::Json::Value version(document, common::Json::ValueType::OBJECT);
+    RETURN_IF_ERROR(version.AddInt("version", pr.first));
+    common::Json::Value total(document, common::Json::ValueType::ARRAY);
+    RETURN_IF_ERROR(AppendMemoryUsage(document, pr.second.total_, &total));
+    RETURN_IF_ERROR(version.Add("usage", std::move(total)));
+    common::Json::Value instances(document, common::Json::ValueType::ARRAY);
+    for (const auto& instance_usage : pr.second.instances_) {
+      common::Json::Value instance(document, common::Json::ValueType::OBJECT);
+      RETURN_IF_ERROR(instance.AddString("name", instance_usage.first));
+      common::Json::Value instance_total(document, common::Json::ValueType::ARRAY);
+      RETURN_IF_ERROR(AppendMemoryUsage(document, instance_usage.second, &instance_total));
+      RETURN_IF_ERROR(instance.Add("usage", std::move(instance_total)));
+      RETURN_IF_ERROR(instances.Append(std::move(instance)));
+    }
+    RETURN_IF_ERROR(version.Add("instances", std::move(instances)));
+    RETURN_IF_ERROR(versions.Append(std::move(version)));
+  }
+  RETURN_IF_ERROR(document.Add("versions", std::move(versions)));
+  message->reset(new Message(document));
+  return Status::Success;
+}
+
+// Add the durations recorded in 'histogram' to 'json' as the member
+// 'name' of 'document'.
+Status AddDurations(common::Json::Value& document, const char* name,
+                    const LatencyHistogram& histogram, common::Json::Value* json) {
+  common::Json::Value durations(document, common::Json::ValueType::OBJECT);
+  RETURN_IF_ERROR(durations.AddUInt("count", histogram.Count()));
+  RETURN_IF_ERROR(durations.AddUInt("ns", histogram.SumNs()));
+  RETURN_IF_ERROR(durations.AddUInt("p50_ns", histogram.QuantileNs(0.5)));
+  RETURN_IF_ERROR(durations.AddUInt("p99_ns", histogram.QuantileNs(0.99)));
+  return json->Add(name, std::move(durations));
+}
+
+// Add the counts and the stage durations of 'stats' to 'json'.
+Status AddStageStats(common::Json::Value& document,
+                     const InferenceStatsAggregator::StageStats& stats,
+                     common::Json::Value* json) {
+  RETURN_IF_ERROR(json->AddUInt("success_count", stats.success_count_.load()));
+  RETURN_IF_ERROR(json->AddUInt("failure_count", stats.failure_count_.load()));
+  RETURN_IF_ERROR(AddDurations(document, "compute_input", stats.compute_input_, json));
+  RETURN_IF_ERROR(AddDurations(document, "compute_infer", stats.compute_infer_, json));
+  RETURN_IF_ERROR(AddDurations(document, "compute_output", stats.compute_output_, json));
+  return AddDurations(document, "execution", stats.execution_, json);
+}
+
+// The execution statistics of the versions of 'model_name' as the JSON
+// of SERVER_ServerModelStatistics().
+Status ModelStatisticsJson(const std::string& model_name,
+                           const std::map<int64_t, std::shared_ptr<Model>>& models,
+                           std::unique_ptr<Message>* message) {
+  common::Json::Value document(common::Json::ValueType::OBJECT);
+  RETURN_IF_ERROR(document.AddString("name", model_name));
+  common::Json::Value versions(document, common::Json::ValueType::ARRAY);
+  for (const auto& pr : models) {
+    common::Json::Value version(document, common::Json::ValueType::OBJECT);
+    RETURN_IF_ERROR(version.AddInt("version", pr.first));
+    const InferenceStatsAggregator* stats = pr.second->ExecutionStatistics();
+    if (stats != nullptr) {
+      common::Json::Value requests(document, common::Json::ValueType::OBJECT);
+      RETURN_IF_ERROR(AddStageStats(document, stats->RequestStats(), &requests));
+      RETURN_IF_ERROR(version.Add("requests", std::move(requests)));
+      common::Json::Value batches(document, common::Json::ValueType::ARRAY);
+      for (size_t batch_size = 1; batch_size <= stats->MaxBatchSize(); ++batch_size) {
+        const InferenceStatsAggregator::StageStats* batch_stats = stats->BatchStats(batch_size);
+        if (batch_stats == nullptr) {
+          continue;
+        }
+        common::Json::Value batch(document, common::Json::ValueType::OBJECT);
+        RETURN_IF_ERROR(batch.AddUInt("batch_size", batch_size));
+        RETURN_IF_ERROR(AddStageStats(document, *batch_stats, &batch));
+        RETURN_IF_ERROR(batches.Append(std::move(batch)));
+      }
+      RETURN_IF_ERROR(version.Add("batches", std::move(batches)));
+      const InferenceStatsAggregator::ResponseStats& response_stats = stats->ResponseStatistics();
+      common::Json::Value responses(document, common::Json::ValueType::OBJECT);
+      RETURN_IF_ERROR(responses.AddUInt("success_count", response_stats.success_count_.load()));
+      RETURN_IF_ERROR(responses.AddUInt("failure_count", response_stats.failure_count_.load()));
+      RETURN_IF_ERROR(
+          AddDurations(document, "compute_infer", response_stats.compute_infer_, &responses));
+      RETURN_IF_ERROR(
+          AddDurations(document, "compute_output", response_stats.compute_output_, &responses));
+      RETURN_IF_ERROR(version.Add("responses", std::move(responses)));
+    }
+    RETURN_IF_ERROR(versions.Append(std::move(version)));
+  }
+  RETURN_IF_ERROR(document.Add("versions", std::move(versions)));
+  message->reset(new Message(document));
+  return Status::Success;
+}
+}  // namespace
+
 InferenceServer::InferenceServer()
   : version_(SERVER_VERSION), 
+    trace_rate_(InferenceTracer::kDefaultRate),
     ready_state_(ServerReadyState::SERVER_INVALID)
 {
+  // Loading a model is mostly waiting on file reads and backend
+  // initialization, so load more models at once than there are cores.
+  model_load_thread_count_ = std::max(4u, std::thread::hardware_concurrency());
 }
 
 Status InferenceServer::Init() {
+  if (ready_state_ != ServerReadyState::SERVER_INVALID) {
+    return Status(Status::Code::ALREADY_EXISTS, "server is already initialized");
+  }
+  ready_state_ = ServerReadyState::SERVER_INITIALIZING;
+  if (model_repository_paths_.empty()) {
+    ready_state_ = ServerReadyState::SERVER_FAILED_TO_INITIALIZE;
+    return Status(Status::Code::INVALID_ARG, "--model-repository must be specified");
+  }
+  Status status = RateLimiter::Create(&rate_limiter_);
+  if (status.IsOk()) {
+    // The executor also runs the model loads, which mostly wait, so it
+    // has at least as many threads as models may load at once.
+    std::unique_ptr<Executor> executor;
+    status = Executor::Create(
+        std::max<size_t>(model_load_thread_count_, std::thread::hardware_concurrency()),
+        &executor);
+    executor_ = std::move(executor);
+  }
+  if (status.IsOk()) {
+    // The responses are delivered apart, a client callback never waits
+    // behind a model load.
+    std::unique_ptr<Executor> executor;
+    status = Executor::Create(std::max(1u, std::thread::hardware_concurrency()), &executor);
+    response_executor_ = std::move(executor);
+  }
+  if (status.IsOk()) {
+    std::unique_ptr<TimerService> timer_service;
+    status = TimerService::Create(kTimerResolutionNs, &timer_service);
+    timer_service_ = std::move(timer_service);
+  }
+  if (status.IsOk()) {
+    status = BackendManager::Create(&backend_manager_);
+  }
+  if (status.IsOk()) {
+    status = ModelRepositoryManager::Create(this, model_repository_paths_,
+                                            backend_cmdline_config_map_,
+                                            host_policy_map_,
+                                            model_load_thread_count_,
+                                            model_load_options_,
+                                            &model_repository_manager_);
+  }
+  if (!status.IsOk()) {
+    ready_state_ = ServerReadyState::SERVER_FAILED_TO_INITIALIZE;
+    return status;
+  }
+  ready_state_ = ServerReadyState::SERVER_READY;
   return Status::Success;
 }
 
 Status InferenceServer::Stop(const bool force) {
+  if (!force && (ready_state_ != ServerReadyState::SERVER_READY)) {
+    return Status::Success;
+  }
+  ready_state_ = ServerReadyState::SERVER_EXITING;
+  if (model_repository_manager_ != nullptr) {
+    RETURN_IF_ERROR(model_repository_manager_->UnloadAllModels());
+  }
   return Status::Success;
 }
 
 Status InferenceServer::IsLive(bool* live) {
+  // The server responds while it is up, whatever its readiness.
+  *live = true;
   return Status::Success;
 }
 
 Status InferenceServer::PollModelRepository() {
-  return Status::Success;
+  if (ready_state_ != ServerReadyState::SERVER_READY) {
+    return Status(Status::Code::UNAVAILABLE, "server is not ready");
+  }
+  return model_repository_manager_->PollAndUpdate();
+}
+
+Status InferenceServer::GetModel(const std::string& model_name,
+                                 const int64_t model_version,
+                                 std::shared_ptr<Model>* model) {
+  if (model_repository_manager_ == nullptr) {
+    return Status(Status::Code::UNAVAILABLE, "server is not ready");
+  }
+  return model_repository_manager_->GetModel(model_name, model_version, model);
+}
+
+const ModelRepositoryManager::ModelStateMap InferenceServer::ModelStates() {
+  if (model_repository_manager_ == nullptr) {
+    return ModelRepositoryManager::ModelStateMap();
+  }
+  return model_repository_manager_->ModelStates();
+}
+
+Status InferenceServer::SetModelVersionTraffic(const std::string& model_name,
+                                               const ModelRepositoryManager::VersionWeightMap& weights) {
+  if (model_repository_manager_ == nullptr) {
+    return Status(Status::Code::UNAVAILABLE, "server is not ready");
+  }
+  return model_repository_manager_->SetVersionTraffic(model_name, weights);
+}
+
+Status InferenceServer::ModelVersionTraffic(const std::string& model_name,
+                                            ModelRepositoryManager::VersionWeightMap* weights) {
+  if (model_repository_manager_ == nullptr) {
+    return Status(Status::Code::UNAVAILABLE, "server is not ready");
+  }
+  return model_repository_manager_->VersionTraffic(model_name, weights);
+}
+
+Status InferenceServer::GetModelMemoryUsage(const std::string& model_name,
+                                            std::map<int64_t, ModelMemoryUsage>* usage) {
+  if (model_repository_manager_ == nullptr) {
+    return Status(Status::Code::UNAVAILABLE, "server is not ready");
+  }
+  return model_repository_manager_->GetMemoryUsage(model_name, usage);
+}
+
+Status InferenceServer::GetLoadedModelVersions(
+    const std::string& model_name, std::map<int64_t, std::shared_ptr<Model>>* models) {
+  if (model_repository_manager_ == nullptr) {
+    return Status(Status::Code::UNAVAILABLE, "server is not ready");
+  }
+  return model_repository_manager_->GetLoadedVersions(model_name, models);
 }
 
 Status InferenceServer::IsReady(bool* ready) {
+  *ready = (ready_state_ == ServerReadyState::SERVER_READY);
   return Status::Success;
 }
 
+Status InferenceServer::InferAsync(std::unique_ptr<InferenceRequest>& request) {
+  if (request->TraceId() == 0) {
+    request->SetTraceId(InferenceTracer::Sample(trace_rate_));
+  }
+  InferenceTracer::Record(request->TraceId(), TraceActivity::REQUEST_RECEIVED,
+                          request->ModelRaw()->TraceNameId());
+  RETURN_IF_ERROR(request->PrepareForInference());
+  // A slow application holds up the response executor rather than the
+  // backend.
+  request->SetResponseExecutor(response_executor_.get());
+  Model* model = request->ModelRaw();
+  return model->Enqueue(request);
+}
+
 }
 
 class ServerError {
@@ -78,6 +336,31 @@ SERVER_Error* ServerError::Create(const core::Status& status) {
   return Create(code, status.Message());
 }
 
+// The options a server is created with through the C API.
+class ServerOptions {
+ public:
+  ServerOptions()
+    : model_load_thread_count_(0), trace_rate_(core::InferenceTracer::kDefaultRate) {}
+
+  std::set<std::string> model_repository_paths_;
+  core::BackendCmdlineConfigMap backend_cmdline_config_map_;
+  // 0 keeps the default of the server.
+  unsigned int model_load_thread_count_;
+  uint32_t trace_rate_;
+};
+
+// A snapshot of the metrics taken through the C API.
+class ServerMetrics {
+ public:
+  std::string prometheus_text_;
+};
+
+// A snapshot of the request traces taken through the C API.
+class ServerTrace {
+ public:
+  std::string chrome_json_;
+};
+
 extern "C" {
 
 //
@@ -114,4 +397,602 @@ const char* SERVER_ErrorMessage(SERVER_Error* error) {
   return lerror->Message().c_str();
 }
 
+//
+// SERVER_MemoryType
+//
+API_DECLSPEC
+const char* SERVER_MemoryTypeString(SERVER_MemoryType memtype) {
+  switch (memtype) {
+    case SERVER_MEMORY_CPU:
+      return "CPU";
+    case SERVER_MEMORY_CPU_PINNED:
+      return "CPU_PINNED";
+    case SERVER_MEMORY_GPU:
+      return "GPU";
+  }
+  return "<invalid>";
+}
+
+//
+// SERVER_DataType
+//
+API_DECLSPEC
+const char* SERVER_DataTypeString(SERVER_DataType datatype) {
+  return core::DataTypeToProtocolString(core::ServerDataTypeToDataType(datatype));
+}
+
+//
+// SERVER_ServerOptions
+//
+API_DECLSPEC
+SERVER_Error* SERVER_ServerOptionsNew(SERVER_ServerOptions** options) {
+  *options = reinterpret_cast<SERVER_ServerOptions*>(new ServerOptions());
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerOptionsDelete(SERVER_ServerOptions* options) {
+  delete reinterpret_cast<ServerOptions*>(options);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerOptionsSetModelRepositoryPath(SERVER_ServerOptions* options,
+                                                         const char* path) {
+  ServerOptions* loptions = reinterpret_cast<ServerOptions*>(options);
+  loptions->model_repository_paths_.insert(path);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerOptionsSetBackendDirectory(SERVER_ServerOptions* options,
+                                                      const char* backend_dir) {
+  return SERVER_ServerOptionsSetBackendConfig(options, "", "backend-directory", backend_dir);
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerOptionsSetBackendConfig(SERVER_ServerOptions* options,
+                                                   const char* backend_name,
+                                                   const char* setting,
+                                                   const char* value) {
+  ServerOptions* loptions = reinterpret_cast<ServerOptions*>(options);
+  core::BackendCmdlineConfig& config = loptions->backend_cmdline_config_map_[backend_name];
+  // A setting given again replaces the earlier value.
+  for (auto& pr : config) {
+    if (pr.first == setting) {
+      pr.second = value;
+      return nullptr;
+    }
+  }
+  config.emplace_back(setting, value);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerOptionsSetModelLoadThreadCount(SERVER_ServerOptions* options,
+                                                          unsigned int thread_count) {
+  ServerOptions* loptions = reinterpret_cast<ServerOptions*>(options);
+  loptions->model_load_thread_count_ = thread_count;
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerOptionsSetTraceRate(SERVER_ServerOptions* options,
+                                               uint32_t trace_rate) {
+  ServerOptions* loptions = reinterpret_cast<ServerOptions*>(options);
+  loptions->trace_rate_ = trace_rate;
+  return nullptr;
+}
+
+//
+// SERVER_ResponseAllocator
+//
+API_DECLSPEC
+SERVER_Error* SERVER_ResponseAllocatorNew(SERVER_ResponseAllocator** allocator,
+                                          SERVER_ResponseAllocatorAllocFn_t alloc_fn,
+                                          SERVER_ResponseAllocatorReleaseFn_t release_fn) {
+  if ((alloc_fn == nullptr) || (release_fn == nullptr)) {
+    return ServerError::Create(SERVER_ERROR_INVALID_ARG,
+                               "a response allocator needs an alloc and a release function");
+  }
+  *allocator = reinterpret_cast<SERVER_ResponseAllocator*>(
+      new core::ResponseAllocator(alloc_fn, release_fn));
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ResponseAllocatorDelete(SERVER_ResponseAllocator* allocator) {
+  delete reinterpret_cast<core::ResponseAllocator*>(allocator);
+  return nullptr;
+}
+
+//
+// SERVER_Server
+//
+API_DECLSPEC
+SERVER_Error* SERVER_ServerNew(SERVER_Server** server, SERVER_ServerOptions* options) {
+  ServerOptions* loptions = reinterpret_cast<ServerOptions*>(options);
+  std::unique_ptr<core::InferenceServer> lserver(new core::InferenceServer());
+  lserver->SetModelRepositoryPaths(loptions->model_repository_paths_);
+  lserver->SetBackendCmdlineConfig(loptions->backend_cmdline_config_map_);
+  if (loptions->model_load_thread_count_ > 0) {
+    lserver->SetModelLoadThreadCount(loptions->model_load_thread_count_);
+  }
+  lserver->SetTraceRate(loptions->trace_rate_);
+  core::Status status = lserver->Init();
+  if (!status.IsOk()) {
+    lserver->Stop(true /* force */);
+    return ServerError::Create(status);
+  }
+  *server = reinterpret_cast<SERVER_Server*>(lserver.release());
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerDelete(SERVER_Server* server) {
+  std::unique_ptr<core::InferenceServer> lserver(
+      reinterpret_cast<core::InferenceServer*>(server));
+  return ServerError::Create(lserver->Stop());
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerIsLive(SERVER_Server* server, bool* live) {
+  core::InferenceServer* lserver = reinterpret_cast<core::InferenceServer*>(server);
+  return ServerError::Create(lserver->IsLive(live));
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerIsReady(SERVER_Server* server, bool* ready) {
+  core::InferenceServer* lserver = reinterpret_cast<core::InferenceServer*>(server);
+  return ServerError::Create(lserver->IsReady(ready));
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerModelMemoryUsage(SERVER_Server* server, const char* model_name,
+                                            SERVER_Message** usage) {
+  core::InferenceServer* lserver = reinterpret_cast<core::InferenceServer*>(server);
+  std::map<int64_t, core::ModelMemoryUsage> model_usage;
+  core::Status status = lserver->GetModelMemoryUsage(model_name, &model_usage);
+  std::unique_ptr<core::Message> message;
+  if (status.IsOk()) {
+    status = core::ModelMemoryUsageJson(model_name, model_usage, &message);
+  }
+  if (!status.IsOk()) {
+    return ServerError::Create(status);
+  }
+  *usage = reinterpret_cast<SERVER_Message*>(message.release());
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerModelStatistics(SERVER_Server* server, const char* model_name,
+                                           SERVER_Message** statistics) {
+  core::InferenceServer* lserver = reinterpret_cast<core::InferenceServer*>(server);
+  std::map<int64_t, std::shared_ptr<core::Model>> models;
+  core::Status status = lserver->GetLoadedModelVersions(model_name, &models);
+  std::unique_ptr<core::Message> message;
+  if (status.IsOk()) {
+    status = core::ModelStatisticsJson(model_name, models, &message);
+  }
+  if (!status.IsOk()) {
+    return ServerError::Create(status);
+  }
+  *statistics = reinterpret_cast<SERVER_Message*>(message.release());
+  return nullptr;
+}
+
+//
+// SERVER_Message
+//
+API_DECLSPEC
+SERVER_Error* SERVER_MessageDelete(SERVER_Message* message) {
+  delete reinterpret_cast<core::Message*>(message);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_MessageSerializeToJson(SERVER_Message* message, const char** base,
+                                            size_t* byte_size) {
+  reinterpret_cast<core::Message*>(message)->Serialize(base, byte_size);
+  return nullptr;
+}
+
+//
+// SERVER_InferenceRequest
+//
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestNew(SERVER_InferenceRequest** request,
+                                         SERVER_Server* server,
+                                         const char* model_name,
+                                         const int64_t model_version) {
+  core::InferenceServer* lserver = reinterpret_cast<core::InferenceServer*>(server);
+  std::shared_ptr<core::Model> model;
+  core::Status status = lserver->GetModel(model_name, model_version, &model);
+  if (!status.IsOk()) {
+    return ServerError::Create(status);
+  }
+  *request = reinterpret_cast<SERVER_InferenceRequest*>(
+      new core::InferenceRequest(model, model_version));
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestDelete(SERVER_InferenceRequest* request) {
+  delete reinterpret_cast<core::InferenceRequest*>(request);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestSetId(SERVER_InferenceRequest* request, const char* id) {
+  core::InferenceRequest* lrequest = reinterpret_cast<core::InferenceRequest*>(request);
+  lrequest->SetId(id);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestSetPriority(SERVER_InferenceRequest* request,
+                                                 uint64_t priority) {
+  core::InferenceRequest* lrequest = reinterpret_cast<core::InferenceRequest*>(request);
+  lrequest->SetPriority(priority);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestSetTimeoutMicroseconds(SERVER_InferenceRequest* request,
+                                                            uint64_t timeout_us) {
+  core::InferenceRequest* lrequest = reinterpret_cast<core::InferenceRequest*>(request);
+  lrequest->SetTimeoutMicroseconds(timeout_us);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestAddInput(SERVER_InferenceRequest* request,
+                                              const char* name,
+                                              const SERVER_DataType datatype,
+                                              const int64_t* shape,
+                                              uint64_t dim_count) {
+  core::InferenceRequest* lrequest = reinterpret_cast<core::InferenceRequest*>(request);
+  core::InferenceRequest::Input* input = nullptr;
+  return ServerError::Create(lrequest->AddInput(
+      name, core::ServerDataTypeToDataType(datatype),
+      std::vector<int64_t>(shape, shape + dim_count), &input));
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestAppendInputData(SERVER_InferenceRequest* request,
+                                                     const char* name,
+                                                     const void* base,
+                                                     size_t byte_size,
+                                                     SERVER_MemoryType memory_type,
+                                                     int64_t memory_type_id) {
+  core::InferenceRequest* lrequest = reinterpret_cast<core::InferenceRequest*>(request);
+  core::InferenceRequest::Input* input = nullptr;
+  core::Status status = lrequest->MutableInput(name, &input);
+  if (!status.IsOk()) {
+    return ServerError::Create(status);
+  }
+  input->AppendData(base, byte_size, memory_type, memory_type_id);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestAddRequestedOutput(SERVER_InferenceRequest* request,
+                                                        const char* name) {
+  core::InferenceRequest* lrequest = reinterpret_cast<core::InferenceRequest*>(request);
+  lrequest->AddRequestedOutput(name);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestCancel(SERVER_InferenceRequest* request) {
+  core::InferenceRequest* lrequest = reinterpret_cast<core::InferenceRequest*>(request);
+  lrequest->Cancel();
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestSetReleaseCallback(SERVER_InferenceRequest* request,
+                                                        SERVER_InferenceRequestReleaseFn_t release_fn,
+                                                        void* release_userp) {
+  core::InferenceRequest* lrequest = reinterpret_cast<core::InferenceRequest*>(request);
+  lrequest->SetReleaseCallback(
+      [release_fn, release_userp](std::unique_ptr<core::InferenceRequest>&& r) {
+        // The application takes the request back.
+        release_fn(reinterpret_cast<SERVER_InferenceRequest*>(r.release()),
+                   SERVER_REQUEST_RELEASE_ALL, release_userp);
+      });
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestSetResponseCallback(SERVER_InferenceRequest* request,
+                                                         SERVER_InferenceResponseCompleteFn_t response_fn,
+                                                         void* response_userp) {
+  core::InferenceRequest* lrequest = reinterpret_cast<core::InferenceRequest*>(request);
+  // The callback runs on the executor of the server the request is sent
+  // to, see SERVER_ServerInferAsync().
+  lrequest->SetResponseCallback(
+      [response_fn, response_userp](std::unique_ptr<core::InferenceResponse>&& r,
+                                    const uint32_t flags) {
+        response_fn(reinterpret_cast<SERVER_InferenceResponse*>(r.release()), flags,
+                    response_userp);
+      });
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceRequestSetResponseAllocator(SERVER_InferenceRequest* request,
+                                                          SERVER_ResponseAllocator* allocator,
+                                                          void* alloc_userp) {
+  core::InferenceRequest* lrequest = reinterpret_cast<core::InferenceRequest*>(request);
+  lrequest->SetResponseAllocator(reinterpret_cast<core::ResponseAllocator*>(allocator),
+                                 alloc_userp);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_ServerInferAsync(SERVER_Server* server, SERVER_InferenceRequest* request) {
+  core::InferenceServer* lserver = reinterpret_cast<core::InferenceServer*>(server);
+  std::unique_ptr<core::InferenceRequest> urequest(
+      reinterpret_cast<core::InferenceRequest*>(request));
+  core::Status status = lserver->InferAsync(urequest);
+  if (!status.IsOk()) {
+    // The caller keeps the request.
+    urequest.release();
+    return ServerError::Create(status);
+  }
+  return nullptr;
+}
+
+//
+// SERVER_InferenceResponse
+//
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceResponseDelete(SERVER_InferenceResponse* response) {
+  delete reinterpret_cast<core::InferenceResponse*>(response);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceResponseError(SERVER_InferenceResponse* response) {
+  core::InferenceResponse* lresponse = reinterpret_cast<core::InferenceResponse*>(response);
+  return ServerError::Create(lresponse->ResponseStatus());
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceResponseId(SERVER_InferenceResponse* response, const char** id) {
+  core::InferenceResponse* lresponse = reinterpret_cast<core::InferenceResponse*>(response);
+  *id = lresponse->Id().c_str();
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceResponseOutputCount(SERVER_InferenceResponse* response,
+                                                  uint32_t* count) {
+  core::InferenceResponse* lresponse = reinterpret_cast<core::InferenceResponse*>(response);
+  *count = lresponse->Outputs().size();
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceResponseOutput(SERVER_InferenceResponse* response,
+                                             const uint32_t index,
+                                             const char** name,
+                                             SERVER_DataType* datatype,
+                                             const int64_t** shape,
+                                             uint64_t* dim_count,
+                                             const void** base,
+                                             size_t* byte_size,
+                                             SERVER_MemoryType* memory_type,
+                                             int64_t* memory_type_id) {
+  core::InferenceResponse* lresponse = reinterpret_cast<core::InferenceResponse*>(response);
+  if (index >= lresponse->Outputs().size()) {
+    return ServerError::Create(
+        SERVER_ERROR_INVALID_ARG,
+        "out of bounds index " + std::to_string(index) + ": response has " +
+        std::to_string(lresponse->Outputs().size()) + " outputs");
+  }
+  const core::InferenceResponse::Output& output = lresponse->Outputs()[index];
+  *name = output.Name().c_str();
+  *datatype = core::DataTypeToServerDataType(output.DType());
+  *shape = output.Shape().data();
+  *dim_count = output.Shape().size();
+  *base = output.Buffer();
+  *byte_size = output.ByteSize();
+  *memory_type = output.MemoryType();
+  *memory_type_id = output.MemoryTypeId();
+  return nullptr;
+}
+
+//
+// SERVER_Metrics
+//
+API_DECLSPEC
+SERVER_Error* SERVER_ServerMetrics(SERVER_Server* /* server */, SERVER_Metrics** metrics) {
+  // The registry is shared by the servers of the process.
+  std::unique_ptr<ServerMetrics> lmetrics(new ServerMetrics());
+  core::RenderMetrics(&lmetrics->prometheus_text_);
+  *metrics = reinterpret_cast<SERVER_Metrics*>(lmetrics.release());
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_MetricsDelete(SERVER_Metrics* metrics) {
+  delete reinterpret_cast<ServerMetrics*>(metrics);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_MetricsFormatted(SERVER_Metrics* metrics, SERVER_MetricFormat format,
+                                      const char** base, size_t* byte_size) {
+  ServerMetrics* lmetrics = reinterpret_cast<ServerMetrics*>(metrics);
+  if (format != SERVER_METRIC_PROMETHEUS) {
+    return ServerError::Create(SERVER_ERROR_INVALID_ARG,
+                               "unknown metric format " + std::to_string(format));
+  }
+  *base = lmetrics->prometheus_text_.data();
+  *byte_size = lmetrics->prometheus_text_.size();
+  return nullptr;
+}
+
+//
+// SERVER_MetricFamily
+//
+API_DECLSPEC
+SERVER_Error* SERVER_MetricFamilyNew(SERVER_MetricFamily** family, const SERVER_MetricKind kind,
+                                     const char* name, const char* description) {
+  std::shared_ptr<core::MetricFamily> lfamily;
+  core::Status status = core::MetricFamily::Create(
+      kind, name, (description == nullptr) ? "" : description, &lfamily);
+  if (!status.IsOk()) {
+    return ServerError::Create(status);
+  }
+  *family = reinterpret_cast<SERVER_MetricFamily*>(
+      new std::shared_ptr<core::MetricFamily>(std::move(lfamily)));
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_MetricFamilyDelete(SERVER_MetricFamily* family) {
+  delete reinterpret_cast<std::shared_ptr<core::MetricFamily>*>(family);
+  return nullptr;
+}
+
+//
+// SERVER_Metric
+//
+API_DECLSPEC
+SERVER_Error* SERVER_MetricNew(SERVER_Metric** metric, SERVER_MetricFamily* family,
+                               const char* const* label_names,
+                               const char* const* label_values, const size_t label_count) {
+  std::shared_ptr<core::MetricFamily>* lfamily =
+      reinterpret_cast<std::shared_ptr<core::MetricFamily>*>(family);
+  std::map<std::string, std::string> labels;
+  for (size_t i = 0; i < label_count; ++i) {
+    if (!labels.emplace(label_names[i], label_values[i]).second) {
+      return ServerError::Create(SERVER_ERROR_INVALID_ARG,
+                                 "duplicate label '" + std::string(label_names[i]) + "'");
+    }
+  }
+  std::shared_ptr<core::Metric> lmetric;
+  core::Status status = (*lfamily)->CreateMetric(labels, &lmetric);
+  if (!status.IsOk()) {
+    return ServerError::Create(status);
+  }
+  *metric = reinterpret_cast<SERVER_Metric*>(
+      new std::shared_ptr<core::Metric>(std::move(lmetric)));
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_MetricDelete(SERVER_Metric* metric) {
+  delete reinterpret_cast<std::shared_ptr<core::Metric>*>(metric);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_GetMetricKind(SERVER_Metric* metric, SERVER_MetricKind* kind) {
+  *kind = (*reinterpret_cast<std::shared_ptr<core::Metric>*>(metric))->Kind();
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_MetricValue(SERVER_Metric* metric, double* value) {
+  core::Metric* lmetric = reinterpret_cast<std::shared_ptr<core::Metric>*>(metric)->get();
+  *value = (lmetric->Kind() == SERVER_METRIC_KIND_HISTOGRAM)
+               ? static_cast<double>(lmetric->Count())
+               : lmetric->Value();
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_MetricIncrement(SERVER_Metric* metric, double value) {
+  core::Metric* lmetric = reinterpret_cast<std::shared_ptr<core::Metric>*>(metric)->get();
+  if (lmetric->Kind() == SERVER_METRIC_KIND_HISTOGRAM) {
+    return ServerError::Create(SERVER_ERROR_UNSUPPORTED,
+                               "a histogram can't be incremented, values are observed");
+  }
+  if ((lmetric->Kind() == SERVER_METRIC_KIND_COUNTER) && (value < 0)) {
+    return ServerError::Create(SERVER_ERROR_INVALID_ARG,
+                               "a counter can't be incremented by a negative value");
+  }
+  lmetric->Increment(value);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_MetricSet(SERVER_Metric* metric, double value) {
+  core::Metric* lmetric = reinterpret_cast<std::shared_ptr<core::Metric>*>(metric)->get();
+  if (lmetric->Kind() != SERVER_METRIC_KIND_GAUGE) {
+    return ServerError::Create(SERVER_ERROR_UNSUPPORTED, "only a gauge can be set");
+  }
+  lmetric->Set(value);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_MetricObserve(SERVER_Metric* metric, double value) {
+  core::Metric* lmetric = reinterpret_cast<std::shared_ptr<core::Metric>*>(metric)->get();
+  if (lmetric->Kind() != SERVER_METRIC_KIND_HISTOGRAM) {
+    return ServerError::Create(SERVER_ERROR_UNSUPPORTED, "only a histogram observes values");
+  }
+  // The histogram counts integers, 2^64 is the first value out of range.
+  if (!(value >= 0) || (value >= 18446744073709551616.0) || (std::floor(value) != value)) {
+    return ServerError::Create(SERVER_ERROR_INVALID_ARG,
+                               "a histogram observes non-negative integers only");
+  }
+  lmetric->Observe(static_cast<uint64_t>(value));
+  return nullptr;
+}
+
+
+//
+// SERVER_InferenceTrace
+//
+API_DECLSPEC
+SERVER_Error* SERVER_ServerTrace(SERVER_Server* /* server */, SERVER_InferenceTrace** trace) {
+  // The events are shared by the servers of the process.
+  std::unique_ptr<ServerTrace> ltrace(new ServerTrace());
+  core::InferenceTracer::ExportChromeTrace(&ltrace->chrome_json_);
+  *trace = reinterpret_cast<SERVER_InferenceTrace*>(ltrace.release());
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceTraceDelete(SERVER_InferenceTrace* trace) {
+  delete reinterpret_cast<ServerTrace*>(trace);
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_InferenceTraceChromeJson(SERVER_InferenceTrace* trace, const char** base,
+                                              size_t* byte_size) {
+  ServerTrace* ltrace = reinterpret_cast<ServerTrace*>(trace);
+  *base = ltrace->chrome_json_.data();
+  *byte_size = ltrace->chrome_json_.size();
+  return nullptr;
+}
+
+//
+// SERVER_LocalTransport
+//
+API_DECLSPEC
+SERVER_Error* SERVER_LocalTransportNew(SERVER_LocalTransport** transport, SERVER_Server* server,
+                                       const char* name) {
+  std::unique_ptr<core::LocalTransport> ltransport;
+  core::Status status = core::LocalTransport::Create(
+      reinterpret_cast<core::InferenceServer*>(server), name, &ltransport);
+  if (!status.IsOk()) {
+    return ServerError::Create(status);
+  }
+  *transport = reinterpret_cast<SERVER_LocalTransport*>(ltransport.release());
+  return nullptr;
+}
+
+API_DECLSPEC
+SERVER_Error* SERVER_LocalTransportDelete(SERVER_LocalTransport* transport) {
+  delete reinterpret_cast<core::LocalTransport*>(transport);
+  return nullptr;
+}
+
 }
\ No newline at end of file
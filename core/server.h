@@ -5,6 +5,7 @@
 
 #include <atomic>
 #include <map>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
@@ -12,9 +13,12 @@
 
 #include "status.h"
 #include "constants.h"
+#include "executor.h"
 #include "model_config.h"
 #include "rate_limiter.h"
+#include "timing_wheel.h"
 #include "backend_manager.h"
+#include "model_repository_manager.h"
 
 namespace core {
 
@@ -63,6 +67,65 @@ class InferenceServer {
   Status IsLive(bool* live);
   Status IsReady(bool* ready);
 
+  // Get the model of 'model_name' with 'model_version'. If the
+  // version is -1 the latest available version is returned.
+  Status GetModel(const std::string& model_name,
+                  const int64_t model_version,
+                  std::shared_ptr<Model>* model);
+
+  // Run 'request' asynchronously. On success the server owns the
+  // request until it is released, on failure 'request' keeps it.
+  Status InferAsync(std::unique_ptr<InferenceRequest>& request);
+
+  // Return the states of all the models in the repositories.
+  const ModelRepositoryManager::ModelStateMap ModelStates();
+
+  // Spread the requests of 'model_name' that do not ask for a version
+  // over its loaded versions by weight, an empty map sends them all to
+  // the latest version.
+  Status SetModelVersionTraffic(const std::string& model_name,
+                                const ModelRepositoryManager::VersionWeightMap& weights);
+
+  // Get the version traffic of 'model_name'.
+  Status ModelVersionTraffic(const std::string& model_name,
+                             ModelRepositoryManager::VersionWeightMap* weights);
+
+  // Get the memory used by each loaded version of 'model_name'.
+  Status GetModelMemoryUsage(const std::string& model_name,
+                             std::map<int64_t, ModelMemoryUsage>* usage);
+
+  // Get the loaded versions of 'model_name'.
+  Status GetLoadedModelVersions(const std::string& model_name,
+                                std::map<int64_t, std::shared_ptr<Model>>* models);
+
+  // Set the model repository paths. Must be called before Init().
+  void SetModelRepositoryPaths(const std::set<std::string>& paths) {
+    model_repository_paths_ = paths;
+  }
+
+  // Set the number of threads used to load models concurrently.
+  void SetModelLoadThreadCount(const size_t count) {
+    model_load_thread_count_ = count;
+  }
+
+  // Set the rate the requests are traced at, one in 'rate' requests and
+  // none if 0.
+  void SetTraceRate(const uint32_t rate) { trace_rate_ = rate; }
+
+  // Set whether the models are loaded on their first request, and when
+  // such models are unloaded again. Must be called before Init().
+  void SetModelLoadOptions(const ModelLoadOptions& options) {
+    model_load_options_ = options;
+  }
+
+  // Set the backend and host policy command line configs.
+  void SetBackendCmdlineConfig(const BackendCmdlineConfigMap& bc) {
+    backend_cmdline_config_map_ = bc;
+  }
+  void SetHostPolicyCmdlineConfig(const HostPolicyCmdlineConfigMap& hp) {
+    host_policy_map_ = hp;
+  }
+
   // Get the Backend Manager
   const std::shared_ptr<BackendManager> GetBackendManager() {
     return backend_manager_;
@@ -71,11 +134,25 @@ class InferenceServer {
   // Return the pointer to RateLimiter object.
   std::shared_ptr<RateLimiter> GetRateLimiter() { return rate_limiter_; }
 
+  // Return the executor running the parallel work of the core.
+  std::shared_ptr<Executor> GetExecutor() { return executor_; }
+
+  // Return the executor delivering the responses to the clients.
+  std::shared_ptr<Executor> GetResponseExecutor() { return response_executor_; }
+
+  // Return the timer service the timeouts of the core expire on.
+  std::shared_ptr<TimerService> GetTimerService() { return timer_service_; }
+
  private:
   const std::string version_;
   std::string id_;
   std::vector<const char*> extensions_;
 
+  std::set<std::string> model_repository_paths_;
+  size_t model_load_thread_count_;
+  uint32_t trace_rate_;
+  ModelLoadOptions model_load_options_;
+
   BackendCmdlineConfigMap backend_cmdline_config_map_;
   HostPolicyCmdlineConfigMap host_policy_map_;
 
@@ -83,7 +160,10 @@ class InferenceServer {
   ServerReadyState ready_state_;
 
   std::shared_ptr<RateLimiter> rate_limiter_;
-  // std::unique_ptr<ModelRepositoryManager> model_repository_manager_;
+  std::shared_ptr<Executor> executor_;
+  std::shared_ptr<Executor> response_executor_;
+  std::shared_ptr<TimerService> timer_service_;
+  std::unique_ptr<ModelRepositoryManager> model_repository_manager_;
   std::shared_ptr<BackendManager> backend_manager_;
 };
 
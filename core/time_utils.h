@@ -0,0 +1,15 @@
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+
+namespace core {
+
+/// Capture the current time of the steady clock.
+/// \return The time in nanoseconds.
+inline uint64_t CaptureTimeNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace core
@@ -0,0 +1,265 @@
+#include "timing_wheel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "time_utils.h"
+
+namespace core {
+
+constexpr size_t TimingWheel::kLevels;
+constexpr size_t TimingWheel::kSlotBits;
+constexpr size_t TimingWheel::kSlots;
+
+TimingWheel::TimingWheel(const uint64_t start_tick)
+  : current_tick_(start_tick), size_(0) {
+  for (size_t level = 0; level < kLevels; ++level) {
+    std::fill(heads_[level], heads_[level] + kSlots, -1);
+  }
+}
+
+TimingWheel::TimerId TimingWheel::Schedule(const uint64_t expiry_tick,
+                                           std::function<void()> callback) {
+  size_t index;
+  if (free_timers_.empty()) {
+    index = timers_.size();
+    timers_.emplace_back();
+    timers_[index].generation_ = 0;
+  } else {
+    index = free_timers_.back();
+    free_timers_.pop_back();
+  }
+  Timer& timer = timers_[index];
+  // The slot of the current tick was handled already.
+  timer.expiry_tick_ = std::max(expiry_tick, current_tick_ + 1);
+  timer.callback_ = std::move(callback);
+  ++timer.generation_;
+  timer.pending_ = true;
+  Insert(index);
+  ++size_;
+  return (static_cast<uint64_t>(timer.generation_) << 32) | (index + 1);
+}
+
+bool TimingWheel::Cancel(const TimerId id) {
+  if (Find(id) == nullptr) {
+    return false;
+  }
+  const size_t index = (id & 0xffffffff) - 1;
+  Unlink(index);
+  timers_[index].pending_ = false;
+  timers_[index].callback_ = nullptr;
+  free_timers_.push_back(index);
+  --size_;
+  return true;
+}
+
+bool TimingWheel::Pending(const TimerId id) const {
+  return (Find(id) != nullptr);
+}
+
+const TimingWheel::Timer* TimingWheel::Find(const TimerId id) const {
+  const uint64_t index = id & 0xffffffff;
+  if ((index == 0) || (index > timers_.size())) {
+    return nullptr;
+  }
+  const Timer& timer = timers_[index - 1];
+  if (!timer.pending_ || (timer.generation_ != (id >> 32))) {
+    return nullptr;
+  }
+  return &timer;
+}
+
+void TimingWheel::Insert(const size_t index) {
+  Timer& timer = timers_[index];
+  // A timer further out than the wheel reaches waits in the last slot it
+  // reaches and is placed again from there.
+  const uint64_t span = 1ULL << (kSlotBits * kLevels);
+  const uint64_t delta = timer.expiry_tick_ - std::min(timer.expiry_tick_, current_tick_);
+  const uint64_t slot_tick = (delta < span) ? timer.expiry_tick_ : current_tick_ + span - 1;
+  size_t level = 0;
+  while ((level + 1 < kLevels) &&
+         ((slot_tick - current_tick_) >= (1ULL << (kSlotBits * (level + 1))))) {
+    ++level;
+  }
+  timer.level_ = level;
+  timer.slot_ = (slot_tick >> (kSlotBits * level)) & (kSlots - 1);
+  timer.prev_ = -1;
+  timer.next_ = heads_[level][timer.slot_];
+  if (timer.next_ != -1) {
+    timers_[timer.next_].prev_ = index;
+  }
+  heads_[level][timer.slot_] = index;
+}
+
+void TimingWheel::Unlink(const size_t index) {
+  Timer& timer = timers_[index];
+  if (timer.prev_ != -1) {
+    timers_[timer.prev_].next_ = timer.next_;
+  } else {
+    heads_[timer.level_][timer.slot_] = timer.next_;
+  }
+  if (timer.next_ != -1) {
+    timers_[timer.next_].prev_ = timer.prev_;
+  }
+}
+
+void TimingWheel::Cascade(const size_t level, const size_t slot) {
+  int64_t index = heads_[level][slot];
+  heads_[level][slot] = -1;
+  while (index != -1) {
+    const int64_t next = timers_[index].next_;
+    Insert(index);
+    index = next;
+  }
+}
+
+void TimingWheel::Advance(const uint64_t tick, std::vector<std::function<void()>>* expired) {
+  while (current_tick_ < tick) {
+    // Skip the ticks where nothing happens.
+    const uint64_t next_tick = NextTick();
+    if (next_tick > tick) {
+      current_tick_ = tick;
+      break;
+    }
+    current_tick_ = next_tick;
+    // Move the timers of the levels that wrapped around down, the higher
+    // levels first so that their timers move all the way down.
+    size_t wrapped = 0;
+    while ((wrapped + 1 < kLevels) &&
+           ((current_tick_ & ((1ULL << (kSlotBits * (wrapped + 1))) - 1)) == 0)) {
+      ++wrapped;
+    }
+    for (size_t level = wrapped; level > 0; --level) {
+      Cascade(level, (current_tick_ >> (kSlotBits * level)) & (kSlots - 1));
+    }
+    const size_t slot = current_tick_ & (kSlots - 1);
+    while (heads_[0][slot] != -1) {
+      const size_t index = heads_[0][slot];
+      Unlink(index);
+      Timer& timer = timers_[index];
+      timer.pending_ = false;
+      expired->push_back(std::move(timer.callback_));
+      timer.callback_ = nullptr;
+      free_timers_.push_back(index);
+      --size_;
+    }
+  }
+}
+
+uint64_t TimingWheel::NextTick() const {
+  // The earliest tick a slot holding timers is reached, on the lowest
+  // level the timers expire, on the others they move down. The timers
+  // of a level are all within one turn of it.
+  uint64_t next_tick = std::numeric_limits<uint64_t>::max();
+  if (size_ == 0) {
+    return next_tick;
+  }
+  for (size_t level = 0; level < kLevels; ++level) {
+    const size_t shift = kSlotBits * level;
+    const uint64_t current_slot = current_tick_ >> shift;
+    for (uint64_t slot = current_slot + 1; slot <= current_slot + kSlots; ++slot) {
+      if ((slot << shift) >= next_tick) {
+        break;
+      }
+      if (heads_[level][slot & (kSlots - 1)] != -1) {
+        next_tick = slot << shift;
+        break;
+      }
+    }
+  }
+  return next_tick;
+}
+
+Status TimerService::Create(const uint64_t resolution_ns,
+                            std::unique_ptr<TimerService>* service) {
+  if (resolution_ns == 0) {
+    return Status(Status::Code::INVALID_ARG, "timer resolution must be greater than 0");
+  }
+  std::unique_ptr<TimerService> local_service(new TimerService(resolution_ns));
+  TimerService* raw_service = local_service.get();
+  local_service->thread_ = std::thread([raw_service]() { raw_service->TimerThread(); });
+  *service = std::move(local_service);
+  return Status::Success;
+}
+
+TimerService::TimerService(const uint64_t resolution_ns)
+  : resolution_ns_(resolution_ns),
+    wheel_(CaptureTimeNs() / resolution_ns),
+    wake_tick_(std::numeric_limits<uint64_t>::max()),
+    exit_(false) {}
+
+TimerService::~TimerService() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    exit_ = true;
+  }
+  cv_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+TimerService::TimerId TimerService::Schedule(const uint64_t expiry_ns,
+                                             std::function<void()> callback) {
+  // Rounded up, a timer never expires early.
+  const uint64_t expiry_tick = (expiry_ns + resolution_ns_ - 1) / resolution_ns_;
+  std::lock_guard<std::mutex> lock(mu_);
+  const TimerId id = wheel_.Schedule(expiry_tick, std::move(callback));
+  // Only a timer due before the thread wakes up needs to wake it. The
+  // thread advances the wheel past any level change on the way, so the
+  // expiry is compared rather than the next tick of the wheel.
+  if (expiry_tick < wake_tick_) {
+    cv_.notify_one();
+  }
+  return id;
+}
+
+bool TimerService::Cancel(const TimerId id) {
+  std::lock_guard<std::mutex> lock(mu_);
+  return wheel_.Cancel(id);
+}
+
+bool TimerService::Pending(const TimerId id) {
+  std::lock_guard<std::mutex> lock(mu_);
+  return wheel_.Pending(id);
+}
+
+void TimerService::WaitForCallbacks() {
+  std::lock_guard<std::mutex> lock(callback_mu_);
+}
+
+void TimerService::TimerThread() {
+  std::vector<std::function<void()>> expired;
+  std::unique_lock<std::mutex> lock(mu_);
+  while (!exit_) {
+    wheel_.Advance(CaptureTimeNs() / resolution_ns_, &expired);
+    if (!expired.empty()) {
+      // The callbacks may schedule and cancel timers. Taking
+      // 'callback_mu_' before letting go of 'mu_' makes a timer that is
+      // no longer pending visible to WaitForCallbacks().
+      std::unique_lock<std::mutex> callback_lock(callback_mu_);
+      lock.unlock();
+      for (auto& callback : expired) {
+        callback();
+      }
+      expired.clear();
+      callback_lock.unlock();
+      lock.lock();
+      continue;
+    }
+    wake_tick_ = wheel_.NextTick();
+    if (wake_tick_ == std::numeric_limits<uint64_t>::max()) {
+      cv_.wait(lock);
+    } else {
+      const uint64_t now_ns = CaptureTimeNs();
+      const uint64_t wake_ns = wake_tick_ * resolution_ns_;
+      if (wake_ns > now_ns) {
+        cv_.wait_for(lock, std::chrono::nanoseconds(wake_ns - now_ns));
+      }
+    }
+    wake_tick_ = std::numeric_limits<uint64_t>::max();
+  }
+}
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "status.h"
+#include "constants.h"
+
+namespace core {
+
+// A hierarchical timing wheel counting time in ticks. Each level has 256
+// slots, a slot of a level spans all the slots of the level below, and
+// the timers of a slot move down a level when the level below wraps
+// around. Scheduling and cancelling a timer take constant time whatever
+// the number of timers. Not thread-safe, see TimerService.
+class TimingWheel {
+ public:
+  // Identifies a scheduled timer, 0 is never a valid id.
+  using TimerId = uint64_t;
+
+  explicit TimingWheel(const uint64_t start_tick);
+
+  // Schedule 'callback' to expire at 'expiry_tick', at the next tick if
+  // that has passed already.
+  TimerId Schedule(const uint64_t expiry_tick, std::function<void()> callback);
+
+  // Cancel the timer 'id'. Return false if it already expired or was
+  // cancelled.
+  bool Cancel(const TimerId id);
+
+  // Return true if the timer 'id' has neither expired nor been cancelled.
+  bool Pending(const TimerId id) const;
+
+  // Advance the wheel to 'tick', appending the callbacks of the timers
+  // that expired on the way to 'expired'.
+  void Advance(const uint64_t tick, std::vector<std::function<void()>>* expired);
+
+  // The tick the wheel must be advanced to for the next timer to expire
+  // or to move down a level, UINT64_MAX if no timer is pending.
+  uint64_t NextTick() const;
+
+  uint64_t CurrentTick() const { return current_tick_; }
+  size_t Size() const { return size_; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TimingWheel);
+
+  static constexpr size_t kLevels = 4;
+  static constexpr size_t kSlotBits = 8;
+  static constexpr size_t kSlots = 1 << kSlotBits;
+
+  struct Timer {
+    uint64_t expiry_tick_;
+    std::function<void()> callback_;
+    // Bumped each time the entry is reused so that stale ids don't match.
+    uint32_t generation_;
+    bool pending_;
+    // The slot the timer is linked in, and its neighbours there by entry
+    // index, -1 for none.
+    size_t level_;
+    size_t slot_;
+    int64_t prev_;
+    int64_t next_;
+  };
+
+  // Link timer 'index' into the slot of its expiry.
+  void Insert(const size_t index);
+  // Unlink timer 'index' from its slot.
+  void Unlink(const size_t index);
+  // Move the timers of 'slot' of 'level' down a level.
+  void Cascade(const size_t level, const size_t slot);
+  // The entry of 'id', nullptr if it is not pending.
+  const Timer* Find(const TimerId id) const;
+
+  uint64_t current_tick_;
+  size_t size_;
+  std::vector<Timer> timers_;
+  std::vector<size_t> free_timers_;
+  // The first timer of each slot, -1 if the slot is empty.
+  int64_t heads_[kLevels][kSlots];
+};
+
+// Runs callbacks at given times on a single thread, using a timing wheel
+// so that hundreds of thousands of pending timers cost no more to manage
+// than a few. Timers expire at most one resolution late. The callbacks
+// must be short, they delay the timers that follow.
+class TimerService {
+ public:
+  using TimerId = TimingWheel::TimerId;
+
+  // Create a timer service whose timers expire in steps of
+  // 'resolution_ns'.
+  static Status Create(const uint64_t resolution_ns, std::unique_ptr<TimerService>* service);
+  // Stop the thread, the pending timers never expire.
+  ~TimerService();
+
+  // Run 'callback' once the steady clock reaches 'expiry_ns'.
+  TimerId Schedule(const uint64_t expiry_ns, std::function<void()> callback);
+
+  // Cancel the timer 'id'. Return false if it expired or was cancelled,
+  // its callback may still be running then, see WaitForCallbacks().
+  bool Cancel(const TimerId id);
+
+  // Return true if the timer 'id' has neither expired nor been cancelled.
+  bool Pending(const TimerId id);
+
+  // Wait for the callbacks being run, if any, to return.
+  void WaitForCallbacks();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TimerService);
+  explicit TimerService(const uint64_t resolution_ns);
+
+  void TimerThread();
+
+  const uint64_t resolution_ns_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  TimingWheel wheel_;
+  // The tick the thread sleeps until, UINT64_MAX if it waits for a timer.
+  uint64_t wake_tick_;
+  bool exit_;
+  // Held while the expired callbacks run.
+  std::mutex callback_mu_;
+  std::thread thread_;
+};
+
+}
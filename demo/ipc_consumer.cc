@@ -1,34 +1,63 @@
-#include <boost/interprocess/ipc/message_queue.hpp>
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
 #include <iostream>
-#include <vector>
-
-using namespace boost::interprocess;
-
-int main ()
-{
-   BOOST_TRY{
-      //Open a message queue.
-      message_queue mq
-         (open_only        //only open
-         ,"message_queue"  //name
-         );
-
-      unsigned int priority;
-      message_queue::size_type recvd_size;
-
-      //Receive 100 numbers
-      for(int i = 0; i < 100; ++i){
-         int number;
-         mq.receive(&number, sizeof(number), recvd_size, priority);
-         if(number != i || recvd_size != sizeof(number))
-            return 1;
-      }
-   }
-   BOOST_CATCH(interprocess_exception &ex){
-      message_queue::remove("message_queue");
-      std::cout << ex.what() << std::endl;
-      return 1;
-   } BOOST_CATCH_END
-   message_queue::remove("message_queue");
-   return 0;
-}
\ No newline at end of file
+#include <thread>
+
+#include "interface/IServer.h"
+
+namespace {
+std::atomic<bool> exiting(false);
+
+void OnSignal(int) { exiting = true; }
+
+bool Check(SERVER_Error* error, const char* what) {
+  if (error == nullptr) {
+    return true;
+  }
+  std::cerr << what << ": " << SERVER_ErrorMessage(error) << std::endl;
+  SERVER_ErrorDelete(error);
+  return false;
+}
+}  // namespace
+
+// Serve the models of a repository to the processes on the same host
+// through the local transport, until interrupted.
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <model repository> <backend directory> [transport]"
+              << std::endl;
+    return 1;
+  }
+  const char* name = (argc > 3) ? argv[3] : "ai_engine";
+
+  SERVER_ServerOptions* options = nullptr;
+  if (!Check(SERVER_ServerOptionsNew(&options), "creating the server options") ||
+      !Check(SERVER_ServerOptionsSetModelRepositoryPath(options, argv[1]),
+             "setting the model repository") ||
+      !Check(SERVER_ServerOptionsSetBackendDirectory(options, argv[2]),
+             "setting the backend directory")) {
+    return 1;
+  }
+  SERVER_Server* server = nullptr;
+  const bool created = Check(SERVER_ServerNew(&server, options), "creating the server");
+  SERVER_ServerOptionsDelete(options);
+  if (!created) {
+    return 1;
+  }
+  SERVER_LocalTransport* transport = nullptr;
+  if (!Check(SERVER_LocalTransportNew(&transport, server, name), "starting the transport")) {
+    SERVER_ServerDelete(server);
+    return 1;
+  }
+  std::cout << "serving on local transport '" << name << "'" << std::endl;
+
+  signal(SIGINT, OnSignal);
+  signal(SIGTERM, OnSignal);
+  while (!exiting) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  SERVER_LocalTransportDelete(transport);
+  return Check(SERVER_ServerDelete(server), "stopping the server") ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/local_transport_client.h"
+
+// Run inferences of a model with one FP32 input through the local
+// transport of a server on the same host, writing the input in place in
+// shared memory, and print the outputs and the latency.
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    std::cerr << "usage: " << argv[0] << " <model> <input> <dim>... [-n <count>] [-t <transport>]"
+              << std::endl;
+    return 1;
+  }
+  const std::string model = argv[1];
+  const std::string input = argv[2];
+  std::vector<int64_t> shape;
+  size_t count = 10;
+  std::string name = "ai_engine";
+  for (int i = 3; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if ((arg == "-n") && (i + 1 < argc)) {
+      count = strtoull(argv[++i], nullptr, 10);
+    } else if ((arg == "-t") && (i + 1 < argc)) {
+      name = argv[++i];
+    } else {
+      shape.push_back(strtoll(argv[i], nullptr, 10));
+    }
+  }
+  size_t element_count = 1;
+  for (const int64_t dim : shape) {
+    element_count *= dim;
+  }
+  const size_t byte_size = element_count * sizeof(float);
+
+  std::unique_ptr<common::LocalTransportClient> client;
+  common::Error error = common::LocalTransportClient::Create(
+      name, "producer" + std::to_string(getpid()), byte_size, 64 * 1024 * 1024,
+      1000 /* timeout_ms */, &client);
+  if (!error.IsOk()) {
+    std::cerr << error.AsString() << std::endl;
+    return 1;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    void* buffer = nullptr;
+    error = client->AddInput(input, SERVER_TYPE_FP32, shape, byte_size, &buffer);
+    if (!error.IsOk()) {
+      std::cerr << error.AsString() << std::endl;
+      return 1;
+    }
+    float* data = static_cast<float*>(buffer);
+    for (size_t j = 0; j < element_count; ++j) {
+      data[j] = static_cast<float>(i + j);
+    }
+    std::vector<common::LocalTransportClient::Output> outputs;
+    const auto start = std::chrono::steady_clock::now();
+    error = client->Infer(model, -1, 10000 /* timeout_ms */, &outputs);
+    const auto end = std::chrono::steady_clock::now();
+    if (!error.IsOk()) {
+      std::cerr << error.AsString() << std::endl;
+      return 1;
+    }
+    std::cout << "inference " << i << " in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()
+              << "us:";
+    for (const auto& output : outputs) {
+      std::cout << " " << output.name_ << " [";
+      for (size_t j = 0; j < output.shape_.size(); ++j) {
+        std::cout << ((j == 0) ? "" : ",") << output.shape_[j];
+      }
+      std::cout << "] " << output.byte_size_ << " bytes";
+    }
+    std::cout << std::endl;
+  }
+  return 0;
+}
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "IServer.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -47,6 +50,499 @@ typedef enum BACKEND_execpolicy_enum {
   BACKEND_EXECUTION_DEVICE_BLOCKING
 } BACKEND_ExecutionPolicy;
 
+/// Report the memory the model holds outside of its instances, such as
+/// weights shared by the instances. The reported size replaces the size
+/// previously reported for the same memory type and id.
+///
+/// \param model The model.
+/// \param memory_type The type of the memory.
+/// \param memory_type_id The id of the memory, the device for GPU memory.
+/// \param byte_size The bytes in use.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelReportMemoryUsage(struct BACKEND_Model* model,
+                                                    SERVER_MemoryType memory_type,
+                                                    int64_t memory_type_id,
+                                                    uint64_t byte_size);
+
+/// Have the server gather the inputs of the batches of the model, see
+/// BACKEND_ModelInstanceBatchInput. The inputs of a batch are copied as
+/// the batch is formed, while the instance still executes the previous
+/// batches, as many batches ahead as the "pipeline_depth" model
+/// parameter allows. Called from BACKEND_ModelInitialize.
+///
+/// \param model The model.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelGatherBatchInputs(struct BACKEND_Model* model);
+
+/// Report the memory held by a model instance. The reported size
+/// replaces the size previously reported for the same memory type and
+/// id.
+///
+/// \param instance The model instance.
+/// \param memory_type The type of the memory.
+/// \param memory_type_id The id of the memory, the device for GPU memory.
+/// \param byte_size The bytes in use.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceReportMemoryUsage(struct BACKEND_ModelInstance* instance,
+                                                            SERVER_MemoryType memory_type,
+                                                            int64_t memory_type_id,
+                                                            uint64_t byte_size);
+
+/// Report the execution of a request by a model instance, once for each
+/// request of a batch. The timestamps are of the steady clock in
+/// nanoseconds: when the execution started, when the inference started
+/// once the inputs were ready, when it ended, and when the outputs were
+/// done. The statistics are read with SERVER_ServerModelStatistics.
+///
+/// \param instance The model instance.
+/// \param success Whether the request succeeded, the timestamps of a
+/// failed request are ignored.
+/// \param exec_start_ns The start of the execution.
+/// \param compute_start_ns The start of the inference.
+/// \param compute_end_ns The end of the inference.
+/// \param exec_end_ns The end of the execution.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceReportStatistics(struct BACKEND_ModelInstance* instance,
+                                                          const bool success,
+                                                          const uint64_t exec_start_ns,
+                                                          const uint64_t compute_start_ns,
+                                                          const uint64_t compute_end_ns,
+                                                          const uint64_t exec_end_ns);
+
+/// Report the execution of a batch by a model instance, once per batch,
+/// with the timestamps of BACKEND_ModelInstanceReportStatistics. The
+/// statistics are kept per batch size.
+///
+/// \param instance The model instance.
+/// \param batch_size The total batch size of the requests of the batch.
+/// \param exec_start_ns The start of the execution.
+/// \param compute_start_ns The start of the inference.
+/// \param compute_end_ns The end of the inference.
+/// \param exec_end_ns The end of the execution.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceReportBatchStatistics(
+    struct BACKEND_ModelInstance* instance, const uint64_t batch_size,
+    const uint64_t exec_start_ns, const uint64_t compute_start_ns,
+    const uint64_t compute_end_ns, const uint64_t exec_end_ns);
+
+/// Create the statistics of a response of a decoupled model, filled
+/// with the setters below and reported with
+/// BACKEND_ModelInstanceReportResponseStatistics.
+///
+/// \param response_statistics Returns the new response statistics.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceResponseStatisticsNew(
+    struct BACKEND_ModelInstanceResponseStatistics** response_statistics);
+
+/// Delete response statistics.
+///
+/// \param response_statistics The response statistics.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceResponseStatisticsDelete(
+    struct BACKEND_ModelInstanceResponseStatistics* response_statistics);
+
+/// Set the model instance that produced the response.
+///
+/// \param response_statistics The response statistics.
+/// \param instance The model instance.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceResponseStatisticsSetModelInstance(
+    struct BACKEND_ModelInstanceResponseStatistics* response_statistics,
+    struct BACKEND_ModelInstance* instance);
+
+/// Set when the backend started producing the response, in nanoseconds
+/// of the steady clock.
+///
+/// \param response_statistics The response statistics.
+/// \param response_start_ns The start of the response.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceResponseStatisticsSetResponseStart(
+    struct BACKEND_ModelInstanceResponseStatistics* response_statistics,
+    const uint64_t response_start_ns);
+
+/// Set when the backend started writing the outputs of the response.
+///
+/// \param response_statistics The response statistics.
+/// \param compute_output_start_ns The start of the outputs.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceResponseStatisticsSetComputeOutputStart(
+    struct BACKEND_ModelInstanceResponseStatistics* response_statistics,
+    const uint64_t compute_output_start_ns);
+
+/// Set when the response was done.
+///
+/// \param response_statistics The response statistics.
+/// \param response_end_ns The end of the response.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceResponseStatisticsSetResponseEnd(
+    struct BACKEND_ModelInstanceResponseStatistics* response_statistics,
+    const uint64_t response_end_ns);
+
+/// Set the error the response carries, nullptr if it succeeded. The
+/// caller keeps ownership of the error.
+///
+/// \param response_statistics The response statistics.
+/// \param error The error of the response.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceResponseStatisticsSetError(
+    struct BACKEND_ModelInstanceResponseStatistics* response_statistics,
+    struct SERVER_Error* error);
+
+/// Report the statistics of a response to the model of its instance,
+/// which must be set.
+///
+/// \param response_statistics The response statistics.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceReportResponseStatistics(
+    struct BACKEND_ModelInstanceResponseStatistics* response_statistics);
+
+/// Get the id of a request.
+///
+/// \param request The request.
+/// \param id Returns the id, valid as long as the request.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_RequestId(struct BACKEND_Request* request, const char** id);
+
+/// Get the number of inputs of a request.
+///
+/// \param request The request.
+/// \param count Returns the number of inputs.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_RequestInputCount(struct BACKEND_Request* request,
+                                              uint32_t* count);
+
+/// Get an input of a request by index, in the order the inputs were
+/// added. The input is valid as long as the request.
+///
+/// \param request The request.
+/// \param index The index of the input, from 0 to the input count.
+/// \param input Returns the input.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_RequestInput(struct BACKEND_Request* request,
+                                         const uint32_t index,
+                                         struct BACKEND_Input** input);
+
+/// Get an input of a request by name. The input is valid as long as the
+/// request.
+///
+/// \param request The request.
+/// \param name The name of the input.
+/// \param input Returns the input.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_RequestInputByName(struct BACKEND_Request* request,
+                                               const char* name,
+                                               struct BACKEND_Input** input);
+
+/// Get the number of outputs the client requested, 0 if it wants all the
+/// outputs of the model.
+///
+/// \param request The request.
+/// \param count Returns the number of requested outputs.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_RequestOutputCount(struct BACKEND_Request* request,
+                                               uint32_t* count);
+
+/// Get the name of a requested output by index.
+///
+/// \param request The request.
+/// \param index The index of the output, from 0 to the output count.
+/// \param name Returns the name, valid as long as the request.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_RequestOutputName(struct BACKEND_Request* request,
+                                              const uint32_t index,
+                                              const char** name);
+
+/// Get the properties of an input. Any of the returned values may be
+/// skipped by passing nullptr.
+///
+/// \param input The input.
+/// \param name Returns the name of the input.
+/// \param datatype Returns the data type of the input.
+/// \param shape Returns the shape of the input, valid as long as the
+/// request.
+/// \param dims_count Returns the number of dimensions of 'shape'.
+/// \param byte_size Returns the size of the data over all the buffers.
+/// \param buffer_count Returns the number of buffers holding the data.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_InputProperties(struct BACKEND_Input* input,
+                                            const char** name,
+                                            SERVER_DataType* datatype,
+                                            const int64_t** shape,
+                                            uint32_t* dims_count,
+                                            uint64_t* byte_size,
+                                            uint32_t* buffer_count);
+
+/// Get a buffer of the data of an input. The buffer is where the client
+/// put the data, it is not copied, and is valid as long as the request.
+///
+/// \param input The input.
+/// \param index The index of the buffer, from 0 to the buffer count.
+/// \param buffer Returns the buffer.
+/// \param buffer_byte_size Returns the size of the buffer in bytes.
+/// \param memory_type Returns the type of the memory of the buffer.
+/// \param memory_type_id Returns the id of the memory of the buffer.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_InputBuffer(struct BACKEND_Input* input,
+                                        const uint32_t index,
+                                        const void** buffer,
+                                        uint64_t* buffer_byte_size,
+                                        SERVER_MemoryType* memory_type,
+                                        int64_t* memory_type_id);
+
+/// Get the data of an input of all the requests of the batch an instance
+/// executes, concatenated in the order of the requests into one buffer
+/// in CPU memory. Only for a model whose inputs are gathered, see
+/// BACKEND_ModelGatherBatchInputs, and only within
+/// BACKEND_ModelInstanceExecute. The buffer is valid until the execution
+/// returns. An input missing from a request or held outside of CPU
+/// memory is not gathered, the backend reads it from the requests.
+///
+/// \param instance The model instance executing the batch.
+/// \param name The name of the input.
+/// \param buffer Returns the gathered data.
+/// \param byte_size Returns the size of the gathered data.
+/// \return a SERVER_Error indicating success or failure, UNAVAILABLE if
+/// the input was not gathered.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ModelInstanceBatchInput(struct BACKEND_ModelInstance* instance,
+                                                    const char* name,
+                                                    const void** buffer,
+                                                    uint64_t* byte_size);
+
+/// Query whether a request was cancelled. A backend may poll it while
+/// it executes the request and stop early, the request must still be
+/// released. A cancelled request that is not yet executing is dropped
+/// by the server without reaching the backend.
+///
+/// \param request The request.
+/// \param is_cancelled Returns true if the request was cancelled.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_RequestIsCancelled(struct BACKEND_Request* request,
+                                               bool* is_cancelled);
+
+/// Release a request once the backend is done with it, the backend
+/// must not access the request afterwards. The responses of the request
+/// may still be sent after it is released.
+///
+/// \param request The request.
+/// \param release_flags Flags from SERVER_RequestReleaseFlag, must be
+/// SERVER_REQUEST_RELEASE_ALL.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_RequestRelease(struct BACKEND_Request* request,
+                                           uint32_t release_flags);
+
+/// Create the response factory of a request. A decoupled model uses the
+/// factory to send the responses of a request at any time, also after
+/// releasing the request. All the factories of a request share its
+/// responses, which reach the client in the order they are sent.
+///
+/// \param factory Returns the new response factory.
+/// \param request The request.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ResponseFactoryNew(struct BACKEND_ResponseFactory** factory,
+                                               struct BACKEND_Request* request);
+
+/// Delete a response factory.
+///
+/// \param factory The response factory.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ResponseFactoryDelete(struct BACKEND_ResponseFactory* factory);
+
+/// Send flags without a response, typically the final flag once the
+/// last response of a decoupled model was sent. May wait, see
+/// BACKEND_ResponseSend.
+///
+/// \param factory The response factory.
+/// \param send_flags Flags from SERVER_ResponseCompleteFlag.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ResponseFactorySendFlags(struct BACKEND_ResponseFactory* factory,
+                                                     uint32_t send_flags);
+
+/// Create a response for a request.
+///
+/// \param response Returns the new response.
+/// \param request The request.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ResponseNew(struct BACKEND_Response** response,
+                                        struct BACKEND_Request* request);
+
+/// Create a response from the response factory of a request.
+///
+/// \param response Returns the new response.
+/// \param factory The response factory.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ResponseNewFromFactory(struct BACKEND_Response** response,
+                                                   struct BACKEND_ResponseFactory* factory);
+
+/// Delete a response that is not sent.
+///
+/// \param response The response.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ResponseDelete(struct BACKEND_Response* response);
+
+/// Add an output to a response. The output must be one of the outputs
+/// of the model configuration and is owned by the response.
+///
+/// \param response The response.
+/// \param output Returns the new output.
+/// \param name The name of the output.
+/// \param shape The shape of the output.
+/// \param dims_count The number of dimensions of 'shape'.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ResponseOutput(struct BACKEND_Response* response,
+                                           struct BACKEND_Output** output,
+                                           const char* name,
+                                           const int64_t* shape,
+                                           uint32_t dims_count);
+
+/// Get the buffer the data of an output is written to, valid until the
+/// response is deleted. The buffer comes from the response allocator
+/// the client set on the request, so the data is written once, where the
+/// client reads it.
+///
+/// \param output The output.
+/// \param buffer Returns the buffer.
+/// \param byte_size The size of the output data in bytes.
+/// \param memory_type Acts as both input and output. On input gives
+/// the preferred type of memory, returns the type of the memory of the
+/// buffer.
+/// \param memory_type_id Acts as both input and output. On input gives
+/// the preferred id of the memory, returns the id of the memory of the
+/// buffer.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_OutputBuffer(struct BACKEND_Output* output,
+                                         void** buffer,
+                                         uint64_t byte_size,
+                                         SERVER_MemoryType* memory_type,
+                                         int64_t* memory_type_id);
+
+/// Send a response, which is deleted by the call even on failure. The
+/// responses of a request wait for the client in a bounded buffer, the
+/// call waits while the buffer of the request is full. A model that is
+/// not decoupled sends exactly one response per request, with
+/// SERVER_RESPONSE_COMPLETE_FINAL.
+///
+/// \param response The response.
+/// \param send_flags Flags from SERVER_ResponseCompleteFlag.
+/// \param error The error the request failed with, nullptr on success.
+/// The caller keeps ownership of the error.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ResponseSend(struct BACKEND_Response* response,
+                                         uint32_t send_flags,
+                                         struct SERVER_Error* error);
+
+/// Send a batch of responses, typically one per request of an executed
+/// batch, with the same flags. All the responses are deleted by the call
+/// even on failure, and all are sent even if some fail. See
+/// BACKEND_ResponseSend.
+///
+/// \param responses The responses.
+/// \param response_count The number of responses.
+/// \param send_flags Flags from SERVER_ResponseCompleteFlag.
+/// \param errors The error each request failed with, nullptr entries on
+/// success, or nullptr if all succeeded. The caller keeps ownership of
+/// the errors.
+/// \return a SERVER_Error for the first response that failed to send,
+/// nullptr if all were sent.
+BACKEND_DECLSPEC
+struct SERVER_Error* BACKEND_ResponseSendBatch(struct BACKEND_Response** responses,
+                                              const uint32_t response_count,
+                                              uint32_t send_flags,
+                                              struct SERVER_Error** errors);
+
+/// Create the batcher of a model, optional. Called once when the model
+/// is loaded, the returned batcher is passed to
+/// BACKEND_ModelBatchInitialize for every batch of the model.
+///
+/// \param batcher Returns the backend's batcher, may be nullptr.
+/// \param model The model.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_ISPEC
+struct SERVER_Error* BACKEND_ModelBatcherInitialize(struct BACKEND_Batcher** batcher,
+                                                   struct BACKEND_Model* model);
+
+/// Delete the batcher of a model, optional. Called once the model forms
+/// no more batches.
+///
+/// \param batcher The backend's batcher.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_ISPEC
+struct SERVER_Error* BACKEND_ModelBatcherFinalize(struct BACKEND_Batcher* batcher);
+
+/// Start forming a batch. A backend implementing the batch functions
+/// decides which queued requests join a batch, for example to cap a
+/// batch by the total size of its inputs rather than by the number of
+/// requests. The dynamic batcher still stops at the maximum batch size.
+/// The batch functions are called on the batcher thread of the model
+/// while it holds the queue, so they must be quick and not call back
+/// into the server other than to read the request.
+///
+/// \param batcher The backend's batcher.
+/// \param userp Returns the state of the batch passed to the other
+/// batch functions.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_ISPEC
+struct SERVER_Error* BACKEND_ModelBatchInitialize(const struct BACKEND_Batcher* batcher,
+                                                 void** userp);
+
+/// Decide whether the next queued request joins the batch. Called for
+/// the requests in queue order until one is left out, which closes the
+/// batch. The first request of a batch always joins it, the function
+/// is still called so that the backend accounts for it.
+///
+/// \param request The request, which must not be released.
+/// \param userp The state of the batch.
+/// \param should_include Returns true if the request joins the batch.
+/// \return a SERVER_Error indicating success or failure, an error
+/// closes the batch.
+BACKEND_ISPEC
+struct SERVER_Error* BACKEND_ModelBatchIncludeRequest(struct BACKEND_Request* request,
+                                                     void* userp,
+                                                     bool* should_include);
+
+/// Finish forming a batch, releasing its state. Called once for each
+/// batch that BACKEND_ModelBatchInitialize started, after the last
+/// BACKEND_ModelBatchIncludeRequest. The batch functions are only
+/// called for a batch that is about to execute. While the batcher waits
+/// for more requests it calls none of them.
+///
+/// \param userp The state of the batch.
+/// \return a SERVER_Error indicating success or failure.
+BACKEND_ISPEC
+struct SERVER_Error* BACKEND_ModelBatchFinalize(void* userp);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
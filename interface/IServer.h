@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -33,6 +34,7 @@ struct SERVER_Error;
 struct SERVER_InferenceRequest;
 struct SERVER_InferenceResponse;
 struct SERVER_InferenceTrace;
+struct SERVER_LocalTransport;
 struct SERVER_Message;
 struct SERVER_Metrics;
 struct SERVER_Parameter;
@@ -96,6 +98,25 @@ const char* SERVER_ErrorCodeString(struct SERVER_Error* error);
 SERVER_DECLSPEC 
 const char* SERVER_ErrorMessage(struct SERVER_Error* error);
 
+/// SERVER_MemoryType
+///
+/// Types of memory recognized by SERVER.
+///
+typedef enum SERVER_memorytype_enum {
+  SERVER_MEMORY_CPU,
+  SERVER_MEMORY_CPU_PINNED,
+  SERVER_MEMORY_GPU
+} SERVER_MemoryType;
+
+/// Get the string representation of a memory type. The returned
+/// string is not owned by the caller and so should not be modified or
+/// freed.
+///
+/// \param memtype The memory type.
+/// \return The string representation of the memory type.
+SERVER_DECLSPEC
+const char* SERVER_MemoryTypeString(SERVER_MemoryType memtype);
+
 /// SERVER_InstanceGroupKind
 ///
 /// Kinds of instance groups recognized by SERVER.
@@ -107,6 +128,701 @@ typedef enum SERVER_instancegroupkind_enum {
   SERVER_INSTANCEGROUPKIND_MODEL
 } SERVER_InstanceGroupKind;
 
+/// SERVER_RequestReleaseFlag
+///
+/// Flags that can be passed when releasing an inference request.
+///
+typedef enum SERVER_requestreleaseflag_enum {
+  SERVER_REQUEST_RELEASE_ALL = 1
+} SERVER_RequestReleaseFlag;
+
+/// SERVER_ResponseCompleteFlag
+///
+/// Flags that can be sent with an inference response. The final flag
+/// marks the last response of a request, it may come without a
+/// response.
+///
+typedef enum SERVER_responsecompleteflag_enum {
+  SERVER_RESPONSE_COMPLETE_FINAL = 1
+} SERVER_ResponseCompleteFlag;
+
+/// SERVER_DataType
+///
+/// Tensor data types recognized by SERVER.
+///
+typedef enum SERVER_datatype_enum {
+  SERVER_TYPE_INVALID,
+  SERVER_TYPE_BOOL,
+  SERVER_TYPE_UINT8,
+  SERVER_TYPE_UINT16,
+  SERVER_TYPE_UINT32,
+  SERVER_TYPE_UINT64,
+  SERVER_TYPE_INT8,
+  SERVER_TYPE_INT16,
+  SERVER_TYPE_INT32,
+  SERVER_TYPE_INT64,
+  SERVER_TYPE_FP16,
+  SERVER_TYPE_FP32,
+  SERVER_TYPE_FP64,
+  SERVER_TYPE_BYTES,
+  SERVER_TYPE_BF16
+} SERVER_DataType;
+
+/// Get the string representation of a data type. The returned string
+/// is not owned by the caller and so should not be modified or freed.
+///
+/// \param datatype The data type.
+/// \return The string representation of the data type.
+SERVER_DECLSPEC
+const char* SERVER_DataTypeString(SERVER_DataType datatype);
+
+/// SERVER_MetricKind
+///
+/// Kinds of metrics. A counter only goes up, a gauge goes up and down,
+/// and a histogram counts non-negative integer values, such as
+/// durations in microseconds, in buckets that grow logarithmically.
+///
+typedef enum SERVER_metrickind_enum {
+  SERVER_METRIC_KIND_COUNTER,
+  SERVER_METRIC_KIND_GAUGE,
+  SERVER_METRIC_KIND_HISTOGRAM
+} SERVER_MetricKind;
+
+/// SERVER_MetricFormat
+///
+/// Formats the metrics can be rendered in.
+///
+typedef enum SERVER_metricformat_enum {
+  SERVER_METRIC_PROMETHEUS
+} SERVER_MetricFormat;
+
+/// Create new server options, which are deleted with
+/// SERVER_ServerOptionsDelete.
+///
+/// \param options Returns the new server options.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerOptionsNew(struct SERVER_ServerOptions** options);
+
+/// Delete server options.
+///
+/// \param options The server options.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerOptionsDelete(struct SERVER_ServerOptions* options);
+
+/// Add a model repository path, may be called for each repository.
+///
+/// \param options The server options.
+/// \param path The path of the model repository.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerOptionsSetModelRepositoryPath(
+    struct SERVER_ServerOptions* options, const char* path);
+
+/// Set the directory the backend libraries are searched in.
+///
+/// \param options The server options.
+/// \param backend_dir The backend directory.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerOptionsSetBackendDirectory(
+    struct SERVER_ServerOptions* options, const char* backend_dir);
+
+/// Set a setting of the configuration of a backend, of all backends if
+/// 'backend_name' is empty.
+///
+/// \param options The server options.
+/// \param backend_name The name of the backend.
+/// \param setting The name of the setting.
+/// \param value The value of the setting.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerOptionsSetBackendConfig(
+    struct SERVER_ServerOptions* options, const char* backend_name,
+    const char* setting, const char* value);
+
+/// Set the number of threads loading models concurrently.
+///
+/// \param options The server options.
+/// \param thread_count The number of threads.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerOptionsSetModelLoadThreadCount(
+    struct SERVER_ServerOptions* options, unsigned int thread_count);
+
+/// Set the rate requests are traced at, one in 'trace_rate' requests,
+/// 0 to trace none. The default traces 1 in 100 requests.
+///
+/// \param options The server options.
+/// \param trace_rate The rate to trace the requests at.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerOptionsSetTraceRate(struct SERVER_ServerOptions* options,
+                                                     uint32_t trace_rate);
+
+/// Create and initialize a server, loading the models of its
+/// repositories. The server is deleted with SERVER_ServerDelete.
+///
+/// \param server Returns the new server.
+/// \param options The server options.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerNew(struct SERVER_Server** server,
+                                     struct SERVER_ServerOptions* options);
+
+/// Unload the models and delete a server.
+///
+/// \param server The server.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerDelete(struct SERVER_Server* server);
+
+/// Query whether the server is live.
+///
+/// \param server The server.
+/// \param live Returns true if the server is live.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerIsLive(struct SERVER_Server* server, bool* live);
+
+/// Query whether the server is ready for inference.
+///
+/// \param server The server.
+/// \param ready Returns true if the server is ready.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerIsReady(struct SERVER_Server* server, bool* ready);
+
+/// Delete a message.
+///
+/// \param message The message.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MessageDelete(struct SERVER_Message* message);
+
+/// Get a message serialized as JSON. The returned text is valid as
+/// long as the message.
+///
+/// \param message The message.
+/// \param base Returns the JSON, not null-terminated.
+/// \param byte_size Returns the size of the JSON.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MessageSerializeToJson(struct SERVER_Message* message,
+                                                  const char** base, size_t* byte_size);
+
+/// Get the memory used by the loaded versions of a model, which is
+/// deleted with SERVER_MessageDelete. The JSON of the message is
+///
+///   {"name": <model>, "versions": [{"version": <version>,
+///     "usage": [{"memory_type": "CPU", "memory_type_id": 0,
+///                "byte_size": <bytes>}, ...],
+///     "instances": [{"name": <instance>, "usage": [...]}, ...]}, ...]}
+///
+/// where the usage of a version includes its instances and the output
+/// buffers of its responses not yet deleted. An instance counts the
+/// size of the model files until its backend reports its memory.
+///
+/// \param server The server.
+/// \param model_name The name of the model.
+/// \param usage Returns the memory usage.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerModelMemoryUsage(struct SERVER_Server* server,
+                                                  const char* model_name,
+                                                  struct SERVER_Message** usage);
+
+/// Get the execution statistics the backend reported for the loaded
+/// versions of a model, which is deleted with SERVER_MessageDelete. The
+/// JSON of the message is
+///
+///   {"name": <model>, "versions": [{"version": <version>,
+///     "requests": {"success_count": <count>, "failure_count": <count>,
+///                  "compute_input": <durations>, "compute_infer": ...,
+///                  "compute_output": ..., "execution": ...},
+///     "batches": [{"batch_size": <size>, "success_count": ..., ...}, ...],
+///     "responses": {"success_count": ..., "failure_count": ...,
+///                   "compute_infer": ..., "compute_output": ...}}, ...]}
+///
+/// where each of the durations is {"count": <count>, "ns": <sum>,
+/// "p50_ns": <ns>, "p99_ns": <ns>}, the quantiles within 25%. Only the
+/// batch sizes executed are listed, larger batches count with the
+/// maximum batch size. A version that isn't executed by a backend has
+/// only its "version".
+///
+/// \param server The server.
+/// \param model_name The name of the model.
+/// \param statistics Returns the statistics.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerModelStatistics(struct SERVER_Server* server,
+                                                 const char* model_name,
+                                                 struct SERVER_Message** statistics);
+
+/// Type for the function called when the server is done with a request.
+/// The application owns the request again and deletes it with
+/// SERVER_InferenceRequestDelete, the responses may still be coming.
+typedef void (*SERVER_InferenceRequestReleaseFn_t)(struct SERVER_InferenceRequest* request,
+                                                  const uint32_t flags, void* userp);
+
+/// Type for the function called with each response to a request, in
+/// the order they are sent. The response is nullptr if only flags are
+/// sent. The application owns the response and deletes it with
+/// SERVER_InferenceResponseDelete. The function runs on a server
+/// thread and should not block, a request stops getting responses
+/// while the application is behind on them.
+typedef void (*SERVER_InferenceResponseCompleteFn_t)(struct SERVER_InferenceResponse* response,
+                                                    const uint32_t flags, void* userp);
+
+/// Type for the function allocating the buffer of an output, called
+/// by the backend producing the output so that it writes the data
+/// straight into the buffer. Returning a nullptr buffer for a non-zero
+/// size fails the allocation.
+///
+/// \param allocator The response allocator.
+/// \param tensor_name The name of the output.
+/// \param byte_size The size of the buffer in bytes.
+/// \param memory_type The preferred type of memory.
+/// \param memory_type_id The preferred id of the memory.
+/// \param userp The user data set with the allocator on the request.
+/// \param buffer Returns the buffer.
+/// \param buffer_userp Returns data passed back when the buffer is
+/// released.
+/// \param actual_memory_type Returns the type of the memory of the
+/// buffer.
+/// \param actual_memory_type_id Returns the id of the memory of the
+/// buffer.
+/// \return a SERVER_Error indicating success or failure.
+typedef struct SERVER_Error* (*SERVER_ResponseAllocatorAllocFn_t)(
+    struct SERVER_ResponseAllocator* allocator, const char* tensor_name,
+    size_t byte_size, SERVER_MemoryType memory_type, int64_t memory_type_id,
+    void* userp, void** buffer, void** buffer_userp,
+    SERVER_MemoryType* actual_memory_type, int64_t* actual_memory_type_id);
+
+/// Type for the function releasing a buffer allocated by
+/// SERVER_ResponseAllocatorAllocFn_t, called when the response holding
+/// it is deleted.
+///
+/// \param allocator The response allocator.
+/// \param buffer The buffer.
+/// \param buffer_userp The data returned with the buffer.
+/// \param byte_size The size of the buffer in bytes.
+/// \param memory_type The type of the memory of the buffer.
+/// \param memory_type_id The id of the memory of the buffer.
+/// \return a SERVER_Error indicating success or failure.
+typedef struct SERVER_Error* (*SERVER_ResponseAllocatorReleaseFn_t)(
+    struct SERVER_ResponseAllocator* allocator, void* buffer, void* buffer_userp,
+    size_t byte_size, SERVER_MemoryType memory_type, int64_t memory_type_id);
+
+/// Create a response allocator. An allocator may serve any number of
+/// requests and must outlive their responses.
+///
+/// \param allocator Returns the new response allocator.
+/// \param alloc_fn The function allocating output buffers.
+/// \param release_fn The function releasing output buffers.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ResponseAllocatorNew(
+    struct SERVER_ResponseAllocator** allocator,
+    SERVER_ResponseAllocatorAllocFn_t alloc_fn,
+    SERVER_ResponseAllocatorReleaseFn_t release_fn);
+
+/// Delete a response allocator.
+///
+/// \param allocator The response allocator.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ResponseAllocatorDelete(struct SERVER_ResponseAllocator* allocator);
+
+/// Create an inference request for a model. A request is used for one
+/// inference.
+///
+/// \param request Returns the new request.
+/// \param server The server.
+/// \param model_name The name of the model.
+/// \param model_version The version of the model, -1 for the latest.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestNew(struct SERVER_InferenceRequest** request,
+                                               struct SERVER_Server* server,
+                                               const char* model_name,
+                                               const int64_t model_version);
+
+/// Delete an inference request that is not in flight.
+///
+/// \param request The request.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestDelete(struct SERVER_InferenceRequest* request);
+
+/// Set the id of a request, which the responses carry.
+///
+/// \param request The request.
+/// \param id The id.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestSetId(struct SERVER_InferenceRequest* request,
+                                                 const char* id);
+
+/// Set the priority level of a request, 0 for the default of the model.
+///
+/// \param request The request.
+/// \param priority The priority level.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestSetPriority(struct SERVER_InferenceRequest* request,
+                                                       uint64_t priority);
+
+/// Set the timeout of a request, 0 for the default of the model.
+///
+/// \param request The request.
+/// \param timeout_us The timeout in microseconds.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestSetTimeoutMicroseconds(
+    struct SERVER_InferenceRequest* request, uint64_t timeout_us);
+
+/// Add an input to a request.
+///
+/// \param request The request.
+/// \param name The name of the input.
+/// \param datatype The data type of the input.
+/// \param shape The shape of the input, with the batch dimension if the
+/// model batches.
+/// \param dim_count The number of dimensions of 'shape'.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestAddInput(struct SERVER_InferenceRequest* request,
+                                                    const char* name,
+                                                    const SERVER_DataType datatype,
+                                                    const int64_t* shape,
+                                                    uint64_t dim_count);
+
+/// Append a buffer to the data of an input. The data is not copied, the
+/// buffer must stay valid and unmodified until the request is released.
+///
+/// \param request The request.
+/// \param name The name of the input.
+/// \param base The start of the buffer.
+/// \param byte_size The size of the buffer in bytes.
+/// \param memory_type The type of the memory of the buffer.
+/// \param memory_type_id The id of the memory, the device for GPU memory.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestAppendInputData(
+    struct SERVER_InferenceRequest* request, const char* name, const void* base,
+    size_t byte_size, SERVER_MemoryType memory_type, int64_t memory_type_id);
+
+/// Request an output, all the outputs of the model are produced if
+/// none is requested.
+///
+/// \param request The request.
+/// \param name The name of the output.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestAddRequestedOutput(
+    struct SERVER_InferenceRequest* request, const char* name);
+
+/// Cancel a request in flight. A request that is still queued is
+/// released without being executed, the backend executing it may stop
+/// early.
+///
+/// \param request The request.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestCancel(struct SERVER_InferenceRequest* request);
+
+/// Set the function called when the server is done with a request.
+///
+/// \param request The request.
+/// \param release_fn The release function.
+/// \param release_userp Passed to 'release_fn'.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestSetReleaseCallback(
+    struct SERVER_InferenceRequest* request,
+    SERVER_InferenceRequestReleaseFn_t release_fn, void* release_userp);
+
+/// Set the function called with the responses of a request. A request
+/// that fails gets a final response carrying the error.
+///
+/// \param request The request.
+/// \param response_fn The response function.
+/// \param response_userp Passed to 'response_fn'.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestSetResponseCallback(
+    struct SERVER_InferenceRequest* request,
+    SERVER_InferenceResponseCompleteFn_t response_fn, void* response_userp);
+
+/// Set the allocator of the output buffers of the responses to a
+/// request. The outputs are allocated in CPU memory owned by the
+/// response if no allocator is set.
+///
+/// \param request The request.
+/// \param allocator The response allocator.
+/// \param alloc_userp Passed to the functions of 'allocator'.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceRequestSetResponseAllocator(
+    struct SERVER_InferenceRequest* request,
+    struct SERVER_ResponseAllocator* allocator, void* alloc_userp);
+
+/// Run an inference asynchronously. On success the server owns the
+/// request until it calls the release function, on failure the caller
+/// keeps it.
+///
+/// \param server The server.
+/// \param request The request.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerInferAsync(struct SERVER_Server* server,
+                                            struct SERVER_InferenceRequest* request);
+
+/// Delete a response.
+///
+/// \param response The response.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceResponseDelete(struct SERVER_InferenceResponse* response);
+
+/// Get the error of a response, nullptr if the inference succeeded. The
+/// caller takes ownership of the returned error.
+///
+/// \param response The response.
+/// \return The error of the response.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceResponseError(struct SERVER_InferenceResponse* response);
+
+/// Get the id of the request of a response, valid as long as the
+/// response.
+///
+/// \param response The response.
+/// \param id Returns the id.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceResponseId(struct SERVER_InferenceResponse* response,
+                                               const char** id);
+
+/// Get the number of outputs of a response.
+///
+/// \param response The response.
+/// \param count Returns the number of outputs.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceResponseOutputCount(struct SERVER_InferenceResponse* response,
+                                                        uint32_t* count);
+
+/// Get an output of a response. The returned pointers point into the
+/// response, the data is not copied, and are valid as long as the
+/// response.
+///
+/// \param response The response.
+/// \param index The index of the output, from 0 to the output count.
+/// \param name Returns the name of the output.
+/// \param datatype Returns the data type of the output.
+/// \param shape Returns the shape of the output.
+/// \param dim_count Returns the number of dimensions of 'shape'.
+/// \param base Returns the data of the output.
+/// \param byte_size Returns the size of the data in bytes.
+/// \param memory_type Returns the type of the memory of the data.
+/// \param memory_type_id Returns the id of the memory of the data.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceResponseOutput(struct SERVER_InferenceResponse* response,
+                                                   const uint32_t index,
+                                                   const char** name,
+                                                   SERVER_DataType* datatype,
+                                                   const int64_t** shape,
+                                                   uint64_t* dim_count,
+                                                   const void** base,
+                                                   size_t* byte_size,
+                                                   SERVER_MemoryType* memory_type,
+                                                   int64_t* memory_type_id);
+
+/// Get a snapshot of the metrics of the server, the models and the
+/// backends, which is deleted with SERVER_MetricsDelete. The metrics are
+/// process-wide, the snapshot holds those of every server of the
+/// process.
+///
+/// \param server The server, unused.
+/// \param metrics Returns the metrics.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerMetrics(struct SERVER_Server* server,
+                                         struct SERVER_Metrics** metrics);
+
+/// Delete a snapshot of metrics.
+///
+/// \param metrics The metrics.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MetricsDelete(struct SERVER_Metrics* metrics);
+
+/// Get a snapshot of metrics rendered in a format. Histograms are
+/// rendered in the Prometheus text format as summaries of their 0.5,
+/// 0.9 and 0.99 quantiles. The returned text is valid as long as the
+/// snapshot.
+///
+/// \param metrics The metrics.
+/// \param format The format to render the metrics in.
+/// \param base Returns the rendered metrics, not null-terminated.
+/// \param byte_size Returns the size of the rendered metrics.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MetricsFormatted(struct SERVER_Metrics* metrics,
+                                            SERVER_MetricFormat format,
+                                            const char** base, size_t* byte_size);
+
+/// Create a family of metrics, which is deleted with
+/// SERVER_MetricFamilyDelete. Creating a family of the name of an
+/// existing family of the same kind gives access to the existing
+/// family.
+///
+/// \param family Returns the family.
+/// \param kind The kind of the metrics of the family.
+/// \param name The name of the family, a valid Prometheus metric name.
+/// \param description The description of the family.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MetricFamilyNew(struct SERVER_MetricFamily** family,
+                                           const SERVER_MetricKind kind, const char* name,
+                                           const char* description);
+
+/// Delete a family of metrics. The family stays registered until its
+/// metrics are deleted as well.
+///
+/// \param family The family.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MetricFamilyDelete(struct SERVER_MetricFamily* family);
+
+/// Create a metric of a family, which is deleted with
+/// SERVER_MetricDelete. Creating a metric with the labels of an
+/// existing metric of the family gives access to the existing metric.
+///
+/// \param metric Returns the metric.
+/// \param family The family of the metric.
+/// \param label_names The names of the labels of the metric.
+/// \param label_values The values of the labels of the metric.
+/// \param label_count The number of labels.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MetricNew(struct SERVER_Metric** metric,
+                                     struct SERVER_MetricFamily* family,
+                                     const char* const* label_names,
+                                     const char* const* label_values,
+                                     const size_t label_count);
+
+/// Delete a metric.
+///
+/// \param metric The metric.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MetricDelete(struct SERVER_Metric* metric);
+
+/// Get the kind of a metric.
+///
+/// \param metric The metric.
+/// \param kind Returns the kind of the metric.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_GetMetricKind(struct SERVER_Metric* metric,
+                                         SERVER_MetricKind* kind);
+
+/// Get the value of a counter or a gauge, or the number of values
+/// counted by a histogram.
+///
+/// \param metric The metric.
+/// \param value Returns the value.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MetricValue(struct SERVER_Metric* metric, double* value);
+
+/// Add a value to a counter, which must not be negative, or to a gauge.
+///
+/// \param metric The metric.
+/// \param value The value to add.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MetricIncrement(struct SERVER_Metric* metric, double value);
+
+/// Set the value of a gauge.
+///
+/// \param metric The metric.
+/// \param value The value.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MetricSet(struct SERVER_Metric* metric, double value);
+
+/// Count a value in a histogram. A histogram counts non-negative
+/// integers below 2^64, observe values in an integer unit such as
+/// microseconds or bytes. Other values are rejected.
+///
+/// \param metric The metric.
+/// \param value The value.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_MetricObserve(struct SERVER_Metric* metric, double value);
+
+/// Get a snapshot of the traces of the sampled requests, which is
+/// deleted with SERVER_InferenceTraceDelete. The traces are of the
+/// latest requests, each thread keeps its latest events only. The traces
+/// are process-wide, the snapshot holds those of every server of the
+/// process, each sampling at the rate of its options.
+///
+/// \param server The server, unused.
+/// \param trace Returns the traces.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_ServerTrace(struct SERVER_Server* server,
+                                       struct SERVER_InferenceTrace** trace);
+
+/// Delete a snapshot of traces.
+///
+/// \param trace The traces.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceTraceDelete(struct SERVER_InferenceTrace* trace);
+
+/// Get a snapshot of traces in the Chrome trace event JSON format, which
+/// chrome://tracing and Perfetto open. Each model is a process and each
+/// request a thread of it, spanning the stages of the request: prepare,
+/// queue, dispatch and compute, with an instant event for each
+/// response. The returned text is valid as long as the snapshot.
+///
+/// \param trace The traces.
+/// \param base Returns the JSON, not null-terminated.
+/// \param byte_size Returns the size of the JSON.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_InferenceTraceChromeJson(struct SERVER_InferenceTrace* trace,
+                                                    const char** base, size_t* byte_size);
+
+/// Serve inferences to the processes on the same host through shared
+/// memory, which is deleted with SERVER_LocalTransportDelete. The
+/// clients write their inputs into shared memory segments and send only
+/// descriptors of them on the channel 'name', the outputs are written
+/// into segments of the clients. See common/local_transport_client.h for
+/// the client.
+///
+/// \param transport Returns the new transport.
+/// \param server The server, which must outlive the transport.
+/// \param name The name of the transport, unique on the host.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_LocalTransportNew(struct SERVER_LocalTransport** transport,
+                                             struct SERVER_Server* server, const char* name);
+
+/// Stop a local transport, waiting for the requests in flight, and
+/// delete it.
+///
+/// \param transport The transport.
+/// \return a SERVER_Error indicating success or failure.
+SERVER_DECLSPEC
+struct SERVER_Error* SERVER_LocalTransportDelete(struct SERVER_LocalTransport* transport);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "admission_controller_test.h"
+
+using namespace core;
+
+namespace test {
+
+constexpr uint64_t AdmissionControllerTest::kMsNs;
+
+TEST_F(AdmissionControllerTest, BurstIsAdmitted) {
+  // The delay is above the target for less than an interval.
+  for (uint64_t now = 0; now < 90 * kMsNs; now += kMsNs) {
+    controller.RecordQueueDelay(20 * kMsNs, now);
+  }
+  controller.RecordQueueDelay(kMsNs, 90 * kMsNs);
+  controller.RecordQueueDelay(20 * kMsNs, 150 * kMsNs);
+  EXPECT_FALSE(controller.Shedding());
+  EXPECT_TRUE(controller.Admit(2, 150 * kMsNs));
+}
+
+TEST_F(AdmissionControllerTest, StandingQueueSheds) {
+  for (uint64_t now = 0; now <= 100 * kMsNs; now += kMsNs) {
+    controller.RecordQueueDelay(20 * kMsNs, now);
+  }
+  EXPECT_TRUE(controller.Shedding());
+  EXPECT_TRUE(controller.Admit(1, 100 * kMsNs));
+  EXPECT_FALSE(controller.Admit(2, 100 * kMsNs));
+  EXPECT_FALSE(controller.Admit(3, 100 * kMsNs));
+  EXPECT_EQ(controller.RejectedCount(), 2U);
+  // A request below the target ends the overload.
+  controller.RecordQueueDelay(kMsNs, 101 * kMsNs);
+  EXPECT_FALSE(controller.Shedding());
+  EXPECT_TRUE(controller.Admit(2, 101 * kMsNs));
+}
+
+TEST_F(AdmissionControllerTest, QueueDrainsWhileShedding) {
+  for (uint64_t now = 0; now <= 100 * kMsNs; now += kMsNs) {
+    controller.RecordQueueDelay(20 * kMsNs, now);
+  }
+  EXPECT_TRUE(controller.Shedding());
+  EXPECT_FALSE(controller.Admit(2, 100 * kMsNs));
+  // The last batch above the target emptied the queue.
+  controller.RecordQueueEmpty();
+  EXPECT_FALSE(controller.Shedding());
+  EXPECT_TRUE(controller.Admit(2, 101 * kMsNs));
+  // The overload takes a full interval above the target again.
+  controller.RecordQueueDelay(20 * kMsNs, 102 * kMsNs);
+  EXPECT_FALSE(controller.Shedding());
+}
+
+TEST_F(AdmissionControllerTest, QuietQueueStopsShedding) {
+  for (uint64_t now = 0; now <= 100 * kMsNs; now += kMsNs) {
+    controller.RecordQueueDelay(20 * kMsNs, now);
+  }
+  EXPECT_FALSE(controller.Admit(2, 150 * kMsNs));
+  // No request left the queue for an interval.
+  EXPECT_TRUE(controller.Admit(2, 200 * kMsNs));
+  EXPECT_FALSE(controller.Shedding());
+  EXPECT_EQ(controller.RejectedCount(), 1U);
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include "core/admission_controller.h"
+
+namespace test {
+
+class AdmissionControllerTest : public testing::Test {
+ protected:
+  // A target of 5ms over 100ms, the levels up to 1 are protected.
+  AdmissionControllerTest()
+    : controller("m", 5 * kMsNs, 100 * kMsNs, 1) {}
+
+  static constexpr uint64_t kMsNs = 1000 * 1000;
+  core::AdmissionController controller;
+};
+
+}
@@ -0,0 +1,228 @@
+#include "test_backend.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace test {
+
+void TestBackendState::Reset() {
+  std::lock_guard<std::mutex> lock(mu_);
+  on_execute_ = nullptr;
+  on_release_ = nullptr;
+  batch_byte_cap_ = 0;
+  gather_inputs_ = false;
+  batch_initialize_count_ = 0;
+  batch_include_count_ = 0;
+  batch_finalize_count_ = 0;
+  instances_.clear();
+  batch_inputs_.clear();
+}
+
+std::vector<BACKEND_ModelInstance*> TestBackendState::Instances() {
+  std::lock_guard<std::mutex> lock(mu_);
+  return instances_;
+}
+
+std::vector<std::string> TestBackendState::BatchInputs() {
+  std::lock_guard<std::mutex> lock(mu_);
+  return batch_inputs_;
+}
+
+TestBackendState& GetTestBackendState() {
+  static TestBackendState state;
+  return state;
+}
+
+namespace {
+uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void IgnoreError(SERVER_Error* err) {
+  if (err != nullptr) {
+    SERVER_ErrorDelete(err);
+  }
+}
+
+// Copy the input "IN" of 'request' into the output "OUT" of 'response'
+// if the request asked for the output by name.
+SERVER_Error* EchoInput(BACKEND_Request* request, BACKEND_Response* response) {
+  uint32_t output_count = 0;
+  SERVER_Error* err = BACKEND_RequestOutputCount(request, &output_count);
+  if ((err != nullptr) || (output_count == 0)) {
+    return err;
+  }
+  BACKEND_Input* input = nullptr;
+  const int64_t* shape = nullptr;
+  uint32_t dims_count = 0;
+  uint64_t byte_size = 0;
+  uint32_t buffer_count = 0;
+  err = BACKEND_RequestInputByName(request, "IN", &input);
+  if (err == nullptr) {
+    err = BACKEND_InputProperties(input, nullptr, nullptr, &shape, &dims_count, &byte_size,
+                                  &buffer_count);
+  }
+  BACKEND_Output* output = nullptr;
+  if (err == nullptr) {
+    err = BACKEND_ResponseOutput(response, &output, "OUT", shape, dims_count);
+  }
+  void* buffer = nullptr;
+  SERVER_MemoryType memory_type = SERVER_MEMORY_CPU;
+  int64_t memory_type_id = 0;
+  if (err == nullptr) {
+    err = BACKEND_OutputBuffer(output, &buffer, byte_size, &memory_type, &memory_type_id);
+  }
+  for (uint32_t i = 0; (err == nullptr) && (i < buffer_count); ++i) {
+    const void* data = nullptr;
+    uint64_t data_byte_size = 0;
+    err = BACKEND_InputBuffer(input, i, &data, &data_byte_size, &memory_type, &memory_type_id);
+    if (err == nullptr) {
+      memcpy(buffer, data, data_byte_size);
+      buffer = static_cast<char*>(buffer) + data_byte_size;
+    }
+  }
+  return err;
+}
+}  // namespace
+
+}
+
+extern "C" {
+
+SERVER_Error* BACKEND_ModelInitialize(BACKEND_Model* model) {
+  if (test::GetTestBackendState().gather_inputs_) {
+    return BACKEND_ModelGatherBatchInputs(model);
+  }
+  return nullptr;
+}
+
+SERVER_Error* BACKEND_ModelInstanceInitialize(BACKEND_ModelInstance* instance) {
+  auto& state = test::GetTestBackendState();
+  std::lock_guard<std::mutex> lock(state.mu_);
+  state.instances_.push_back(instance);
+  return nullptr;
+}
+
+SERVER_Error* BACKEND_ModelInstanceFinalize(BACKEND_ModelInstance* instance) {
+  auto& state = test::GetTestBackendState();
+  std::lock_guard<std::mutex> lock(state.mu_);
+  state.instances_.erase(
+      std::remove(state.instances_.begin(), state.instances_.end(), instance),
+      state.instances_.end());
+  return nullptr;
+}
+
+SERVER_Error* BACKEND_ModelInstanceExecute(BACKEND_ModelInstance* instance,
+                                           BACKEND_Request** requests,
+                                           const uint32_t request_count) {
+  auto& state = test::GetTestBackendState();
+  const uint64_t exec_start_ns = test::NowNs();
+  if (state.gather_inputs_) {
+    const void* buffer = nullptr;
+    uint64_t byte_size = 0;
+    SERVER_Error* err = BACKEND_ModelInstanceBatchInput(instance, "IN", &buffer, &byte_size);
+    std::string batch_input;
+    if (err == nullptr) {
+      batch_input.assign(reinterpret_cast<const char*>(buffer), byte_size);
+    } else {
+      SERVER_ErrorDelete(err);
+    }
+    std::lock_guard<std::mutex> lock(state.mu_);
+    state.batch_inputs_.push_back(batch_input);
+  }
+  std::vector<std::string> request_ids;
+  for (uint32_t i = 0; i < request_count; ++i) {
+    const char* id = "";
+    test::IgnoreError(BACKEND_RequestId(requests[i], &id));
+    request_ids.push_back(id);
+  }
+  const uint64_t compute_start_ns = test::NowNs();
+  if (state.on_execute_) {
+    state.on_execute_(instance, request_ids);
+  }
+  const uint64_t compute_end_ns = test::NowNs();
+  for (uint32_t i = 0; i < request_count; ++i) {
+    const bool success = (request_ids[i].compare(0, 4, "fail") != 0);
+    SERVER_Error* response_err =
+        success ? nullptr : SERVER_ErrorNew(SERVER_ERROR_INTERNAL, "request failed");
+    BACKEND_Response* response = nullptr;
+    SERVER_Error* err = BACKEND_ResponseNew(&response, requests[i]);
+    if ((err == nullptr) && success) {
+      err = test::EchoInput(requests[i], response);
+      if (err != nullptr) {
+        response_err = err;
+        err = nullptr;
+      }
+    }
+    if (err == nullptr) {
+      err = BACKEND_ResponseSend(response, SERVER_RESPONSE_COMPLETE_FINAL, response_err);
+    }
+    test::IgnoreError(err);
+    test::IgnoreError(response_err);
+    test::IgnoreError(BACKEND_ModelInstanceReportStatistics(
+        instance, success, exec_start_ns, compute_start_ns, compute_end_ns, test::NowNs()));
+  }
+  // The requests of the tests are of batch size 1. Reported before the
+  // requests are released, the tests read the statistics once they are.
+  test::IgnoreError(BACKEND_ModelInstanceReportBatchStatistics(
+      instance, request_count, exec_start_ns, compute_start_ns, compute_end_ns, test::NowNs()));
+  if (state.on_release_) {
+    state.on_release_(request_ids);
+  }
+  for (uint32_t i = 0; i < request_count; ++i) {
+    test::IgnoreError(BACKEND_RequestRelease(requests[i], SERVER_REQUEST_RELEASE_ALL));
+  }
+  return nullptr;
+}
+
+SERVER_Error* BACKEND_ModelBatcherInitialize(BACKEND_Batcher** batcher, BACKEND_Model* model) {
+  *batcher = nullptr;
+  return nullptr;
+}
+
+SERVER_Error* BACKEND_ModelBatcherFinalize(BACKEND_Batcher* batcher) {
+  return nullptr;
+}
+
+SERVER_Error* BACKEND_ModelBatchInitialize(const BACKEND_Batcher* batcher, void** userp) {
+  ++test::GetTestBackendState().batch_initialize_count_;
+  // The bytes of input included so far.
+  *userp = new uint64_t(0);
+  return nullptr;
+}
+
+SERVER_Error* BACKEND_ModelBatchIncludeRequest(BACKEND_Request* request, void* userp,
+                                               bool* should_include) {
+  auto& state = test::GetTestBackendState();
+  ++state.batch_include_count_;
+  uint64_t* batch_byte_size = reinterpret_cast<uint64_t*>(userp);
+  uint32_t input_count = 0;
+  SERVER_Error* err = BACKEND_RequestInputCount(request, &input_count);
+  for (uint32_t i = 0; (err == nullptr) && (i < input_count); ++i) {
+    BACKEND_Input* input = nullptr;
+    err = BACKEND_RequestInput(request, i, &input);
+    uint64_t byte_size = 0;
+    if (err == nullptr) {
+      err = BACKEND_InputProperties(input, nullptr, nullptr, nullptr, nullptr, &byte_size,
+                                    nullptr);
+    }
+    *batch_byte_size += byte_size;
+  }
+  if (err != nullptr) {
+    return err;
+  }
+  *should_include = (state.batch_byte_cap_ == 0) || (*batch_byte_size <= state.batch_byte_cap_);
+  return nullptr;
+}
+
+SERVER_Error* BACKEND_ModelBatchFinalize(void* userp) {
+  ++test::GetTestBackendState().batch_finalize_count_;
+  delete reinterpret_cast<uint64_t*>(userp);
+  return nullptr;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "interface/IBackend.h"
+
+namespace test {
+
+// The state of the test backend, libtriton_test.so, shared with the
+// tests linked with it. The backend answers each request with a
+// response echoing its input "IN" as the output "OUT" if the request
+// asks for it by name, an error for the requests whose id starts with
+// "fail", and caps the batches it forms by the bytes of their inputs.
+// It reports the statistics of each request and batch it executes.
+struct TestBackendState {
+  // Forget the instances and the calls, and drop the hooks.
+  void Reset();
+
+  // Called on the backend thread with the instance and the ids of the
+  // requests of each batch before they are responded to, it may block
+  // to keep the instance busy. Set while no model is loaded.
+  std::function<void(BACKEND_ModelInstance* instance,
+                     const std::vector<std::string>& request_ids)> on_execute_;
+  // Called on the backend thread with the ids of the requests of each
+  // batch once they are responded to and before they are released, it
+  // may block to hold the requests. Set while no model is loaded.
+  std::function<void(const std::vector<std::string>& request_ids)> on_release_;
+  // The most bytes of input a batch takes, 0 for no limit.
+  std::atomic<uint64_t> batch_byte_cap_{0};
+  // Whether the models loaded from now on have their inputs gathered,
+  // the gathered input "IN" of each batch is kept in 'batch_inputs_',
+  // empty if it was not gathered.
+  std::atomic<bool> gather_inputs_{false};
+  std::vector<std::string> BatchInputs();
+  // The calls of the batch functions.
+  std::atomic<size_t> batch_initialize_count_{0};
+  std::atomic<size_t> batch_include_count_{0};
+  std::atomic<size_t> batch_finalize_count_{0};
+
+  // The instances initialized and not finalized yet, in order.
+  std::vector<BACKEND_ModelInstance*> Instances();
+
+  std::mutex mu_;
+  std::vector<BACKEND_ModelInstance*> instances_;
+  std::vector<std::string> batch_inputs_;
+};
+
+TestBackendState& GetTestBackendState();
+
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "core/server.h"
+#include "core/file_utils.h"
+#include "core/backend_model.h"
+#include "core/backend_model_instance.h"
+#include "core/infer_request.h"
+#include "test/backend/test_backend.h"
+
+namespace test {
+
+// Serves models of the test backend from a temporary repository. The
+// executions of the instances are recorded and can be held to keep the
+// instances busy while requests queue up.
+class TestBackendFixture : public testing::Test {
+ protected:
+  // The requests of a batch and the instance executing it.
+  struct Batch {
+    core::BackendModelInstance* instance_;
+    std::vector<std::string> request_ids_;
+  };
+
+  void SetUp() override {
+    GetTestBackendState().Reset();
+    GetTestBackendState().on_execute_ = [this](BACKEND_ModelInstance* instance,
+                                               const std::vector<std::string>& request_ids) {
+      std::unique_lock<std::mutex> lock(mu_);
+      batches_.push_back(Batch{reinterpret_cast<core::BackendModelInstance*>(instance),
+                               request_ids});
+      cv_.notify_all();
+      cv_.wait(lock, [this]() { return !hold_; });
+    };
+    char root_template[] = "/tmp/test_backend_fixture_XXXXXX";
+    ASSERT_NE(mkdtemp(root_template), nullptr);
+    repository = root_template;
+  }
+
+  void TearDown() override {
+    Resume();
+    if (server != nullptr) {
+      server->Stop();
+      released_.clear();
+      server.reset();
+    }
+    GetTestBackendState().Reset();
+    nftw(repository.c_str(), RemovePath, 16, FTW_DEPTH | FTW_PHYS);
+  }
+
+  static int RemovePath(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+  }
+
+  // Write model 'name' of the test backend taking an INT8 input 'IN' of
+  // any size, with 'config' added to its configuration.
+  void WriteModel(const std::string& name, const int max_batch_size,
+                  const std::string& config = "") {
+    const std::string path = core::JoinPath({repository, name});
+    mkdir(path.c_str(), 0755);
+    mkdir(core::JoinPath({path, "1"}).c_str(), 0755);
+    std::ofstream(core::JoinPath({path, "config.pbtxt"}))
+        << "name: \"" << name << "\"\nbackend: \"test\"\n"
+        << "max_batch_size: " << max_batch_size << "\n"
+        << "input [ { name: \"IN\" data_type: TYPE_INT8 dims: [ -1 ] } ]\n"
+        << "output [ { name: \"OUT\" data_type: TYPE_INT8 dims: [ -1 ] } ]\n"
+        << config;
+    ASSERT_EQ(symlink(TEST_BACKEND_PATH, core::JoinPath({path, "libtriton_test.so"}).c_str()), 0);
+  }
+
+  // Start the server loading the models written.
+  core::Status StartServer(
+      const core::HostPolicyCmdlineConfigMap& host_policy = core::HostPolicyCmdlineConfigMap()) {
+    server.reset(new core::InferenceServer());
+    server->SetModelRepositoryPaths({repository});
+    core::BackendCmdlineConfigMap backend_config;
+    backend_config[""] = {{"backend-directory", repository},
+                          {"auto-complete-config", "false"},
+                          {"min-compute-capability", "0"}};
+    server->SetBackendCmdlineConfig(backend_config);
+    server->SetHostPolicyCmdlineConfig(host_policy);
+    return server->Init();
+  }
+
+  core::BackendModel* GetBackendModel(const std::string& model_name) {
+    std::shared_ptr<core::Model> model;
+    EXPECT_TRUE(server->GetModel(model_name, -1, &model).IsOk());
+    return static_cast<core::BackendModel*>(model.get());
+  }
+
+  // The instances of the loaded models in the order they were created.
+  std::vector<core::BackendModelInstance*> Instances() {
+    std::vector<core::BackendModelInstance*> instances;
+    for (const auto instance : GetTestBackendState().Instances()) {
+      instances.push_back(reinterpret_cast<core::BackendModelInstance*>(instance));
+    }
+    return instances;
+  }
+
+  // A request 'id' for 'model_name' with 'byte_size' bytes of input,
+  // ready to be executed. Its response is waited for with Response().
+  std::unique_ptr<core::InferenceRequest> NewRequest(const std::string& model_name,
+                                                     const std::string& id,
+                                                     const uint64_t priority = 0,
+                                                     const uint64_t timeout_us = 0,
+                                                     const size_t byte_size = 16) {
+    std::shared_ptr<core::Model> model;
+    EXPECT_TRUE(server->GetModel(model_name, -1, &model).IsOk());
+    std::unique_ptr<core::InferenceRequest> request(new core::InferenceRequest(model, -1));
+    request->SetId(id);
+    request->SetPriority(priority);
+    request->SetTimeoutMicroseconds(timeout_us);
+    core::InferenceRequest::Input* input = nullptr;
+    EXPECT_TRUE(request->AddInput("IN", inference::TYPE_INT8,
+                                  {1, static_cast<int64_t>(byte_size)}, &input).IsOk());
+    EXPECT_LE(byte_size, sizeof(data_));
+    input->AppendData(data_, byte_size, SERVER_MEMORY_CPU, 0);
+    request->SetResponseCallback(
+        [this, id](std::unique_ptr<core::InferenceResponse>&& response, const uint32_t flags) {
+          if ((flags & SERVER_RESPONSE_COMPLETE_FINAL) == 0) {
+            return;
+          }
+          std::lock_guard<std::mutex> lock(mu_);
+          responses_.emplace(id, (response == nullptr) ? core::Status::Success
+                                                        : response->ResponseStatus());
+          cv_.notify_all();
+        });
+    // Kept until the server stops, a request sent without the scheduler
+    // may hold the last reference to its model.
+    request->SetReleaseCallback([this](std::unique_ptr<core::InferenceRequest>&& request) {
+      std::lock_guard<std::mutex> lock(mu_);
+      released_ids_.insert(request->Id());
+      released_.push_back(std::move(request));
+      cv_.notify_all();
+    });
+    EXPECT_TRUE(request->PrepareForInference().IsOk());
+    return request;
+  }
+
+  // Fill the input data of the requests with 'value', the requests all
+  // share the same data.
+  void FillInputData(const char value) { memset(data_, value, sizeof(data_)); }
+
+  // Send request 'id', see NewRequest().
+  core::Status Send(const std::string& model_name, const std::string& id,
+                    const uint64_t priority = 0, const uint64_t timeout_us = 0,
+                    const size_t byte_size = 16) {
+    auto request = NewRequest(model_name, id, priority, timeout_us, byte_size);
+    return server->InferAsync(request);
+  }
+
+  // The status of the final response of request 'id', waiting for a
+  // while for the response and the release of the request.
+  core::Status Response(const std::string& id) {
+    std::unique_lock<std::mutex> lock(mu_);
+    if (!cv_.wait_for(lock, std::chrono::seconds(10), [this, &id]() {
+          return (responses_.find(id) != responses_.end()) &&
+                 (released_ids_.find(id) != released_ids_.end());
+        })) {
+      return core::Status(core::Status::Code::INTERNAL, "no response to '" + id + "'");
+    }
+    return responses_.at(id);
+  }
+
+  bool Responded(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mu_);
+    return responses_.find(id) != responses_.end();
+  }
+
+  // Keep the instances executing from now on until Resume().
+  void Hold() {
+    std::lock_guard<std::mutex> lock(mu_);
+    hold_ = true;
+  }
+
+  void Resume() {
+    std::lock_guard<std::mutex> lock(mu_);
+    hold_ = false;
+    cv_.notify_all();
+  }
+
+  // Wait for a while until 'count' batches were executed or are held.
+  bool WaitForBatches(const size_t count) {
+    std::unique_lock<std::mutex> lock(mu_);
+    return cv_.wait_for(lock, std::chrono::seconds(10),
+                        [this, count]() { return batches_.size() >= count; });
+  }
+
+  std::vector<Batch> Batches() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return batches_;
+  }
+
+  // The ids of the requests executed so far, in order.
+  std::vector<std::string> ExecutedRequestIds() {
+    std::vector<std::string> request_ids;
+    for (const auto& batch : Batches()) {
+      request_ids.insert(request_ids.end(), batch.request_ids_.begin(), batch.request_ids_.end());
+    }
+    return request_ids;
+  }
+
+  std::string repository;
+  std::unique_ptr<core::InferenceServer> server;
+
+ private:
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool hold_ = false;
+  std::vector<Batch> batches_;
+  std::map<std::string, core::Status> responses_;
+  std::set<std::string> released_ids_;
+  std::vector<std::unique_ptr<core::InferenceRequest>> released_;
+  // The input data of all the requests.
+  char data_[1024] = {};
+};
+
+}
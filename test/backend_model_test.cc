@@ -0,0 +1,120 @@
+#include "backend_model_test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace core;
+
+namespace test {
+
+TEST_F(BackendModelTest, RemovedInstancesDrainBeforeDestroyed) {
+  WriteModel(2);
+  ASSERT_TRUE(StartServer().IsOk());
+  const std::vector<BackendModelInstance*> before = Instances();
+  ASSERT_EQ(before.size(), 2U);
+  // Both instances execute a request, two more wait in the queue.
+  Hold();
+  ASSERT_TRUE(Send("m", "a").IsOk());
+  ASSERT_TRUE(Send("m", "b").IsOk());
+  ASSERT_TRUE(WaitForBatches(2));
+  ASSERT_TRUE(Send("m", "c").IsOk());
+  ASSERT_TRUE(Send("m", "d").IsOk());
+  std::atomic<bool> updated(false);
+  Status status;
+  std::thread updater([this, &updated, &status]() {
+    status = GetBackendModel("m")->UpdateInstanceGroup(InstanceGroup(1));
+    updated = true;
+  });
+  // The removed instance is not destroyed while it executes its request,
+  // the update waits for it and the requests keep arriving meanwhile.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(updated);
+  EXPECT_EQ(Instances().size(), 2U);
+  ASSERT_TRUE(Send("m", "e").IsOk());
+  Resume();
+  updater.join();
+  EXPECT_TRUE(status.IsOk()) << status.AsString();
+  for (const auto& id : {"a", "b", "c", "d", "e"}) {
+    EXPECT_TRUE(Response(id).IsOk()) << id;
+  }
+  const std::vector<BackendModelInstance*> after = Instances();
+  ASSERT_EQ(after.size(), 1U);
+  EXPECT_NE(std::find(before.begin(), before.end(), after[0]), before.end());
+  // Every request ran exactly once.
+  std::vector<std::string> executed = ExecutedRequestIds();
+  std::sort(executed.begin(), executed.end());
+  EXPECT_EQ(executed, (std::vector<std::string>{"a", "b", "c", "d", "e"}));
+}
+
+TEST_F(BackendModelTest, AddedInstancesTakeQueuedRequests) {
+  WriteModel(1);
+  ASSERT_TRUE(StartServer().IsOk());
+  Hold();
+  ASSERT_TRUE(Send("m", "a").IsOk());
+  ASSERT_TRUE(WaitForBatches(1));
+  ASSERT_TRUE(Send("m", "b").IsOk());
+  ASSERT_TRUE(Send("m", "c").IsOk());
+  // The current instance keeps executing while the new ones are created.
+  ASSERT_TRUE(GetBackendModel("m")->UpdateInstanceGroup(InstanceGroup(3)).IsOk());
+  EXPECT_EQ(Instances().size(), 3U);
+  ASSERT_TRUE(WaitForBatches(3));
+  std::set<BackendModelInstance*> executing;
+  for (const auto& batch : Batches()) {
+    executing.insert(batch.instance_);
+  }
+  EXPECT_EQ(executing.size(), 3U);
+  Resume();
+  for (const auto& id : {"a", "b", "c"}) {
+    EXPECT_TRUE(Response(id).IsOk()) << id;
+  }
+}
+
+TEST_F(BackendModelTest, AutoscalerAddsInstancesUpToMax) {
+  WriteAutoscaledModel(1, 1, 3);
+  ASSERT_TRUE(StartServer().IsOk());
+  // The requests wait in the queue while the instances are held.
+  Hold();
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(Send("m", "r" + std::to_string(i)).IsOk());
+  }
+  EXPECT_TRUE(WaitForInstanceCount(3));
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_EQ(Instances().size(), 3U);
+  Resume();
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(Response("r" + std::to_string(i)).IsOk()) << i;
+  }
+}
+
+TEST_F(BackendModelTest, AutoscalerRemovesIdleInstancesDownToMin) {
+  WriteAutoscaledModel(4, 2, 4);
+  ASSERT_TRUE(StartServer().IsOk());
+  ASSERT_TRUE(Send("m", "a").IsOk());
+  EXPECT_TRUE(Response("a").IsOk());
+  EXPECT_TRUE(WaitForInstanceCount(2));
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_EQ(Instances().size(), 2U);
+  ASSERT_TRUE(Send("m", "b").IsOk());
+  EXPECT_TRUE(Response("b").IsOk());
+}
+
+TEST_F(BackendModelTest, AutoscalerBringsUpdatedCountBackWithinBounds) {
+  WriteAutoscaledModel(1, 1, 2);
+  ASSERT_TRUE(StartServer().IsOk());
+  // The update and the autoscaler take turns on the instance group, the
+  // autoscaler goes on from the count of the update.
+  ASSERT_TRUE(GetBackendModel("m")->UpdateInstanceGroup(InstanceGroup(4)).IsOk());
+  ASSERT_TRUE(Send("m", "a").IsOk());
+  EXPECT_TRUE(Response("a").IsOk());
+  EXPECT_TRUE(WaitForInstanceCount(1));
+  // An update leaving more than one non-passive group is rejected.
+  inference::ModelConfig config = InstanceGroup(1);
+  *config.add_instance_group() = config.instance_group(0);
+  EXPECT_FALSE(GetBackendModel("m")->UpdateInstanceGroup(config).IsOk());
+  EXPECT_EQ(Instances().size(), 1U);
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "core/backend_model.h"
+#include "test/backend/test_backend_fixture.h"
+
+namespace test {
+
+class BackendModelTest : public TestBackendFixture {
+ protected:
+  // A model of 'count' instances executing one request per batch, with
+  // 'config' added to its configuration.
+  void WriteModel(const int count, const std::string& config = "") {
+    TestBackendFixture::WriteModel(
+        "m", 1,
+        "instance_group [ { kind: KIND_CPU count: " + std::to_string(count) + " } ]\n"
+        "dynamic_batching { }\n"
+        "parameters { key: \"pipeline_depth\" value { string_value: \"1\" } }\n" + config);
+  }
+
+  // A model of 'count' instances autoscaled between 'min_instances' and
+  // 'max_instances' every 20 ms, keeping the queue delay under 1 ms.
+  void WriteAutoscaledModel(const int count, const int min_instances, const int max_instances) {
+    WriteModel(count,
+               "parameters { key: \"autoscale_min_instances\" value { string_value: \"" +
+                   std::to_string(min_instances) + "\" } }\n"
+               "parameters { key: \"autoscale_max_instances\" value { string_value: \"" +
+                   std::to_string(max_instances) + "\" } }\n"
+               "parameters { key: \"autoscale_interval_ms\" value { string_value: \"20\" } }\n"
+               "parameters { key: \"autoscale_target_queue_delay_us\" "
+               "value { string_value: \"1000\" } }\n");
+  }
+
+  // Wait for a while until the model has 'count' instances.
+  bool WaitForInstanceCount(const size_t count) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (Instances().size() != count) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+  }
+
+  // The configuration of model 'm' changed to 'count' instances.
+  inference::ModelConfig InstanceGroup(const int count) {
+    inference::ModelConfig config = GetBackendModel("m")->Config();
+    config.clear_instance_group();
+    auto group = config.add_instance_group();
+    group->set_kind(inference::ModelInstanceGroup::KIND_CPU);
+    group->set_count(count);
+    return config;
+  }
+};
+
+}
@@ -0,0 +1,230 @@
+#include "dynamic_batch_scheduler_test.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace core;
+
+namespace test {
+
+TEST_F(DynamicBatchSchedulerTest, DeadlineOrderRunsEarliestDeadlineFirst) {
+  WriteModel("default_queue_policy { allow_timeout_override: true }",
+             "parameters { key: \"queue_order\" value { string_value: \"deadline\" } }\n");
+  ASSERT_TRUE(StartServer().IsOk());
+  KeepInstanceBusy();
+  ASSERT_TRUE(Send("m", "3s", 0, 3000000).IsOk());
+  ASSERT_TRUE(Send("m", "none").IsOk());
+  ASSERT_TRUE(Send("m", "1s", 0, 1000000).IsOk());
+  ASSERT_TRUE(Send("m", "2s", 0, 2000000).IsOk());
+  ASSERT_TRUE(Send("m", "1s-later", 0, 1000000).IsOk());
+  ASSERT_TRUE(Send("m", "none-later").IsOk());
+  Resume();
+  for (const auto& id : {"busy", "3s", "none", "1s", "2s", "1s-later", "none-later"}) {
+    EXPECT_TRUE(Response(id).IsOk()) << id;
+  }
+  // The requests without a deadline go last, in arrival order as the
+  // requests of the same deadline.
+  EXPECT_EQ(ExecutedRequestIds(),
+            (std::vector<std::string>{"busy", "1s", "1s-later", "2s", "3s", "none", "none-later"}));
+}
+
+TEST_F(DynamicBatchSchedulerTest, DeadlineOrderDoesNotStarveRequestsWithoutDeadline) {
+  WriteModel("max_queue_delay_microseconds: 20000 "
+             "default_queue_policy { allow_timeout_override: true }",
+             "parameters { key: \"queue_order\" value { string_value: \"deadline\" } }\n");
+  ASSERT_TRUE(StartServer().IsOk());
+  KeepInstanceBusy();
+  ASSERT_TRUE(Send("m", "none").IsOk());
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // More requests with a deadline than fit in a batch keep arriving, the
+  // request without a deadline waited the maximum queue delay already.
+  std::vector<std::string> ids;
+  for (size_t i = 0; i < 12; ++i) {
+    ids.push_back("deadline-" + std::to_string(i));
+    ASSERT_TRUE(Send("m", ids.back(), 0, 60000000).IsOk());
+  }
+  Resume();
+  EXPECT_TRUE(Response("none").IsOk());
+  for (const auto& id : ids) {
+    EXPECT_TRUE(Response(id).IsOk()) << id;
+  }
+  const auto batches = Batches();
+  ASSERT_GE(batches.size(), 2U);
+  EXPECT_EQ(batches[1].request_ids_.front(), "none");
+}
+
+TEST_F(DynamicBatchSchedulerTest, DeadlineOrderDelayCountsFromOldestRequest) {
+  WriteModel("max_queue_delay_microseconds: 1000000 "
+             "default_queue_policy { allow_timeout_override: true }",
+             "parameters { key: \"queue_order\" value { string_value: \"deadline\" } }\n");
+  ASSERT_TRUE(StartServer().IsOk());
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(Send("m", "none").IsOk());
+  std::this_thread::sleep_for(std::chrono::milliseconds(700));
+  // Ahead of the oldest request, the batch is still due one delay after
+  // the oldest request arrived.
+  ASSERT_TRUE(Send("m", "deadline", 0, 60000000).IsOk());
+  EXPECT_TRUE(Response("none").IsOk());
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1500));
+  EXPECT_TRUE(Response("deadline").IsOk());
+  EXPECT_EQ(ExecutedRequestIds(), (std::vector<std::string>{"deadline", "none"}));
+}
+
+TEST_F(DynamicBatchSchedulerTest, CancelledRequestLeavesQueueAnywhere) {
+  WriteModel("");
+  ASSERT_TRUE(StartServer().IsOk());
+  KeepInstanceBusy();
+  ASSERT_TRUE(Send("m", "first").IsOk());
+  auto request = NewRequest("m", "cancelled");
+  InferenceRequest* cancelled = request.get();
+  ASSERT_TRUE(server->InferAsync(request).IsOk());
+  ASSERT_TRUE(Send("m", "last").IsOk());
+  cancelled->Cancel();
+  // Wakes up the batcher.
+  ASSERT_TRUE(Send("m", "wake").IsOk());
+  // Dropped while the instance is still busy, not once it is batched.
+  EXPECT_EQ(Response("cancelled").StatusCode(), Status::Code::CANCELLED);
+  Resume();
+  for (const auto& id : {"busy", "first", "last", "wake"}) {
+    EXPECT_TRUE(Response(id).IsOk()) << id;
+  }
+  EXPECT_EQ(ExecutedRequestIds(), (std::vector<std::string>{"busy", "first", "last", "wake"}));
+}
+
+TEST_F(DynamicBatchSchedulerTest, RequestMayOnlyShortenPolicyTimeout) {
+  WriteModel("default_queue_policy { default_timeout_microseconds: 300000 "
+             "allow_timeout_override: true }");
+  ASSERT_TRUE(StartServer().IsOk());
+  KeepInstanceBusy();
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(Send("m", "short", 0, 20000).IsOk());
+  ASSERT_TRUE(Send("m", "long", 0, 60000000).IsOk());
+  EXPECT_EQ(Response("short").StatusCode(), Status::Code::UNAVAILABLE);
+  EXPECT_FALSE(Responded("long"));
+  // The longer timeout of the request is capped by the policy.
+  EXPECT_EQ(Response("long").StatusCode(), Status::Code::UNAVAILABLE);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  Resume();
+  EXPECT_TRUE(Response("busy").IsOk());
+  EXPECT_EQ(ExecutedRequestIds(), std::vector<std::string>{"busy"});
+}
+
+TEST_F(DynamicBatchSchedulerTest, ExpiredRequestIsRejectedOrDelayed) {
+  WriteModel(
+      "priority_levels: 3 default_priority_level: 3\n"
+      "priority_queue_policy { key: 1 value { timeout_action: REJECT "
+      "default_timeout_microseconds: 50000 } }\n"
+      "priority_queue_policy { key: 2 value { timeout_action: DELAY "
+      "default_timeout_microseconds: 50000 } }");
+  ASSERT_TRUE(StartServer().IsOk());
+  KeepInstanceBusy();
+  ASSERT_TRUE(Send("m", "delayed", 2).IsOk());
+  ASSERT_TRUE(Send("m", "rejected", 1).IsOk());
+  EXPECT_EQ(Response("rejected").StatusCode(), Status::Code::UNAVAILABLE);
+  // The delayed request waits for the requests that are on time.
+  ASSERT_TRUE(Send("m", "on-time", 3).IsOk());
+  Resume();
+  EXPECT_TRUE(Response("delayed").IsOk());
+  EXPECT_TRUE(Response("on-time").IsOk());
+  EXPECT_EQ(ExecutedRequestIds(), (std::vector<std::string>{"busy", "on-time", "delayed"}));
+}
+
+TEST_F(DynamicBatchSchedulerTest, MaxQueueSizeIsPerPriority) {
+  WriteModel(
+      "priority_levels: 2 default_priority_level: 2\n"
+      "priority_queue_policy { key: 1 value { max_queue_size: 1 } }\n"
+      "priority_queue_policy { key: 2 value { max_queue_size: 2 } }");
+  ASSERT_TRUE(StartServer().IsOk());
+  KeepInstanceBusy();
+  // The request executing does not count.
+  EXPECT_TRUE(Send("m", "high-1", 1).IsOk());
+  EXPECT_EQ(Send("m", "high-2", 1).StatusCode(), Status::Code::UNAVAILABLE);
+  EXPECT_TRUE(Send("m", "low-1", 2).IsOk());
+  EXPECT_TRUE(Send("m", "low-2", 2).IsOk());
+  EXPECT_EQ(Send("m", "low-3", 2).StatusCode(), Status::Code::UNAVAILABLE);
+  Resume();
+  for (const auto& id : {"busy", "high-1", "low-1", "low-2"}) {
+    EXPECT_TRUE(Response(id).IsOk()) << id;
+  }
+  // The queue has room again once the requests were sent.
+  EXPECT_TRUE(Send("m", "high-3", 1).IsOk());
+  EXPECT_TRUE(Response("high-3").IsOk());
+}
+
+TEST_F(DynamicBatchSchedulerTest, CustomBatchingCapsBatchBytes) {
+  WriteModel("");
+  GetTestBackendState().batch_byte_cap_ = 32;
+  ASSERT_TRUE(StartServer().IsOk());
+  KeepInstanceBusy();
+  // The first request joins its batch even past the cap, and counts
+  // against it.
+  ASSERT_TRUE(Send("m", "big", 0, 0, 48).IsOk());
+  for (const auto& id : {"a", "b", "c"}) {
+    ASSERT_TRUE(Send("m", id).IsOk());
+  }
+  Resume();
+  for (const auto& id : {"busy", "big", "a", "b", "c"}) {
+    EXPECT_TRUE(Response(id).IsOk()) << id;
+  }
+  const auto batches = Batches();
+  ASSERT_EQ(batches.size(), 4U);
+  EXPECT_EQ(batches[1].request_ids_, std::vector<std::string>{"big"});
+  EXPECT_EQ(batches[2].request_ids_, (std::vector<std::string>{"a", "b"}));
+  EXPECT_EQ(batches[3].request_ids_, std::vector<std::string>{"c"});
+  // Every request is asked for, and the request closing a batch once
+  // more for the next batch.
+  const auto& state = GetTestBackendState();
+  EXPECT_EQ(state.batch_initialize_count_, 4U);
+  EXPECT_EQ(state.batch_include_count_, 7U);
+  EXPECT_EQ(state.batch_finalize_count_, 4U);
+}
+
+TEST_F(DynamicBatchSchedulerTest, CustomBatchingOnlyAskedForBatchSent) {
+  WriteModel("max_queue_delay_microseconds: 1000000");
+  ASSERT_TRUE(StartServer().IsOk());
+  for (const auto& id : {"a", "b", "c"}) {
+    ASSERT_TRUE(Send("m", id).IsOk());
+  }
+  // The batcher wakes up for each request, the batch is not due yet.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  const auto& state = GetTestBackendState();
+  EXPECT_EQ(state.batch_initialize_count_, 0U);
+  EXPECT_EQ(state.batch_include_count_, 0U);
+  for (const auto& id : {"a", "b", "c"}) {
+    EXPECT_TRUE(Response(id).IsOk()) << id;
+  }
+  ASSERT_EQ(Batches().size(), 1U);
+  EXPECT_EQ(state.batch_initialize_count_, 1U);
+  EXPECT_EQ(state.batch_include_count_, 3U);
+  EXPECT_EQ(state.batch_finalize_count_, 1U);
+}
+
+TEST_F(DynamicBatchSchedulerTest, NextBatchIsGatheredWhileInstanceExecutes) {
+  GetTestBackendState().gather_inputs_ = true;
+  // The default pipeline depth forms the next batch while the instance
+  // executes.
+  TestBackendFixture::WriteModel("m", 8,
+                                 "instance_group [ { kind: KIND_CPU count: 1 } ]\n"
+                                 "dynamic_batching { }\n");
+  ASSERT_TRUE(StartServer().IsOk());
+  FillInputData('a');
+  KeepInstanceBusy();
+  FillInputData('b');
+  ASSERT_TRUE(Send("m", "next").IsOk());
+  auto rate_limiter = server->GetRateLimiter();
+  BackendModel* model = GetBackendModel("m");
+  for (int i = 0; (i < 1000) && rate_limiter->PayloadSlotAvailable(model, 2); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_FALSE(rate_limiter->PayloadSlotAvailable(model, 2));
+  // The batch waiting for the instance holds a copy of its inputs, made
+  // before the data changed.
+  FillInputData('c');
+  Resume();
+  EXPECT_TRUE(Response("busy").IsOk());
+  EXPECT_TRUE(Response("next").IsOk());
+  EXPECT_EQ(GetTestBackendState().BatchInputs(),
+            (std::vector<std::string>{std::string(16, 'a'), std::string(16, 'b')}));
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "core/dynamic_batch_scheduler.h"
+#include "core/rate_limiter.h"
+#include "test/backend/test_backend_fixture.h"
+
+namespace test {
+
+class DynamicBatchSchedulerTest : public TestBackendFixture {
+ protected:
+  // A model with one instance batching up to 8 requests, with
+  // 'dynamic_batching' as its batching configuration. A batch is only
+  // formed once the instance is idle, the requests queue up while it is
+  // held.
+  void WriteModel(const std::string& dynamic_batching, const std::string& config = "") {
+    TestBackendFixture::WriteModel(
+        "m", 8,
+        "instance_group [ { kind: KIND_CPU count: 1 } ]\n"
+        "dynamic_batching { " + dynamic_batching + " }\n"
+        "parameters { key: \"pipeline_depth\" value { string_value: \"1\" } }\n" + config);
+  }
+
+  // Hold the instance executing the request 'busy'.
+  void KeepInstanceBusy() {
+    Hold();
+    ASSERT_TRUE(Send("m", "busy").IsOk());
+    ASSERT_TRUE(WaitForBatches(1));
+  }
+};
+
+}
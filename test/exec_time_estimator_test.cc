@@ -0,0 +1,82 @@
+#include "exec_time_estimator_test.h"
+
+#include <random>
+
+using namespace core;
+
+namespace test {
+
+namespace {
+// Stands in for an instance, only the address is used.
+const BackendModelInstance* FakeInstance(const uintptr_t id) {
+  return reinterpret_cast<const BackendModelInstance*>(id);
+}
+}  // namespace
+
+TEST_F(ExecTimeEstimatorTest, Quantiles) {
+  // The executions take 1ms to 2ms spread evenly.
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<uint64_t> exec_ns(1000000, 2000000);
+  for (int i = 0; i < 5000; ++i) {
+    estimator.Record(nullptr, 4, 0, exec_ns(rng));
+  }
+  ExecTimeEstimator::Estimate estimate;
+  ASSERT_TRUE(estimator.Get(nullptr, 4, 0, &estimate));
+  EXPECT_EQ(estimate.count_, 5000U);
+  EXPECT_NEAR(estimate.mean_ns_, 1500000, 200000);
+  EXPECT_NEAR(estimate.p50_ns_, 1500000, 250000);
+  EXPECT_NEAR(estimate.p90_ns_, 1900000, 250000);
+  EXPECT_GE(estimate.p99_ns_, estimate.p90_ns_);
+  EXPECT_LE(estimate.p99_ns_, 2200000);
+}
+
+TEST_F(ExecTimeEstimatorTest, InterpolateBatchSizes) {
+  estimator.Record(FakeInstance(1), 2, 0, 2000);
+  estimator.Record(FakeInstance(1), 6, 0, 4000);
+  ExecTimeEstimator::Estimate estimate;
+  ASSERT_TRUE(estimator.Get(FakeInstance(1), 4, 0, &estimate));
+  EXPECT_DOUBLE_EQ(estimate.mean_ns_, 3000);
+  // Past the measured sizes, 1500ns of fixed cost and 500ns per item.
+  ASSERT_TRUE(estimator.Get(FakeInstance(1), 12, 0, &estimate));
+  EXPECT_DOUBLE_EQ(estimate.mean_ns_, 7000);
+  ASSERT_TRUE(estimator.Get(FakeInstance(1), 1, 0, &estimate));
+  EXPECT_DOUBLE_EQ(estimate.mean_ns_, 1500);
+  EXPECT_EQ(estimator.LargestBatchSize(FakeInstance(1), 0), 6U);
+  EXPECT_FALSE(estimator.Get(FakeInstance(1), 4, 1, &estimate));
+  EXPECT_FALSE(estimator.Get(FakeInstance(2), 4, 0, &estimate));
+  EXPECT_EQ(estimator.LargestBatchSize(FakeInstance(2), 0), 0U);
+}
+
+TEST_F(ExecTimeEstimatorTest, ExtrapolationIsBounded) {
+  // A single size gives the cost per item.
+  estimator.Record(FakeInstance(1), 4, 0, 4000);
+  ExecTimeEstimator::Estimate estimate;
+  ASSERT_TRUE(estimator.Get(FakeInstance(1), 8, 0, &estimate));
+  EXPECT_DOUBLE_EQ(estimate.mean_ns_, 8000);
+  ASSERT_TRUE(estimator.Get(FakeInstance(1), 2, 0, &estimate));
+  EXPECT_DOUBLE_EQ(estimate.mean_ns_, 2000);
+  // Noisy measurements where the larger batch was faster don't make the
+  // larger batches cheaper still, nor the smaller ones dearer.
+  estimator.Record(FakeInstance(1), 6, 0, 3000);
+  ASSERT_TRUE(estimator.Get(FakeInstance(1), 12, 0, &estimate));
+  EXPECT_DOUBLE_EQ(estimate.mean_ns_, 3000);
+  ASSERT_TRUE(estimator.Get(FakeInstance(1), 2, 0, &estimate));
+  EXPECT_DOUBLE_EQ(estimate.mean_ns_, 4000);
+  // A smaller batch costs at least its share of the smallest measured.
+  estimator.Record(FakeInstance(2), 4, 0, 1000);
+  estimator.Record(FakeInstance(2), 8, 0, 9000);
+  ASSERT_TRUE(estimator.Get(FakeInstance(2), 2, 0, &estimate));
+  EXPECT_DOUBLE_EQ(estimate.mean_ns_, 500);
+}
+
+TEST_F(ExecTimeEstimatorTest, RemoveInstance) {
+  estimator.Record(FakeInstance(1), 1, 0, 1000);
+  estimator.Record(FakeInstance(2), 1, 0, 3000);
+  estimator.RemoveInstance(FakeInstance(1));
+  ExecTimeEstimator::Estimate estimate;
+  EXPECT_FALSE(estimator.Get(FakeInstance(1), 1, 0, &estimate));
+  ASSERT_TRUE(estimator.Get(nullptr, 1, 0, &estimate));
+  EXPECT_DOUBLE_EQ(estimate.mean_ns_, 2000);
+}
+
+}
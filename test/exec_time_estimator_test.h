@@ -0,0 +1,13 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include "core/exec_time_estimator.h"
+
+namespace test {
+
+class ExecTimeEstimatorTest : public testing::Test {
+ protected:
+  core::ExecTimeEstimator estimator;
+};
+
+}
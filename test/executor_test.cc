@@ -0,0 +1,36 @@
+#include "executor_test.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace core;
+
+namespace test {
+
+TEST_F(ExecutorTest, ParallelFor) {
+  std::vector<int> visits(1000, 0);
+  executor->ParallelFor(0, visits.size(), [&visits](size_t i) { ++visits[i]; });
+  for (const int visit : visits) {
+    EXPECT_EQ(visit, 1);
+  }
+}
+
+TEST_F(ExecutorTest, NestedParallelFor) {
+  // More nested loops than workers, each one waiting for its own.
+  std::atomic<size_t> sum(0);
+  executor->ParallelFor(0, 16, [this, &sum](size_t i) {
+    executor->ParallelFor(0, 100, [&sum](size_t j) { sum += j; });
+  });
+  EXPECT_EQ(sum.load(), 16 * 4950U);
+}
+
+TEST_F(ExecutorTest, SubmitRunsBeforeDestruction) {
+  std::atomic<int> count(0);
+  for (int i = 0; i < 100; ++i) {
+    executor->Submit([&count]() { ++count; });
+  }
+  executor.reset();
+  EXPECT_EQ(count.load(), 100);
+}
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include "core/executor.h"
+
+namespace test {
+
+class ExecutorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(core::Executor::Create(4, &executor).IsOk());
+  }
+  void TearDown() override {
+    executor.reset();
+  }
+
+  std::unique_ptr<core::Executor> executor;
+};
+
+}
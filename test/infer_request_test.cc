@@ -0,0 +1,43 @@
+#include "infer_request_test.h"
+
+#include <vector>
+
+#include "interface/IServer.h"
+
+using namespace core;
+
+namespace test {
+
+TEST_F(InferRequestTest, PrepareForInference) {
+  std::shared_ptr<Model> model = CreateModel();
+  const int32_t data[12] = {0};
+
+  InferenceRequest missing_input(model, -1);
+  EXPECT_FALSE(missing_input.PrepareForInference().IsOk());
+
+  InferenceRequest request(model, -1);
+  InferenceRequest::Input* input = nullptr;
+  ASSERT_TRUE(request.AddInput("IN", inference::TYPE_INT32, {2, 3, 2}, &input).IsOk());
+  EXPECT_FALSE(request.AddInput("IN", inference::TYPE_INT32, {2, 3, 2}, &input).IsOk());
+  // The data may come in several buffers, all of it must be there.
+  input->AppendData(data, 16, SERVER_MEMORY_CPU, 0);
+  EXPECT_FALSE(request.PrepareForInference().IsOk());
+  input->AppendData(data + 4, 32, SERVER_MEMORY_CPU, 0);
+  request.AddRequestedOutput("OUT");
+  ASSERT_TRUE(request.PrepareForInference().IsOk());
+  EXPECT_EQ(request.BatchSize(), 2u);
+  EXPECT_EQ(input->Buffers().size(), 2u);
+
+  InferenceRequest wrong_shape(model, -1);
+  ASSERT_TRUE(wrong_shape.AddInput("IN", inference::TYPE_INT32, {2, 3, 3}, &input).IsOk());
+  input->AppendData(data, 48, SERVER_MEMORY_CPU, 0);
+  EXPECT_FALSE(wrong_shape.PrepareForInference().IsOk());
+
+  InferenceRequest unknown_output(model, -1);
+  ASSERT_TRUE(unknown_output.AddInput("IN", inference::TYPE_INT32, {1, 1, 2}, &input).IsOk());
+  input->AppendData(data, 8, SERVER_MEMORY_CPU, 0);
+  unknown_output.AddRequestedOutput("UNKNOWN");
+  EXPECT_FALSE(unknown_output.PrepareForInference().IsOk());
+}
+
+}
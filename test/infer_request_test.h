@@ -0,0 +1,35 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "core/model.h"
+#include "core/infer_request.h"
+
+namespace test {
+
+class InferRequestTest : public testing::Test {
+ protected:
+  // A model batching up to 8 samples of a [-1, 2] INT32 input.
+  std::shared_ptr<core::Model> CreateModel() {
+    inference::ModelConfig config;
+    config.set_name("m");
+    config.set_backend("stream");
+    config.set_max_batch_size(8);
+    auto input = config.add_input();
+    input->set_name("IN");
+    input->set_data_type(inference::TYPE_INT32);
+    input->add_dims(-1);
+    input->add_dims(2);
+    auto output = config.add_output();
+    output->set_name("OUT");
+    output->set_data_type(inference::TYPE_INT32);
+    output->add_dims(1);
+    std::shared_ptr<core::Model> model = std::make_shared<core::Model>(0, "", 1, config);
+    EXPECT_TRUE(model->Init(true).IsOk());
+    return model;
+  }
+};
+
+}
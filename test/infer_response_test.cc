@@ -0,0 +1,233 @@
+#include "infer_response_test.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "interface/IServer.h"
+
+using namespace core;
+
+namespace test {
+
+TEST_F(InferResponseTest, NotDecoupledSendsOneFinalResponse) {
+  std::vector<uint32_t> flags;
+  auto factory = std::make_shared<InferenceResponseFactory>(
+      CreateModel(false), "r",
+      [&flags](std::unique_ptr<InferenceResponse>&& response, const uint32_t response_flags) {
+        flags.push_back(response_flags);
+      },
+      nullptr);
+  InferenceResponse::Output* output = nullptr;
+  auto response = factory->CreateResponse();
+  EXPECT_FALSE(response->AddOutput("UNKNOWN", {1}, &output).IsOk());
+  ASSERT_TRUE(response->AddOutput("TOKEN", {1}, &output).IsOk());
+  EXPECT_FALSE(factory->Send(std::move(response), 0).IsOk());
+  EXPECT_FALSE(factory->Send(nullptr, SERVER_RESPONSE_COMPLETE_FINAL).IsOk());
+  EXPECT_TRUE(factory->Send(factory->CreateResponse(), SERVER_RESPONSE_COMPLETE_FINAL).IsOk());
+  EXPECT_FALSE(factory->Send(factory->CreateResponse(), SERVER_RESPONSE_COMPLETE_FINAL).IsOk());
+  EXPECT_EQ(flags, std::vector<uint32_t>({SERVER_RESPONSE_COMPLETE_FINAL}));
+}
+
+TEST_F(InferResponseTest, SlowClientHoldsBackTheStream) {
+  std::unique_ptr<Executor> executor;
+  ASSERT_TRUE(Executor::Create(2, &executor).IsOk());
+  std::mutex mu;
+  std::condition_variable cv;
+  bool blocked = true;
+  std::vector<int32_t> received;
+  bool final = false;
+  auto factory = std::make_shared<InferenceResponseFactory>(
+      CreateModel(true), "r",
+      [&](std::unique_ptr<InferenceResponse>&& response, const uint32_t flags) {
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [&blocked]() { return !blocked; });
+        if (response != nullptr) {
+          received.push_back(
+              *reinterpret_cast<const int32_t*>(response->Outputs()[0].Buffer()));
+        }
+        final = ((flags & SERVER_RESPONSE_COMPLETE_FINAL) != 0);
+      },
+      executor.get());
+  std::atomic<int32_t> sent(0);
+  std::thread producer([&factory, &sent]() {
+    for (int32_t token = 0; token < 10; ++token) {
+      auto response = factory->CreateResponse();
+      InferenceResponse::Output* output = nullptr;
+      void* buffer = nullptr;
+      SERVER_MemoryType memory_type = SERVER_MEMORY_CPU;
+      int64_t memory_type_id = 0;
+      ASSERT_TRUE(response->AddOutput("TOKEN", {1}, &output).IsOk());
+      ASSERT_TRUE(output->AllocateBuffer(sizeof(token), &memory_type, &memory_type_id, &buffer).IsOk());
+      *reinterpret_cast<int32_t*>(buffer) = token;
+      ASSERT_TRUE(factory->Send(std::move(response), 0).IsOk());
+      ++sent;
+    }
+    ASSERT_TRUE(factory->Send(nullptr, SERVER_RESPONSE_COMPLETE_FINAL).IsOk());
+  });
+  // One response is with the client and two are buffered, the next send
+  // waits.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(sent, 3);
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    blocked = false;
+  }
+  cv.notify_all();
+  producer.join();
+  executor.reset();
+  EXPECT_EQ(received, std::vector<int32_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  EXPECT_TRUE(final);
+}
+
+TEST_F(InferResponseTest, OutputsComeFromTheAllocator) {
+  struct Arena {
+    char data[64];
+    size_t used;
+    size_t released;
+  } arena = {{0}, 0, 0};
+  ResponseAllocator allocator(
+      [](SERVER_ResponseAllocator* allocator, const char* tensor_name, size_t byte_size,
+         SERVER_MemoryType memory_type, int64_t memory_type_id, void* userp, void** buffer,
+         void** buffer_userp, SERVER_MemoryType* actual_memory_type,
+         int64_t* actual_memory_type_id) -> SERVER_Error* {
+        Arena* arena = reinterpret_cast<Arena*>(userp);
+        *buffer = arena->data + arena->used;
+        arena->used += byte_size;
+        *buffer_userp = arena;
+        *actual_memory_type = SERVER_MEMORY_CPU_PINNED;
+        *actual_memory_type_id = 0;
+        return nullptr;
+      },
+      [](SERVER_ResponseAllocator* allocator, void* buffer, void* buffer_userp, size_t byte_size,
+         SERVER_MemoryType memory_type, int64_t memory_type_id) -> SERVER_Error* {
+        reinterpret_cast<Arena*>(buffer_userp)->released += byte_size;
+        return nullptr;
+      });
+  std::unique_ptr<InferenceResponse> received;
+  auto factory = std::make_shared<InferenceResponseFactory>(
+      CreateModel(false), "r",
+      [&received](std::unique_ptr<InferenceResponse>&& response, const uint32_t flags) {
+        received = std::move(response);
+      },
+      nullptr, &allocator, &arena);
+  auto response = factory->CreateResponse();
+  InferenceResponse::Output* output = nullptr;
+  ASSERT_TRUE(response->AddOutput("TOKEN", {1}, &output).IsOk());
+  void* buffer = nullptr;
+  SERVER_MemoryType memory_type = SERVER_MEMORY_CPU;
+  int64_t memory_type_id = 0;
+  ASSERT_TRUE(output->AllocateBuffer(4, &memory_type, &memory_type_id, &buffer).IsOk());
+  // The backend writes straight into the memory of the client.
+  EXPECT_EQ(buffer, arena.data);
+  EXPECT_EQ(memory_type, SERVER_MEMORY_CPU_PINNED);
+  EXPECT_EQ(arena.used, 4u);
+  ASSERT_TRUE(factory->Send(std::move(response), SERVER_RESPONSE_COMPLETE_FINAL).IsOk());
+  ASSERT_NE(received, nullptr);
+  EXPECT_EQ(received->Outputs()[0].Buffer(), arena.data);
+  EXPECT_EQ(received->Outputs()[0].MemoryType(), SERVER_MEMORY_CPU_PINNED);
+  received.reset();
+  EXPECT_EQ(arena.released, 4u);
+}
+
+TEST_F(InferResponseTest, OutputBuffersAreAccounted) {
+  std::shared_ptr<Model> model = CreateModel(false);
+  std::unique_ptr<InferenceResponse> sent;
+  auto factory = std::make_shared<InferenceResponseFactory>(
+      model, "r",
+      [&sent](std::unique_ptr<InferenceResponse>&& response, const uint32_t flags) {
+        sent = std::move(response);
+      },
+      nullptr);
+  auto response = factory->CreateResponse();
+  InferenceResponse::Output* output = nullptr;
+  ASSERT_TRUE(response->AddOutput("TOKEN", {1}, &output).IsOk());
+  void* buffer = nullptr;
+  SERVER_MemoryType memory_type = SERVER_MEMORY_CPU;
+  int64_t memory_type_id = 0;
+  ASSERT_TRUE(output->AllocateBuffer(64, &memory_type, &memory_type_id, &buffer).IsOk());
+  EXPECT_EQ(model->OutputMemory().TotalByteSize(), 64U);
+  ASSERT_TRUE(factory->Send(std::move(response), SERVER_RESPONSE_COMPLETE_FINAL).IsOk());
+  // Held until the client deletes the response.
+  ASSERT_NE(sent, nullptr);
+  ModelMemoryUsage usage;
+  model->GetMemoryUsage(&usage);
+  EXPECT_EQ(TotalByteSize(usage.total_), 64U);
+  sent.reset();
+  EXPECT_EQ(model->OutputMemory().TotalByteSize(), 0U);
+}
+
+TEST_F(InferResponseTest, StuckClientTimesOutTheSend) {
+  std::unique_ptr<Executor> executor;
+  ASSERT_TRUE(Executor::Create(1, &executor).IsOk());
+  std::mutex mu;
+  std::condition_variable cv;
+  bool blocked = true;
+  uint32_t final_flags = 0;
+  auto factory = std::make_shared<InferenceResponseFactory>(
+      CreateModel(true, 50), "r",
+      [&](std::unique_ptr<InferenceResponse>&& response, const uint32_t flags) {
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [&blocked]() { return !blocked; });
+        final_flags |= flags;
+      },
+      executor.get());
+  // One response is with the client and two are buffered.
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(factory->Send(factory->CreateResponse(), 0).IsOk());
+  }
+  const auto start = std::chrono::steady_clock::now();
+  Status status = factory->Send(factory->CreateResponse(), 0);
+  EXPECT_EQ(status.StatusCode(), Status::Code::UNAVAILABLE);
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+  // The end of the stream is buffered regardless.
+  EXPECT_TRUE(factory->Send(nullptr, SERVER_RESPONSE_COMPLETE_FINAL).IsOk());
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    blocked = false;
+  }
+  cv.notify_all();
+  executor.reset();
+  EXPECT_NE(final_flags & SERVER_RESPONSE_COMPLETE_FINAL, 0U);
+}
+
+TEST_F(InferResponseTest, CancelWakesWaitingSend) {
+  std::unique_ptr<Executor> executor;
+  ASSERT_TRUE(Executor::Create(1, &executor).IsOk());
+  std::mutex mu;
+  std::condition_variable cv;
+  bool blocked = true;
+  auto factory = std::make_shared<InferenceResponseFactory>(
+      CreateModel(true), "r",
+      [&](std::unique_ptr<InferenceResponse>&& response, const uint32_t flags) {
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [&blocked]() { return !blocked; });
+      },
+      executor.get());
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(factory->Send(factory->CreateResponse(), 0).IsOk());
+  }
+  std::atomic<bool> returned(false);
+  Status status;
+  std::thread producer([&]() {
+    status = factory->Send(factory->CreateResponse(), 0);
+    returned = true;
+  });
+  // The model waits for the client without a timeout until cancelled.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(returned);
+  factory->Cancel();
+  producer.join();
+  EXPECT_EQ(status.StatusCode(), Status::Code::UNAVAILABLE);
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    blocked = false;
+  }
+  cv.notify_all();
+  executor.reset();
+}
+
+}
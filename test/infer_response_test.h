@@ -0,0 +1,37 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "core/model.h"
+#include "core/executor.h"
+#include "core/infer_response.h"
+
+namespace test {
+
+class InferResponseTest : public testing::Test {
+ protected:
+  // A model with one output, buffering two responses per request and
+  // giving up on a full buffer after 'send_timeout_ms', 0 to not give up.
+  std::shared_ptr<core::Model> CreateModel(const bool decoupled,
+                                           const uint64_t send_timeout_ms = 0) {
+    inference::ModelConfig config;
+    config.set_name("m");
+    config.set_backend("stream");
+    config.mutable_model_transaction_policy()->set_decoupled(decoupled);
+    auto output = config.add_output();
+    output->set_name("TOKEN");
+    output->set_data_type(inference::TYPE_INT32);
+    output->add_dims(1);
+    (*config.mutable_parameters())["response_buffer_size"].set_string_value("2");
+    (*config.mutable_parameters())["response_send_timeout_ms"].set_string_value(
+        std::to_string(send_timeout_ms));
+    std::shared_ptr<core::Model> model = std::make_shared<core::Model>(0, "", 1, config);
+    EXPECT_TRUE(model->Init(true).IsOk());
+    return model;
+  }
+};
+
+}
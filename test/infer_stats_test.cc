@@ -0,0 +1,61 @@
+#include "infer_stats_test.h"
+
+using namespace core;
+
+namespace test {
+
+TEST_F(InferStatsTest, HistogramBuckets) {
+  // Every value falls in a bucket bounding it within 25%.
+  const uint64_t values[] = {0, 1, 7, 8, 9, 15, 16, 1000, 123456789, UINT64_MAX};
+  for (const uint64_t value : values) {
+    const size_t index = LatencyHistogram::BucketIndex(value);
+    ASSERT_LT(index, LatencyHistogram::kBuckets);
+    EXPECT_GE(LatencyHistogram::BucketUpperBound(index), value);
+    if (index > 0) {
+      EXPECT_LT(LatencyHistogram::BucketUpperBound(index - 1), value);
+    }
+    EXPECT_LE(LatencyHistogram::BucketUpperBound(index) - value, value / 4);
+  }
+
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.QuantileNs(0.5), 0u);
+  for (uint64_t ns = 1; ns <= 100; ++ns) {
+    histogram.Record(ns * 1000);
+  }
+  EXPECT_EQ(histogram.Count(), 100u);
+  EXPECT_EQ(histogram.SumNs(), 5050000u);
+  const uint64_t p50 = histogram.QuantileNs(0.5);
+  EXPECT_GE(p50, 50000u);
+  EXPECT_LE(p50, 62500u);
+  EXPECT_GE(histogram.QuantileNs(1.0), 100000u);
+}
+
+TEST_F(InferStatsTest, AggregateStages) {
+  InferenceStatsAggregator aggregator(4);
+  aggregator.UpdateRequest(true, 100, 200, 1200, 1300);
+  aggregator.UpdateRequest(false, 100, 200, 1200, 1300);
+  EXPECT_EQ(aggregator.RequestStats().success_count_.load(), 1u);
+  EXPECT_EQ(aggregator.RequestStats().failure_count_.load(), 1u);
+  EXPECT_EQ(aggregator.RequestStats().compute_input_.SumNs(), 100u);
+  EXPECT_EQ(aggregator.RequestStats().compute_infer_.SumNs(), 1000u);
+  EXPECT_EQ(aggregator.RequestStats().compute_output_.SumNs(), 100u);
+  EXPECT_EQ(aggregator.RequestStats().execution_.SumNs(), 1200u);
+
+  // The batches are accounted per size, larger ones with the largest.
+  EXPECT_EQ(aggregator.BatchStats(2), nullptr);
+  aggregator.UpdateBatch(2, 0, 10, 20, 30);
+  aggregator.UpdateBatch(2, 0, 10, 20, 30);
+  aggregator.UpdateBatch(9, 0, 10, 20, 30);
+  ASSERT_NE(aggregator.BatchStats(2), nullptr);
+  EXPECT_EQ(aggregator.BatchStats(2)->success_count_.load(), 2u);
+  ASSERT_NE(aggregator.BatchStats(4), nullptr);
+  EXPECT_EQ(aggregator.BatchStats(4)->success_count_.load(), 1u);
+  EXPECT_EQ(aggregator.BatchStats(3), nullptr);
+  EXPECT_EQ(aggregator.BatchStats(5), nullptr);
+
+  aggregator.UpdateResponse(true, 0, 40, 50);
+  EXPECT_EQ(aggregator.ResponseStatistics().compute_infer_.SumNs(), 40u);
+  EXPECT_EQ(aggregator.ResponseStatistics().compute_output_.SumNs(), 10u);
+}
+
+}
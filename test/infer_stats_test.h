@@ -0,0 +1,11 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include "core/infer_stats.h"
+
+namespace test {
+
+class InferStatsTest : public testing::Test {};
+
+}
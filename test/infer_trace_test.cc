@@ -0,0 +1,57 @@
+#include "infer_trace_test.h"
+
+#include <thread>
+
+using namespace core;
+
+namespace test {
+
+TEST_F(InferTraceTest, Sampling) {
+  EXPECT_EQ(InferenceTracer::Sample(0), 0u);
+  const uint64_t first = InferenceTracer::Sample(1);
+  EXPECT_NE(first, 0u);
+  EXPECT_NE(InferenceTracer::Sample(1), first);
+  // One in 10 requests of a thread is traced.
+  size_t traced = 0;
+  for (int i = 0; i < 100; ++i) {
+    traced += (InferenceTracer::Sample(10) != 0) ? 1 : 0;
+  }
+  EXPECT_EQ(traced, 10u);
+}
+
+TEST_F(InferTraceTest, ExportChromeTrace) {
+  const uint32_t model = InferenceTracer::InternModelName("trace \"model\"");
+  EXPECT_EQ(InferenceTracer::InternModelName("trace \"model\""), model);
+  const uint64_t trace_id = InferenceTracer::Sample(1);
+  InferenceTracer::Record(trace_id, TraceActivity::REQUEST_RECEIVED, model);
+  InferenceTracer::Record(trace_id, TraceActivity::QUEUED, model);
+  // The stages of a request are recorded by several threads.
+  std::thread batcher([trace_id, model]() {
+    InferenceTracer::Record(trace_id, TraceActivity::BATCH_FORMED, model);
+    InferenceTracer::Record(trace_id, TraceActivity::COMPUTE_START, model);
+    InferenceTracer::Record(trace_id, TraceActivity::COMPUTE_END, model);
+    InferenceTracer::Record(trace_id, TraceActivity::RESPONSE_SENT, model);
+    InferenceTracer::Record(trace_id, TraceActivity::RESPONSE_SENT, model);
+  });
+  batcher.join();
+  InferenceTracer::Record(trace_id, TraceActivity::RELEASED, model);
+  // Not traced.
+  InferenceTracer::Record(0, TraceActivity::QUEUED, model);
+
+  std::string json;
+  InferenceTracer::ExportChromeTrace(&json);
+  EXPECT_EQ(json.compare(0, 40, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"), 0);
+  EXPECT_NE(json.find("\"args\":{\"name\":\"trace \\\"model\\\"\"}"), std::string::npos);
+  const std::string track =
+      "\"pid\":" + std::to_string(model) + ",\"tid\":" + std::to_string(trace_id) + ",";
+  EXPECT_EQ(Count(json, track), 7u);
+  for (const char* span : {"request", "prepare", "queue", "dispatch", "compute"}) {
+    EXPECT_NE(json.find("{\"name\":\"" + std::string(span) + "\",\"ph\":\"X\",\"pid\":" +
+                        std::to_string(model) + ",\"tid\":" + std::to_string(trace_id) + ","),
+              std::string::npos)
+        << span;
+  }
+  EXPECT_EQ(json.compare(json.size() - 4, 4, "\n]}\n"), 0);
+}
+
+}
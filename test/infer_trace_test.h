@@ -0,0 +1,24 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "core/infer_trace.h"
+
+namespace test {
+
+class InferTraceTest : public testing::Test {
+ protected:
+  // The number of times 'needle' occurs in 'text'.
+  static size_t Count(const std::string& text, const std::string& needle) {
+    size_t count = 0;
+    for (size_t pos = text.find(needle); pos != std::string::npos;
+         pos = text.find(needle, pos + 1)) {
+      ++count;
+    }
+    return count;
+  }
+};
+
+}
@@ -0,0 +1,149 @@
+#include "instance_rotation_test.h"
+
+using namespace core;
+
+namespace test {
+
+constexpr uint64_t InstanceRotationTest::kMsNs;
+
+TEST_F(InstanceRotationTest, DeepQueuePromotesStandby) {
+  ASSERT_TRUE(rotation.Add(Instance(0), "m_0", false).IsOk());
+  ASSERT_TRUE(rotation.Add(Instance(1), "m_1", true).IsOk());
+  EXPECT_TRUE(InRotation(0));
+  EXPECT_FALSE(InRotation(1));
+  rotation.Manage(15, kMsNs);
+  EXPECT_FALSE(InRotation(1));
+  rotation.Manage(16, 2 * kMsNs);
+  EXPECT_TRUE(InRotation(1));
+  EXPECT_TRUE(Promoted(1));
+  EXPECT_TRUE(rotation.Standbys().empty());
+}
+
+TEST_F(InstanceRotationTest, QuietQueueDemotesStandby) {
+  ASSERT_TRUE(rotation.Add(Instance(0), "m_0", false).IsOk());
+  ASSERT_TRUE(rotation.Add(Instance(1), "m_1", true).IsOk());
+  rotation.Manage(16, kMsNs);
+  // A full batch queued keeps the standby in rotation.
+  EXPECT_EQ(rotation.Manage(8, 50 * kMsNs), 100 * kMsNs);
+  EXPECT_EQ(rotation.Manage(0, 100 * kMsNs), 50 * kMsNs);
+  EXPECT_TRUE(InRotation(1));
+  EXPECT_EQ(rotation.Manage(0, 150 * kMsNs), 0U);
+  EXPECT_FALSE(InRotation(1));
+  EXPECT_TRUE(InRotation(0));
+  ASSERT_EQ(rotation.Standbys().size(), 1U);
+  EXPECT_EQ(rotation.Standbys().front(), Instance(1));
+}
+
+TEST_F(InstanceRotationTest, FailoverPromotesStandby) {
+  ASSERT_TRUE(rotation.Add(Instance(0), "m_0", false).IsOk());
+  ASSERT_TRUE(rotation.Add(Instance(1), "m_1", true).IsOk());
+  rotation.Failed(Instance(0), "device lost", kMsNs);
+  EXPECT_FALSE(InRotation(0));
+  EXPECT_TRUE(InRotation(1));
+  // The other batches of the failed instance fail too.
+  rotation.Failed(Instance(0), "device lost", 2 * kMsNs);
+  EXPECT_TRUE(InRotation(1));
+  // The standby keeps serving until the failed instance is back, then it
+  // is demoted after a quiet period.
+  EXPECT_EQ(rotation.Manage(0, 500 * kMsNs), 501 * kMsNs);
+  EXPECT_FALSE(Promoted(1));
+  rotation.Manage(0, 1001 * kMsNs);
+  EXPECT_TRUE(InRotation(0));
+  EXPECT_TRUE(Promoted(1));
+  rotation.Manage(0, 1101 * kMsNs);
+  EXPECT_TRUE(InRotation(0));
+  EXPECT_FALSE(InRotation(1));
+}
+
+TEST_F(InstanceRotationTest, FailedInstanceLeavesRotationWithoutStandby) {
+  ASSERT_TRUE(rotation.Add(Instance(0), "m_0", false).IsOk());
+  ASSERT_TRUE(rotation.Add(Instance(1), "m_1", false).IsOk());
+  rotation.Failed(Instance(0), "device lost", 0);
+  EXPECT_FALSE(InRotation(0));
+  EXPECT_TRUE(InRotation(1));
+  EXPECT_EQ(rotation.Manage(0, 400 * kMsNs), 600 * kMsNs);
+  EXPECT_FALSE(InRotation(0));
+  // Put back to probe it, failing again doubles the retry delay.
+  rotation.Manage(0, 1000 * kMsNs);
+  EXPECT_TRUE(InRotation(0));
+  rotation.Failed(Instance(0), "device lost", 1100 * kMsNs);
+  EXPECT_FALSE(InRotation(0));
+  rotation.Manage(0, 2100 * kMsNs);
+  EXPECT_FALSE(InRotation(0));
+  rotation.Manage(0, 3100 * kMsNs);
+  EXPECT_TRUE(InRotation(0));
+  // A retry delay without failing clears the failures.
+  rotation.Manage(0, 4100 * kMsNs);
+  rotation.Failed(Instance(0), "device lost", 4200 * kMsNs);
+  rotation.Manage(0, 5200 * kMsNs);
+  EXPECT_TRUE(InRotation(0));
+}
+
+TEST_F(InstanceRotationTest, LastInstanceKeepsServing) {
+  ASSERT_TRUE(rotation.Add(Instance(0), "m_0", false).IsOk());
+  rotation.Failed(Instance(0), "device lost", kMsNs);
+  EXPECT_TRUE(InRotation(0));
+}
+
+TEST_F(InstanceRotationTest, FailedStandbyReturnsToStandbys) {
+  ASSERT_TRUE(rotation.Add(Instance(0), "m_0", false).IsOk());
+  ASSERT_TRUE(rotation.Add(Instance(1), "m_1", true).IsOk());
+  rotation.Manage(16, 0);
+  ASSERT_TRUE(InRotation(1));
+  rotation.Failed(Instance(1), "device lost", kMsNs);
+  EXPECT_FALSE(InRotation(1));
+  EXPECT_TRUE(rotation.Promoted().empty());
+  EXPECT_TRUE(rotation.Standbys().empty());
+  rotation.Manage(0, 1001 * kMsNs);
+  EXPECT_FALSE(InRotation(1));
+  ASSERT_EQ(rotation.Standbys().size(), 1U);
+  EXPECT_EQ(rotation.Standbys().front(), Instance(1));
+}
+
+TEST_F(InstanceRotationTest, RemovedInstanceLeavesRotation) {
+  ASSERT_TRUE(rotation.Add(Instance(0), "m_0", false).IsOk());
+  ASSERT_TRUE(rotation.Add(Instance(1), "m_1", false).IsOk());
+  rotation.Failed(Instance(0), "device lost", 0);
+  rotation.Remove(Instance(0));
+  rotation.Remove(Instance(1));
+  EXPECT_TRUE(rotated.empty());
+  EXPECT_EQ(rotation.Manage(0, 1000 * kMsNs), 0U);
+  EXPECT_TRUE(rotated.empty());
+}
+
+TEST_F(InstanceRotationTest, InstanceFailingToRotateStaysFailed) {
+  ASSERT_TRUE(rotation.Add(Instance(0), "m_0", false).IsOk());
+  ASSERT_TRUE(rotation.Add(Instance(1), "m_1", false).IsOk());
+  rotation.Failed(Instance(0), "device lost", 0);
+  refused.insert(Instance(0));
+  // The retry fails, the instance waits the doubled retry delay.
+  EXPECT_EQ(rotation.Manage(0, 1000 * kMsNs), 2000 * kMsNs);
+  EXPECT_FALSE(InRotation(0));
+  EXPECT_EQ(rotation.Active().count(Instance(0)), 0U);
+  refused.clear();
+  rotation.Manage(0, 2000 * kMsNs);
+  EXPECT_FALSE(InRotation(0));
+  rotation.Manage(0, 3000 * kMsNs);
+  EXPECT_TRUE(InRotation(0));
+}
+
+TEST_F(InstanceRotationTest, StandbyFailingToRotateIsNotPromoted) {
+  ASSERT_TRUE(rotation.Add(Instance(0), "m_0", false).IsOk());
+  ASSERT_TRUE(rotation.Add(Instance(1), "m_1", true).IsOk());
+  ASSERT_TRUE(rotation.Add(Instance(2), "m_2", true).IsOk());
+  refused.insert(Instance(1));
+  EXPECT_EQ(rotation.Manage(16, 0), 1000 * kMsNs);
+  EXPECT_FALSE(InRotation(1));
+  EXPECT_TRUE(rotation.Promoted().empty());
+  // A failover skips the standby failing to rotate.
+  rotation.Failed(Instance(0), "device lost", kMsNs);
+  EXPECT_FALSE(InRotation(0));
+  EXPECT_TRUE(InRotation(2));
+  // The standby is back once its retry delay passed.
+  refused.clear();
+  rotation.Manage(0, 1000 * kMsNs);
+  ASSERT_EQ(rotation.Standbys().size(), 1U);
+  EXPECT_EQ(rotation.Standbys().front(), Instance(1));
+}
+
+}
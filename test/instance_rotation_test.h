@@ -0,0 +1,54 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+
+#include "core/instance_rotation.h"
+
+namespace test {
+
+class InstanceRotationTest : public testing::Test {
+ protected:
+  // A model batching up to 8, promoting a standby at 16 requests queued,
+  // demoting it after 100ms and retrying a failed instance after 1s.
+  InstanceRotationTest()
+    : rotation("m", 8, 16, 100 * kMsNs, 1000 * kMsNs,
+               [this](core::BackendModelInstance* instance, const bool in_rotation) {
+                 if (refused.find(instance) != refused.end()) {
+                   return core::Status(core::Status::Code::UNAVAILABLE, "refused");
+                 }
+                 if (in_rotation) {
+                   rotated.insert(instance);
+                 } else {
+                   rotated.erase(instance);
+                 }
+                 return core::Status::Success;
+               }) {}
+
+  // The instances are only compared, never dereferenced.
+  core::BackendModelInstance* Instance(const size_t i) {
+    return reinterpret_cast<core::BackendModelInstance*>(&slots[i]);
+  }
+
+  bool InRotation(const size_t i) const {
+    return rotated.find(reinterpret_cast<core::BackendModelInstance*>(
+               const_cast<char*>(&slots[i]))) != rotated.end();
+  }
+
+  bool Promoted(const size_t i) {
+    return std::find(rotation.Promoted().begin(), rotation.Promoted().end(), Instance(i)) !=
+           rotation.Promoted().end();
+  }
+
+  static constexpr uint64_t kMsNs = 1000 * 1000;
+  char slots[4];
+  // The instances the rotation put in rotation.
+  std::set<core::BackendModelInstance*> rotated;
+  // The instances that fail to be put in or taken out of rotation.
+  std::set<core::BackendModelInstance*> refused;
+  core::InstanceRotation rotation;
+};
+
+}
@@ -0,0 +1,214 @@
+#include "local_transport_test.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace common;
+
+namespace test {
+
+TEST_F(LocalTransportTest, RequestRoundTrip) {
+  LocalInferRequest request;
+  request.client_ = "sidecar";
+  request.sequence_id_ = 7;
+  request.model_name_ = "model";
+  request.model_version_ = 2;
+  request.inputs_.push_back(Tensor("INPUT0", "local.sidecar.input", 0, 64));
+  request.inputs_.push_back(Tensor("INPUT1", "local.sidecar.input", 64, 128));
+  request.requested_outputs_.push_back("OUTPUT0");
+  request.output_region_ = Tensor("", "local.sidecar.output", 0, 4096).region_;
+  std::string message;
+  SerializeLocalRequest(request, &message);
+
+  LocalMessageType type;
+  ASSERT_TRUE(LocalMessageTypeOf(message.data(), message.size(), &type).IsOk());
+  EXPECT_EQ(type, LocalMessageType::INFER_REQUEST);
+  LocalInferRequest parsed;
+  ASSERT_TRUE(DeserializeLocalRequest(message.data(), message.size(), &parsed).IsOk());
+  EXPECT_EQ(parsed.client_, "sidecar");
+  EXPECT_EQ(parsed.sequence_id_, 7u);
+  EXPECT_EQ(parsed.model_name_, "model");
+  EXPECT_EQ(parsed.model_version_, 2);
+  ASSERT_EQ(parsed.inputs_.size(), 2u);
+  EXPECT_EQ(parsed.inputs_[1].name_, "INPUT1");
+  EXPECT_EQ(parsed.inputs_[1].datatype_, static_cast<uint32_t>(SERVER_TYPE_FP32));
+  EXPECT_EQ(parsed.inputs_[1].shape_, std::vector<int64_t>({1, 32}));
+  EXPECT_EQ(parsed.inputs_[1].region_.segment_, "local.sidecar.input");
+  EXPECT_EQ(parsed.inputs_[1].region_.offset_, 64u);
+  EXPECT_EQ(parsed.inputs_[1].region_.byte_size_, 128u);
+  EXPECT_EQ(parsed.requested_outputs_, std::vector<std::string>({"OUTPUT0"}));
+  EXPECT_EQ(parsed.output_region_.segment_, "local.sidecar.output");
+  EXPECT_EQ(parsed.output_region_.byte_size_, 4096u);
+
+  // A message is only read as its own kind, and never past its end.
+  LocalInferResponse response;
+  EXPECT_FALSE(DeserializeLocalResponse(message.data(), message.size(), &response).IsOk());
+  for (size_t size = 0; size < message.size(); ++size) {
+    EXPECT_FALSE(DeserializeLocalRequest(message.data(), size, &parsed).IsOk());
+  }
+}
+
+TEST_F(LocalTransportTest, ResponseRoundTrip) {
+  LocalInferResponse response;
+  response.sequence_id_ = 3;
+  response.flags_ = SERVER_RESPONSE_COMPLETE_FINAL;
+  response.error_code_ = static_cast<uint32_t>(Error::Code::INVALID_ARG);
+  response.error_message_ = "bad input";
+  response.outputs_.push_back(Tensor("OUTPUT0", "local.sidecar.output", 128, 256));
+  std::string message;
+  SerializeLocalResponse(response, &message);
+
+  LocalInferResponse parsed;
+  ASSERT_TRUE(DeserializeLocalResponse(message.data(), message.size(), &parsed).IsOk());
+  EXPECT_EQ(parsed.sequence_id_, 3u);
+  EXPECT_EQ(parsed.flags_, static_cast<uint32_t>(SERVER_RESPONSE_COMPLETE_FINAL));
+  EXPECT_EQ(parsed.error_code_, static_cast<uint32_t>(Error::Code::INVALID_ARG));
+  EXPECT_EQ(parsed.error_message_, "bad input");
+  ASSERT_EQ(parsed.outputs_.size(), 1u);
+  EXPECT_EQ(parsed.outputs_[0].region_.offset_, 128u);
+
+  message.clear();
+  SerializeLocalDisconnect("sidecar", &message);
+  std::string client;
+  ASSERT_TRUE(DeserializeLocalDisconnect(message.data(), message.size(), &client).IsOk());
+  EXPECT_EQ(client, "sidecar");
+  const char stray[] = "not a message";
+  LocalMessageType type;
+  EXPECT_FALSE(LocalMessageTypeOf(stray, sizeof(stray), &type).IsOk());
+}
+
+TEST_F(LocalTransportTest, ClientWithoutServer) {
+  std::unique_ptr<LocalTransportClient> client;
+  // The names of the segments and channels are made of the client name.
+  EXPECT_EQ(LocalTransportClient::Create("local_transport_test", "side.car", 4096, 4096, 10,
+                                         &client).ErrorCode(),
+            Error::Code::INVALID_ARG);
+  EXPECT_EQ(LocalTransportClient::Create("local_transport_test", "sidecar", 4096, 4096, 10,
+                                         &client).ErrorCode(),
+            Error::Code::UNAVAILABLE);
+  EXPECT_EQ(client, nullptr);
+}
+
+TEST_F(LocalTransportTest, InferReadsInputsInPlace) {
+  StartTransport();
+  std::unique_ptr<LocalTransportClient> client;
+  ASSERT_TRUE(LocalTransportClient::Create(kTransport, "reader", 4096, 4096, 1000, &client).IsOk());
+  for (const char value : {'a', 'b'}) {
+    void* buffer = nullptr;
+    ASSERT_TRUE(client->AddInput("IN", SERVER_TYPE_INT8, {1, 16}, 16, &buffer).IsOk());
+    memset(buffer, 'x', 16);
+    client->AddRequestedOutput("OUT");
+    // The input is written once the request is executing, the server
+    // reads it where the client wrote it.
+    Hold();
+    Error error;
+    std::vector<LocalTransportClient::Output> outputs;
+    std::thread infer([&]() { error = client->Infer("echo", -1, 10000, &outputs); });
+    EXPECT_TRUE(WaitForBatches(value - 'a' + 1));
+    memset(buffer, value, 16);
+    Resume();
+    infer.join();
+    ASSERT_TRUE(error.IsOk()) << error.Message();
+    ASSERT_EQ(outputs.size(), 1u);
+    EXPECT_EQ(outputs[0].name_, "OUT");
+    EXPECT_EQ(outputs[0].datatype_, SERVER_TYPE_INT8);
+    EXPECT_EQ(outputs[0].shape_, std::vector<int64_t>({1, 16}));
+    EXPECT_EQ(std::string(static_cast<const char*>(outputs[0].base_), outputs[0].byte_size_),
+              std::string(16, value));
+  }
+}
+
+TEST_F(LocalTransportTest, SegmentsOfOtherClientsAreRefused) {
+  StartTransport();
+  std::unique_ptr<LocalTransportClient> owner;
+  ASSERT_TRUE(LocalTransportClient::Create(kTransport, "owner", 4096, 4096, 1000, &owner).IsOk());
+  // A client sending the descriptors itself, of the input segment of
+  // "owner" and of a segment of "intruderx", whose name only starts with
+  // its own.
+  const std::string prefix = LocalResponseChannelName(kTransport, "intruder");
+  ipc::channel response_channel;
+  ipc::channel request_channel;
+  ASSERT_TRUE(response_channel.connect(prefix.c_str(), ipc::receiver));
+  ASSERT_TRUE(request_channel.connect(kTransport, ipc::sender));
+  const std::vector<std::string> segments = {
+      LocalResponseChannelName(kTransport, "owner") + ".input",
+      LocalResponseChannelName(kTransport, "intruderx") + ".input"};
+  for (size_t i = 0; i < segments.size(); ++i) {
+    LocalInferRequest request;
+    request.client_ = "intruder";
+    request.sequence_id_ = i + 1;
+    request.model_name_ = "echo";
+    request.model_version_ = -1;
+    request.inputs_.push_back(Tensor("IN", segments[i], 0, 16));
+    request.inputs_.back().datatype_ = SERVER_TYPE_INT8;
+    request.inputs_.back().shape_ = {1, 16};
+    request.output_region_ = Tensor("", prefix + ".output", 0, 4096).region_;
+    std::string message;
+    SerializeLocalRequest(request, &message);
+    ASSERT_TRUE(request_channel.send(message.data(), message.size()));
+
+    ipc::buff_t received = response_channel.recv(10000);
+    ASSERT_FALSE(received.empty());
+    LocalInferResponse response;
+    ASSERT_TRUE(DeserializeLocalResponse(received.data(), received.size(), &response).IsOk());
+    EXPECT_EQ(response.sequence_id_, i + 1);
+    EXPECT_EQ(response.flags_, static_cast<uint32_t>(SERVER_RESPONSE_COMPLETE_FINAL));
+    // Refused before the segment is looked for.
+    EXPECT_EQ(response.error_code_, static_cast<uint32_t>(Error::Code::INVALID_ARG))
+        << response.error_message_;
+    EXPECT_TRUE(response.outputs_.empty());
+  }
+  EXPECT_TRUE(Batches().empty());
+}
+
+TEST_F(LocalTransportTest, FinalResponseWaitsForRelease) {
+  std::mutex mu;
+  std::condition_variable cv;
+  bool releasing = false;
+  bool release = false;
+  GetTestBackendState().on_release_ = [&](const std::vector<std::string>& request_ids) {
+    std::unique_lock<std::mutex> lock(mu);
+    releasing = true;
+    cv.notify_all();
+    cv.wait(lock, [&]() { return release; });
+  };
+  StartTransport();
+  std::unique_ptr<LocalTransportClient> client;
+  ASSERT_TRUE(LocalTransportClient::Create(kTransport, "waiter", 4096, 4096, 1000, &client).IsOk());
+  void* buffer = nullptr;
+  ASSERT_TRUE(client->AddInput("IN", SERVER_TYPE_INT8, {1, 16}, 16, &buffer).IsOk());
+  memset(buffer, 'a', 16);
+  client->AddRequestedOutput("OUT");
+
+  Error error;
+  std::atomic<bool> done(false);
+  std::vector<LocalTransportClient::Output> outputs;
+  std::thread infer([&]() {
+    error = client->Infer("echo", -1, 10000, &outputs);
+    done = true;
+  });
+  {
+    std::unique_lock<std::mutex> lock(mu);
+    EXPECT_TRUE(cv.wait_for(lock, std::chrono::seconds(10), [&]() { return releasing; }));
+  }
+  // Responded to, but the request still holds the input segment.
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_FALSE(done);
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    release = true;
+    cv.notify_all();
+  }
+  infer.join();
+  ASSERT_TRUE(error.IsOk()) << error.Message();
+  ASSERT_EQ(outputs.size(), 1u);
+  EXPECT_EQ(std::string(static_cast<const char*>(outputs[0].base_), outputs[0].byte_size_),
+            std::string(16, 'a'));
+}
+
+}
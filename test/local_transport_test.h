@@ -0,0 +1,54 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "common/local_transport_client.h"
+#include "common/local_transport_protocol.h"
+#include "core/local_transport.h"
+#include "interface/IServer.h"
+#include "test/backend/test_backend_fixture.h"
+
+namespace test {
+
+class LocalTransportTest : public TestBackendFixture {
+ protected:
+  // The name of the transport of the tests serving a server.
+  static constexpr const char* kTransport = "local_transport_test_server";
+
+  // Serve model "echo", echoing its input "IN" as the output "OUT",
+  // through the transport.
+  void StartTransport() {
+    WriteModel("echo", 8,
+               "instance_group [ { kind: KIND_CPU count: 1 } ]\n"
+               "dynamic_batching { }\n");
+    ASSERT_TRUE(StartServer().IsOk());
+    ASSERT_TRUE(core::LocalTransport::Create(server.get(), kTransport, &transport).IsOk());
+  }
+
+  void TearDown() override {
+    transport.reset();
+    TestBackendFixture::TearDown();
+  }
+
+  // A tensor of 'name' in the region at 'offset' of 'segment'.
+  static common::LocalTensor Tensor(const std::string& name, const std::string& segment,
+                                    const uint64_t offset, const uint64_t byte_size) {
+    common::LocalTensor tensor;
+    tensor.name_ = name;
+    tensor.datatype_ = SERVER_TYPE_FP32;
+    tensor.shape_ = {1, static_cast<int64_t>(byte_size / sizeof(float))};
+    tensor.region_.segment_ = segment;
+    tensor.region_.segment_byte_size_ = 4096;
+    tensor.region_.offset_ = offset;
+    tensor.region_.byte_size_ = byte_size;
+    return tensor;
+  }
+
+  std::unique_ptr<core::LocalTransport> transport;
+};
+
+}
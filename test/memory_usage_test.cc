@@ -0,0 +1,71 @@
+#include "memory_usage_test.h"
+
+#include <thread>
+#include <vector>
+
+using namespace core;
+
+namespace test {
+
+TEST_F(MemoryUsageTest, ConcurrentUpdates) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 16; ++i) {
+    threads.emplace_back([this]() {
+      for (int j = 0; j < 1000; ++j) {
+        usage.Allocated(SERVER_MEMORY_CPU, 0, 64);
+        usage.Allocated(SERVER_MEMORY_GPU, 1, 32);
+        usage.Released(SERVER_MEMORY_GPU, 1, 16);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const MemoryUsageMap result = usage.Usage();
+  EXPECT_EQ(result.at(SERVER_MEMORY_CPU).at(0), 16 * 1000 * 64U);
+  EXPECT_EQ(result.at(SERVER_MEMORY_GPU).at(1), 16 * 1000 * 16U);
+  EXPECT_EQ(usage.TotalByteSize(), 16 * 1000 * 80U);
+}
+
+TEST_F(MemoryUsageTest, SetAndOverflow) {
+  usage.Allocated(SERVER_MEMORY_CPU, 0, 100);
+  usage.Set(SERVER_MEMORY_CPU, 0, 40);
+  EXPECT_EQ(usage.Usage().at(SERVER_MEMORY_CPU).at(0), 40U);
+  // More memory ids than the counters kept inline.
+  for (int64_t id = 0; id < 32; ++id) {
+    usage.Allocated(SERVER_MEMORY_GPU, id, 10);
+  }
+  const MemoryUsageMap result = usage.Usage();
+  EXPECT_EQ(result.at(SERVER_MEMORY_GPU).size(), 32U);
+  EXPECT_EQ(TotalByteSize(result), 40U + 32 * 10U);
+}
+
+TEST_F(MemoryUsageTest, ConcurrentSetsAndUpdates) {
+  usage.Allocated(SERVER_MEMORY_CPU, 0, 1000);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([this, i]() {
+      for (int j = 0; j < 1000; ++j) {
+        if (i % 2 == 0) {
+          usage.Set(SERVER_MEMORY_CPU, 0, 4096);
+        } else {
+          usage.Allocated(SERVER_MEMORY_CPU, 0, 8);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // The sets never add up, and the allocations made after the last set
+  // are kept whole.
+  const size_t byte_size = usage.Usage().at(SERVER_MEMORY_CPU).at(0);
+  EXPECT_GE(byte_size, 4096U);
+  EXPECT_LE(byte_size, 4096U + 4 * 1000 * 8);
+  EXPECT_EQ((byte_size - 4096) % 8, 0U);
+  usage.Set(SERVER_MEMORY_CPU, 0, 4096);
+  usage.Allocated(SERVER_MEMORY_CPU, 0, 8);
+  EXPECT_EQ(usage.Usage().at(SERVER_MEMORY_CPU).at(0), 4096U + 8);
+}
+
+}
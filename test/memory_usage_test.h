@@ -0,0 +1,18 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include "core/memory_usage.h"
+
+namespace test {
+
+class MemoryUsageTest : public testing::Test {
+ protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+
+  core::MemoryUsage usage;
+};
+
+}
@@ -0,0 +1,117 @@
+#include "metrics_test.h"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace core;
+
+namespace test {
+
+TEST_F(MetricsTest, CountersAndGauges) {
+  std::shared_ptr<Metric> counter =
+      CreateMetric(SERVER_METRIC_KIND_COUNTER, "test_counter", {{"model", "m"}});
+  // The threads update their own shards, the value sums them.
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&counter]() {
+      for (int j = 0; j < 1000; ++j) {
+        counter->Increment(1);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(counter->Value(), 4000);
+  // The same labels give the same metric.
+  EXPECT_EQ(CreateMetric(SERVER_METRIC_KIND_COUNTER, "test_counter", {{"model", "m"}}), counter);
+
+  std::shared_ptr<Metric> gauge =
+      CreateMetric(SERVER_METRIC_KIND_GAUGE, "test_gauge", {{"model", "say \"hi\"\n"}});
+  gauge->Increment(5);
+  gauge->Set(2.5);
+  gauge->Increment(-1);
+  EXPECT_EQ(gauge->Value(), 1.5);
+
+  std::shared_ptr<MetricFamily> family;
+  EXPECT_FALSE(MetricFamily::Create(SERVER_METRIC_KIND_GAUGE, "test_counter", "", &family).IsOk());
+  EXPECT_FALSE(MetricFamily::Create(SERVER_METRIC_KIND_GAUGE, "0test", "", &family).IsOk());
+
+  const std::string text = Render();
+  EXPECT_NE(text.find("# TYPE test_counter counter\ntest_counter{model=\"m\"} 4000\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("test_gauge{model=\"say \\\"hi\\\"\\n\"} 1.5\n"), std::string::npos);
+
+  // A metric is no longer rendered once it is gone.
+  counter.reset();
+  EXPECT_EQ(Render().find("test_counter"), std::string::npos);
+}
+
+TEST_F(MetricsTest, GaugeIsSetAtOnce) {
+  // Each CPU has a shard of its own.
+  EXPECT_GE(Metric::ShardCount(), std::thread::hardware_concurrency());
+  std::shared_ptr<Metric> gauge =
+      CreateMetric(SERVER_METRIC_KIND_GAUGE, "test_set_gauge", {{"model", "m"}});
+  // Racing sets leave one of the values set, not a mix of them.
+  std::vector<std::thread> threads;
+  for (int i = 1; i <= 4; ++i) {
+    threads.emplace_back([&gauge, i]() {
+      for (int j = 0; j < 10000; ++j) {
+        gauge->Set(i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const double value = gauge->Value();
+  EXPECT_TRUE((value == 1) || (value == 2) || (value == 3) || (value == 4)) << value;
+}
+
+TEST_F(MetricsTest, Histograms) {
+  std::shared_ptr<Metric> histogram =
+      CreateMetric(SERVER_METRIC_KIND_HISTOGRAM, "test_duration_us", {});
+  for (uint64_t us = 1; us <= 100; ++us) {
+    histogram->Observe(us);
+  }
+  EXPECT_EQ(histogram->Count(), 100u);
+  EXPECT_EQ(histogram->Sum(), 5050u);
+  EXPECT_GE(histogram->Quantile(0.99), 99u);
+
+  std::shared_ptr<MetricFamily> family;
+  ASSERT_TRUE(
+      MetricFamily::Create(SERVER_METRIC_KIND_HISTOGRAM, "test_duration_us", "", &family).IsOk());
+  std::shared_ptr<Metric> metric;
+  EXPECT_FALSE(family->CreateMetric({{"quantile", "1"}}, &metric).IsOk());
+
+  const std::string text = Render();
+  EXPECT_NE(text.find("# TYPE test_duration_us summary\n"), std::string::npos);
+  EXPECT_NE(text.find("test_duration_us{quantile=\"0.5\"} "), std::string::npos);
+  EXPECT_NE(text.find("test_duration_us_sum 5050\ntest_duration_us_count 100\n"),
+            std::string::npos);
+}
+
+TEST_F(MetricsTest, HistogramObservesIntegers) {
+  SERVER_MetricFamily* family = nullptr;
+  ASSERT_EQ(SERVER_MetricFamilyNew(&family, SERVER_METRIC_KIND_HISTOGRAM, "test_size_bytes", ""),
+            nullptr);
+  SERVER_Metric* metric = nullptr;
+  ASSERT_EQ(SERVER_MetricNew(&metric, family, nullptr, nullptr, 0), nullptr);
+  EXPECT_EQ(SERVER_MetricObserve(metric, 0), nullptr);
+  EXPECT_EQ(SERVER_MetricObserve(metric, 1e15), nullptr);
+  // Fractions and values out of range are not rounded into another one.
+  for (const double value : {0.5, -1.0, 1e20, std::nan("")}) {
+    SERVER_Error* err = SERVER_MetricObserve(metric, value);
+    ASSERT_NE(err, nullptr) << value;
+    EXPECT_EQ(SERVER_ErrorCode(err), SERVER_ERROR_INVALID_ARG);
+    SERVER_ErrorDelete(err);
+  }
+  double count = 0;
+  EXPECT_EQ(SERVER_MetricValue(metric, &count), nullptr);
+  EXPECT_EQ(count, 2);
+  EXPECT_EQ(SERVER_MetricDelete(metric), nullptr);
+  EXPECT_EQ(SERVER_MetricFamilyDelete(family), nullptr);
+}
+
+}
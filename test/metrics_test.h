@@ -0,0 +1,34 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "core/metrics.h"
+#include "interface/IServer.h"
+
+namespace test {
+
+class MetricsTest : public testing::Test {
+ protected:
+  // Create the metric of 'labels' in the family 'name' of 'kind'.
+  std::shared_ptr<core::Metric> CreateMetric(const SERVER_MetricKind kind,
+                                             const std::string& name,
+                                             const std::map<std::string, std::string>& labels) {
+    std::shared_ptr<core::MetricFamily> family;
+    EXPECT_TRUE(core::MetricFamily::Create(kind, name, "test " + name, &family).IsOk());
+    std::shared_ptr<core::Metric> metric;
+    EXPECT_TRUE(family->CreateMetric(labels, &metric).IsOk());
+    return metric;
+  }
+
+  std::string Render() {
+    std::string text;
+    core::RenderMetrics(&text);
+    return text;
+  }
+};
+
+}
@@ -0,0 +1,409 @@
+#include "model_repository_manager_test.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <thread>
+
+using namespace core;
+
+namespace test {
+
+TEST_F(ModelRepositoryManagerTest, DependenciesLoadFirst) {
+  WriteModel("base", Config("base"));
+  WriteModel("mid", EnsembleConfig("mid", {"base"}));
+  WriteModel("top", EnsembleConfig("top", {"mid", "base"}));
+  WriteModel("other", Config("other"));
+  ASSERT_TRUE(CreateManager().IsOk());
+  EXPECT_LT(CreatedAt("base"), CreatedAt("mid"));
+  EXPECT_LT(CreatedAt("mid"), CreatedAt("top"));
+  EXPECT_EQ(manager->Created().size(), 4U);
+  for (const auto& name : {"base", "mid", "top", "other"}) {
+    EXPECT_EQ(State(name).first, ModelReadyState::READY) << name;
+  }
+}
+
+TEST_F(ModelRepositoryManagerTest, IndependentModelsLoadInParallel) {
+  WriteModel("a", Config("a"));
+  WriteModel("b", Config("b"));
+  // Each load waits for the other one to start.
+  std::mutex mu;
+  std::condition_variable cv;
+  size_t started = 0;
+  bool overlapped = true;
+  NewManager(2);
+  manager->on_create = [&](const std::string&) {
+    std::unique_lock<std::mutex> lock(mu);
+    ++started;
+    cv.notify_all();
+    if (!cv.wait_for(lock, std::chrono::seconds(10), [&]() { return started >= 2; })) {
+      overlapped = false;
+    }
+    return Status::Success;
+  };
+  ASSERT_TRUE(manager->Start().IsOk());
+  EXPECT_TRUE(overlapped);
+  EXPECT_EQ(State("a").first, ModelReadyState::READY);
+  EXPECT_EQ(State("b").first, ModelReadyState::READY);
+}
+
+TEST_F(ModelRepositoryManagerTest, FailedDependencyFailsDependents) {
+  WriteModel("base", Config("base"));
+  WriteModel("mid", EnsembleConfig("mid", {"base"}));
+  WriteModel("top", EnsembleConfig("top", {"mid"}));
+  NewManager();
+  manager->on_create = [](const std::string& name) {
+    return (name == "base") ? Status(Status::Code::INTERNAL, "no backend")
+                            : Status::Success;
+  };
+  ASSERT_TRUE(manager->Start().IsOk());
+  EXPECT_TRUE(manager->Created().empty());
+  EXPECT_EQ(State("base"), std::make_pair(ModelReadyState::UNAVAILABLE, std::string("no backend")));
+  EXPECT_EQ(State("mid").second, "failed to load dependency 'base'");
+  EXPECT_EQ(State("top").second, "failed to load dependency 'mid'");
+}
+
+TEST_F(ModelRepositoryManagerTest, CircularDependencyIsReported) {
+  WriteModel("p", EnsembleConfig("p", {"q"}));
+  WriteModel("q", EnsembleConfig("q", {"p"}));
+  WriteModel("r", EnsembleConfig("r", {"p"}));
+  WriteModel("other", Config("other"));
+  ASSERT_TRUE(CreateManager().IsOk());
+  EXPECT_EQ(manager->Created(), std::vector<std::string>{"other"});
+  for (const auto& name : {"p", "q", "r"}) {
+    EXPECT_EQ(State(name),
+              std::make_pair(ModelReadyState::UNAVAILABLE,
+                             std::string("circular dependency between models")))
+        << name;
+  }
+}
+
+TEST_F(ModelRepositoryManagerTest, CircularDependencyOnDemand) {
+  WriteModel("p", EnsembleConfig("p", {"q"}));
+  WriteModel("q", EnsembleConfig("q", {"p"}));
+  ModelLoadOptions options;
+  options.on_demand_ = true;
+  ASSERT_TRUE(CreateManager(4, options).IsOk());
+  std::shared_ptr<Model> model;
+  const Status status = manager->GetModel("p", -1, &model);
+  EXPECT_EQ(status.StatusCode(), Status::Code::INVALID_ARG);
+  EXPECT_NE(status.Message().find("circular dependency"), std::string::npos);
+  EXPECT_TRUE(manager->Created().empty());
+  // The failure sticks until the model changes.
+  EXPECT_EQ(manager->GetModel("p", -1, &model).StatusCode(), Status::Code::UNAVAILABLE);
+}
+
+TEST_F(ModelRepositoryManagerTest, UnreadableConfigIsReported) {
+  WriteModel("broken", "name: \"broken\"\nthis is not a model config\n");
+  WriteModel("good", Config("good"));
+  ASSERT_TRUE(CreateManager().IsOk());
+  EXPECT_EQ(manager->Created(), std::vector<std::string>{"good"});
+  EXPECT_EQ(State("broken").first, ModelReadyState::UNAVAILABLE);
+  EXPECT_FALSE(State("broken").second.empty());
+  EXPECT_EQ(State("good").first, ModelReadyState::READY);
+}
+
+TEST_F(ModelRepositoryManagerTest, UnreadableConfigKeepsLoadedVersion) {
+  WriteModel("m", Config("m"));
+  ASSERT_TRUE(CreateManager().IsOk());
+  std::shared_ptr<Model> loaded;
+  ASSERT_TRUE(manager->GetModel("m", -1, &loaded).IsOk());
+  // Caught half written.
+  WriteModel("m", "name: \"m\"\nbackend: ");
+  ASSERT_TRUE(manager->PollAndUpdate().IsOk());
+  std::shared_ptr<Model> model;
+  ASSERT_TRUE(manager->GetModel("m", -1, &model).IsOk());
+  EXPECT_EQ(model, loaded);
+  EXPECT_EQ(State("m").first, ModelReadyState::READY);
+  EXPECT_EQ(manager->Created().size(), 1U);
+  // Once written out it is loaded again.
+  WriteModel("m", Config("m") + "max_batch_size: 4\n");
+  ASSERT_TRUE(manager->PollAndUpdate().IsOk());
+  ASSERT_TRUE(manager->GetModel("m", -1, &model).IsOk());
+  EXPECT_NE(model, loaded);
+  EXPECT_EQ(model->Config().max_batch_size(), 4);
+}
+
+TEST_F(ModelRepositoryManagerTest, FingerprintTracksModelFiles) {
+  WriteModel("m", Config("m"));
+  const std::string path = JoinPath({repository, "m"});
+  ModelFingerprint before, after;
+  ASSERT_TRUE(GetModelFingerprint(path, &before).IsOk());
+  ASSERT_TRUE(GetModelFingerprint(path, &after).IsOk());
+  EXPECT_EQ(before, after);
+  // A new configuration leaves the model files alone.
+  WriteFile("m/config.pbtxt", Config("m") + "max_batch_size: 4\n");
+  ASSERT_TRUE(GetModelFingerprint(path, &after).IsOk());
+  EXPECT_NE(after.hash_, before.hash_);
+  EXPECT_EQ(after.files_hash_, before.files_hash_);
+  before = after;
+  WriteFile("m/1/model.bin", "weights");
+  ASSERT_TRUE(GetModelFingerprint(path, &after).IsOk());
+  EXPECT_NE(after.files_hash_, before.files_hash_);
+  EXPECT_EQ(after.size_, before.size_ + 7);
+  before = after;
+  ASSERT_EQ(rename(JoinPath({path, "1/model.bin"}).c_str(),
+                   JoinPath({path, "1/model.old"}).c_str()), 0);
+  ASSERT_TRUE(GetModelFingerprint(path, &after).IsOk());
+  EXPECT_NE(after.files_hash_, before.files_hash_);
+  EXPECT_EQ(after.size_, before.size_);
+  // Rewritten with the same size, only the modification time tells.
+  before = after;
+  const struct timespec times[2] = {{0, UTIME_OMIT}, {1000000000, 0}};
+  ASSERT_EQ(utimensat(AT_FDCWD, JoinPath({path, "1/model.old"}).c_str(), times, 0), 0);
+  ASSERT_TRUE(GetModelFingerprint(path, &after).IsOk());
+  EXPECT_NE(after, before);
+  EXPECT_NE(after.files_hash_, before.files_hash_);
+}
+
+TEST_F(ModelRepositoryManagerTest, PollReloadsTouchedModels) {
+  WriteModel("a", Config("a"));
+  WriteModel("b", Config("b"));
+  ASSERT_TRUE(CreateManager().IsOk());
+  ASSERT_TRUE(manager->PollAndUpdate().IsOk());
+  EXPECT_EQ(manager->Created().size(), 2U);
+  WriteFile("a/config.pbtxt", Config("a") + "max_batch_size: 4\n");
+  ASSERT_TRUE(manager->PollAndUpdate().IsOk());
+  EXPECT_EQ(CreatedCount("a"), 2U);
+  EXPECT_EQ(CreatedCount("b"), 1U);
+  WriteFile("b/1/model.bin", "weights");
+  ASSERT_TRUE(manager->PollAndUpdate().IsOk());
+  EXPECT_EQ(CreatedCount("a"), 2U);
+  EXPECT_EQ(CreatedCount("b"), 2U);
+  WriteModel("c", Config("c"));
+  ASSERT_EQ(nftw(JoinPath({repository, "a"}).c_str(), RemovePath, 16, FTW_DEPTH | FTW_PHYS), 0);
+  ASSERT_TRUE(manager->PollAndUpdate().IsOk());
+  EXPECT_EQ(CreatedCount("c"), 1U);
+  EXPECT_EQ(State("c").first, ModelReadyState::READY);
+  EXPECT_EQ(State("a").first, ModelReadyState::UNKNOWN);
+  EXPECT_EQ(CreatedCount("b"), 2U);
+}
+
+TEST_F(ModelRepositoryManagerTest, PollRescansAfterLostEvents) {
+  size_t max_queued_events = 16384;
+  std::ifstream("/proc/sys/fs/inotify/max_queued_events") >> max_queued_events;
+  if (max_queued_events > 100000) {
+    GTEST_SKIP() << "inotify queue too large to overflow";
+  }
+  WriteModel("a", Config("a"));
+  WriteModel("b", Config("b"));
+  ASSERT_TRUE(CreateManager().IsOk());
+  for (size_t i = 0; i <= max_queued_events; ++i) {
+    WriteFile("a/1/" + std::to_string(i), "");
+  }
+  // Only found by rescanning, the event is lost.
+  WriteFile("b/config.pbtxt", Config("b") + "max_batch_size: 4\n");
+  ASSERT_TRUE(manager->PollAndUpdate().IsOk());
+  EXPECT_EQ(CreatedCount("a"), 2U);
+  EXPECT_EQ(CreatedCount("b"), 2U);
+}
+
+TEST_F(ModelRepositoryManagerTest, VersionTrafficSteps) {
+  inference::ModelConfig config;
+  config.set_name("m");
+  std::vector<uint32_t> steps;
+  uint64_t interval_ms = 0;
+  ASSERT_TRUE(GetVersionTrafficSteps(config, &steps, &interval_ms).IsOk());
+  EXPECT_TRUE(steps.empty());
+  auto& parameters = *config.mutable_parameters();
+  parameters["version_traffic_steps"].set_string_value("1, 10,50");
+  ASSERT_TRUE(GetVersionTrafficSteps(config, &steps, &interval_ms).IsOk());
+  EXPECT_EQ(steps, (std::vector<uint32_t>{1, 10, 50, 100}));
+  EXPECT_EQ(interval_ms, 10000U);
+  parameters["version_traffic_steps"].set_string_value("10,100");
+  parameters["version_traffic_step_interval_ms"].set_string_value("5");
+  ASSERT_TRUE(GetVersionTrafficSteps(config, &steps, &interval_ms).IsOk());
+  EXPECT_EQ(steps, (std::vector<uint32_t>{10, 100}));
+  EXPECT_EQ(interval_ms, 5U);
+  for (const auto& invalid : {"10,5", "10,10", "0", "101", "-1", "ten"}) {
+    parameters["version_traffic_steps"].set_string_value(invalid);
+    EXPECT_EQ(GetVersionTrafficSteps(config, &steps, &interval_ms).StatusCode(),
+              Status::Code::INVALID_ARG)
+        << invalid;
+  }
+}
+
+TEST_F(ModelRepositoryManagerTest, RolloutStepsTrafficToNewVersion) {
+  const std::string config =
+      Config("m") +
+      "parameters { key: \"version_traffic_steps\" value { string_value: \"50\" } }\n"
+      "parameters { key: \"version_traffic_step_interval_ms\" value { string_value: \"300\" } }\n";
+  WriteModel("m", config, {1});
+  ASSERT_TRUE(CreateManager().IsOk());
+  ModelRepositoryManager::VersionWeightMap traffic;
+  ASSERT_TRUE(manager->VersionTraffic("m", &traffic).IsOk());
+  EXPECT_TRUE(traffic.empty());
+  // The new version takes half of the traffic, the previous one keeps
+  // serving the other half until the next step.
+  WriteModel("m", config, {2});
+  ASSERT_TRUE(manager->PollAndUpdate().IsOk());
+  ASSERT_TRUE(manager->VersionTraffic("m", &traffic).IsOk());
+  EXPECT_EQ(traffic, (ModelRepositoryManager::VersionWeightMap{{1, 50}, {2, 50}}));
+  std::map<int64_t, size_t> picked;
+  for (size_t i = 0; i < 100; ++i) {
+    std::shared_ptr<Model> model;
+    ASSERT_TRUE(manager->GetModel("m", -1, &model).IsOk());
+    ++picked[model->Version()];
+  }
+  EXPECT_GT(picked[1], 0U);
+  EXPECT_GT(picked[2], 0U);
+  // The last step moves everything and retires the previous version.
+  std::shared_ptr<Model> model;
+  for (size_t i = 0; (i < 500) && manager->GetModel("m", 1, &model).IsOk(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(manager->GetModel("m", 1, &model).StatusCode(), Status::Code::UNAVAILABLE);
+  ASSERT_TRUE(manager->VersionTraffic("m", &traffic).IsOk());
+  EXPECT_TRUE(traffic.empty());
+  ASSERT_TRUE(manager->GetModel("m", -1, &model).IsOk());
+  EXPECT_EQ(model->Version(), 2);
+  EXPECT_EQ(manager->ModelStates().at("m").size(), 1U);
+}
+
+TEST_F(ModelRepositoryManagerTest, TrafficSplitsByWeight) {
+  WriteModel("m", Config("m") + "version_policy { all {} }\n", {1, 2, 3});
+  ASSERT_TRUE(CreateManager().IsOk());
+  EXPECT_EQ(manager->SetVersionTraffic("m", {{4, 1}}).StatusCode(), Status::Code::INVALID_ARG);
+  ASSERT_TRUE(manager->SetVersionTraffic("m", {{1, 1}, {3, 3}}).IsOk());
+  std::map<int64_t, size_t> picked;
+  for (size_t i = 0; i < 4000; ++i) {
+    std::shared_ptr<Model> model;
+    ASSERT_TRUE(manager->GetModel("m", -1, &model).IsOk());
+    ++picked[model->Version()];
+  }
+  EXPECT_EQ(picked.count(2), 0U);
+  EXPECT_NEAR(picked[1], 1000, 200);
+  EXPECT_NEAR(picked[3], 3000, 200);
+  // An explicit version ignores the traffic.
+  std::shared_ptr<Model> model;
+  ASSERT_TRUE(manager->GetModel("m", 2, &model).IsOk());
+  EXPECT_EQ(model->Version(), 2);
+  // Back to the latest version.
+  ASSERT_TRUE(manager->SetVersionTraffic("m", {}).IsOk());
+  ASSERT_TRUE(manager->GetModel("m", -1, &model).IsOk());
+  EXPECT_EQ(model->Version(), 3);
+}
+
+TEST_F(ModelRepositoryManagerTest, ShutdownDrainIsBounded) {
+  WriteModel("m", Config("m"));
+  ModelLoadOptions options;
+  options.drain_timeout_ms_ = 100;
+  ASSERT_TRUE(CreateManager(4, options).IsOk());
+  std::shared_ptr<Model> model;
+  ASSERT_TRUE(manager->GetModel("m", -1, &model).IsOk());
+  model.reset();
+  // A request that never completes.
+  *manager->inflight = 1;
+  const auto start = std::chrono::steady_clock::now();
+  manager.reset();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST_F(ModelRepositoryManagerTest, OnDemandLoadIsSingleFlight) {
+  WriteModel("m", Config("m"));
+  ModelLoadOptions options;
+  options.on_demand_ = true;
+  NewManager(4, options);
+  std::mutex mu;
+  std::condition_variable cv;
+  size_t loads = 0;
+  bool release = false;
+  manager->on_create = [&](const std::string&) {
+    std::unique_lock<std::mutex> lock(mu);
+    ++loads;
+    cv.notify_all();
+    cv.wait(lock, [&]() { return release; });
+    return Status::Success;
+  };
+  ASSERT_TRUE(manager->Start().IsOk());
+  EXPECT_TRUE(manager->Created().empty());
+  EXPECT_EQ(State("m").first, ModelReadyState::UNAVAILABLE);
+  std::vector<std::shared_ptr<Model>> models(8);
+  std::vector<Status> statuses(models.size());
+  std::vector<std::thread> requests;
+  for (size_t i = 0; i < models.size(); ++i) {
+    requests.emplace_back([&, i]() { statuses[i] = manager->GetModel("m", -1, &models[i]); });
+  }
+  {
+    std::unique_lock<std::mutex> lock(mu);
+    ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(10), [&]() { return loads > 0; }));
+  }
+  // Give the other requests the time to pile up behind the load.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    release = true;
+  }
+  cv.notify_all();
+  for (auto& request : requests) {
+    request.join();
+  }
+  EXPECT_EQ(loads, 1U);
+  for (size_t i = 0; i < models.size(); ++i) {
+    EXPECT_TRUE(statuses[i].IsOk()) << i;
+    EXPECT_EQ(models[i], models[0]) << i;
+  }
+  EXPECT_NE(models[0], nullptr);
+  EXPECT_EQ(State("m").first, ModelReadyState::READY);
+}
+
+TEST_F(ModelRepositoryManagerTest, BudgetEvictsLeastRecentlyUsed) {
+  // Until a model reports its memory, the size of its files counts.
+  for (const auto& name : {"a", "b", "c"}) {
+    WriteModel(name, Config(name));
+    WriteFile(std::string(name) + "/1/model.bin", std::string(1000, 'x'));
+  }
+  WriteModel("big", Config("big"));
+  WriteFile("big/1/model.bin", std::string(3000, 'x'));
+  ModelLoadOptions options;
+  options.on_demand_ = true;
+  options.memory_budget_bytes_ = 2500;
+  ASSERT_TRUE(CreateManager(4, options).IsOk());
+  std::shared_ptr<Model> model;
+  ASSERT_TRUE(manager->GetModel("a", -1, &model).IsOk());
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  ASSERT_TRUE(manager->GetModel("b", -1, &model).IsOk());
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  ASSERT_TRUE(manager->GetModel("a", -1, &model).IsOk());
+  // Only two fit, 'b' was requested last the longest ago.
+  ASSERT_TRUE(manager->GetModel("c", -1, &model).IsOk());
+  EXPECT_EQ(State("a").first, ModelReadyState::READY);
+  EXPECT_EQ(State("b").first, ModelReadyState::UNAVAILABLE);
+  EXPECT_EQ(State("c").first, ModelReadyState::READY);
+  // An evicted model is loaded again by its next request.
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  ASSERT_TRUE(manager->GetModel("b", -1, &model).IsOk());
+  EXPECT_EQ(CreatedCount("b"), 2U);
+  EXPECT_EQ(State("a").first, ModelReadyState::UNAVAILABLE);
+  EXPECT_EQ(State("c").first, ModelReadyState::READY);
+  // A model larger than the budget still loads, alone.
+  ASSERT_TRUE(manager->GetModel("big", -1, &model).IsOk());
+  for (const auto& name : {"a", "b", "c"}) {
+    EXPECT_EQ(State(name).first, ModelReadyState::UNAVAILABLE) << name;
+  }
+  EXPECT_EQ(State("big").first, ModelReadyState::READY);
+}
+
+TEST_F(ModelRepositoryManagerTest, IdleModelIsUnloaded) {
+  WriteModel("m", Config("m"));
+  ModelLoadOptions options;
+  options.on_demand_ = true;
+  options.idle_unload_timeout_ms_ = 100;
+  ASSERT_TRUE(CreateManager(4, options).IsOk());
+  std::shared_ptr<Model> model;
+  ASSERT_TRUE(manager->GetModel("m", -1, &model).IsOk());
+  model.reset();
+  EXPECT_EQ(State("m").first, ModelReadyState::READY);
+  for (size_t i = 0; (i < 500) && (State("m").first == ModelReadyState::READY); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(State("m").first, ModelReadyState::UNAVAILABLE);
+  ASSERT_TRUE(manager->GetModel("m", -1, &model).IsOk());
+  EXPECT_EQ(CreatedCount("m"), 2U);
+}
+
+}
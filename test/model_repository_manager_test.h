@@ -0,0 +1,205 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/server.h"
+#include "core/file_utils.h"
+#include "core/model_repository_manager.h"
+#include "core/scheduler.h"
+
+namespace test {
+
+// Reports the requests in flight set by the test.
+class FakeScheduler : public core::Scheduler {
+ public:
+  explicit FakeScheduler(std::shared_ptr<std::atomic<size_t>> inflight)
+    : inflight_(std::move(inflight)) {}
+
+  core::Status Enqueue(std::unique_ptr<core::InferenceRequest>& request) override {
+    return core::Status(core::Status::Code::UNSUPPORTED, "fake model");
+  }
+  size_t InflightInferenceCount() override { return *inflight_; }
+  void Stop() override {}
+
+ private:
+  std::shared_ptr<std::atomic<size_t>> inflight_;
+};
+
+class FakeModel : public core::Model {
+ public:
+  FakeModel(const std::string& model_dir,
+            const int64_t version,
+            const inference::ModelConfig& config,
+            std::shared_ptr<std::atomic<size_t>> inflight)
+    : Model(0, model_dir, version, config) {
+    SetScheduler(std::unique_ptr<core::Scheduler>(new FakeScheduler(std::move(inflight))));
+  }
+};
+
+// Creates every version as a FakeModel so that no backend is needed,
+// and records the order the models are created in.
+class FakeModelRepositoryManager : public core::ModelRepositoryManager {
+ public:
+  FakeModelRepositoryManager(core::InferenceServer* server,
+                             const std::string& repository_path,
+                             const size_t model_load_thread_count,
+                             const core::ModelLoadOptions& load_options)
+    : ModelRepositoryManager(server, {repository_path}, core::BackendCmdlineConfigMap(),
+                             core::HostPolicyCmdlineConfigMap(), model_load_thread_count,
+                             load_options) {}
+
+  using ModelRepositoryManager::Start;
+
+  // Called with the name of the model before each version is created, the
+  // version fails to load if it returns an error.
+  std::function<core::Status(const std::string&)> on_create;
+
+  // The requests in flight of every model created.
+  std::shared_ptr<std::atomic<size_t>> inflight = std::make_shared<std::atomic<size_t>>(0);
+
+  // The names of the models, once per version created.
+  std::vector<std::string> Created() {
+    std::lock_guard<std::mutex> lock(created_mu_);
+    return created_;
+  }
+
+ protected:
+  core::Status CreateModel(const ModelInfo& info,
+                           const int64_t version,
+                           std::unique_ptr<core::Model>* model) override {
+    if (on_create) {
+      const core::Status status = on_create(info.model_config_.name());
+      if (!status.IsOk()) {
+        return status;
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(created_mu_);
+      created_.push_back(info.model_config_.name());
+    }
+    model->reset(new FakeModel(info.model_path_, version, info.model_config_, inflight));
+    return core::Status::Success;
+  }
+
+ private:
+  std::mutex created_mu_;
+  std::vector<std::string> created_;
+};
+
+class ModelRepositoryManagerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char root_template[] = "/tmp/model_repository_manager_test_XXXXXX";
+    ASSERT_NE(mkdtemp(root_template), nullptr);
+    root = root_template;
+    repository = core::JoinPath({root, "models"});
+    ASSERT_EQ(mkdir(repository.c_str(), 0755), 0);
+    // The server only provides the executor and the timers, its own
+    // repository stays empty.
+    const std::string empty = core::JoinPath({root, "empty"});
+    ASSERT_EQ(mkdir(empty.c_str(), 0755), 0);
+    server.SetModelRepositoryPaths({empty});
+    ASSERT_TRUE(server.Init().IsOk());
+  }
+
+  void TearDown() override {
+    manager.reset();
+    nftw(root.c_str(), RemovePath, 16, FTW_DEPTH | FTW_PHYS);
+  }
+
+  static int RemovePath(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+  }
+
+  // Write model 'name' with 'config' and a directory for each of
+  // 'versions'.
+  void WriteModel(const std::string& name,
+                  const std::string& config,
+                  const std::set<int64_t>& versions = {1}) {
+    const std::string path = core::JoinPath({repository, name});
+    mkdir(path.c_str(), 0755);
+    std::ofstream(core::JoinPath({path, "config.pbtxt"})) << config;
+    for (const auto version : versions) {
+      mkdir(core::JoinPath({path, std::to_string(version)}).c_str(), 0755);
+    }
+  }
+
+  void WriteFile(const std::string& relative_path, const std::string& content) {
+    std::ofstream(core::JoinPath({repository, relative_path})) << content;
+  }
+
+  static std::string Config(const std::string& name) {
+    return "name: \"" + name + "\"\nbackend: \"fake\"\n";
+  }
+
+  // An ensemble running 'steps' one after another.
+  static std::string EnsembleConfig(const std::string& name,
+                                    const std::vector<std::string>& steps) {
+    std::string config = "name: \"" + name + "\"\nplatform: \"ensemble\"\n";
+    config += "ensemble_scheduling {\n";
+    for (const auto& step : steps) {
+      config += "  step { model_name: \"" + step + "\" model_version: -1 }\n";
+    }
+    return config + "}\n";
+  }
+
+  // Create the manager of 'repository' without loading anything yet.
+  void NewManager(const size_t model_load_thread_count = 4,
+                  const core::ModelLoadOptions& load_options = core::ModelLoadOptions()) {
+    manager.reset(new FakeModelRepositoryManager(&server, repository,
+                                                 model_load_thread_count, load_options));
+  }
+
+  // Create the manager of 'repository' and load the models found there.
+  core::Status CreateManager(const size_t model_load_thread_count = 4,
+                             const core::ModelLoadOptions& load_options = core::ModelLoadOptions()) {
+    NewManager(model_load_thread_count, load_options);
+    return manager->Start();
+  }
+
+  // The state of the lowest version of 'name' and its reason.
+  std::pair<core::ModelReadyState, std::string> State(const std::string& name) {
+    const auto states = manager->ModelStates();
+    const auto itr = states.find(name);
+    if ((itr == states.end()) || itr->second.empty()) {
+      return std::make_pair(core::ModelReadyState::UNKNOWN, std::string());
+    }
+    return itr->second.begin()->second;
+  }
+
+  // The position of the first creation of 'name', the number of models
+  // created if it was never created.
+  size_t CreatedAt(const std::string& name) {
+    const auto created = manager->Created();
+    return std::find(created.begin(), created.end(), name) - created.begin();
+  }
+
+  // The number of versions of 'name' created.
+  size_t CreatedCount(const std::string& name) {
+    const auto created = manager->Created();
+    return std::count(created.begin(), created.end(), name);
+  }
+
+  core::InferenceServer server;
+  std::string root;
+  std::string repository;
+  std::unique_ptr<FakeModelRepositoryManager> manager;
+};
+
+}
@@ -0,0 +1,99 @@
+#include "payload_test.h"
+
+using namespace core;
+
+namespace test {
+
+TEST_F(PayloadTest, CancelledRequestsLeaveBatch) {
+  Payload payload;
+  payload.Reset(Payload::Operation::INFER_RUN);
+  AddRequest(&payload, 0);
+  AddRequest(&payload, 1)->Cancel();
+  AddRequest(&payload, 2);
+  ASSERT_EQ(payload.BatchSize(), 3U);
+  payload.DropCancelledRequests();
+  EXPECT_EQ(payload.RequestCount(), 2U);
+  EXPECT_EQ(payload.BatchSize(), 2U);
+  EXPECT_EQ(released, 1U);
+  EXPECT_TRUE(statuses[0].IsOk());
+  EXPECT_EQ(statuses[1].StatusCode(), Status::Code::CANCELLED);
+  EXPECT_TRUE(statuses[2].IsOk());
+}
+
+TEST_F(PayloadTest, AllCancelledBatchIsNotExecuted) {
+  // Without an instance, executing anything would crash.
+  Payload payload;
+  payload.Reset(Payload::Operation::INFER_RUN);
+  AddRequest(&payload, 0)->Cancel();
+  AddRequest(&payload, 1)->Cancel();
+  bool should_exit = true;
+  payload.Execute(&should_exit);
+  EXPECT_FALSE(should_exit);
+  EXPECT_TRUE(payload.Wait().IsOk());
+  EXPECT_EQ(payload.RequestCount(), 0U);
+  EXPECT_EQ(payload.BatchSize(), 0U);
+  EXPECT_EQ(payload.ExecNs(), 0U);
+  EXPECT_EQ(released, 2U);
+  EXPECT_EQ(statuses[0].StatusCode(), Status::Code::CANCELLED);
+  EXPECT_EQ(statuses[1].StatusCode(), Status::Code::CANCELLED);
+}
+
+TEST_F(PayloadTest, InputsAreGatheredInRequestOrder) {
+  const char* data = "abcdefgh";
+  // Add the input 'name' with the bytes of 'data' from 'offset' in
+  // buffers of 'buffer_sizes'.
+  auto add_input = [data](const std::string& name, size_t offset,
+                           const std::vector<size_t>& buffer_sizes,
+                           const SERVER_MemoryType memory_type = SERVER_MEMORY_CPU) {
+    return [=](InferenceRequest* request) {
+      InferenceRequest::Input* input = nullptr;
+      ASSERT_TRUE(request->AddInput(name, inference::TYPE_INT8, {1}, &input).IsOk());
+      size_t buffer_offset = offset;
+      for (const size_t size : buffer_sizes) {
+        input->AppendData(data + buffer_offset, size, memory_type, 0);
+        buffer_offset += size;
+      }
+    };
+  };
+  Payload payload;
+  payload.Reset(Payload::Operation::INFER_RUN);
+  payload.SetGatherInputs(true);
+  AddRequest(&payload, 0, [&](InferenceRequest* request) {
+    add_input("IN", 0, {2})(request);
+    add_input("GPU", 0, {1})(request);
+    add_input("SOME", 0, {1})(request);
+  });
+  AddRequest(&payload, 1, [&](InferenceRequest* request) {
+    add_input("IN", 2, {1, 1})(request);
+    add_input("GPU", 1, {1}, SERVER_MEMORY_GPU)(request);
+  });
+  AddRequest(&payload, 2, [&](InferenceRequest* request) {
+    add_input("GPU", 2, {1})(request);
+    add_input("IN", 4, {2})(request);
+  });
+  const void* buffer = nullptr;
+  size_t byte_size = 0;
+  ASSERT_TRUE(payload.GatheredInput("IN", &buffer, &byte_size).IsOk());
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(buffer), byte_size), "abcdef");
+  // Memory outside the CPU and inputs some requests lack are left to the
+  // backend.
+  EXPECT_EQ(payload.GatheredInput("GPU", &buffer, &byte_size).StatusCode(),
+            Status::Code::UNAVAILABLE);
+  EXPECT_EQ(payload.GatheredInput("SOME", &buffer, &byte_size).StatusCode(),
+            Status::Code::UNAVAILABLE);
+  EXPECT_EQ(payload.GatheredInput("NONE", &buffer, &byte_size).StatusCode(),
+            Status::Code::UNAVAILABLE);
+
+  // A reused payload only gathers when asked to.
+  payload.Reset(Payload::Operation::INFER_RUN);
+  AddRequest(&payload, 3, add_input("IN", 6, {2}));
+  EXPECT_EQ(payload.GatheredInput("IN", &buffer, &byte_size).StatusCode(),
+            Status::Code::UNAVAILABLE);
+  payload.Reset(Payload::Operation::INFER_RUN);
+  payload.SetGatherInputs(true);
+  AddRequest(&payload, 4, add_input("IN", 6, {2}));
+  ASSERT_TRUE(payload.GatheredInput("IN", &buffer, &byte_size).IsOk());
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(buffer), byte_size), "gh");
+}
+
+}
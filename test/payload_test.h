@@ -0,0 +1,60 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/model.h"
+#include "core/payload.h"
+#include "core/infer_request.h"
+#include "core/infer_response.h"
+
+namespace test {
+
+class PayloadTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    inference::ModelConfig config;
+    config.set_name("m");
+    config.set_backend("stream");
+    config.set_max_batch_size(8);
+    model = std::make_shared<core::Model>(0, "", 1, config);
+    ASSERT_TRUE(model->Init(true).IsOk());
+  }
+
+  // Add a request to 'payload' recording its final status in 'statuses'
+  // at 'index' and counting its release. 'prepare' is called with the
+  // request before it is added.
+  core::InferenceRequest* AddRequest(
+      core::Payload* payload, const size_t index,
+      const std::function<void(core::InferenceRequest*)>& prepare = nullptr) {
+    statuses.resize(std::max(statuses.size(), index + 1), core::Status::Success);
+    std::unique_ptr<core::InferenceRequest> request(new core::InferenceRequest(model, -1));
+    request->SetResponseCallback(
+        [this, index](std::unique_ptr<core::InferenceResponse>&& response, const uint32_t flags) {
+          if (response != nullptr) {
+            statuses[index] = response->ResponseStatus();
+          }
+        });
+    request->SetReleaseCallback([this](std::unique_ptr<core::InferenceRequest>&& request) {
+      ++released;
+      request.reset();
+    });
+    core::InferenceRequest* raw = request.get();
+    if (prepare) {
+      prepare(raw);
+    }
+    payload->AddRequest(std::move(request));
+    return raw;
+  }
+
+  std::shared_ptr<core::Model> model;
+  std::vector<core::Status> statuses;
+  size_t released = 0;
+};
+
+}
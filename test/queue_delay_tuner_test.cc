@@ -0,0 +1,98 @@
+#include "queue_delay_tuner_test.h"
+
+using namespace core;
+
+namespace test {
+
+constexpr uint64_t QueueDelayTunerTest::kMsNs;
+constexpr uint64_t QueueDelayTunerTest::kTargetNs;
+
+TEST_F(QueueDelayTunerTest, NoDelayAtLowRate) {
+  // Too few requests arrive to grow a batch, waiting would only add
+  // latency.
+  const uint64_t now_ns = Arrive(1, 100 * kMsNs);
+  EXPECT_EQ(tuner->QueueDelayNs(now_ns), 0U);
+}
+
+TEST_F(QueueDelayTunerTest, DelayFillsBatchAtHighRate) {
+  const uint64_t now_ns = Arrive(1, 100 * 1000);
+  const uint64_t delay_ns = tuner->QueueDelayNs(now_ns);
+  // A full batch gathers in 700us, the shortest step past it is chosen.
+  EXPECT_GE(delay_ns, 700 * 1000U);
+  EXPECT_LE(delay_ns + 4 * kMsNs, kTargetNs);
+  EXPECT_LT(delay_ns, 2 * kMsNs);
+}
+
+TEST_F(QueueDelayTunerTest, MissedTargetShortensDelay) {
+  // Batches of eight take 8ms.
+  for (int i = 0; i < 100; ++i) {
+    estimator.Record(nullptr, 8, 0, 8 * kMsNs);
+  }
+  uint64_t now_ns = Arrive(1, 1000 * 1000);
+  const uint64_t delay_ns = tuner->QueueDelayNs(now_ns);
+  EXPECT_GT(delay_ns, 0U);
+  // The measured p99 is past the target, the budget shrinks until no
+  // wait fits.
+  for (int i = 0; i < 10; ++i) {
+    tuner->RecordLatency(30 * kMsNs, 100);
+    now_ns = Arrive(now_ns, 1000 * 1000);
+    tuner->QueueDelayNs(now_ns);
+  }
+  EXPECT_LT(tuner->QueueDelayNs(now_ns), delay_ns);
+}
+
+TEST_F(QueueDelayTunerTest, OldLatenciesDoNotKeepShorteningDelay) {
+  uint64_t now_ns = Arrive(1, 1000 * 1000);
+  tuner->QueueDelayNs(now_ns);
+  tuner->RecordLatency(30 * kMsNs, 100);
+  now_ns = Arrive(now_ns, 1000 * 1000);
+  const uint64_t delay_ns = tuner->QueueDelayNs(now_ns);
+  EXPECT_GT(delay_ns, 0U);
+  // Without requests completing since, the one slow interval does not
+  // count again.
+  for (int i = 0; i < 10; ++i) {
+    now_ns = Arrive(now_ns, 1000 * 1000);
+    EXPECT_EQ(tuner->QueueDelayNs(now_ns), delay_ns);
+  }
+}
+
+TEST_F(QueueDelayTunerTest, WaitsForBatchesLargerThanMeasured) {
+  // Nothing measured, a request arriving every millisecond makes a batch
+  // of two within a millisecond.
+  ExecTimeEstimator unmeasured;
+  QueueDelayTuner explorer(&unmeasured, 8, kTargetNs, 5 * kMsNs);
+  uint64_t now_ns = Arrive(1, kMsNs, &explorer);
+  EXPECT_EQ(explorer.QueueDelayNs(now_ns), kMsNs);
+  // Batches of one and two take 2ms a request, waiting only adds latency
+  // once measured.
+  unmeasured.Record(nullptr, 1, 0, 2 * kMsNs);
+  unmeasured.Record(nullptr, 2, 0, 4 * kMsNs);
+  now_ns = Arrive(now_ns, kMsNs, &explorer);
+  EXPECT_EQ(explorer.QueueDelayNs(now_ns), 0U);
+  // Until the larger sizes are tried now and then.
+  bool explored = false;
+  for (int i = 0; i < 8; ++i) {
+    now_ns = Arrive(now_ns, kMsNs, &explorer);
+    explored = explored || (explorer.QueueDelayNs(now_ns) == 2 * kMsNs);
+  }
+  EXPECT_TRUE(explored);
+}
+
+TEST_F(QueueDelayTunerTest, NoDelayWithoutMeasuresAtLowRate) {
+  ExecTimeEstimator unmeasured;
+  QueueDelayTuner explorer(&unmeasured, 8, kTargetNs, 5 * kMsNs);
+  const uint64_t now_ns = Arrive(1, 100 * kMsNs, &explorer);
+  EXPECT_EQ(explorer.QueueDelayNs(now_ns), 0U);
+}
+
+TEST_F(QueueDelayTunerTest, FixedCostMakesWaitingWorthIt) {
+  // Measured up to two only, the fixed cost of 2ms favors larger batches.
+  ExecTimeEstimator measured;
+  measured.Record(nullptr, 1, 0, 2100 * 1000);
+  measured.Record(nullptr, 2, 0, 2200 * 1000);
+  QueueDelayTuner fitted(&measured, 8, kTargetNs, 0);
+  const uint64_t now_ns = Arrive(1, kMsNs, &fitted);
+  EXPECT_GT(fitted.QueueDelayNs(now_ns), 0U);
+}
+
+}
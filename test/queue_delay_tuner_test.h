@@ -0,0 +1,39 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include "core/queue_delay_tuner.h"
+
+namespace test {
+
+class QueueDelayTunerTest : public testing::Test {
+ protected:
+  // A model batching up to 8 for a p99 of 20ms, whose batches take 2ms
+  // for one request and 4ms for eight.
+  void SetUp() override {
+    estimator.Record(nullptr, 1, 0, 2 * kMsNs);
+    estimator.Record(nullptr, 8, 0, 4 * kMsNs);
+    tuner.reset(new core::QueueDelayTuner(&estimator, 8, kTargetNs, 0));
+  }
+
+  // Feed arrivals every 'interval_ns' for one tuning interval starting
+  // at 'start_ns' to 'delay_tuner', 'tuner' if nullptr, return the time
+  // of the last one.
+  uint64_t Arrive(const uint64_t start_ns, const uint64_t interval_ns,
+                  core::QueueDelayTuner* delay_tuner = nullptr) {
+    if (delay_tuner == nullptr) {
+      delay_tuner = tuner.get();
+    }
+    uint64_t now_ns = start_ns;
+    for (; now_ns < start_ns + 500 * kMsNs; now_ns += interval_ns) {
+      delay_tuner->RecordArrival(now_ns);
+    }
+    return now_ns;
+  }
+
+  static constexpr uint64_t kMsNs = 1000 * 1000;
+  static constexpr uint64_t kTargetNs = 20 * kMsNs;
+  core::ExecTimeEstimator estimator;
+  std::unique_ptr<core::QueueDelayTuner> tuner;
+};
+
+}
@@ -0,0 +1,101 @@
+#include "rate_limiter_test.h"
+
+#include <unistd.h>
+
+using namespace core;
+
+namespace test {
+
+TEST_F(RateLimiterTest, PicksTheInstanceExpectedToFinishFirst) {
+  WriteModel("instance_group [ { kind: KIND_CPU count: 2 } ]");
+  ASSERT_TRUE(StartServer().IsOk());
+  const auto instances = Instances();
+  ASSERT_EQ(instances.size(), 2U);
+  // With two instances both are compared for every request.
+  RecordExecutions(instances[0], 10 * 1000 * 1000);
+  auto counts = SendOneByOne("a", 8);
+  EXPECT_EQ(counts[instances[1]], 8U);
+  RecordExecutions(instances[1], 20 * 1000 * 1000);
+  counts = SendOneByOne("b", 8);
+  EXPECT_EQ(counts[instances[0]], 8U);
+}
+
+TEST_F(RateLimiterTest, UnmeasuredInstanceFallsBackToRecentExecutionTime) {
+  WriteModel("instance_group [ { kind: KIND_CPU count: 2 } ]");
+  ASSERT_TRUE(StartServer().IsOk());
+  Hold();
+  ASSERT_TRUE(Send("m", "slow").IsOk());
+  ASSERT_TRUE(WaitForBatches(1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  Resume();
+  ASSERT_TRUE(Response("slow").IsOk());
+  BackendModelInstance* slow = Batches()[0].instance_;
+  // The estimator forgets the slow execution, the instance is still
+  // known to be slow from its recent execution time.
+  ExecTimeEstimator& estimator = GetBackendModel("m")->ExecEstimator();
+  ExecTimeEstimator::Estimate estimate;
+  for (int i = 0; (i < 1000) && !estimator.Get(slow, 1, 0, &estimate); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  estimator.RemoveInstance(slow);
+  EXPECT_GE(slow->RecentExecNs(), 50U * 1000 * 1000);
+  const auto counts = SendOneByOne("a", 8);
+  EXPECT_EQ(counts.count(slow), 0U);
+}
+
+TEST_F(RateLimiterTest, RemoteNumaNodeCostsMore) {
+  if (access("/sys/devices/system/node/node1", F_OK) == 0) {
+    GTEST_SKIP() << "the batcher may run on any NUMA node";
+  }
+  WriteModel(
+      "instance_group [\n"
+      "  { name: \"near\" kind: KIND_CPU count: 1 host_policy: \"near\" },\n"
+      "  { name: \"far\" kind: KIND_CPU count: 1 host_policy: \"far\" }\n"
+      "]\n");
+  HostPolicyCmdlineConfigMap host_policy;
+  host_policy["near"]["numa-node"] = "0";
+  host_policy["far"]["numa-node"] = "1";
+  ASSERT_TRUE(StartServer(host_policy).IsOk());
+  const auto instances = Instances();
+  ASSERT_EQ(instances.size(), 2U);
+  BackendModelInstance* near = (instances[0]->NumaNode() == 0) ? instances[0] : instances[1];
+  BackendModelInstance* far = (near == instances[0]) ? instances[1] : instances[0];
+  ASSERT_EQ(far->NumaNode(), 1);
+  // The remote instance is faster, but not by enough to make up for
+  // the payloads gathered on the other node.
+  RecordExecutions(near, 1000 * 1000);
+  RecordExecutions(far, 800 * 1000);
+  const auto counts = SendOneByOne("a", 8);
+  EXPECT_EQ(counts.count(far), 0U);
+}
+
+TEST_F(RateLimiterTest, UnregisteredInstanceHandsBackItsPayloads) {
+  WriteModel("instance_group [ { kind: KIND_CPU count: 2 } ]");
+  ASSERT_TRUE(StartServer().IsOk());
+  Hold();
+  ASSERT_TRUE(Send("m", "busy").IsOk());
+  ASSERT_TRUE(WaitForBatches(1));
+  BackendModelInstance* busy = Batches()[0].instance_;
+  // Two payloads wait for the busy instance, then it is taken out.
+  auto rate_limiter = server->GetRateLimiter();
+  for (const auto& id : {"a", "b"}) {
+    auto payload = rate_limiter->GetPayload(Payload::Operation::INFER_RUN, busy);
+    payload->AddRequest(NewRequest("m", id));
+    ASSERT_TRUE(rate_limiter->EnqueuePayload(GetBackendModel("m"), payload).IsOk());
+  }
+  rate_limiter->UnregisterModelInstance(busy);
+  ASSERT_TRUE(WaitForBatches(2));
+  Resume();
+  EXPECT_TRUE(Response("busy").IsOk());
+  EXPECT_TRUE(Response("a").IsOk());
+  EXPECT_TRUE(Response("b").IsOk());
+  // The other instance took them in their order.
+  const auto batches = Batches();
+  ASSERT_EQ(batches.size(), 3U);
+  EXPECT_NE(batches[1].instance_, busy);
+  EXPECT_EQ(batches[1].request_ids_, std::vector<std::string>{"a"});
+  EXPECT_NE(batches[2].instance_, busy);
+  EXPECT_EQ(batches[2].request_ids_, std::vector<std::string>{"b"});
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "core/rate_limiter.h"
+#include "test/backend/test_backend_fixture.h"
+
+namespace test {
+
+class RateLimiterTest : public TestBackendFixture {
+ protected:
+  // A model of 'config' executing each request on its own.
+  void WriteModel(const std::string& config) {
+    TestBackendFixture::WriteModel("m", 1, config);
+  }
+
+  // Have 'instance' measured at 'exec_ns' per request.
+  void RecordExecutions(core::BackendModelInstance* instance, const uint64_t exec_ns) {
+    for (int i = 0; i < 64; ++i) {
+      GetBackendModel("m")->ExecEstimator().Record(instance, 1, 0, exec_ns);
+    }
+  }
+
+  // Send 'count' requests one after another, each once the instances
+  // are idle again, and return the number executed by each instance.
+  std::map<core::BackendModelInstance*, size_t> SendOneByOne(const std::string& prefix,
+                                                            const size_t count) {
+    const size_t first = Batches().size();
+    for (size_t i = 0; i < count; ++i) {
+      // An instance is only picked while its backend thread waits.
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      const std::string id = prefix + std::to_string(i);
+      EXPECT_TRUE(Send("m", id).IsOk());
+      EXPECT_TRUE(Response(id).IsOk());
+    }
+    std::map<core::BackendModelInstance*, size_t> counts;
+    const auto batches = Batches();
+    for (size_t i = first; i < batches.size(); ++i) {
+      ++counts[batches[i].instance_];
+    }
+    return counts;
+  }
+};
+
+}
@@ -0,0 +1,53 @@
+#include "repository_watcher_test.h"
+
+#include <stdio.h>
+
+using namespace core;
+
+namespace test {
+
+TEST_F(RepositoryWatcherTest, ReportsTouchedModels) {
+  EXPECT_TRUE(Changes().empty());
+  WriteFile("a/config.pbtxt", "name: \"a\" max_batch_size: 8");
+  WriteFile("b/1/model.bin", "weights");
+  EXPECT_EQ(Changes(), (std::set<std::string>{"a", "b"}));
+  EXPECT_TRUE(Changes().empty());
+  // A new version directory is watched once the model is revisited.
+  MakeDirectory(Path("b/2"));
+  EXPECT_EQ(Changes(), std::set<std::string>{"b"});
+  ASSERT_TRUE(watcher->WatchModel("b", Path("b")).IsOk());
+  WriteFile("b/2/model.bin", "weights");
+  EXPECT_EQ(Changes(), std::set<std::string>{"b"});
+}
+
+TEST_F(RepositoryWatcherTest, ReportsAddedRenamedAndRemovedModels) {
+  MakeDirectory(Path("d"));
+  ASSERT_EQ(rename(Path("c").c_str(), Path("e").c_str()), 0);
+  EXPECT_EQ(Changes(), (std::set<std::string>{"c", "d", "e"}));
+  ASSERT_EQ(remove(Path("d").c_str()), 0);
+  EXPECT_EQ(Changes(), std::set<std::string>{"d"});
+  // Renaming a file inside a model only reports the model.
+  ASSERT_EQ(rename(Path("a/config.pbtxt").c_str(), Path("a/config.old").c_str()), 0);
+  EXPECT_EQ(Changes(), std::set<std::string>{"a"});
+}
+
+TEST_F(RepositoryWatcherTest, LostEventsRequestRescan) {
+  // Enough distinct events to overflow the default inotify queue.
+  size_t max_queued_events = 16384;
+  std::ifstream("/proc/sys/fs/inotify/max_queued_events") >> max_queued_events;
+  if (max_queued_events > 100000) {
+    GTEST_SKIP() << "inotify queue too large to overflow";
+  }
+  for (size_t i = 0; i <= max_queued_events; ++i) {
+    WriteFile("a/1/" + std::to_string(i), "");
+  }
+  std::set<std::string> models;
+  bool rescan = false;
+  ASSERT_TRUE(watcher->Changes(&models, &rescan).IsOk());
+  EXPECT_TRUE(rescan);
+  // Back to incremental reports once the queue is drained.
+  WriteFile("c/config.pbtxt", "name: \"c\" max_batch_size: 8");
+  EXPECT_EQ(Changes(), std::set<std::string>{"c"});
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "core/file_utils.h"
+#include "core/repository_watcher.h"
+
+namespace test {
+
+class RepositoryWatcherTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char root_template[] = "/tmp/repository_watcher_test_XXXXXX";
+    ASSERT_NE(mkdtemp(root_template), nullptr);
+    repository = root_template;
+    for (const auto& name : {"a", "b", "c"}) {
+      MakeDirectory(Path(name));
+      MakeDirectory(Path(std::string(name) + "/1"));
+      WriteFile(std::string(name) + "/config.pbtxt", "name: \"" + std::string(name) + "\"");
+    }
+    ASSERT_TRUE(core::RepositoryWatcher::Create({repository}, &watcher).IsOk());
+    for (const auto& name : {"a", "b", "c"}) {
+      ASSERT_TRUE(watcher->WatchModel(name, Path(name)).IsOk());
+    }
+  }
+
+  void TearDown() override {
+    watcher.reset();
+    nftw(repository.c_str(), RemovePath, 16, FTW_DEPTH | FTW_PHYS);
+  }
+
+  static int RemovePath(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+  }
+
+  std::string Path(const std::string& relative_path) {
+    return core::JoinPath({repository, relative_path});
+  }
+
+  void MakeDirectory(const std::string& path) { mkdir(path.c_str(), 0755); }
+
+  void WriteFile(const std::string& relative_path, const std::string& content) {
+    std::ofstream(Path(relative_path)) << content;
+  }
+
+  // The models reported since the last call, checking no rescan is
+  // needed.
+  std::set<std::string> Changes() {
+    std::set<std::string> models;
+    bool rescan = true;
+    EXPECT_TRUE(watcher->Changes(&models, &rescan).IsOk());
+    EXPECT_FALSE(rescan);
+    return models;
+  }
+
+  std::string repository;
+  std::unique_ptr<core::RepositoryWatcher> watcher;
+};
+
+}
@@ -0,0 +1,130 @@
+#include "server_test.h"
+
+using namespace core;
+
+namespace test {
+
+TEST_F(ServerTest, ModelStatisticsAreReadBack) {
+  WriteModel("m");
+  ASSERT_TRUE(StartServer().IsOk());
+  Hold();
+  ASSERT_TRUE(Send("m", "busy").IsOk());
+  ASSERT_TRUE(WaitForBatches(1));
+  ASSERT_TRUE(Send("m", "first").IsOk());
+  ASSERT_TRUE(Send("m", "failed").IsOk());
+  ASSERT_TRUE(Send("m", "last").IsOk());
+  Resume();
+  EXPECT_TRUE(Response("busy").IsOk());
+  EXPECT_TRUE(Response("first").IsOk());
+  EXPECT_EQ(Response("failed").StatusCode(), Status::Code::INTERNAL);
+  EXPECT_TRUE(Response("last").IsOk());
+  ASSERT_EQ(Batches().size(), 2U);
+
+  common::Json::Value statistics;
+  GetModelStatistics("m", &statistics);
+  common::Json::Value versions;
+  ASSERT_TRUE(statistics.MemberAsArray("versions", &versions).IsOk()) << json_;
+  ASSERT_EQ(versions.ArraySize(), 1U);
+  common::Json::Value version;
+  ASSERT_TRUE(versions.IndexAsObject(0, &version).IsOk());
+
+  // The failed request is counted without its stages.
+  common::Json::Value requests, execution;
+  uint64_t count = 0;
+  ASSERT_TRUE(version.MemberAsObject("requests", &requests).IsOk()) << json_;
+  ASSERT_TRUE(requests.MemberAsUInt("success_count", &count).IsOk());
+  EXPECT_EQ(count, 3U);
+  ASSERT_TRUE(requests.MemberAsUInt("failure_count", &count).IsOk());
+  EXPECT_EQ(count, 1U);
+  ASSERT_TRUE(requests.MemberAsObject("execution", &execution).IsOk());
+  ASSERT_TRUE(execution.MemberAsUInt("count", &count).IsOk());
+  EXPECT_EQ(count, 3U);
+  uint64_t p99_ns = 0;
+  ASSERT_TRUE(execution.MemberAsUInt("p99_ns", &p99_ns).IsOk());
+  EXPECT_GT(p99_ns, 0U);
+
+  // The batches of 1 and 3 requests.
+  common::Json::Value batches;
+  ASSERT_TRUE(version.MemberAsArray("batches", &batches).IsOk()) << json_;
+  ASSERT_EQ(batches.ArraySize(), 2U);
+  const uint64_t batch_sizes[] = {1, 3};
+  for (size_t i = 0; i < batches.ArraySize(); ++i) {
+    common::Json::Value batch;
+    ASSERT_TRUE(batches.IndexAsObject(i, &batch).IsOk());
+    uint64_t batch_size = 0;
+    ASSERT_TRUE(batch.MemberAsUInt("batch_size", &batch_size).IsOk());
+    EXPECT_EQ(batch_size, batch_sizes[i]);
+    ASSERT_TRUE(batch.MemberAsUInt("success_count", &count).IsOk());
+    EXPECT_EQ(count, 1U);
+  }
+
+  SERVER_Message* message = nullptr;
+  SERVER_Error* err = SERVER_ServerModelStatistics(
+      reinterpret_cast<SERVER_Server*>(server.get()), "missing", &message);
+  ASSERT_NE(err, nullptr);
+  EXPECT_EQ(SERVER_ErrorCode(err), SERVER_ERROR_UNAVAILABLE);
+  SERVER_ErrorDelete(err);
+}
+
+TEST_F(ServerTest, InferAsyncDeliversResponses) {
+  WriteModel("m");
+  ASSERT_TRUE(StartServer().IsOk());
+  SERVER_ResponseAllocator* allocator = nullptr;
+  ASSERT_EQ(SERVER_ResponseAllocatorNew(&allocator, Allocate, Release), nullptr);
+  // The requests queue up behind the busy instance and form one batch.
+  Hold();
+  ASSERT_TRUE(Send("m", "busy").IsOk());
+  ASSERT_TRUE(WaitForBatches(1));
+  const std::map<std::string, std::string> inputs = {
+      {"a", "aaaa"}, {"b", "bbbbbbbb"}, {"failed", "ff"}};
+  for (const auto& pr : inputs) {
+    InferAsync(pr.first, pr.second, allocator);
+  }
+  Resume();
+  ASSERT_TRUE(WaitForClient(inputs.size()));
+  EXPECT_TRUE(Response("busy").IsOk());
+  const auto batches = Batches();
+  ASSERT_EQ(batches.size(), 2U);
+  EXPECT_EQ(batches[1].request_ids_.size(), inputs.size());
+
+  for (const auto& pr : client_.responses_) {
+    SERVER_InferenceResponse* response = pr.second;
+    uint32_t output_count = 0;
+    ASSERT_EQ(SERVER_InferenceResponseOutputCount(response, &output_count), nullptr);
+    SERVER_Error* err = SERVER_InferenceResponseError(response);
+    if (pr.first == "failed") {
+      ASSERT_NE(err, nullptr);
+      EXPECT_EQ(SERVER_ErrorCode(err), SERVER_ERROR_INTERNAL);
+      SERVER_ErrorDelete(err);
+      EXPECT_EQ(output_count, 0U);
+    } else {
+      // The output was written into the buffer of the allocator.
+      EXPECT_EQ(err, nullptr) << SERVER_ErrorMessage(err);
+      ASSERT_EQ(output_count, 1U);
+      const char* name = nullptr;
+      SERVER_DataType datatype;
+      const int64_t* shape = nullptr;
+      uint64_t dim_count = 0;
+      const void* base = nullptr;
+      size_t byte_size = 0;
+      SERVER_MemoryType memory_type;
+      int64_t memory_type_id = 0;
+      ASSERT_EQ(SERVER_InferenceResponseOutput(response, 0, &name, &datatype, &shape,
+                                               &dim_count, &base, &byte_size, &memory_type,
+                                               &memory_type_id),
+                nullptr);
+      EXPECT_STREQ(name, "OUT");
+      EXPECT_EQ(datatype, SERVER_TYPE_INT8);
+      ASSERT_EQ(dim_count, 2U);
+      EXPECT_EQ(shape[1], static_cast<int64_t>(inputs.at(pr.first).size()));
+      EXPECT_EQ(std::string(static_cast<const char*>(base), byte_size), inputs.at(pr.first));
+      EXPECT_EQ(memory_type, SERVER_MEMORY_CPU);
+    }
+    EXPECT_EQ(SERVER_InferenceResponseDelete(response), nullptr);
+  }
+  EXPECT_EQ(client_.allocated_, 2U);
+  EXPECT_EQ(client_.freed_, 2U);
+  EXPECT_EQ(SERVER_ResponseAllocatorDelete(allocator), nullptr);
+}
+
+}
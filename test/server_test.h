@@ -0,0 +1,137 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "core/status.h"
+#include "core/message.h"
+#include "interface/IServer.h"
+#include "test/backend/test_backend_fixture.h"
+
+namespace test {
+
+class ServerTest : public TestBackendFixture {
+ protected:
+  // A model with one instance batching up to 8 requests, a batch is only
+  // formed once the instance is idle.
+  void WriteModel(const std::string& name) {
+    TestBackendFixture::WriteModel(
+        name, 8,
+        "instance_group [ { kind: KIND_CPU count: 1 } ]\n"
+        "dynamic_batching { }\n"
+        "parameters { key: \"pipeline_depth\" value { string_value: \"1\" } }\n");
+  }
+
+  // Parse the execution statistics of 'model_name' into 'statistics'.
+  void GetModelStatistics(const std::string& model_name, common::Json::Value* statistics) {
+    SERVER_Message* message = nullptr;
+    SERVER_Error* err = SERVER_ServerModelStatistics(
+        reinterpret_cast<SERVER_Server*>(server.get()), model_name.c_str(), &message);
+    ASSERT_EQ(err, nullptr) << SERVER_ErrorMessage(err);
+    const char* base = nullptr;
+    size_t byte_size = 0;
+    ASSERT_EQ(SERVER_MessageSerializeToJson(message, &base, &byte_size), nullptr);
+    json_.assign(base, byte_size);
+    SERVER_MessageDelete(message);
+    ASSERT_TRUE(statistics->Parse(json_).IsOk()) << json_;
+  }
+
+  // The responses and the releases of the requests sent through the C
+  // API, with the output buffers allocated for them.
+  struct Client {
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::map<std::string, SERVER_InferenceResponse*> responses_;
+    size_t released_ = 0;
+    std::atomic<size_t> allocated_{0};
+    std::atomic<size_t> freed_{0};
+  };
+
+  // Send request 'id' for model 'm' through the C API, with 'data' as
+  // its input and asking for the output, allocated by 'allocator'.
+  void InferAsync(const std::string& id, const std::string& data,
+                  SERVER_ResponseAllocator* allocator) {
+    SERVER_Server* lserver = reinterpret_cast<SERVER_Server*>(server.get());
+    SERVER_InferenceRequest* request = nullptr;
+    ASSERT_EQ(SERVER_InferenceRequestNew(&request, lserver, "m", -1), nullptr);
+    ASSERT_EQ(SERVER_InferenceRequestSetId(request, id.c_str()), nullptr);
+    const int64_t shape[] = {1, static_cast<int64_t>(data.size())};
+    ASSERT_EQ(SERVER_InferenceRequestAddInput(request, "IN", SERVER_TYPE_INT8, shape, 2),
+              nullptr);
+    ASSERT_EQ(SERVER_InferenceRequestAppendInputData(request, "IN", data.data(), data.size(),
+                                                     SERVER_MEMORY_CPU, 0),
+              nullptr);
+    ASSERT_EQ(SERVER_InferenceRequestAddRequestedOutput(request, "OUT"), nullptr);
+    ASSERT_EQ(SERVER_InferenceRequestSetReleaseCallback(request, RequestRelease, &client_),
+              nullptr);
+    ASSERT_EQ(SERVER_InferenceRequestSetResponseCallback(request, ResponseComplete, &client_),
+              nullptr);
+    ASSERT_EQ(SERVER_InferenceRequestSetResponseAllocator(request, allocator, &client_),
+              nullptr);
+    ASSERT_EQ(SERVER_ServerInferAsync(lserver, request), nullptr);
+  }
+
+  // Wait for a while until 'count' requests were responded to and
+  // released.
+  bool WaitForClient(const size_t count) {
+    std::unique_lock<std::mutex> lock(client_.mu_);
+    return client_.cv_.wait_for(lock, std::chrono::seconds(10), [this, count]() {
+      return (client_.responses_.size() >= count) && (client_.released_ >= count);
+    });
+  }
+
+  static void ResponseComplete(SERVER_InferenceResponse* response, const uint32_t flags,
+                               void* userp) {
+    Client* client = static_cast<Client*>(userp);
+    const char* id = "";
+    EXPECT_EQ(SERVER_InferenceResponseId(response, &id), nullptr);
+    EXPECT_NE(flags & SERVER_RESPONSE_COMPLETE_FINAL, 0U);
+    std::lock_guard<std::mutex> lock(client->mu_);
+    client->responses_[id] = response;
+    client->cv_.notify_all();
+  }
+
+  static void RequestRelease(SERVER_InferenceRequest* request, const uint32_t flags,
+                             void* userp) {
+    Client* client = static_cast<Client*>(userp);
+    SERVER_InferenceRequestDelete(request);
+    std::lock_guard<std::mutex> lock(client->mu_);
+    ++client->released_;
+    client->cv_.notify_all();
+  }
+
+  static SERVER_Error* Allocate(SERVER_ResponseAllocator* allocator, const char* tensor_name,
+                                size_t byte_size, SERVER_MemoryType memory_type,
+                                int64_t memory_type_id, void* userp, void** buffer,
+                                void** buffer_userp, SERVER_MemoryType* actual_memory_type,
+                                int64_t* actual_memory_type_id) {
+    Client* client = static_cast<Client*>(userp);
+    ++client->allocated_;
+    *buffer = malloc(byte_size);
+    *buffer_userp = client;
+    *actual_memory_type = SERVER_MEMORY_CPU;
+    *actual_memory_type_id = 0;
+    return nullptr;
+  }
+
+  static SERVER_Error* Release(SERVER_ResponseAllocator* allocator, void* buffer,
+                               void* buffer_userp, size_t byte_size,
+                               SERVER_MemoryType memory_type, int64_t memory_type_id) {
+    ++static_cast<Client*>(buffer_userp)->freed_;
+    free(buffer);
+    return nullptr;
+  }
+
+  std::string json_;
+  Client client_;
+};
+
+}
@@ -0,0 +1,86 @@
+#include "timing_wheel_test.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "core/time_utils.h"
+
+using namespace core;
+
+namespace test {
+
+TEST_F(TimingWheelTest, ExpireInOrderAcrossLevels) {
+  // On the first level, on the second and third, and beyond the wheel.
+  const std::vector<uint64_t> ticks = {1001, 1255, 1256, 70000, 20000000, 5000000000};
+  for (auto itr = ticks.rbegin(); itr != ticks.rend(); ++itr) {
+    Schedule(*itr);
+  }
+  EXPECT_EQ(wheel.Size(), ticks.size());
+  for (size_t i = 0; i < ticks.size(); ++i) {
+    // Nothing fires a tick early.
+    Advance(ticks[i] - 1);
+    EXPECT_EQ(fired.size(), i);
+    Advance(ticks[i]);
+    ASSERT_EQ(fired.size(), i + 1);
+    EXPECT_EQ(fired[i], ticks[i]);
+  }
+  EXPECT_EQ(wheel.Size(), 0U);
+}
+
+TEST_F(TimingWheelTest, CancelAndPending) {
+  const auto first = Schedule(1100);
+  const auto second = Schedule(1100);
+  EXPECT_TRUE(wheel.Pending(first));
+  EXPECT_TRUE(wheel.Cancel(first));
+  EXPECT_FALSE(wheel.Pending(first));
+  EXPECT_FALSE(wheel.Cancel(first));
+  // The entry of the cancelled timer is reused under a new id.
+  const auto third = Schedule(1200);
+  EXPECT_NE(third, first);
+  EXPECT_FALSE(wheel.Cancel(first));
+  Advance(1100);
+  EXPECT_EQ(fired, std::vector<uint64_t>({1100}));
+  EXPECT_FALSE(wheel.Pending(second));
+  EXPECT_TRUE(wheel.Pending(third));
+}
+
+TEST_F(TimingWheelTest, NextTick) {
+  EXPECT_EQ(wheel.NextTick(), UINT64_MAX);
+  // A past expiry fires on the next tick.
+  Schedule(10);
+  EXPECT_EQ(wheel.NextTick(), 1001U);
+  Advance(1001);
+  Schedule(1010);
+  EXPECT_EQ(wheel.NextTick(), 1010U);
+  Advance(1010);
+  // A timer on a higher level wakes the wheel when it moves down.
+  Schedule(2000);
+  EXPECT_EQ(wheel.NextTick(), 1792U);
+  Advance(1792);
+  EXPECT_EQ(wheel.NextTick(), 2000U);
+}
+
+TEST_F(TimingWheelTest, EarlierTimerWakesService) {
+  std::unique_ptr<TimerService> service;
+  ASSERT_TRUE(TimerService::Create(100 * 1000, &service).IsOk());
+  std::atomic<int> fired_count{0};
+  const uint64_t start_ns = CaptureTimeNs();
+  const auto later = service->Schedule(start_ns + 60000000000ULL, [&fired_count]() {
+    fired_count += 100;
+  });
+  // The thread sleeps until the later timer by now.
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  service->Schedule(start_ns + 30000000ULL, [&fired_count]() { ++fired_count; });
+  // Not earlier than the timer just scheduled, it doesn't wake the thread.
+  service->Schedule(start_ns + 40000000ULL, [&fired_count]() { ++fired_count; });
+  for (int i = 0; (i < 500) && (fired_count < 2); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  EXPECT_EQ(fired_count, 2);
+  EXPECT_LT(CaptureTimeNs() - start_ns, 1000000000ULL);
+  EXPECT_TRUE(service->Cancel(later));
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "core/timing_wheel.h"
+
+namespace test {
+
+class TimingWheelTest : public testing::Test {
+ protected:
+  // Start away from 0 so that the levels are not aligned.
+  TimingWheelTest() : wheel(1000) {}
+
+  // Schedule a timer recording 'tick' once it fires.
+  core::TimingWheel::TimerId Schedule(const uint64_t tick) {
+    return wheel.Schedule(tick, [this, tick]() { fired.push_back(tick); });
+  }
+
+  // Advance to 'tick' and run the timers that expired.
+  void Advance(const uint64_t tick) {
+    std::vector<std::function<void()>> expired;
+    wheel.Advance(tick, &expired);
+    for (auto& callback : expired) {
+      callback();
+    }
+  }
+
+  core::TimingWheel wheel;
+  std::vector<uint64_t> fired;
+};
+
+}